@@ -0,0 +1,61 @@
+/*
+ *  Copyright (C) [2019-2020] by Cambricon, Inc.
+ *
+ *  This file is part of CNStream-Gst.
+ *
+ *  CNStream-Gst is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU Lesser General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  CNStream-Gst is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU Lesser General Public License for more details.
+ *
+ *  You should have received a copy of the GNU Lesser General Public License
+ *  along with CNStream-Gst.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#include "frame_syncer.h"
+
+#include <gst/gst.h>
+
+QueueNotifier::~QueueNotifier()
+{
+  if (notifier_) {
+    cnrtDestroyNotifier(&notifier_);
+  }
+}
+
+bool
+QueueNotifier::place(cnrtQueue_t queue)
+{
+  std::lock_guard<std::mutex> lk(mutex_);
+  if (!notifier_ && CNRT_RET_SUCCESS != cnrtCreateNotifier(&notifier_)) {
+    GST_ERROR("Create cnrt notifier failed");
+    notifier_ = nullptr;
+    return false;
+  }
+  if (CNRT_RET_SUCCESS != cnrtPlaceNotifier(notifier_, queue)) {
+    GST_ERROR("Place cnrt notifier failed");
+    return false;
+  }
+  done_ = false;
+  return true;
+}
+
+bool
+QueueNotifier::wait()
+{
+  std::lock_guard<std::mutex> lk(mutex_);
+  if (done_ || !notifier_) {
+    return true;
+  }
+  if (CNRT_RET_SUCCESS != cnrtWaitNotifier(notifier_)) {
+    GST_ERROR("Wait cnrt notifier failed");
+    return false;
+  }
+  done_ = true;
+  return true;
+}
@@ -0,0 +1,69 @@
+/*
+ *  Copyright (C) [2019-2020] by Cambricon, Inc.
+ *
+ *  This file is part of CNStream-Gst.
+ *
+ *  CNStream-Gst is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU Lesser General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  CNStream-Gst is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU Lesser General Public License for more details.
+ *
+ *  You should have received a copy of the GNU Lesser General Public License
+ *  along with CNStream-Gst.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#ifndef FRAME_SYNCER_H_
+#define FRAME_SYNCER_H_
+
+#include <cnrt.h>
+
+#include <memory>
+#include <mutex>
+
+/**
+ * Waits for device work which is still writing the frame, attached to GstMluFrame by asynchronous producers.
+ * sync() may be called from several threads and more than once.
+ */
+struct FrameSyncer
+{
+  virtual bool sync() = 0;
+  virtual ~FrameSyncer() {}
+};
+
+/**
+ * Completion of work enqueued on a cnrt queue before place() is called.
+ */
+class QueueNotifier
+{
+public:
+  QueueNotifier() = default;
+  ~QueueNotifier();
+  QueueNotifier(const QueueNotifier&) = delete;
+  QueueNotifier& operator=(const QueueNotifier&) = delete;
+
+  bool place(cnrtQueue_t queue);
+  // blocks until work before notifier is done, returns immediately once done
+  bool wait();
+
+private:
+  std::mutex mutex_;
+  cnrtNotifier_t notifier_ = nullptr;
+  bool done_ = false;
+};
+
+struct NotifierFrameSyncer : public FrameSyncer
+{
+  explicit NotifierFrameSyncer(std::shared_ptr<QueueNotifier> n)
+    : notifier(std::move(n))
+  {}
+  bool sync() override { return notifier->wait(); }
+
+  std::shared_ptr<QueueNotifier> notifier;
+};
+
+#endif // FRAME_SYNCER_H_
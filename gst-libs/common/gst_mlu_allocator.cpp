@@ -0,0 +1,276 @@
+/*
+ *  Copyright (C) [2019-2020] by Cambricon, Inc.
+ *
+ *  This file is part of CNStream-Gst.
+ *
+ *  CNStream-Gst is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU Lesser General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  CNStream-Gst is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU Lesser General Public License for more details.
+ *
+ *  You should have received a copy of the GNU Lesser General Public License
+ *  along with CNStream-Gst.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#include "gst_mlu_allocator.h"
+
+#include <mutex>
+
+#include "device/mlu_context.h"
+#include "easyinfer/mlu_memory_op.h"
+#include "mlu_memory_pool.h"
+
+G_DEFINE_TYPE(GstMluAllocator, gst_mlu_allocator, GST_TYPE_ALLOCATOR);
+
+// sync head of GstSyncedMemory is not thread safe, and a plane may be mapped from several branches at the same time
+static std::mutex g_sync_mutex;
+
+// buffers are mapped and copied from any thread, which may not have bound the device of the frame
+static gboolean
+bind_device(gint device_id)
+{
+  thread_local gint bound_device_id = -1;
+  if (bound_device_id != device_id) {
+    try {
+      edk::MluContext context;
+      context.SetDeviceId(device_id);
+      context.BindDevice();
+    } catch (edk::Exception& e) {
+      GST_ERROR("Bind device %d failed, %s", device_id, e.what());
+      return FALSE;
+    }
+    MluMemoryPool::set_thread_device(device_id);
+    bound_device_id = device_id;
+  }
+  return TRUE;
+}
+
+static GstMluMemory*
+mlu_memory_new(GstMemory* parent, GstMluFrame_t frame, guint plane, gsize maxsize, gsize offset, gsize size)
+{
+  GstMluMemory* mem = g_slice_new0(GstMluMemory);
+  gst_memory_init(GST_MEMORY_CAST(mem), (GstMemoryFlags)0, gst_mlu_allocator_get(), parent, maxsize, 0, offset, size);
+  mem->frame = gst_mlu_frame_ref(frame);
+  mem->plane = plane;
+  mem->map_count = 0;
+  return mem;
+}
+
+static GstMemory*
+gst_mlu_allocator_alloc(GstAllocator* allocator, gsize size, GstAllocationParams* params)
+{
+  GstMluFrame_t frame = gst_mlu_frame_new();
+  frame->n_planes = 1;
+  frame->width = size;
+  frame->height = 1;
+  frame->stride[0] = size;
+  frame->data[0] = cn_syncedmem_new(size);
+
+  GstMemory* mem = gst_mlu_memory_new(frame, 0, size);
+  gst_mlu_frame_unref(frame);
+  return mem;
+}
+
+static void
+gst_mlu_allocator_free(GstAllocator* allocator, GstMemory* memory)
+{
+  GstMluMemory* mem = GST_MLU_MEMORY_CAST(memory);
+  if (mem->map_count) {
+    GST_WARNING("Free mlu memory %p which is still mapped", mem);
+  }
+  gst_mlu_frame_unref(mem->frame);
+  g_slice_free(GstMluMemory, mem);
+}
+
+static gpointer
+gst_mlu_memory_map_full(GstMemory* memory, GstMapInfo* info, gsize maxsize)
+{
+  GstMluMemory* mem = GST_MLU_MEMORY_CAST(memory);
+  GstSyncedMemory_t data = mem->frame->data[mem->plane];
+  gpointer ptr = nullptr;
+
+  if (!bind_device(mem->frame->device_id)) {
+    return nullptr;
+  }
+  if (!gst_mlu_frame_sync(mem->frame)) {
+    GST_ERROR("Map mlu memory failed, sync frame failed");
+    return nullptr;
+  }
+  std::lock_guard<std::mutex> lk(g_sync_mutex);
+  try {
+    if (info->flags & GST_MAP_WRITE) {
+      // host data will be newer than device data, sync back to MLU when device data is requested
+      ptr = cn_syncedmem_get_mutable_host_data(data);
+    } else {
+      ptr = const_cast<void*>(cn_syncedmem_get_host_data(data));
+    }
+  } catch (edk::Exception& e) {
+    GST_ERROR("Map mlu memory failed, %s", e.what());
+    return nullptr;
+  }
+  if (ptr) {
+    mem->map_count++;
+  }
+  return ptr;
+}
+
+static void
+gst_mlu_memory_unmap_full(GstMemory* memory, GstMapInfo* info)
+{
+  GstMluMemory* mem = GST_MLU_MEMORY_CAST(memory);
+  std::lock_guard<std::mutex> lk(g_sync_mutex);
+  mem->map_count--;
+}
+
+static GstMemory*
+gst_mlu_memory_copy(GstMemory* memory, gssize offset, gssize size)
+{
+  GstMluMemory* mem = GST_MLU_MEMORY_CAST(memory);
+  if (size == -1) {
+    size = memory->size > (gsize)offset ? memory->size - offset : 0;
+  }
+  if (size <= 0 || !bind_device(mem->frame->device_id)) {
+    return nullptr;
+  }
+
+  GstMluMemory* copy = GST_MLU_MEMORY_CAST(gst_mlu_allocator_alloc(nullptr, size, nullptr));
+  copy->frame->device_id = mem->frame->device_id;
+  copy->frame->channel_id = mem->frame->channel_id;
+
+  if (!gst_mlu_frame_sync(mem->frame)) {
+    GST_ERROR("Copy mlu memory failed, sync frame failed");
+    gst_memory_unref(GST_MEMORY_CAST(copy));
+    return nullptr;
+  }
+  std::lock_guard<std::mutex> lk(g_sync_mutex);
+  try {
+    auto src = static_cast<const guint8*>(cn_syncedmem_get_dev_data(mem->frame->data[mem->plane]));
+    auto dst = cn_syncedmem_get_mutable_dev_data(copy->frame->data[0]);
+    edk::MluMemoryOp::MemcpyD2D(dst, const_cast<guint8*>(src) + memory->offset + offset, size);
+  } catch (edk::Exception& e) {
+    GST_ERROR("Copy mlu memory failed, %s", e.what());
+    gst_memory_unref(GST_MEMORY_CAST(copy));
+    return nullptr;
+  }
+  return GST_MEMORY_CAST(copy);
+}
+
+static GstMemory*
+gst_mlu_memory_share(GstMemory* memory, gssize offset, gssize size)
+{
+  GstMluMemory* mem = GST_MLU_MEMORY_CAST(memory);
+  GstMemory* parent = memory->parent ? memory->parent : memory;
+  if (size == -1) {
+    size = memory->size - offset;
+  }
+
+  return GST_MEMORY_CAST(mlu_memory_new(parent, mem->frame, mem->plane, memory->maxsize, memory->offset + offset, size));
+}
+
+static void
+gst_mlu_allocator_class_init(GstMluAllocatorClass* klass)
+{
+  GstAllocatorClass* allocator_class = GST_ALLOCATOR_CLASS(klass);
+
+  allocator_class->alloc = gst_mlu_allocator_alloc;
+  allocator_class->free = gst_mlu_allocator_free;
+}
+
+static void
+gst_mlu_allocator_init(GstMluAllocator* self)
+{
+  GstAllocator* allocator = GST_ALLOCATOR_CAST(self);
+
+  allocator->mem_type = GST_MLU_MEMORY_TYPE;
+  allocator->mem_map_full = gst_mlu_memory_map_full;
+  allocator->mem_unmap_full = gst_mlu_memory_unmap_full;
+  allocator->mem_copy = gst_mlu_memory_copy;
+  allocator->mem_share = gst_mlu_memory_share;
+
+  GST_OBJECT_FLAG_SET(allocator, GST_ALLOCATOR_FLAG_CUSTOM_ALLOC);
+}
+
+GstAllocator*
+gst_mlu_allocator_get(void)
+{
+  static GstAllocator* allocator = nullptr;
+
+  if (g_once_init_enter(&allocator)) {
+    GstAllocator* _allocator = GST_ALLOCATOR_CAST(g_object_new(GST_TYPE_MLU_ALLOCATOR, NULL));
+    // never released, memories may outlive any element
+    GST_OBJECT_FLAG_SET(_allocator, GST_OBJECT_FLAG_MAY_BE_LEAKED);
+    g_once_init_leave(&allocator, _allocator);
+  }
+  return allocator;
+}
+
+GstMemory*
+gst_mlu_memory_new(GstMluFrame_t frame, guint plane, gsize size)
+{
+  g_return_val_if_fail(frame && plane < frame->n_planes && frame->data[plane], nullptr);
+  return GST_MEMORY_CAST(mlu_memory_new(nullptr, frame, plane, size, 0, size));
+}
+
+gboolean
+gst_is_mlu_memory(GstMemory* mem)
+{
+  return mem && gst_memory_is_type(mem, GST_MLU_MEMORY_TYPE);
+}
+
+static inline gsize
+plane_size(GstMluFrame_t frame, const GstVideoInfo* info, guint plane)
+{
+  return frame->stride[plane] * GST_VIDEO_FORMAT_INFO_SCALE_HEIGHT(info->finfo, plane, frame->height);
+}
+
+gboolean
+gst_mlu_frame_match_video_info(GstMluFrame_t frame, const GstVideoInfo* info)
+{
+  if (frame->n_planes != GST_VIDEO_INFO_N_PLANES(info) || frame->width != (guint)GST_VIDEO_INFO_WIDTH(info) ||
+      frame->height != (guint)GST_VIDEO_INFO_HEIGHT(info)) {
+    return FALSE;
+  }
+  gsize offset = 0;
+  for (guint i = 0; i < frame->n_planes; ++i) {
+    if (frame->stride[i] != (guint)GST_VIDEO_INFO_PLANE_STRIDE(info, i) ||
+        offset != GST_VIDEO_INFO_PLANE_OFFSET(info, i)) {
+      return FALSE;
+    }
+    offset += plane_size(frame, info, i);
+  }
+  return TRUE;
+}
+
+gboolean
+gst_buffer_set_mlu_frame_memory(GstBuffer* buffer, GstMluFrame_t frame, const GstVideoInfo* info)
+{
+  g_return_val_if_fail(gst_buffer_is_writable(buffer), FALSE);
+  g_return_val_if_fail(frame->n_planes > 0 && frame->n_planes <= GST_VIDEO_MAX_PLANES, FALSE);
+
+  gst_buffer_remove_all_memory(buffer);
+  GstVideoMeta* video_meta = gst_buffer_get_video_meta(buffer);
+  if (video_meta) {
+    gst_buffer_remove_meta(buffer, GST_META_CAST(video_meta));
+  }
+
+  gsize offset[GST_VIDEO_MAX_PLANES] = { 0 };
+  gint stride[GST_VIDEO_MAX_PLANES] = { 0 };
+  gsize total = 0;
+  for (guint i = 0; i < frame->n_planes; ++i) {
+    // chroma planes of odd height frames are rounded down by producers
+    gsize size = MIN(plane_size(frame, info, i), cn_syncedmem_get_size(frame->data[i]));
+    gst_buffer_append_memory(buffer, gst_mlu_memory_new(frame, i, size));
+    offset[i] = total;
+    stride[i] = frame->stride[i];
+    total += size;
+  }
+
+  gst_buffer_add_video_meta_full(buffer, GST_VIDEO_FRAME_FLAG_NONE, GST_VIDEO_INFO_FORMAT(info), frame->width,
+                                 frame->height, frame->n_planes, offset, stride);
+  return TRUE;
+}
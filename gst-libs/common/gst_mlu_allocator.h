@@ -0,0 +1,100 @@
+/*
+ *  Copyright (C) [2019-2020] by Cambricon, Inc.
+ *
+ *  This file is part of CNStream-Gst.
+ *
+ *  CNStream-Gst is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU Lesser General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  CNStream-Gst is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU Lesser General Public License for more details.
+ *
+ *  You should have received a copy of the GNU Lesser General Public License
+ *  along with CNStream-Gst.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#ifndef GST_MLU_ALLOCATOR_H_
+#define GST_MLU_ALLOCATOR_H_
+
+#include <gst/gst.h>
+#include <gst/video/video.h>
+
+#include "gst_mlu_frame.h"
+
+G_BEGIN_DECLS
+
+#define GST_MLU_MEMORY_TYPE "MluMemory"
+
+GType
+gst_mlu_allocator_get_type(void);
+#define GST_TYPE_MLU_ALLOCATOR (gst_mlu_allocator_get_type())
+#define GST_MLU_MEMORY_CAST(mem) ((GstMluMemory*)(mem))
+
+/**
+ * GstMemory wrapping one plane of GstMluFrame.
+ *
+ * Data stays on MLU until the memory is mapped, mapping for read synchronizes plane to host lazily, mapping for write
+ * marks host data as the latest, so that following device access synchronizes it back to MLU.
+ */
+struct GstMluMemory
+{
+  GstMemory mem;
+
+  GstMluFrame_t frame;
+  guint plane;
+  gint map_count;
+};
+
+typedef struct GstMluMemory GstMluMemory;
+
+struct GstMluAllocator
+{
+  GstAllocator parent;
+};
+
+struct GstMluAllocatorClass
+{
+  GstAllocatorClass parent_class;
+};
+
+typedef struct GstMluAllocator GstMluAllocator;
+typedef struct GstMluAllocatorClass GstMluAllocatorClass;
+
+/**
+ * Gets the allocator of MLU memory, transfer none.
+ *
+ * gst_allocator_alloc with this allocator allocates a single plane frame on MLU.
+ */
+GstAllocator*
+gst_mlu_allocator_get(void);
+
+/**
+ * Wraps plane of frame into GstMluMemory, takes a reference of frame.
+ */
+GstMemory*
+gst_mlu_memory_new(GstMluFrame_t frame, guint plane, gsize size);
+
+gboolean
+gst_is_mlu_memory(GstMemory* mem);
+
+/**
+ * Checks whether planes of frame are laid out as described by info, so that the frame could be mapped as info.
+ */
+gboolean
+gst_mlu_frame_match_video_info(GstMluFrame_t frame, const GstVideoInfo* info);
+
+/**
+ * Replaces memories of buffer with planes of frame and updates GstVideoMeta of buffer.
+ *
+ * @note buffer must be writable.
+ */
+gboolean
+gst_buffer_set_mlu_frame_memory(GstBuffer* buffer, GstMluFrame_t frame, const GstVideoInfo* info);
+
+G_END_DECLS
+
+#endif // GST_MLU_ALLOCATOR_H_
@@ -0,0 +1,115 @@
+/*
+ *  Copyright (C) [2019-2020] by Cambricon, Inc.
+ *
+ *  This file is part of CNStream-Gst.
+ *
+ *  CNStream-Gst is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU Lesser General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  CNStream-Gst is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU Lesser General Public License for more details.
+ *
+ *  You should have received a copy of the GNU Lesser General Public License
+ *  along with CNStream-Gst.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#include "gst_mlu_buffer_pool.h"
+
+#include "gst_mlu_allocator.h"
+#include "mlu_memory_meta.h"
+
+G_DEFINE_TYPE(GstMluBufferPool, gst_mlu_buffer_pool, GST_TYPE_BUFFER_POOL);
+// gst_mlu_buffer_pool_parent_class is defined in G_DEFINE_TYPE macro
+#define PARENT_CLASS gst_mlu_buffer_pool_parent_class
+
+static const gchar**
+gst_mlu_buffer_pool_get_options(GstBufferPool* pool)
+{
+  static const gchar* options[] = { GST_BUFFER_POOL_OPTION_VIDEO_META, NULL };
+  return options;
+}
+
+static gboolean
+gst_mlu_buffer_pool_set_config(GstBufferPool* pool, GstStructure* config)
+{
+  GstMluBufferPool* self = GST_MLU_BUFFER_POOL(pool);
+  GstCaps* caps;
+  guint size, min_buffers, max_buffers;
+
+  if (!gst_buffer_pool_config_get_params(config, &caps, &size, &min_buffers, &max_buffers) || !caps) {
+    GST_WARNING_OBJECT(pool, "invalid config, no caps");
+    return FALSE;
+  }
+  if (!gst_video_info_from_caps(&self->info, caps)) {
+    GST_WARNING_OBJECT(pool, "failed getting video info from caps %" GST_PTR_FORMAT, caps);
+    return FALSE;
+  }
+  GST_DEBUG_OBJECT(pool, "%dx%d, caps %" GST_PTR_FORMAT, self->info.width, self->info.height, caps);
+
+  gst_buffer_pool_config_set_params(config, caps, self->info.size, min_buffers, max_buffers);
+  return GST_BUFFER_POOL_CLASS(PARENT_CLASS)->set_config(pool, config);
+}
+
+static GstFlowReturn
+gst_mlu_buffer_pool_alloc_buffer(GstBufferPool* pool, GstBuffer** buffer, GstBufferPoolAcquireParams* params)
+{
+  GstMluBufferPool* self = GST_MLU_BUFFER_POOL(pool);
+  const GstVideoInfo* info = &self->info;
+
+  GstMluFrame_t frame = gst_mlu_frame_new();
+  frame->width = GST_VIDEO_INFO_WIDTH(info);
+  frame->height = GST_VIDEO_INFO_HEIGHT(info);
+  frame->n_planes = GST_VIDEO_INFO_N_PLANES(info);
+  for (guint i = 0; i < frame->n_planes; ++i) {
+    gsize end = i + 1 < frame->n_planes ? GST_VIDEO_INFO_PLANE_OFFSET(info, i + 1) : GST_VIDEO_INFO_SIZE(info);
+    frame->stride[i] = GST_VIDEO_INFO_PLANE_STRIDE(info, i);
+    frame->data[i] = cn_syncedmem_new(end - GST_VIDEO_INFO_PLANE_OFFSET(info, i));
+  }
+
+  GstBuffer* buf = gst_buffer_new();
+  // metas added here are marked as pooled by GstBufferPool and stay with buffer
+  gst_buffer_add_mlu_memory_meta(buf, frame, "mlu_buffer_pool");
+  if (!gst_buffer_set_mlu_frame_memory(buf, frame, info)) {
+    gst_buffer_unref(buf);
+    return GST_FLOW_ERROR;
+  }
+
+  g_atomic_int_inc(&self->n_allocated);
+  GST_DEBUG_OBJECT(pool, "allocated buffer %p, %d in total", buf, g_atomic_int_get(&self->n_allocated));
+  *buffer = buf;
+  return GST_FLOW_OK;
+}
+
+static void
+gst_mlu_buffer_pool_class_init(GstMluBufferPoolClass* klass)
+{
+  GstBufferPoolClass* pool_class = GST_BUFFER_POOL_CLASS(klass);
+
+  pool_class->get_options = gst_mlu_buffer_pool_get_options;
+  pool_class->set_config = gst_mlu_buffer_pool_set_config;
+  pool_class->alloc_buffer = gst_mlu_buffer_pool_alloc_buffer;
+}
+
+static void
+gst_mlu_buffer_pool_init(GstMluBufferPool* self)
+{
+  gst_video_info_init(&self->info);
+  self->n_allocated = 0;
+}
+
+GstBufferPool*
+gst_mlu_buffer_pool_new(void)
+{
+  return GST_BUFFER_POOL_CAST(g_object_new(GST_TYPE_MLU_BUFFER_POOL, NULL));
+}
+
+guint
+gst_mlu_buffer_pool_get_n_allocated(GstBufferPool* pool)
+{
+  g_return_val_if_fail(GST_IS_MLU_BUFFER_POOL(pool), 0);
+  return g_atomic_int_get(&GST_MLU_BUFFER_POOL(pool)->n_allocated);
+}
@@ -0,0 +1,67 @@
+/*
+ *  Copyright (C) [2019-2020] by Cambricon, Inc.
+ *
+ *  This file is part of CNStream-Gst.
+ *
+ *  CNStream-Gst is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU Lesser General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  CNStream-Gst is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU Lesser General Public License for more details.
+ *
+ *  You should have received a copy of the GNU Lesser General Public License
+ *  along with CNStream-Gst.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#ifndef GST_MLU_BUFFER_POOL_H_
+#define GST_MLU_BUFFER_POOL_H_
+
+#include <gst/gst.h>
+#include <gst/video/video.h>
+
+G_BEGIN_DECLS
+
+GType
+gst_mlu_buffer_pool_get_type(void);
+#define GST_TYPE_MLU_BUFFER_POOL (gst_mlu_buffer_pool_get_type())
+#define GST_MLU_BUFFER_POOL(obj) (G_TYPE_CHECK_INSTANCE_CAST((obj), GST_TYPE_MLU_BUFFER_POOL, GstMluBufferPool))
+#define GST_IS_MLU_BUFFER_POOL(obj) (G_TYPE_CHECK_INSTANCE_TYPE((obj), GST_TYPE_MLU_BUFFER_POOL))
+
+/**
+ * Buffer pool of MLU video frames.
+ *
+ * Each buffer carries a GstMluFrame laid out as the caps in config, both as MluMemoryMeta and as GstMluMemory planes
+ * with GstVideoMeta. Device memory of planes is allocated on first device access and kept while buffer is recycled.
+ */
+struct GstMluBufferPool
+{
+  GstBufferPool parent;
+
+  GstVideoInfo info;
+  gint n_allocated;
+};
+
+struct GstMluBufferPoolClass
+{
+  GstBufferPoolClass parent_class;
+};
+
+typedef struct GstMluBufferPool GstMluBufferPool;
+typedef struct GstMluBufferPoolClass GstMluBufferPoolClass;
+
+GstBufferPool*
+gst_mlu_buffer_pool_new(void);
+
+/**
+ * Gets number of buffers allocated by pool, buffers recycled are not counted again.
+ */
+guint
+gst_mlu_buffer_pool_get_n_allocated(GstBufferPool* pool);
+
+G_END_DECLS
+
+#endif // GST_MLU_BUFFER_POOL_H_
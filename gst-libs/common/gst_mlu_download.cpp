@@ -0,0 +1,109 @@
+/* 
+ *  Copyright (C) [2019-2020] by Cambricon, Inc.
+ * 
+ *  This file is part of CNStream-Gst.
+ *
+ *  CNStream-Gst is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU Lesser General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ * 
+ *  CNStream-Gst is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU Lesser General Public License for more details.
+ * 
+ *  You should have received a copy of the GNU Lesser General Public License
+ *  along with CNStream-Gst.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#include "gst_mlu_download.h"
+
+#include <cstring>
+
+#include "cnrt.h"
+
+// planes of formats on MLU starts with the component of the same index, e.g. y and uv of NV12
+static inline guint
+plane_rows(const GstVideoInfo* info, guint plane)
+{
+  return GST_VIDEO_INFO_COMP_HEIGHT(info, plane);
+}
+
+static gboolean
+copy_plane(guint8* dst, gsize dst_stride, void* src, gsize src_stride, gsize rows)
+{
+  if (dst_stride == src_stride) {
+    return cnrtMemcpy(dst, src, src_stride * rows, CNRT_MEM_TRANS_DIR_DEV2HOST) == CNRT_RET_SUCCESS;
+  }
+  // padding at the end of rows is dropped, row of plane is not wider than any of the strides
+  gsize row_size = MIN(dst_stride, src_stride);
+#if CNRT_MAJOR_VERSION < 5
+  // no 2D copy, copy plane as it is and move rows to their place, in the order not overwriting rows not moved yet
+  if (cnrtMemcpy(dst, src, src_stride * rows, CNRT_MEM_TRANS_DIR_DEV2HOST) != CNRT_RET_SUCCESS) {
+    return FALSE;
+  }
+  if (dst_stride < src_stride) {
+    for (gsize i = 1; i < rows; ++i) {
+      memmove(dst + i * dst_stride, dst + i * src_stride, row_size);
+    }
+  } else {
+    for (gsize i = rows - 1; i > 0; --i) {
+      memmove(dst + i * dst_stride, dst + i * src_stride, row_size);
+    }
+  }
+  return TRUE;
+#else
+  return cnrtMemcpy2D(dst, dst_stride, src, src_stride, row_size, rows, CNRT_MEM_TRANS_DIR_DEV2HOST) ==
+         CNRT_RET_SUCCESS;
+#endif
+}
+
+GstBuffer*
+gst_mlu_download_frame(const GstVideoInfo* info, void* const* planes, const guint* strides, gboolean strided)
+{
+  guint n_planes = GST_VIDEO_INFO_N_PLANES(info);
+  gsize offset[GST_VIDEO_MAX_PLANES];
+  gint stride[GST_VIDEO_MAX_PLANES];
+  gsize size = 0, alloc_size = 0;
+
+  for (guint i = 0; i < n_planes; ++i) {
+    stride[i] = strided ? strides[i] : GST_VIDEO_INFO_PLANE_STRIDE(info, i);
+    offset[i] = strided ? size : GST_VIDEO_INFO_PLANE_OFFSET(info, i);
+    size = offset[i] + (gsize)stride[i] * plane_rows(info, i);
+    // planes are copied as they are before their rows are moved in place
+    alloc_size = MAX(alloc_size, offset[i] + (gsize)MAX((guint)stride[i], strides[i]) * plane_rows(info, i));
+  }
+  if (!strided) {
+    size = GST_VIDEO_INFO_SIZE(info);
+  }
+
+  GstMemory* mem = gst_allocator_alloc(NULL, MAX(size, alloc_size), NULL);
+  GstMapInfo map;
+  if (!mem || !gst_memory_map(mem, &map, GST_MAP_WRITE)) {
+    GST_ERROR("map host memory failed");
+    if (mem)
+      gst_memory_unref(mem);
+    return nullptr;
+  }
+  gboolean ok = TRUE;
+  // planes copied as they are may overlap the following planes until rows are moved, so copy them in order
+  for (guint i = 0; ok && i < n_planes; ++i) {
+    ok = copy_plane(map.data + offset[i], stride[i], planes[i], strides[i], plane_rows(info, i));
+  }
+  gst_memory_unmap(mem, &map);
+  if (!ok) {
+    GST_ERROR("copy frame from device(MLU) to host failed");
+    gst_memory_unref(mem);
+    return nullptr;
+  }
+  gst_memory_resize(mem, 0, size);
+
+  GstBuffer* buffer = gst_buffer_new();
+  gst_buffer_append_memory(buffer, mem);
+  if (strided) {
+    gst_buffer_add_video_meta_full(buffer, GST_VIDEO_FRAME_FLAG_NONE, GST_VIDEO_INFO_FORMAT(info),
+                                   GST_VIDEO_INFO_WIDTH(info), GST_VIDEO_INFO_HEIGHT(info), n_planes, offset, stride);
+  }
+  return buffer;
+}
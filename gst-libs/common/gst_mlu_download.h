@@ -0,0 +1,42 @@
+/* 
+ *  Copyright (C) [2019-2020] by Cambricon, Inc.
+ * 
+ *  This file is part of CNStream-Gst.
+ *
+ *  CNStream-Gst is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU Lesser General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ * 
+ *  CNStream-Gst is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU Lesser General Public License for more details.
+ * 
+ *  You should have received a copy of the GNU Lesser General Public License
+ *  along with CNStream-Gst.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#ifndef GST_MLU_DOWNLOAD_H_
+#define GST_MLU_DOWNLOAD_H_
+
+#include <gst/gst.h>
+#include <gst/video/video.h>
+
+G_BEGIN_DECLS
+
+/**
+ * Downloads planes of a frame on MLU to a new buffer of host memory, laid out as info except for strides.
+ *
+ * With strided, planes are copied as they are, one copy each, and their offsets and strides on host are described by
+ * a GstVideoMeta. Otherwise downstream does not know video meta, rows are repacked to the default strides of info by a
+ * 2D copy, or moved in place after the copy where CNRT has no 2D copy. No intermediate host memory is allocated.
+ *
+ * Returns NULL on failure.
+ */
+GstBuffer*
+gst_mlu_download_frame(const GstVideoInfo* info, void* const* planes, const guint* strides, gboolean strided);
+
+G_END_DECLS
+
+#endif // GST_MLU_DOWNLOAD_H_
@@ -23,6 +23,7 @@
 #include <cstring>
 
 #include "frame_deallocator.h"
+#include "frame_syncer.h"
 
 GST_DEFINE_MINI_OBJECT_TYPE(GstMluFrame, gst_mlu_frame);
 
@@ -30,6 +31,12 @@ static void
 gst_mlu_frame_free(GstMluFrame_t frame)
 {
   GST_TRACE("Free mlu frame meta\n");
+  if (frame->syncer) {
+    // device may be still writing data, which is going to be returned to memory pool
+    frame->syncer->sync();
+    delete frame->syncer;
+    frame->syncer = nullptr;
+  }
   if (frame->deallocator) {
     frame->deallocator->deallocate();
     delete frame->deallocator;
@@ -55,6 +62,7 @@ gst_mlu_frame_new()
                        (GstMiniObjectFreeFunction)gst_mlu_frame_free);
 
   frame->deallocator = nullptr;
+  frame->syncer = nullptr;
   frame->device_id = 0;
   frame->n_planes = 0;
   memset(frame->stride, 0x0, MAXIMUM_PLANE * sizeof(guint));
@@ -62,3 +70,21 @@ gst_mlu_frame_new()
 
   return frame;
 }
+
+void
+gst_mlu_frame_set_syncer(GstMluFrame_t frame, struct FrameSyncer* syncer)
+{
+  if (frame->syncer) {
+    delete frame->syncer;
+  }
+  frame->syncer = syncer;
+}
+
+gboolean
+gst_mlu_frame_sync(GstMluFrame_t frame)
+{
+  if (!frame->syncer) {
+    return TRUE;
+  }
+  return frame->syncer->sync() ? TRUE : FALSE;
+}
@@ -34,6 +34,7 @@ gst_mlu_frame_get_type(void);
 #define MAXIMUM_PLANE 6
 
 struct FrameDeallocator;
+struct FrameSyncer;
 
 struct GstMluFrame
 {
@@ -51,6 +52,8 @@ struct GstMluFrame
   GstSyncedMemory_t data[MAXIMUM_PLANE];
 
   struct FrameDeallocator* deallocator;
+  // set when device work writing data may be still in progress, see gst_mlu_frame_sync
+  struct FrameSyncer* syncer;
 };
 
 typedef struct GstMluFrame* GstMluFrame_t;
@@ -70,6 +73,20 @@ gst_mlu_frame_unref(GstMluFrame_t frame)
   gst_mini_object_unref(GST_MINI_OBJECT_CAST(frame));
 }
 
+/**
+ * Takes ownership of syncer, replaces the one attached before. Only the producer owning the frame exclusively
+ * (e.g. buffer just acquired from pool) should call this.
+ */
+void
+gst_mlu_frame_set_syncer(GstMluFrame_t frame, struct FrameSyncer* syncer);
+
+/**
+ * Waits until frame data written by asynchronous producers is ready. Consumers must call this before accessing data
+ * of frame, either on device or on host.
+ */
+gboolean
+gst_mlu_frame_sync(GstMluFrame_t frame);
+
 G_END_DECLS
 
 #endif // GST_MLU_FRAME_H_
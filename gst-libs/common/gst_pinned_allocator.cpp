@@ -0,0 +1,143 @@
+/*
+ *  Copyright (C) [2019-2020] by Cambricon, Inc.
+ *
+ *  This file is part of CNStream-Gst.
+ *
+ *  CNStream-Gst is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU Lesser General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  CNStream-Gst is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU Lesser General Public License for more details.
+ *
+ *  You should have received a copy of the GNU Lesser General Public License
+ *  along with CNStream-Gst.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#include "gst_pinned_allocator.h"
+
+#include "cnrt.h"
+#include "device/mlu_context.h"
+
+G_DEFINE_TYPE(GstPinnedAllocator, gst_pinned_allocator, GST_TYPE_ALLOCATOR);
+
+struct GstPinnedMemory
+{
+  GstMemory mem;
+
+  // start of the page-locked block, shared by sub-memories
+  gpointer data;
+};
+
+static GstPinnedMemory*
+pinned_memory_new(GstAllocator* allocator, GstMemoryFlags flags, GstMemory* parent, gpointer data, gsize maxsize,
+                  gsize align, gsize offset, gsize size)
+{
+  GstPinnedMemory* mem = g_slice_new0(GstPinnedMemory);
+  gst_memory_init(GST_MEMORY_CAST(mem), flags, allocator, parent, maxsize, align, offset, size);
+  mem->data = data;
+  return mem;
+}
+
+static GstMemory*
+gst_pinned_allocator_alloc(GstAllocator* allocator, gsize size, GstAllocationParams* params)
+{
+  GstPinnedAllocator* self = GST_PINNED_ALLOCATOR(allocator);
+  gsize maxsize = size + params->prefix + params->padding;
+
+  // page-locked memory belongs to context of device, thread of upstream may not have bound it
+  thread_local gint bound_device_id = -1;
+  if (bound_device_id != self->device_id) {
+    try {
+      edk::MluContext context;
+      context.SetDeviceId(self->device_id);
+      context.BindDevice();
+    } catch (edk::Exception& e) {
+      GST_ERROR_OBJECT(self, "Bind device %d failed, %s", self->device_id, e.what());
+      return nullptr;
+    }
+    bound_device_id = self->device_id;
+  }
+
+  // blocks are page aligned, which satisfies any alignment asked
+  void* data = nullptr;
+  if (cnrtMallocHost(&data, maxsize, CNRT_MEMTYPE_LOCKED) != CNRT_RET_SUCCESS) {
+    GST_ERROR_OBJECT(self, "Allocate %" G_GSIZE_FORMAT " bytes of page-locked memory failed", maxsize);
+    return nullptr;
+  }
+  GST_LOG_OBJECT(self, "allocated %" G_GSIZE_FORMAT " bytes of page-locked memory %p", maxsize, data);
+  return GST_MEMORY_CAST(
+    pinned_memory_new(allocator, params->flags, nullptr, data, maxsize, params->align, params->prefix, size));
+}
+
+static void
+gst_pinned_allocator_free(GstAllocator* allocator, GstMemory* memory)
+{
+  GstPinnedMemory* mem = reinterpret_cast<GstPinnedMemory*>(memory);
+  if (!memory->parent && cnrtFreeHost(mem->data) != CNRT_RET_SUCCESS) {
+    GST_ERROR_OBJECT(allocator, "Free page-locked memory %p failed", mem->data);
+  }
+  g_slice_free(GstPinnedMemory, mem);
+}
+
+static gpointer
+gst_pinned_memory_map(GstMemory* memory, gsize maxsize, GstMapFlags flags)
+{
+  return reinterpret_cast<GstPinnedMemory*>(memory)->data;
+}
+
+static void
+gst_pinned_memory_unmap(GstMemory* memory)
+{}
+
+static GstMemory*
+gst_pinned_memory_share(GstMemory* memory, gssize offset, gssize size)
+{
+  GstPinnedMemory* mem = reinterpret_cast<GstPinnedMemory*>(memory);
+  GstMemory* parent = memory->parent ? memory->parent : memory;
+  if (size == -1) {
+    size = memory->size - offset;
+  }
+  GstMemoryFlags flags = (GstMemoryFlags)(GST_MINI_OBJECT_FLAGS(parent) | GST_MINI_OBJECT_FLAG_LOCK_READONLY);
+  return GST_MEMORY_CAST(pinned_memory_new(memory->allocator, flags, parent, mem->data, memory->maxsize, memory->align,
+                                           memory->offset + offset, size));
+}
+
+static void
+gst_pinned_allocator_class_init(GstPinnedAllocatorClass* klass)
+{
+  GstAllocatorClass* allocator_class = GST_ALLOCATOR_CLASS(klass);
+
+  allocator_class->alloc = gst_pinned_allocator_alloc;
+  allocator_class->free = gst_pinned_allocator_free;
+}
+
+static void
+gst_pinned_allocator_init(GstPinnedAllocator* self)
+{
+  GstAllocator* allocator = GST_ALLOCATOR_CAST(self);
+
+  allocator->mem_type = GST_PINNED_MEMORY_TYPE;
+  allocator->mem_map = gst_pinned_memory_map;
+  allocator->mem_unmap = gst_pinned_memory_unmap;
+  allocator->mem_share = gst_pinned_memory_share;
+  self->device_id = 0;
+}
+
+GstAllocator*
+gst_pinned_allocator_new(gint device_id)
+{
+  GstPinnedAllocator* allocator = GST_PINNED_ALLOCATOR(g_object_new(GST_TYPE_PINNED_ALLOCATOR, NULL));
+  allocator->device_id = device_id;
+  gst_object_ref_sink(allocator);
+  return GST_ALLOCATOR_CAST(allocator);
+}
+
+gboolean
+gst_is_pinned_memory(GstMemory* mem)
+{
+  return mem && gst_memory_is_type(mem, GST_PINNED_MEMORY_TYPE);
+}
@@ -0,0 +1,67 @@
+/*
+ *  Copyright (C) [2019-2020] by Cambricon, Inc.
+ *
+ *  This file is part of CNStream-Gst.
+ *
+ *  CNStream-Gst is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU Lesser General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  CNStream-Gst is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU Lesser General Public License for more details.
+ *
+ *  You should have received a copy of the GNU Lesser General Public License
+ *  along with CNStream-Gst.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#ifndef GST_PINNED_ALLOCATOR_H_
+#define GST_PINNED_ALLOCATOR_H_
+
+#include <gst/gst.h>
+
+G_BEGIN_DECLS
+
+#define GST_PINNED_MEMORY_TYPE "PinnedHostMemory"
+
+GType
+gst_pinned_allocator_get_type(void);
+#define GST_TYPE_PINNED_ALLOCATOR (gst_pinned_allocator_get_type())
+#define GST_PINNED_ALLOCATOR(obj) (G_TYPE_CHECK_INSTANCE_CAST((obj), GST_TYPE_PINNED_ALLOCATOR, GstPinnedAllocator))
+#define GST_IS_PINNED_ALLOCATOR(obj) (G_TYPE_CHECK_INSTANCE_TYPE((obj), GST_TYPE_PINNED_ALLOCATOR))
+
+/**
+ * Allocator of page-locked host memory.
+ *
+ * Memory is registered for DMA once when it is allocated, so copies from it to MLU, such as bitstream fed to the
+ * decoder, go without staging. Registration is expensive, memories are meant to be recycled by a GstBufferPool.
+ */
+struct GstPinnedAllocator
+{
+  GstAllocator parent;
+
+  gint device_id;
+};
+
+struct GstPinnedAllocatorClass
+{
+  GstAllocatorClass parent_class;
+};
+
+typedef struct GstPinnedAllocator GstPinnedAllocator;
+typedef struct GstPinnedAllocatorClass GstPinnedAllocatorClass;
+
+/**
+ * Creates an allocator of page-locked memory for MLU device_id, transfer full.
+ */
+GstAllocator*
+gst_pinned_allocator_new(gint device_id);
+
+gboolean
+gst_is_pinned_memory(GstMemory* mem);
+
+G_END_DECLS
+
+#endif // GST_PINNED_ALLOCATOR_H_
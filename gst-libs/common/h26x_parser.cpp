@@ -0,0 +1,419 @@
+/*
+ *  Copyright (C) [2019-2020] by Cambricon, Inc.
+ *
+ *  This file is part of CNStream-Gst.
+ *
+ *  CNStream-Gst is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU Lesser General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  CNStream-Gst is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU Lesser General Public License for more details.
+ *
+ *  You should have received a copy of the GNU Lesser General Public License
+ *  along with CNStream-Gst.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#include "h26x_parser.h"
+
+guint
+NalBitReader::read_bit()
+{
+  if (bit_ == 0) {
+    // 0x000003 is inserted to avoid start codes in payload
+    if (zeros_ >= 2 && pos_ < size_ && data_[pos_] == 0x03) {
+      pos_++;
+      zeros_ = 0;
+    }
+    if (pos_ >= size_) {
+      failed_ = true;
+      return 0;
+    }
+    zeros_ = data_[pos_] == 0 ? zeros_ + 1 : 0;
+  }
+  guint v = (data_[pos_] >> (7 - bit_)) & 1;
+  if (++bit_ == 8) {
+    bit_ = 0;
+    pos_++;
+  }
+  return v;
+}
+
+guint32
+NalBitReader::read_bits(guint n)
+{
+  guint32 v = 0;
+  for (guint i = 0; i < n; ++i) {
+    v = (v << 1) | read_bit();
+  }
+  return v;
+}
+
+guint32
+NalBitReader::read_ue()
+{
+  guint leading_zeros = 0;
+  while (read_bit() == 0) {
+    if (failed_ || ++leading_zeros > 31) {
+      failed_ = true;
+      return 0;
+    }
+  }
+  return (1u << leading_zeros) - 1 + read_bits(leading_zeros);
+}
+
+gint32
+NalBitReader::read_se()
+{
+  guint32 v = read_ue();
+  return v & 1 ? (gint32)((v + 1) / 2) : -(gint32)(v / 2);
+}
+
+std::vector<NalUnit>
+split_annexb(const guint8* data, gsize size)
+{
+  std::vector<NalUnit> units;
+  gsize start = 0;
+  bool in_unit = false;
+  gsize i = 0;
+  auto close = [&](gsize end) {
+    while (end > start && data[end - 1] == 0) {
+      end--;
+    }
+    if (in_unit && end > start) {
+      units.push_back({ data + start, end - start });
+    }
+  };
+  while (i + 3 <= size) {
+    if (data[i] == 0 && data[i + 1] == 0 && data[i + 2] == 1) {
+      close(i);
+      i += 3;
+      start = i;
+      in_unit = true;
+    } else {
+      i++;
+    }
+  }
+  close(size);
+  return units;
+}
+
+/* H.264 */
+
+// MaxDpbMbs of levels, Table A-1 of H.264
+static guint
+h264_max_dpb_mbs(guint level_idc)
+{
+  static const struct
+  {
+    guint level_idc;
+    guint max_dpb_mbs;
+  } levels[] = { { 9, 396 },      { 10, 396 },     { 11, 900 },     { 12, 2376 },    { 13, 2376 },
+                 { 20, 2376 },    { 21, 4752 },    { 22, 8100 },    { 30, 8100 },    { 31, 18000 },
+                 { 32, 20480 },   { 40, 32768 },   { 41, 32768 },   { 42, 34816 },   { 50, 110400 },
+                 { 51, 184320 },  { 52, 184320 },  { 60, 696320 },  { 61, 696320 },  { 62, 696320 } };
+  for (const auto& level : levels) {
+    if (level.level_idc == level_idc) {
+      return level.max_dpb_mbs;
+    }
+  }
+  return 696320;
+}
+
+static void
+h264_skip_scaling_list(NalBitReader* reader, guint size)
+{
+  gint last_scale = 8, next_scale = 8;
+  for (guint j = 0; j < size && next_scale != 0; ++j) {
+    next_scale = (last_scale + reader->read_se() + 256) % 256;
+    last_scale = next_scale == 0 ? last_scale : next_scale;
+  }
+}
+
+static bool
+h264_skip_hrd(NalBitReader* reader)
+{
+  guint cpb_cnt = reader->read_ue() + 1;
+  if (cpb_cnt > 32) {
+    return false;
+  }
+  reader->read_bits(8);
+  for (guint i = 0; i < cpb_cnt; ++i) {
+    reader->read_ue();
+    reader->read_ue();
+    reader->read_bits(1);
+  }
+  reader->read_bits(20);
+  return true;
+}
+
+bool
+h264_parse_sps(const guint8* nal, gsize size, H26xSequenceInfo* info)
+{
+  if (size < 4 || (nal[0] & 0x1f) != 7) {
+    return false;
+  }
+  NalBitReader reader(nal + 1, size - 1);
+  H26xSequenceInfo sps = {};
+  sps.profile_idc = reader.read_bits(8);
+  guint constraint_flags = reader.read_bits(8);
+  sps.level_idc = reader.read_bits(8);
+  reader.read_ue();
+
+  sps.chroma_format_idc = 1;
+  sps.bit_depth_luma = 8;
+  sps.bit_depth_chroma = 8;
+  bool separate_colour_plane = false;
+  switch (sps.profile_idc) {
+    case 100: case 110: case 122: case 244: case 44: case 83: case 86: case 118: case 128: case 138: case 139:
+    case 134: case 135:
+      sps.chroma_format_idc = reader.read_ue();
+      if (sps.chroma_format_idc > 3) {
+        return false;
+      }
+      if (sps.chroma_format_idc == 3) {
+        separate_colour_plane = reader.read_bits(1);
+      }
+      sps.bit_depth_luma = reader.read_ue() + 8;
+      sps.bit_depth_chroma = reader.read_ue() + 8;
+      reader.read_bits(1);
+      if (reader.read_bits(1)) {
+        for (guint i = 0; i < (sps.chroma_format_idc != 3 ? 8u : 12u); ++i) {
+          if (reader.read_bits(1)) {
+            h264_skip_scaling_list(&reader, i < 6 ? 16 : 64);
+          }
+        }
+      }
+      break;
+    default:
+      break;
+  }
+
+  reader.read_ue();
+  guint pic_order_cnt_type = reader.read_ue();
+  if (pic_order_cnt_type == 0) {
+    reader.read_ue();
+  } else if (pic_order_cnt_type == 1) {
+    reader.read_bits(1);
+    reader.read_se();
+    reader.read_se();
+    guint n_ref_frames_in_cycle = reader.read_ue();
+    if (n_ref_frames_in_cycle > 255) {
+      return false;
+    }
+    for (guint i = 0; i < n_ref_frames_in_cycle; ++i) {
+      reader.read_se();
+    }
+  }
+  guint max_num_ref_frames = reader.read_ue();
+  reader.read_bits(1);
+  guint width_in_mbs = reader.read_ue() + 1;
+  guint height_in_map_units = reader.read_ue() + 1;
+  guint frame_mbs_only = reader.read_bits(1);
+  if (!frame_mbs_only) {
+    reader.read_bits(1);
+  }
+  reader.read_bits(1);
+  guint crop_left = 0, crop_right = 0, crop_top = 0, crop_bottom = 0;
+  if (reader.read_bits(1)) {
+    crop_left = reader.read_ue();
+    crop_right = reader.read_ue();
+    crop_top = reader.read_ue();
+    crop_bottom = reader.read_ue();
+  }
+  guint height_in_mbs = (2 - frame_mbs_only) * height_in_map_units;
+  if (reader.failed() || width_in_mbs > 1024 || height_in_mbs > 1024 || max_num_ref_frames > 16) {
+    return false;
+  }
+
+  guint mbs = width_in_mbs * height_in_mbs;
+  sps.dpb_size = MAX(MIN(h264_max_dpb_mbs(sps.level_idc) / mbs, 16u), max_num_ref_frames);
+  // baseline has no B slices, POC type 2 ties output order to decoding order, constraint_set3 marks intra profiles
+  bool intra_profile = constraint_flags & 0x10;
+  switch (sps.profile_idc) {
+    case 44: case 86: case 100: case 110: case 122: case 244:
+      break;
+    default:
+      intra_profile = false;
+      break;
+  }
+  sps.num_reorder_frames = sps.profile_idc == 66 || pic_order_cnt_type == 2 || intra_profile ? 0 : sps.dpb_size;
+
+  // max_dec_frame_buffering in VUI overrides the level limit
+  if (reader.read_bits(1)) {
+    if (reader.read_bits(1) && reader.read_bits(8) == 255) {
+      reader.read_bits(32);
+    }
+    if (reader.read_bits(1)) {
+      reader.read_bits(1);
+    }
+    if (reader.read_bits(1)) {
+      reader.read_bits(4);
+      if (reader.read_bits(1)) {
+        reader.read_bits(24);
+      }
+    }
+    if (reader.read_bits(1)) {
+      reader.read_ue();
+      reader.read_ue();
+    }
+    if (reader.read_bits(1)) {
+      reader.read_bits(32);
+      reader.read_bits(32);
+      reader.read_bits(1);
+    }
+    guint nal_hrd = reader.read_bits(1);
+    if (nal_hrd && !h264_skip_hrd(&reader)) {
+      return false;
+    }
+    guint vcl_hrd = reader.read_bits(1);
+    if (vcl_hrd && !h264_skip_hrd(&reader)) {
+      return false;
+    }
+    if (nal_hrd || vcl_hrd) {
+      reader.read_bits(1);
+    }
+    reader.read_bits(1);
+    if (reader.read_bits(1)) {
+      reader.read_bits(1);
+      reader.read_ue();
+      reader.read_ue();
+      reader.read_ue();
+      reader.read_ue();
+      guint num_reorder_frames = reader.read_ue();
+      guint max_dec_frame_buffering = reader.read_ue();
+      if (!reader.failed() && max_dec_frame_buffering <= 16 && num_reorder_frames <= 16) {
+        sps.dpb_size = MAX(MAX(max_dec_frame_buffering, num_reorder_frames), 1u);
+        sps.num_reorder_frames = num_reorder_frames;
+      }
+    }
+  }
+
+  guint crop_unit_x = 1, crop_unit_y = 2 - frame_mbs_only;
+  if (sps.chroma_format_idc != 0 && !separate_colour_plane) {
+    crop_unit_x = sps.chroma_format_idc == 3 ? 1 : 2;
+    crop_unit_y *= sps.chroma_format_idc == 1 ? 2 : 1;
+  }
+  guint crop_x = (crop_left + crop_right) * crop_unit_x;
+  guint crop_y = (crop_top + crop_bottom) * crop_unit_y;
+  if (crop_x >= width_in_mbs * 16 || crop_y >= height_in_mbs * 16) {
+    return false;
+  }
+  sps.width = width_in_mbs * 16 - crop_x;
+  sps.height = height_in_mbs * 16 - crop_y;
+  *info = sps;
+  return true;
+}
+
+/* H.265 */
+
+static void
+h265_skip_profile_tier_level(NalBitReader* reader, guint max_sub_layers_minus1, H26xSequenceInfo* sps)
+{
+  reader->read_bits(3);
+  sps->profile_idc = reader->read_bits(5);
+  reader->read_bits(32);
+  reader->read_bits(4);
+  reader->read_bits(32);
+  reader->read_bits(12);
+  sps->level_idc = reader->read_bits(8);
+
+  guint profile_present[8] = { 0 }, level_present[8] = { 0 };
+  for (guint i = 0; i < max_sub_layers_minus1; ++i) {
+    profile_present[i] = reader->read_bits(1);
+    level_present[i] = reader->read_bits(1);
+  }
+  if (max_sub_layers_minus1 > 0) {
+    reader->read_bits(2 * (8 - max_sub_layers_minus1));
+  }
+  for (guint i = 0; i < max_sub_layers_minus1; ++i) {
+    if (profile_present[i]) {
+      reader->read_bits(32);
+      reader->read_bits(32);
+      reader->read_bits(24);
+    }
+    if (level_present[i]) {
+      reader->read_bits(8);
+    }
+  }
+}
+
+bool
+h265_parse_sps(const guint8* nal, gsize size, H26xSequenceInfo* info)
+{
+  if (size < 4 || ((nal[0] >> 1) & 0x3f) != 33) {
+    return false;
+  }
+  NalBitReader reader(nal + 2, size - 2);
+  H26xSequenceInfo sps = {};
+  reader.read_bits(4);
+  guint max_sub_layers_minus1 = reader.read_bits(3);
+  if (max_sub_layers_minus1 > 6) {
+    return false;
+  }
+  reader.read_bits(1);
+  h265_skip_profile_tier_level(&reader, max_sub_layers_minus1, &sps);
+
+  reader.read_ue();
+  sps.chroma_format_idc = reader.read_ue();
+  if (sps.chroma_format_idc > 3) {
+    return false;
+  }
+  bool separate_colour_plane = false;
+  if (sps.chroma_format_idc == 3) {
+    separate_colour_plane = reader.read_bits(1);
+  }
+  guint width = reader.read_ue();
+  guint height = reader.read_ue();
+  guint conf_left = 0, conf_right = 0, conf_top = 0, conf_bottom = 0;
+  if (reader.read_bits(1)) {
+    conf_left = reader.read_ue();
+    conf_right = reader.read_ue();
+    conf_top = reader.read_ue();
+    conf_bottom = reader.read_ue();
+  }
+  sps.bit_depth_luma = reader.read_ue() + 8;
+  sps.bit_depth_chroma = reader.read_ue() + 8;
+  reader.read_ue();
+  guint sub_layer_ordering_info = reader.read_bits(1);
+  guint max_dec_pic_buffering = 0, max_num_reorder_pics = 0;
+  for (guint i = sub_layer_ordering_info ? 0 : max_sub_layers_minus1; i <= max_sub_layers_minus1; ++i) {
+    max_dec_pic_buffering = reader.read_ue() + 1;
+    max_num_reorder_pics = reader.read_ue();
+    reader.read_ue();
+  }
+  if (reader.failed() || width == 0 || height == 0 || width > 16888 || height > 16888 || max_dec_pic_buffering > 16 ||
+      max_num_reorder_pics >= max_dec_pic_buffering) {
+    return false;
+  }
+
+  guint sub_width = 1, sub_height = 1;
+  if (!separate_colour_plane) {
+    sub_width = sps.chroma_format_idc == 1 || sps.chroma_format_idc == 2 ? 2 : 1;
+    sub_height = sps.chroma_format_idc == 1 ? 2 : 1;
+  }
+  guint crop_x = (conf_left + conf_right) * sub_width;
+  guint crop_y = (conf_top + conf_bottom) * sub_height;
+  if (crop_x >= width || crop_y >= height) {
+    return false;
+  }
+  sps.width = width - crop_x;
+  sps.height = height - crop_y;
+  sps.dpb_size = max_dec_pic_buffering;
+  sps.num_reorder_frames = max_num_reorder_pics;
+  *info = sps;
+  return true;
+}
+
+bool
+h26x_find_sps(bool hevc, const guint8* data, gsize size, H26xSequenceInfo* info)
+{
+  bool found = false;
+  for (const auto& nal : split_annexb(data, size)) {
+    found = (hevc ? h265_parse_sps(nal.data, nal.size, info) : h264_parse_sps(nal.data, nal.size, info)) || found;
+  }
+  return found;
+}
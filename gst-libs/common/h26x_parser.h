@@ -0,0 +1,97 @@
+/*
+ *  Copyright (C) [2019-2020] by Cambricon, Inc.
+ *
+ *  This file is part of CNStream-Gst.
+ *
+ *  CNStream-Gst is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU Lesser General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  CNStream-Gst is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU Lesser General Public License for more details.
+ *
+ *  You should have received a copy of the GNU Lesser General Public License
+ *  along with CNStream-Gst.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#ifndef GST_LIBS_H26X_PARSER_H_
+#define GST_LIBS_H26X_PARSER_H_
+
+#include <gst/gst.h>
+
+#include <vector>
+
+/**
+ * Reads bits of a NAL unit payload, emulation prevention bytes are skipped. Reading past the end yields zeros and
+ * sets failed().
+ */
+class NalBitReader
+{
+public:
+  NalBitReader(const guint8* data, gsize size)
+    : data_(data)
+    , size_(size)
+  {}
+
+  guint32 read_bits(guint n);
+  // unsigned and signed Exp-Golomb codes, ue(v) and se(v)
+  guint32 read_ue();
+  gint32 read_se();
+  bool failed() const { return failed_; }
+
+private:
+  guint read_bit();
+
+  const guint8* data_;
+  gsize size_;
+  gsize pos_ = 0;
+  guint bit_ = 0;
+  guint zeros_ = 0;
+  bool failed_ = false;
+};
+
+// NAL unit of an Annex-B byte stream, start code and trailing zero bytes excluded
+struct NalUnit
+{
+  const guint8* data;
+  gsize size;
+};
+
+std::vector<NalUnit>
+split_annexb(const guint8* data, gsize size);
+
+// stream properties carried by a sequence parameter set
+struct H26xSequenceInfo
+{
+  guint profile_idc;
+  guint level_idc;
+  // 0 monochrome, 1 4:2:0, 2 4:2:2, 3 4:4:4
+  guint chroma_format_idc;
+  guint bit_depth_luma;
+  guint bit_depth_chroma;
+  // cropped picture size
+  guint width;
+  guint height;
+  // pictures decoder keeps for reference and reordering
+  guint dpb_size;
+  // pictures that may precede a picture in decoding order and follow it in output order, 0 if stream has no B-frames
+  guint num_reorder_frames;
+};
+
+/**
+ * Parses a sequence parameter set NAL unit, header included. Returns false if unit is not an SPS or is malformed.
+ * Input is not trusted, any byte string is safe to parse.
+ */
+bool
+h264_parse_sps(const guint8* nal, gsize size, H26xSequenceInfo* info);
+bool
+h265_parse_sps(const guint8* nal, gsize size, H26xSequenceInfo* info);
+
+// parses the last SPS in Annex-B data, returns false if there is none
+bool
+h26x_find_sps(bool hevc, const guint8* data, gsize size, H26xSequenceInfo* info);
+
+#endif // GST_LIBS_H26X_PARSER_H_
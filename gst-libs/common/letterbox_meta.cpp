@@ -0,0 +1,101 @@
+/* 
+ *  Copyright (C) [2019-2020] by Cambricon, Inc.
+ * 
+ *  This file is part of CNStream-Gst.
+ *
+ *  CNStream-Gst is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU Lesser General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ * 
+ *  CNStream-Gst is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU Lesser General Public License for more details.
+ * 
+ *  You should have received a copy of the GNU Lesser General Public License
+ *  along with CNStream-Gst.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#include "letterbox_meta.h"
+
+#include <gst/video/video.h>
+
+GType
+gst_letterbox_meta_api_get_type(void)
+{
+  static volatile GType type;
+  // dropped by elements changing size of video, mapping is no longer valid then
+  static const gchar* tags[] = { GST_META_TAG_VIDEO_STR, GST_META_TAG_VIDEO_SIZE_STR, NULL };
+
+  if (g_once_init_enter(&type)) {
+    GType _type = gst_meta_api_type_register("GstLetterboxMetaAPI", tags);
+    g_once_init_leave(&type, _type);
+  }
+  return type;
+}
+
+static gboolean
+gst_letterbox_meta_init(GstMeta* meta, gpointer params, GstBuffer* buffer)
+{
+  LetterboxMeta_t letterbox_meta = (LetterboxMeta_t)meta;
+  letterbox_meta->src_x = letterbox_meta->src_y = letterbox_meta->src_w = letterbox_meta->src_h = 0;
+  letterbox_meta->dst_x = letterbox_meta->dst_y = letterbox_meta->dst_w = letterbox_meta->dst_h = 0;
+  letterbox_meta->scale_x = letterbox_meta->scale_y = 1.0;
+  return TRUE;
+}
+
+static gboolean
+gst_letterbox_meta_transform(GstBuffer* transbuf, GstMeta* meta, GstBuffer* buffer, GQuark type, gpointer data)
+{
+  LetterboxMeta_t letterbox_meta = (LetterboxMeta_t)meta;
+
+  if (GST_META_TRANSFORM_IS_COPY(type)) {
+    gst_buffer_add_letterbox_meta(transbuf, letterbox_meta->src_x, letterbox_meta->src_y, letterbox_meta->src_w,
+                                  letterbox_meta->src_h, letterbox_meta->dst_x, letterbox_meta->dst_y,
+                                  letterbox_meta->dst_w, letterbox_meta->dst_h);
+  } else {
+    /* transform type not supported */
+    return FALSE;
+  }
+  return TRUE;
+}
+
+const GstMetaInfo*
+gst_letterbox_meta_get_info(void)
+{
+  static const GstMetaInfo* letterbox_meta_info = nullptr;
+
+  if (g_once_init_enter(&letterbox_meta_info)) {
+    const GstMetaInfo* meta = gst_meta_register(LETTERBOX_META_API_TYPE, "LetterboxMeta", sizeof(struct LetterboxMeta),
+                                                gst_letterbox_meta_init, NULL, gst_letterbox_meta_transform);
+
+    g_once_init_leave(&letterbox_meta_info, meta);
+  }
+  return letterbox_meta_info;
+}
+
+LetterboxMeta_t
+gst_buffer_add_letterbox_meta(GstBuffer* buffer, gint src_x, gint src_y, gint src_w, gint src_h, gint dst_x,
+                              gint dst_y, gint dst_w, gint dst_h)
+{
+  LetterboxMeta_t meta;
+
+  g_return_val_if_fail(GST_IS_BUFFER(buffer), NULL);
+  g_return_val_if_fail(src_w > 0 && src_h > 0, NULL);
+
+  meta = (LetterboxMeta_t)(gst_buffer_add_meta(buffer, LETTERBOX_META_INFO, NULL));
+
+  meta->src_x = src_x;
+  meta->src_y = src_y;
+  meta->src_w = src_w;
+  meta->src_h = src_h;
+  meta->dst_x = dst_x;
+  meta->dst_y = dst_y;
+  meta->dst_w = dst_w;
+  meta->dst_h = dst_h;
+  meta->scale_x = (gdouble)dst_w / src_w;
+  meta->scale_y = (gdouble)dst_h / src_h;
+
+  return meta;
+}
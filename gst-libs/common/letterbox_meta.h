@@ -0,0 +1,65 @@
+/* 
+ *  Copyright (C) [2019-2020] by Cambricon, Inc.
+ * 
+ *  This file is part of CNStream-Gst.
+ *
+ *  CNStream-Gst is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU Lesser General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ * 
+ *  CNStream-Gst is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU Lesser General Public License for more details.
+ * 
+ *  You should have received a copy of the GNU Lesser General Public License
+ *  along with CNStream-Gst.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#ifndef LETTERBOX_META_H_
+#define LETTERBOX_META_H_
+
+#include <gst/gst.h>
+
+G_BEGIN_DECLS
+
+/**
+ * Describes an output resized with aspect ratio kept and padded to output size.
+ *
+ * Region (src_x, src_y, src_w, src_h) of input is resized to region (dst_x, dst_y, dst_w, dst_h) of output, the rest
+ * of output is padded. A point (x, y) on output maps back to input as
+ * (src_x + (x - dst_x) / scale_x, src_y + (y - dst_y) / scale_y).
+ * When output is also rotated or flipped, src region and the point mapped back are in input rotated or flipped the
+ * same way, e.g. of size height x width for a 90 degrees rotation.
+ */
+struct LetterboxMeta
+{
+  GstMeta meta;
+
+  gint src_x, src_y, src_w, src_h;
+  gint dst_x, dst_y, dst_w, dst_h;
+  gdouble scale_x, scale_y;
+};
+
+typedef struct LetterboxMeta* LetterboxMeta_t;
+
+GType
+gst_letterbox_meta_api_get_type(void);
+
+const GstMetaInfo*
+gst_letterbox_meta_get_info(void);
+
+#define LETTERBOX_META_API_TYPE (gst_letterbox_meta_api_get_type())
+
+#define gst_buffer_get_letterbox_meta(b) ((LetterboxMeta*)gst_buffer_get_meta((b), LETTERBOX_META_API_TYPE))
+
+#define LETTERBOX_META_INFO (gst_letterbox_meta_get_info())
+
+LetterboxMeta_t
+gst_buffer_add_letterbox_meta(GstBuffer* buffer, gint src_x, gint src_y, gint src_w, gint src_h, gint dst_x,
+                              gint dst_y, gint dst_w, gint dst_h);
+
+G_END_DECLS
+
+#endif // LETTERBOX_META_H_
@@ -57,13 +57,8 @@ gst_mlu_memory_meta_transform(GstBuffer* transbuf, GstMeta* meta, GstBuffer* buf
   MluMemoryMeta_t memory_meta = (MluMemoryMeta_t)meta;
 
   if (GST_META_TRANSFORM_IS_COPY(type)) {
-    GstMetaTransformCopy* copy = (GstMetaTransformCopy*)(data);
-    if (!copy->region) {
-      /* only copy if the complete data is copied as well */
-      gst_buffer_add_mlu_memory_meta(transbuf, gst_mlu_frame_ref(memory_meta->frame), memory_meta->meta_src);
-    } else {
-      return FALSE;
-    }
+    // frame is shared by reference, region copies keep referring to the whole frame as plane memories do
+    gst_buffer_add_mlu_memory_meta(transbuf, gst_mlu_frame_ref(memory_meta->frame), memory_meta->meta_src);
   } else {
     /* transform type not supported */
     return FALSE;
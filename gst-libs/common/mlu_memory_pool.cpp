@@ -0,0 +1,266 @@
+/*
+ *  Copyright (C) [2019-2020] by Cambricon, Inc.
+ *
+ *  This file is part of CNStream-Gst.
+ *
+ *  CNStream-Gst is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU Lesser General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  CNStream-Gst is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU Lesser General Public License for more details.
+ *
+ *  You should have received a copy of the GNU Lesser General Public License
+ *  along with CNStream-Gst.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#include "mlu_memory_pool.h"
+
+#include <cstdlib>
+#include <map>
+#include <mutex>
+
+#include "easyinfer/mlu_memory_op.h"
+
+// minimum size class, also the granularity of small blocks
+static constexpr size_t MIN_SIZE_CLASS = 4096;
+// check idle blocks at most once per interval
+static constexpr auto TRIM_CHECK_INTERVAL = std::chrono::seconds(1);
+
+static thread_local int g_thread_device = -1;
+
+void*
+MluMemoryBackend::alloc(size_t size)
+{
+  return edk::MluMemoryOp::AllocMlu(size);
+}
+
+void
+MluMemoryBackend::free(void* ptr)
+{
+  edk::MluMemoryOp::FreeMlu(ptr);
+}
+
+void*
+HostMemoryBackend::alloc(size_t size)
+{
+  return malloc(size);
+}
+
+void
+HostMemoryBackend::free(void* ptr)
+{
+  ::free(ptr);
+}
+
+MluMemoryPool::MluMemoryPool(std::unique_ptr<MemoryPoolBackend> backend, const MluMemoryPoolConfig& config)
+  : backend_(std::move(backend))
+  , config_(config)
+  , last_trim_check_(Clock::now())
+{}
+
+MluMemoryPool::~MluMemoryPool()
+{
+  std::lock_guard<std::mutex> lk(mtx_);
+  trim_locked(0);
+}
+
+MluMemoryPool*
+MluMemoryPool::get(int device_id)
+{
+  static std::mutex pools_mtx;
+  static std::map<int, MluMemoryPool*> pools;
+
+  std::lock_guard<std::mutex> lk(pools_mtx);
+  auto iter = pools.find(device_id);
+  if (iter != pools.end()) {
+    return iter->second;
+  }
+
+  MluMemoryPoolConfig config;
+  if (const char* max_cached = std::getenv("CN_MEMPOOL_MAX_CACHED_MB")) {
+    config.max_cached_bytes = static_cast<size_t>(std::strtoul(max_cached, nullptr, 10)) << 20;
+  }
+  if (const char* idle_timeout = std::getenv("CN_MEMPOOL_IDLE_TIMEOUT_MS")) {
+    config.idle_timeout_ms = static_cast<uint32_t>(std::strtoul(idle_timeout, nullptr, 10));
+  }
+  // never destructed, cnrt may have been released when static objects are destroyed
+  auto pool = new MluMemoryPool(std::unique_ptr<MemoryPoolBackend>(new MluMemoryBackend), config);
+  pools[device_id] = pool;
+  return pool;
+}
+
+void
+MluMemoryPool::set_thread_device(int device_id)
+{
+  g_thread_device = device_id;
+}
+
+int
+MluMemoryPool::thread_device()
+{
+  return g_thread_device;
+}
+
+size_t
+MluMemoryPool::size_class(size_t size)
+{
+  if (size <= MIN_SIZE_CLASS) {
+    return MIN_SIZE_CLASS;
+  }
+  // 8 classes between two powers of 2, so a block wastes less than 25%
+  size_t pow2 = MIN_SIZE_CLASS;
+  while (pow2 < size) {
+    pow2 <<= 1;
+  }
+  size_t granularity = pow2 >> 3;
+  return (size + granularity - 1) / granularity * granularity;
+}
+
+void*
+MluMemoryPool::alloc(size_t size)
+{
+  if (!size) {
+    return nullptr;
+  }
+
+  std::unique_lock<std::mutex> lk(mtx_);
+  auto now = Clock::now();
+  trim_idle_locked(now);
+
+  if (size > config_.max_block_size) {
+    stats_.misses++;
+    lk.unlock();
+    void* ptr = backend_->alloc(size);
+    lk.lock();
+    in_use_[ptr] = Allocation{ size, false };
+    stats_.in_use_bytes += size;
+    return ptr;
+  }
+
+  size_t cls = size_class(size);
+  auto iter = free_lists_.find(cls);
+  if (iter != free_lists_.end() && !iter->second.empty()) {
+    void* ptr = iter->second.back().ptr;
+    iter->second.pop_back();
+    stats_.hits++;
+    stats_.cached_bytes -= cls;
+    stats_.in_use_bytes += cls;
+    in_use_[ptr] = Allocation{ cls, true };
+    return ptr;
+  }
+
+  stats_.misses++;
+  lk.unlock();
+  void* ptr = backend_->alloc(cls);
+  lk.lock();
+  in_use_[ptr] = Allocation{ cls, true };
+  stats_.in_use_bytes += cls;
+  return ptr;
+}
+
+bool
+MluMemoryPool::free(void* ptr)
+{
+  if (!ptr) {
+    return true;
+  }
+
+  std::unique_lock<std::mutex> lk(mtx_);
+  auto iter = in_use_.find(ptr);
+  if (iter == in_use_.end()) {
+    return false;
+  }
+  size_t cls = iter->second.bytes;
+  bool pooled = iter->second.pooled;
+  in_use_.erase(iter);
+  stats_.in_use_bytes -= cls;
+
+  auto now = Clock::now();
+  if (!pooled || stats_.cached_bytes + cls > config_.max_cached_bytes) {
+    // not pooled, or cache is full
+    if (pooled) stats_.trimmed++;
+    lk.unlock();
+    backend_->free(ptr);
+    return true;
+  }
+
+  stats_.cached_bytes += cls;
+  free_lists_[cls].push_back(Block{ ptr, now });
+  trim_idle_locked(now);
+  return true;
+}
+
+void
+MluMemoryPool::trim(size_t target_bytes)
+{
+  std::lock_guard<std::mutex> lk(mtx_);
+  trim_locked(target_bytes);
+}
+
+void
+MluMemoryPool::trim_locked(size_t target_bytes)
+{
+  // release largest blocks first, they are the most likely to fragment device memory
+  for (auto iter = free_lists_.rbegin(); iter != free_lists_.rend() && stats_.cached_bytes > target_bytes; ++iter) {
+    auto& blocks = iter->second;
+    size_t n_freed = 0;
+    while (n_freed < blocks.size() && stats_.cached_bytes > target_bytes) {
+      backend_->free(blocks[n_freed].ptr);
+      stats_.cached_bytes -= iter->first;
+      ++n_freed;
+    }
+    blocks.erase(blocks.begin(), blocks.begin() + n_freed);
+    stats_.trimmed += n_freed;
+  }
+}
+
+void
+MluMemoryPool::trim_idle_locked(Clock::time_point now)
+{
+  if (!config_.idle_timeout_ms || now - last_trim_check_ < TRIM_CHECK_INTERVAL) {
+    return;
+  }
+  last_trim_check_ = now;
+
+  auto timeout = std::chrono::milliseconds(config_.idle_timeout_ms);
+  for (auto& free_list : free_lists_) {
+    auto& blocks = free_list.second;
+    // blocks are ordered by last used time, oldest at front
+    size_t n_idle = 0;
+    while (n_idle < blocks.size() && now - blocks[n_idle].last_used > timeout) {
+      backend_->free(blocks[n_idle].ptr);
+      ++n_idle;
+    }
+    if (n_idle) {
+      blocks.erase(blocks.begin(), blocks.begin() + n_idle);
+      stats_.cached_bytes -= n_idle * free_list.first;
+      stats_.trimmed += n_idle;
+    }
+  }
+}
+
+void
+MluMemoryPool::set_config(const MluMemoryPoolConfig& config)
+{
+  std::lock_guard<std::mutex> lk(mtx_);
+  config_ = config;
+  trim_locked(config_.max_cached_bytes);
+}
+
+MluMemoryPoolConfig
+MluMemoryPool::config() const
+{
+  std::lock_guard<std::mutex> lk(mtx_);
+  return config_;
+}
+
+MluMemoryPoolStats
+MluMemoryPool::stats() const
+{
+  std::lock_guard<std::mutex> lk(mtx_);
+  return stats_;
+}
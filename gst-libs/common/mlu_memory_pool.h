@@ -0,0 +1,164 @@
+/*
+ *  Copyright (C) [2019-2020] by Cambricon, Inc.
+ *
+ *  This file is part of CNStream-Gst.
+ *
+ *  CNStream-Gst is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU Lesser General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  CNStream-Gst is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU Lesser General Public License for more details.
+ *
+ *  You should have received a copy of the GNU Lesser General Public License
+ *  along with CNStream-Gst.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#ifndef GST_LIBS_MLU_MEMORY_POOL_H_
+#define GST_LIBS_MLU_MEMORY_POOL_H_
+
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <unordered_map>
+#include <vector>
+
+/**
+ * Allocation backend of MluMemoryPool, does the real alloc and free.
+ */
+struct MemoryPoolBackend
+{
+  virtual void* alloc(size_t size) = 0;
+  virtual void free(void* ptr) = 0;
+  virtual ~MemoryPoolBackend() {}
+};
+
+/**
+ * Allocates device memory on the MLU bound to the calling thread.
+ */
+struct MluMemoryBackend : public MemoryPoolBackend
+{
+  void* alloc(size_t size) override;
+  void free(void* ptr) override;
+};
+
+/**
+ * Allocates host memory, used to exercise the pool without MLU.
+ */
+struct HostMemoryBackend : public MemoryPoolBackend
+{
+  void* alloc(size_t size) override;
+  void free(void* ptr) override;
+};
+
+struct MluMemoryPoolConfig
+{
+  size_t max_cached_bytes = 512UL << 20; ///< Upper bound of bytes kept in free lists, 0 disables caching.
+  size_t max_block_size = 64UL << 20;    ///< Requests larger than this bypass the pool.
+  uint32_t idle_timeout_ms = 10000;      ///< Cached blocks unused for longer than this are trimmed, 0 never.
+};
+
+struct MluMemoryPoolStats
+{
+  uint64_t hits = 0;         ///< Allocations served from free lists.
+  uint64_t misses = 0;       ///< Allocations passed to backend.
+  uint64_t trimmed = 0;      ///< Cached blocks released to backend.
+  size_t cached_bytes = 0;   ///< Bytes in free lists.
+  size_t in_use_bytes = 0;   ///< Bytes handed out by pool and not yet returned.
+};
+
+/**
+ * Size-class memory pool with recycling free lists.
+ *
+ * Requests are rounded up to a size class (less than 25% larger than requested), freed blocks are kept in the free list
+ * of their class and reused by later requests of the same class. Cached blocks are released to backend when the cache
+ * grows over max_cached_bytes, or when they have been idle for idle_timeout_ms (checked lazily on alloc and free).
+ *
+ * @note Thread safe.
+ */
+class MluMemoryPool
+{
+public:
+  explicit MluMemoryPool(std::unique_ptr<MemoryPoolBackend> backend,
+                         const MluMemoryPoolConfig& config = MluMemoryPoolConfig());
+  ~MluMemoryPool();
+
+  /**
+   * Gets pool of MLU device memory for device_id.
+   *
+   * Default config could be overridden by environment variables CN_MEMPOOL_MAX_CACHED_MB and
+   * CN_MEMPOOL_IDLE_TIMEOUT_MS.
+   *
+   * @note Device pools live as long as the process, cached blocks are not released at exit.
+   */
+  static MluMemoryPool* get(int device_id);
+
+  /**
+   * Records device bound to the calling thread, -1 if none.
+   *
+   * Pool memory is only valid on the device it is allocated on, callers use this to pick the pool of current device.
+   */
+  static void set_thread_device(int device_id);
+  static int thread_device();
+
+  /**
+   * Allocates at least size bytes.
+   *
+   * @note Exceptions thrown by backend are passed to caller.
+   */
+  void* alloc(size_t size);
+
+  /**
+   * Returns ptr allocated by this pool.
+   *
+   * @return false if ptr is not allocated by this pool.
+   */
+  bool free(void* ptr);
+
+  /**
+   * Releases cached blocks to backend until cached bytes are not greater than target_bytes.
+   */
+  void trim(size_t target_bytes = 0);
+
+  void set_config(const MluMemoryPoolConfig& config);
+  MluMemoryPoolConfig config() const;
+  MluMemoryPoolStats stats() const;
+
+  static size_t size_class(size_t size);
+
+private:
+  using Clock = std::chrono::steady_clock;
+  struct Block
+  {
+    void* ptr;
+    Clock::time_point last_used;
+  };
+
+  void trim_locked(size_t target_bytes);
+  void trim_idle_locked(Clock::time_point now);
+
+  MluMemoryPool(const MluMemoryPool&) = delete;
+  MluMemoryPool& operator=(const MluMemoryPool&) = delete;
+
+  std::unique_ptr<MemoryPoolBackend> backend_;
+  MluMemoryPoolConfig config_;
+  MluMemoryPoolStats stats_;
+  // size class -> cached blocks, most recently freed at back
+  std::map<size_t, std::vector<Block>> free_lists_;
+  struct Allocation
+  {
+    size_t bytes;
+    bool pooled;
+  };
+  std::unordered_map<void*, Allocation> in_use_;
+  Clock::time_point last_trim_check_;
+  mutable std::mutex mtx_;
+};
+
+#endif // GST_LIBS_MLU_MEMORY_POOL_H_
@@ -33,6 +33,7 @@
 
 #include "device/mlu_context.h"
 #include "easyinfer/mlu_memory_op.h"
+#include "mlu_memory_pool.h"
 
 constexpr static uint32_t SYNCMEM_ERRMSG_LENGTH = 1024;
 
@@ -53,6 +54,7 @@ struct GstSyncedMemory
   char err_msg[SYNCMEM_ERRMSG_LENGTH];
 
   edk::MluContext ctx;
+  MluMemoryPool* pool = nullptr; ///< Pool which MLU data is allocated from.
 }; // struct GstSyncedMemory
 
 GstSyncedMemory_t
@@ -77,7 +79,11 @@ cn_syncedmem_free(GstSyncedMemory_t mem)
   if (mem->dev_ptr && mem->own_dev_data) {
     // set device id before call cnrt functions, or CNRT_RET_ERR_EXISTS will be returned from cnrt function
     try {
-      edk::MluMemoryOp::FreeMlu(mem->dev_ptr);
+      if (!mem->pool->free(mem->dev_ptr)) {
+        snprintf(mem->err_msg, SYNCMEM_ERRMSG_LENGTH, "Free MLU memory %p failed, it is not from memory pool",
+                 mem->dev_ptr);
+        return false;
+      }
     } catch (edk::Exception& e) {
       snprintf(mem->err_msg, SYNCMEM_ERRMSG_LENGTH, "%s", e.what());
       return false;
@@ -111,18 +117,27 @@ to_cpu(GstSyncedMemory_t mem)
   }
 }
 
+static inline void*
+alloc_mlu(GstSyncedMemory_t mem)
+{
+  // blocks are cached per device, reuse them instead of calling cnrtMalloc for every frame
+  int dev_id = MluMemoryPool::thread_device();
+  mem->pool = MluMemoryPool::get(dev_id < 0 ? mem->ctx.DeviceId() : dev_id);
+  return mem->pool->alloc(mem->size);
+}
+
 static inline void
 to_mlu(GstSyncedMemory_t mem)
 {
   switch (mem->head) {
     case GST_SYNCHEAD_UNINITIALIZED:
-      mem->dev_ptr = edk::MluMemoryOp::AllocMlu(mem->size);
+      mem->dev_ptr = alloc_mlu(mem);
       mem->head = GST_SYNCHEAD_AT_MLU;
       mem->own_dev_data = true;
       break;
     case GST_SYNCHEAD_AT_CPU:
       if (NULL == mem->dev_ptr) {
-        mem->dev_ptr = edk::MluMemoryOp::AllocMlu(mem->size);
+        mem->dev_ptr = alloc_mlu(mem);
         mem->own_dev_data = true;
       }
       edk::MluMemoryOp::MemcpyH2D(mem->dev_ptr, mem->host_ptr, mem->size);
@@ -173,7 +188,11 @@ cn_syncedmem_set_dev_data(GstSyncedMemory_t mem, void* data)
   }
   if (mem->own_dev_data) {
     try {
-      edk::MluMemoryOp::FreeMlu(mem->dev_ptr);
+      if (!mem->pool->free(mem->dev_ptr)) {
+        snprintf(mem->err_msg, SYNCMEM_ERRMSG_LENGTH, "Free MLU memory %p failed, it is not from memory pool",
+                 mem->dev_ptr);
+        return false;
+      }
     } catch (edk::Exception& e) {
       snprintf(mem->err_msg, SYNCMEM_ERRMSG_LENGTH, "%s", e.what());
       return false;
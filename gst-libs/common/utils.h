@@ -24,6 +24,7 @@
 
 #include <gst/gst.h>
 #include "device/mlu_context.h"
+#include "mlu_memory_pool.h"
 
 static inline gboolean
 set_cnrt_env(GstElement* self, int device_id)
@@ -32,6 +33,7 @@ set_cnrt_env(GstElement* self, int device_id)
     edk::MluContext context;
     context.SetDeviceId(device_id);
     context.BindDevice();
+    MluMemoryPool::set_thread_device(device_id);
   } catch (edk::Exception& err) {
     GST_ELEMENT_ERROR(self, LIBRARY, SETTINGS, ("set mlu environment failed"), ("%s", err.what()));
     return FALSE;
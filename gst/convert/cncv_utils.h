@@ -0,0 +1,102 @@
+/*
+ *  Copyright (C) [2019-2020] by Cambricon, Inc.
+ *
+ *  This file is part of CNStream-Gst.
+ *
+ *  CNStream-Gst is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU Lesser General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  CNStream-Gst is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU Lesser General Public License for more details.
+ *
+ *  You should have received a copy of the GNU Lesser General Public License
+ *  along with CNStream-Gst.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#ifndef GST_CONVERT_CNCV_UTILS_H_
+#define GST_CONVERT_CNCV_UTILS_H_
+
+#include <gst/gst.h>
+#include <gst/video/video.h>
+
+#include "cncv.h"
+
+static inline int get_channel_num_plane0(GstVideoFormat fmt)
+{
+  switch (fmt) {
+    case GST_VIDEO_FORMAT_NV12: case GST_VIDEO_FORMAT_NV21: case GST_VIDEO_FORMAT_I420:
+      return 1;
+    case GST_VIDEO_FORMAT_RGB: case GST_VIDEO_FORMAT_BGR:
+      return 3;
+    case GST_VIDEO_FORMAT_RGBA: case GST_VIDEO_FORMAT_BGRA: case GST_VIDEO_FORMAT_ARGB: case GST_VIDEO_FORMAT_ABGR:
+      return 4;
+    default:
+      GST_ERROR("Unsupported pixel format");
+      return 0;
+  }
+}
+
+static inline cncvPixelFormat format_cast(GstVideoFormat fmt)
+{
+  switch (fmt) {
+    case GST_VIDEO_FORMAT_NV12:
+      return CNCV_PIX_FMT_NV12;
+    case GST_VIDEO_FORMAT_NV21:
+      return CNCV_PIX_FMT_NV21;
+    case GST_VIDEO_FORMAT_I420:
+      return CNCV_PIX_FMT_I420;
+    case GST_VIDEO_FORMAT_RGB:
+      return CNCV_PIX_FMT_RGB;
+    case GST_VIDEO_FORMAT_BGR:
+      return CNCV_PIX_FMT_BGR;
+    case GST_VIDEO_FORMAT_RGBA:
+      return CNCV_PIX_FMT_RGBA;
+    case GST_VIDEO_FORMAT_BGRA:
+      return CNCV_PIX_FMT_BGRA;
+    case GST_VIDEO_FORMAT_ARGB:
+      return CNCV_PIX_FMT_ARGB;
+    case GST_VIDEO_FORMAT_ABGR:
+      return CNCV_PIX_FMT_ABGR;
+    default:
+      GST_ERROR("unsupport pixel format");
+      return CNCV_PIX_FMT_INVALID;
+  }
+}
+
+static inline bool isYUV420sp(GstVideoFormat fmt) {
+  if (fmt == GST_VIDEO_FORMAT_NV12 || fmt == GST_VIDEO_FORMAT_NV21)
+    return true;
+
+  return false;
+}
+
+static inline bool isRGB(GstVideoFormat fmt) {
+  if (fmt == GST_VIDEO_FORMAT_RGB || fmt == GST_VIDEO_FORMAT_BGR ||
+      fmt == GST_VIDEO_FORMAT_RGBA || fmt == GST_VIDEO_FORMAT_BGRA ||
+      fmt == GST_VIDEO_FORMAT_ARGB || fmt == GST_VIDEO_FORMAT_ABGR)
+    return true;
+
+  return false;
+}
+
+static inline cncvImageDescriptor video_info_to_desc(const GstVideoInfo& info)
+{
+  cncvImageDescriptor desc;
+  desc.width = info.width;
+  desc.height = info.height;
+  desc.pixel_fmt = format_cast(info.finfo->format);
+  desc.color_space = CNCV_COLOR_SPACE_BT_601;
+  desc.depth = CNCV_DEPTH_8U;
+  desc.stride[0] = info.stride[0];
+  desc.stride[1] = info.stride[1];
+  desc.stride[2] = info.stride[2];
+  desc.stride[3] = info.stride[3];
+  desc.stride[4] = desc.stride[5] = 0;
+  return desc;
+}
+
+#endif // GST_CONVERT_CNCV_UTILS_H_
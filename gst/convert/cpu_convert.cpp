@@ -0,0 +1,377 @@
+/* 
+ *  Copyright (C) [2019-2020] by Cambricon, Inc.
+ * 
+ *  This file is part of CNStream-Gst.
+ *
+ *  CNStream-Gst is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU Lesser General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ * 
+ *  CNStream-Gst is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU Lesser General Public License for more details.
+ * 
+ *  You should have received a copy of the GNU Lesser General Public License
+ *  along with CNStream-Gst.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#include "cpu_convert.h"
+
+#include <atomic>
+#include <cstring>
+
+#ifdef WITH_LIBYUV
+#include "libyuv/convert_argb.h"
+#include "libyuv/convert_from_argb.h"
+#include "libyuv/planar_functions.h"
+#include "libyuv/rotate_argb.h"
+#include "libyuv/scale_argb.h"
+#endif
+
+// rows converted at a time through intermediate ARGB, small enough to stay in cache
+static constexpr guint CHUNK_ROWS = 16;
+
+SliceWorkers::SliceWorkers(guint n_threads)
+{
+  for (guint i = 1; i < n_threads; ++i) {
+    threads_.emplace_back(&SliceWorkers::loop, this);
+  }
+}
+
+SliceWorkers::~SliceWorkers()
+{
+  {
+    std::lock_guard<std::mutex> lk(mutex_);
+    stop_ = true;
+  }
+  cond_.notify_all();
+  for (auto& t : threads_) {
+    t.join();
+  }
+}
+
+void
+SliceWorkers::run(guint n, const std::function<void(guint)>& task)
+{
+  std::unique_lock<std::mutex> lk(mutex_);
+  task_ = &task;
+  n_ = n;
+  next_ = 0;
+  done_ = 0;
+  cond_.notify_all();
+  work(&lk);
+  done_cond_.wait(lk, [this] { return done_ == n_; });
+  task_ = nullptr;
+}
+
+void
+SliceWorkers::work(std::unique_lock<std::mutex>* lk)
+{
+  while (task_ && next_ < n_) {
+    guint i = next_++;
+    const std::function<void(guint)>* task = task_;
+    lk->unlock();
+    (*task)(i);
+    lk->lock();
+    if (++done_ == n_) {
+      done_cond_.notify_all();
+    }
+  }
+}
+
+void
+SliceWorkers::loop()
+{
+  std::unique_lock<std::mutex> lk(mutex_);
+  while (true) {
+    cond_.wait(lk, [this] { return stop_ || (task_ && next_ < n_); });
+    if (stop_) {
+      return;
+    }
+    work(&lk);
+  }
+}
+
+// slice i of n splitting rows, begins at even row as chroma rows are shared by two rows
+static inline void
+slice_rows(guint rows, guint n, guint i, guint* begin, guint* end)
+{
+  guint step = ((rows + n - 1) / n + 1) & ~1u;
+  *begin = MIN(i * step, rows);
+  *end = MIN(*begin + step, rows);
+}
+
+#ifdef WITH_LIBYUV
+
+static inline const guint8*
+plane_data(const GstVideoFrame* frame, guint plane, gint x, gint y)
+{
+  return static_cast<const guint8*>(GST_VIDEO_FRAME_PLANE_DATA(frame, plane)) +
+         y * GST_VIDEO_FRAME_PLANE_STRIDE(frame, plane) + x;
+}
+
+// rows [row, row + rows) of roi to libyuv ARGB, which is BGRA in memory
+static bool
+yuv_to_argb(const GstVideoFrame* src, const GstVideoRectangle& roi, gint row, gint rows, guint8* dst, gint dst_stride)
+{
+  gint x = roi.x, y = roi.y + row;
+  switch (GST_VIDEO_FRAME_FORMAT(src)) {
+    case GST_VIDEO_FORMAT_NV12:
+      // uv are interleaved, offset in bytes equals to x
+      return libyuv::NV12ToARGB(plane_data(src, 0, x, y), GST_VIDEO_FRAME_PLANE_STRIDE(src, 0),
+                                plane_data(src, 1, x, y / 2), GST_VIDEO_FRAME_PLANE_STRIDE(src, 1), dst, dst_stride,
+                                roi.width, rows) == 0;
+    case GST_VIDEO_FORMAT_NV21:
+      return libyuv::NV21ToARGB(plane_data(src, 0, x, y), GST_VIDEO_FRAME_PLANE_STRIDE(src, 0),
+                                plane_data(src, 1, x, y / 2), GST_VIDEO_FRAME_PLANE_STRIDE(src, 1), dst, dst_stride,
+                                roi.width, rows) == 0;
+    case GST_VIDEO_FORMAT_I420:
+      return libyuv::I420ToARGB(plane_data(src, 0, x, y), GST_VIDEO_FRAME_PLANE_STRIDE(src, 0),
+                                plane_data(src, 1, x / 2, y / 2), GST_VIDEO_FRAME_PLANE_STRIDE(src, 1),
+                                plane_data(src, 2, x / 2, y / 2), GST_VIDEO_FRAME_PLANE_STRIDE(src, 2), dst, dst_stride,
+                                roi.width, rows) == 0;
+    default:
+      return false;
+  }
+}
+
+// libyuv names formats by the order in a little endian word, GstVideoFormat by the order in memory
+static bool
+argb_to(GstVideoFormat fmt, const guint8* src, gint src_stride, guint8* dst, gint dst_stride, gint width, gint rows)
+{
+  switch (fmt) {
+    case GST_VIDEO_FORMAT_BGRA:
+      return libyuv::ARGBCopy(src, src_stride, dst, dst_stride, width, rows) == 0;
+    case GST_VIDEO_FORMAT_RGBA:
+      return libyuv::ARGBToABGR(src, src_stride, dst, dst_stride, width, rows) == 0;
+    case GST_VIDEO_FORMAT_ARGB:
+      return libyuv::ARGBToBGRA(src, src_stride, dst, dst_stride, width, rows) == 0;
+    case GST_VIDEO_FORMAT_ABGR:
+      return libyuv::ARGBToRGBA(src, src_stride, dst, dst_stride, width, rows) == 0;
+    case GST_VIDEO_FORMAT_BGR:
+      return libyuv::ARGBToRGB24(src, src_stride, dst, dst_stride, width, rows) == 0;
+    case GST_VIDEO_FORMAT_RGB:
+      return libyuv::ARGBToRAW(src, src_stride, dst, dst_stride, width, rows) == 0;
+    default:
+      return false;
+  }
+}
+
+static inline void
+fill_pixels(guint8* dst, const guint8* pixel, guint bpp, guint n)
+{
+  for (guint i = 0; i < n; ++i) {
+    memcpy(dst + i * bpp, pixel, bpp);
+  }
+}
+
+#endif  // WITH_LIBYUV
+
+CpuConverter::CpuConverter(guint n_threads)
+  : workers_(n_threads)
+{}
+
+bool
+CpuConverter::supports(GstVideoFormat in, GstVideoFormat out)
+{
+#ifdef WITH_LIBYUV
+  bool yuv = in == GST_VIDEO_FORMAT_NV12 || in == GST_VIDEO_FORMAT_NV21 || in == GST_VIDEO_FORMAT_I420;
+  bool rgb = out == GST_VIDEO_FORMAT_RGB || out == GST_VIDEO_FORMAT_BGR || out == GST_VIDEO_FORMAT_RGBA ||
+             out == GST_VIDEO_FORMAT_BGRA || out == GST_VIDEO_FORMAT_ARGB || out == GST_VIDEO_FORMAT_ABGR;
+  return yuv && rgb;
+#else
+  return false;
+#endif
+}
+
+bool
+CpuConverter::transposes(GstVideoOrientationMethod method)
+{
+  return method == GST_VIDEO_ORIENTATION_90R || method == GST_VIDEO_ORIENTATION_90L ||
+         method == GST_VIDEO_ORIENTATION_UL_LR || method == GST_VIDEO_ORIENTATION_UR_LL;
+}
+
+bool
+CpuConverter::to_argb(const GstVideoFrame* src, const GstVideoRectangle& roi)
+{
+#ifdef WITH_LIBYUV
+  guint n = workers_.size();
+  std::atomic<bool> ok(true);
+  argb_.resize(roi.width * roi.height * 4);
+  workers_.run(n, [&](guint i) {
+    guint begin, end;
+    slice_rows(roi.height, n, i, &begin, &end);
+    if (begin < end && !yuv_to_argb(src, roi, begin, end - begin, argb_.data() + begin * roi.width * 4, roi.width * 4)) {
+      ok = false;
+    }
+  });
+  return ok;
+#else
+  return false;
+#endif
+}
+
+// roi is resized in its own orientation, then rotated or flipped into dst roi
+bool
+CpuConverter::convert_oriented(const GstVideoFrame* src, const GstVideoRectangle& roi, GstVideoFormat fmt, guint8* dst,
+                               gint dst_stride, const GstVideoRectangle& dst_roi, GstVideoOrientationMethod method)
+{
+#ifdef WITH_LIBYUV
+  if (!to_argb(src, roi)) {
+    return false;
+  }
+  gint width = transposes(method) ? dst_roi.height : dst_roi.width;
+  gint height = transposes(method) ? dst_roi.width : dst_roi.height;
+  const guint8* scaled = argb_.data();
+  if (width != roi.width || height != roi.height) {
+    guint n = workers_.size();
+    std::atomic<bool> ok(true);
+    argb_scaled_.resize(width * height * 4);
+    workers_.run(n, [&](guint i) {
+      guint begin, end;
+      slice_rows(height, n, i, &begin, &end);
+      if (begin < end && libyuv::ARGBScaleClip(argb_.data(), roi.width * 4, roi.width, roi.height,
+                                               argb_scaled_.data(), width * 4, width, height, 0, begin, width,
+                                               end - begin, libyuv::kFilterBilinear) != 0) {
+        ok = false;
+      }
+    });
+    if (!ok) {
+      return false;
+    }
+    scaled = argb_scaled_.data();
+  }
+
+  bool direct = fmt == GST_VIDEO_FORMAT_BGRA;
+  guint8* out = dst;
+  gint out_stride = dst_stride;
+  if (!direct) {
+    argb_dst_.resize(dst_roi.width * dst_roi.height * 4);
+    out = argb_dst_.data();
+    out_stride = dst_roi.width * 4;
+  }
+  // negative height flips source vertically, transposes are rotations of flipped source
+  gint ret;
+  switch (method) {
+    case GST_VIDEO_ORIENTATION_90R:
+      ret = libyuv::ARGBRotate(scaled, width * 4, out, out_stride, width, height, libyuv::kRotate90);
+      break;
+    case GST_VIDEO_ORIENTATION_90L:
+      ret = libyuv::ARGBRotate(scaled, width * 4, out, out_stride, width, height, libyuv::kRotate270);
+      break;
+    case GST_VIDEO_ORIENTATION_180:
+      ret = libyuv::ARGBRotate(scaled, width * 4, out, out_stride, width, height, libyuv::kRotate180);
+      break;
+    case GST_VIDEO_ORIENTATION_HORIZ:
+      ret = libyuv::ARGBMirror(scaled, width * 4, out, out_stride, width, height);
+      break;
+    case GST_VIDEO_ORIENTATION_VERT:
+      ret = libyuv::ARGBCopy(scaled, width * 4, out, out_stride, width, -height);
+      break;
+    case GST_VIDEO_ORIENTATION_UL_LR:
+      ret = libyuv::ARGBRotate(scaled, width * 4, out, out_stride, width, -height, libyuv::kRotate90);
+      break;
+    case GST_VIDEO_ORIENTATION_UR_LL:
+      ret = libyuv::ARGBRotate(scaled, width * 4, out, out_stride, width, -height, libyuv::kRotate270);
+      break;
+    default:
+      ret = libyuv::ARGBCopy(scaled, width * 4, out, out_stride, width, height);
+      break;
+  }
+  return ret == 0 && (direct || argb_to(fmt, out, out_stride, dst, dst_stride, dst_roi.width, dst_roi.height));
+#else
+  return false;
+#endif
+}
+
+bool
+CpuConverter::convert(const GstVideoFrame* src, const GstVideoRectangle& roi, GstVideoFrame* dst,
+                      const GstVideoRectangle& dst_roi, const guint8* pad, GstVideoOrientationMethod method)
+{
+#ifdef WITH_LIBYUV
+  GstVideoFormat fmt = GST_VIDEO_FRAME_FORMAT(dst);
+  guint8* dst_data = static_cast<guint8*>(GST_VIDEO_FRAME_PLANE_DATA(dst, 0));
+  gint dst_stride = GST_VIDEO_FRAME_PLANE_STRIDE(dst, 0);
+  guint bpp = GST_VIDEO_FRAME_COMP_PSTRIDE(dst, 0);
+  guint dst_width = GST_VIDEO_FRAME_WIDTH(dst), dst_height = GST_VIDEO_FRAME_HEIGHT(dst);
+  guint8* dst_roi_data = dst_data + dst_roi.y * dst_stride + dst_roi.x * bpp;
+  // libyuv ARGB is written to output directly
+  bool direct = fmt == GST_VIDEO_FORMAT_BGRA;
+  guint n = workers_.size();
+  std::atomic<bool> ok(true);
+
+  if (pad) {
+    workers_.run(n, [&](guint i) {
+      guint begin, end;
+      slice_rows(dst_height, n, i, &begin, &end);
+      for (guint r = begin; r < end; ++r) {
+        guint8* row = dst_data + r * dst_stride;
+        if (r < (guint)dst_roi.y || r >= (guint)(dst_roi.y + dst_roi.height)) {
+          fill_pixels(row, pad, bpp, dst_width);
+        } else {
+          fill_pixels(row, pad, bpp, dst_roi.x);
+          fill_pixels(row + (dst_roi.x + dst_roi.width) * bpp, pad, bpp, dst_width - dst_roi.x - dst_roi.width);
+        }
+      }
+    });
+  }
+
+  if (method != GST_VIDEO_ORIENTATION_IDENTITY) {
+    return convert_oriented(src, roi, fmt, dst_roi_data, dst_stride, dst_roi, method);
+  }
+
+  if (roi.width == dst_roi.width && roi.height == dst_roi.height) {
+    workers_.run(n, [&](guint i) {
+      guint begin, end;
+      slice_rows(roi.height, n, i, &begin, &end);
+      if (direct) {
+        if (begin < end && !yuv_to_argb(src, roi, begin, end - begin, dst_roi_data + begin * dst_stride, dst_stride)) {
+          ok = false;
+        }
+        return;
+      }
+      std::vector<guint8> chunk(roi.width * 4 * CHUNK_ROWS);
+      for (guint r = begin; r < end; r += CHUNK_ROWS) {
+        guint rows = MIN(CHUNK_ROWS, end - r);
+        if (!yuv_to_argb(src, roi, r, rows, chunk.data(), roi.width * 4) ||
+            !argb_to(fmt, chunk.data(), roi.width * 4, dst_roi_data + r * dst_stride, dst_stride, roi.width, rows)) {
+          ok = false;
+          return;
+        }
+      }
+    });
+    return ok;
+  }
+
+  // roi to ARGB, then resize slices of output rows, each reading rows of ARGB it needs
+  if (!to_argb(src, roi)) {
+    return false;
+  }
+  guint8* scaled = dst_roi_data;
+  gint scaled_stride = dst_stride;
+  if (!direct) {
+    argb_dst_.resize(dst_roi.width * dst_roi.height * 4);
+    scaled = argb_dst_.data();
+    scaled_stride = dst_roi.width * 4;
+  }
+  workers_.run(n, [&](guint i) {
+    guint begin, end;
+    slice_rows(dst_roi.height, n, i, &begin, &end);
+    if (begin == end) {
+      return;
+    }
+    if (libyuv::ARGBScaleClip(argb_.data(), roi.width * 4, roi.width, roi.height, scaled, scaled_stride,
+                              dst_roi.width, dst_roi.height, 0, begin, dst_roi.width, end - begin,
+                              libyuv::kFilterBilinear) != 0 ||
+        (!direct && !argb_to(fmt, scaled + begin * scaled_stride, scaled_stride, dst_roi_data + begin * dst_stride,
+                             dst_stride, dst_roi.width, end - begin))) {
+      ok = false;
+    }
+  });
+  return ok;
+#else
+  return false;
+#endif
+}
@@ -0,0 +1,99 @@
+/* 
+ *  Copyright (C) [2019-2020] by Cambricon, Inc.
+ * 
+ *  This file is part of CNStream-Gst.
+ *
+ *  CNStream-Gst is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU Lesser General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ * 
+ *  CNStream-Gst is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU Lesser General Public License for more details.
+ * 
+ *  You should have received a copy of the GNU Lesser General Public License
+ *  along with CNStream-Gst.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#ifndef GST_CONVERT_CPU_CONVERT_H_
+#define GST_CONVERT_CPU_CONVERT_H_
+
+#include <gst/gst.h>
+#include <gst/video/video.h>
+
+#include <condition_variable>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+/**
+ * Workers running slices of a task in parallel, the calling thread works on slices too.
+ */
+class SliceWorkers
+{
+public:
+  explicit SliceWorkers(guint n_threads);
+  ~SliceWorkers();
+  SliceWorkers(const SliceWorkers&) = delete;
+  SliceWorkers& operator=(const SliceWorkers&) = delete;
+
+  // number of threads, including the calling one
+  guint size() const { return threads_.size() + 1; }
+  // calls task(i) for i in [0, n) and returns when all of them are done
+  void run(guint n, const std::function<void(guint)>& task);
+
+private:
+  void loop();
+  // runs slices left, called with lock held
+  void work(std::unique_lock<std::mutex>* lk);
+
+  std::vector<std::thread> threads_;
+  std::mutex mutex_;
+  std::condition_variable cond_;
+  std::condition_variable done_cond_;
+  const std::function<void(guint)>* task_ = nullptr;
+  guint n_ = 0;
+  guint next_ = 0;
+  guint done_ = 0;
+  bool stop_ = false;
+};
+
+/**
+ * Resize, color convert and orientation of yuv420 frames in host memory to rgb series by libyuv, with rows split into
+ * slices run by SliceWorkers. Available when built with libyuv.
+ */
+class CpuConverter
+{
+public:
+  explicit CpuConverter(guint n_threads);
+
+  static bool supports(GstVideoFormat in, GstVideoFormat out);
+
+  /**
+   * Converts region roi of src to region dst_roi of dst, rotated or flipped by method. The rest of dst is filled with
+   * pad, a pixel in format of dst, if it is not null. Offsets and sizes of roi are even.
+   */
+  bool convert(const GstVideoFrame* src, const GstVideoRectangle& roi, GstVideoFrame* dst,
+               const GstVideoRectangle& dst_roi, const guint8* pad, GstVideoOrientationMethod method);
+
+  // whether method swaps width and height
+  static bool transposes(GstVideoOrientationMethod method);
+
+private:
+  bool to_argb(const GstVideoFrame* src, const GstVideoRectangle& roi);
+  bool convert_oriented(const GstVideoFrame* src, const GstVideoRectangle& roi, GstVideoFormat fmt, guint8* dst,
+                        gint dst_stride, const GstVideoRectangle& dst_roi, GstVideoOrientationMethod method);
+
+  SliceWorkers workers_;
+  // src roi in libyuv ARGB, kept between frames
+  std::vector<guint8> argb_;
+  // src roi resized to dst roi before orientation
+  std::vector<guint8> argb_scaled_;
+  // dst roi in libyuv ARGB, for formats other than BGRA
+  std::vector<guint8> argb_dst_;
+};
+
+#endif // GST_CONVERT_CPU_CONVERT_H_
@@ -0,0 +1,827 @@
+/*
+ *  Copyright (C) [2019-2020] by Cambricon, Inc.
+ *
+ *  This file is part of CNStream-Gst.
+ *
+ *  CNStream-Gst is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU Lesser General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  CNStream-Gst is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU Lesser General Public License for more details.
+ *
+ *  You should have received a copy of the GNU Lesser General Public License
+ *  along with CNStream-Gst.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#include "gstcnbatchconvert.h"
+
+#include <gst/gst.h>
+#include <gst/video/video.h>
+#include <chrono>
+#include <condition_variable>
+#include <cstdio>
+#include <deque>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+#include "cncv.h"
+#include "cnrt.h"
+#include "common/gst_mlu_buffer_pool.h"
+#include "common/mlu_memory_meta.h"
+#include "common/utils.h"
+#include "convert/cncv_utils.h"
+
+enum
+{
+  PROP_0,
+  PROP_DEVICE_ID,
+  PROP_BATCH_SIZE,
+  PROP_TIMEOUT,
+};
+static constexpr gint DEFAULT_DEVICE_ID = -1;
+static constexpr guint DEFAULT_BATCH_SIZE = 16;
+static constexpr guint MAX_BATCH_SIZE = 128;
+// in milliseconds
+static constexpr guint DEFAULT_TIMEOUT = 10;
+static constexpr guint DEFAULT_MIN_BUFFERS = 2;
+static constexpr guint DEFAULT_MAX_BUFFERS = 8;
+
+GST_DEBUG_CATEGORY_EXTERN(gst_cambricon_debug);
+#define GST_CAT_DEFAULT gst_cambricon_debug
+
+#define GST_CNBATCHCONVERT_ERROR(el, domain, code, msg) GST_ELEMENT_ERROR(el, domain, code, msg, ("None"))
+
+#define CNRT_SAFECALL(func, val) \
+  do { \
+    auto ret = func; \
+    if (ret != CNRT_RET_SUCCESS) { \
+      GST_CNBATCHCONVERT_ERROR(self, LIBRARY, FAILED, ("Call [" #func "] failed")); \
+      return val; \
+    } \
+  } while(0)
+
+#define CNCV_SAFECALL(func, val) \
+  do { \
+    auto ret = func; \
+    if (ret != CNCV_STATUS_SUCCESS) { \
+      GST_CNBATCHCONVERT_ERROR(self, LIBRARY, FAILED, ("Call [" #func "] failed")); \
+      return val; \
+    } \
+  } while(0)
+
+/* the capabilities of the inputs and outputs. */
+static GstStaticPadTemplate sink_factory =
+  GST_STATIC_PAD_TEMPLATE("sink_%u",
+                          GST_PAD_SINK,
+                          GST_PAD_REQUEST,
+                          GST_STATIC_CAPS("video/x-raw(memory:mlu), format={NV12, NV21}"));
+
+static GstStaticPadTemplate src_factory =
+  GST_STATIC_PAD_TEMPLATE("src_%u",
+                          GST_PAD_SRC,
+                          GST_PAD_SOMETIMES,
+                          GST_STATIC_CAPS("video/x-raw(memory:mlu), format={RGB, BGR, RGBA, ARGB, BGRA, ABGR};"
+                                          "video/x-raw, format={RGB, BGR, RGBA, ARGB, BGRA, ABGR};"));
+
+struct BatchStream
+{
+  guint index;
+  GstPad* sinkpad;
+  GstPad* srcpad;
+  GstVideoInfo sink_info;
+  GstVideoInfo src_info;
+  GstBufferPool* pool = nullptr;
+  // between FLUSH_START and FLUSH_STOP, guarded by batch_mtx
+  bool flushing = false;
+};
+
+struct BatchItem
+{
+  std::shared_ptr<BatchStream> stream;
+  // owned by input buffer, which is held by chain until item is done
+  GstMluFrame_t frame;
+  GstBuffer* output;
+  GstFlowReturn ret = GST_FLOW_OK;
+  bool done = false;
+};
+
+struct GstCnbatchconvertPrivateCpp
+{
+  std::mutex streams_mtx;
+  std::map<guint, std::shared_ptr<BatchStream>> streams;
+  guint next_index = 0;
+
+  std::mutex batch_mtx;
+  // signaled when an item arrives or worker is stopped
+  std::condition_variable batch_cond;
+  // signaled when items are done
+  std::condition_variable done_cond;
+  std::deque<std::shared_ptr<BatchItem>> pending;
+  std::chrono::steady_clock::time_point first_arrival;
+  bool running = false;
+  std::thread worker;
+};
+
+struct GstCnbatchconvertPrivate
+{
+  cncvHandle_t handle;
+  cnrtQueue_t queue;
+  GstSyncedMemory_t cncv_workspace;
+  gint device_id;
+  guint batch_size;
+  guint timeout;
+
+  GstCnbatchconvertPrivateCpp* cpp;
+};
+
+G_DEFINE_TYPE_WITH_PRIVATE(GstCnbatchconvert, gst_cnbatchconvert, GST_TYPE_ELEMENT);
+// gst_cnbatchconvert_parent_class is defined in G_DEFINE_TYPE macro
+#define PARENT_CLASS gst_cnbatchconvert_parent_class
+
+static inline GstCnbatchconvertPrivate*
+gst_cnbatchconvert_get_private(GstCnbatchconvert* object)
+{
+  return reinterpret_cast<GstCnbatchconvertPrivate*>(gst_cnbatchconvert_get_instance_private(object));
+}
+
+// GObject vmethod
+static void
+gst_cnbatchconvert_set_property(GObject* object, guint prop_id, const GValue* value, GParamSpec* pspec);
+static void
+gst_cnbatchconvert_get_property(GObject* object, guint prop_id, GValue* value, GParamSpec* pspec);
+static void
+gst_cnbatchconvert_finalize(GObject* gobject);
+static GstPad*
+gst_cnbatchconvert_request_new_pad(GstElement* element, GstPadTemplate* templ, const gchar* name,
+                                   const GstCaps* caps);
+static void
+gst_cnbatchconvert_release_pad(GstElement* element, GstPad* pad);
+static GstStateChangeReturn
+gst_cnbatchconvert_change_state(GstElement* element, GstStateChange transition);
+static gboolean
+gst_cnbatchconvert_sink_event(GstPad* pad, GstObject* parent, GstEvent* event);
+static gboolean
+gst_cnbatchconvert_sink_query(GstPad* pad, GstObject* parent, GstQuery* query);
+static GstIterator*
+gst_cnbatchconvert_iterate_internal_links(GstPad* pad, GstObject* parent);
+static GstFlowReturn
+gst_cnbatchconvert_chain(GstPad* pad, GstObject* parent, GstBuffer* buffer);
+
+// GstCnbatchconvert private method
+static gboolean
+gst_cnbatchconvert_setcaps(GstCnbatchconvert* self, BatchStream* stream, GstCaps* sinkcaps);
+static void
+gst_cnbatchconvert_release_stream_pool(BatchStream* stream);
+static void
+gst_cnbatchconvert_set_stream_flushing(GstCnbatchconvert* self, BatchStream* stream, bool flushing);
+static void
+batch_loop(GstCnbatchconvert* self);
+
+/* GObject vmethod implementations */
+
+static void
+gst_cnbatchconvert_class_init(GstCnbatchconvertClass* klass)
+{
+  GObjectClass* gobject_class;
+  GstElementClass* gstelement_class;
+
+  gobject_class = (GObjectClass*)klass;
+  gstelement_class = (GstElementClass*)klass;
+
+  gobject_class->set_property = gst_cnbatchconvert_set_property;
+  gobject_class->get_property = gst_cnbatchconvert_get_property;
+  gobject_class->finalize = gst_cnbatchconvert_finalize;
+
+  gstelement_class->request_new_pad = GST_DEBUG_FUNCPTR(gst_cnbatchconvert_request_new_pad);
+  gstelement_class->release_pad = GST_DEBUG_FUNCPTR(gst_cnbatchconvert_release_pad);
+  gstelement_class->change_state = GST_DEBUG_FUNCPTR(gst_cnbatchconvert_change_state);
+
+  g_object_class_install_property(gobject_class, PROP_DEVICE_ID,
+                                  g_param_spec_int("device-id", "device id",
+                                                   "device identification, -1 to use device of input frames", -1, 10,
+                                                   DEFAULT_DEVICE_ID,
+                                                   (GParamFlags)(G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS)));
+  g_object_class_install_property(gobject_class, PROP_BATCH_SIZE,
+                                  g_param_spec_uint("batch-size", "batch size",
+                                                    "maximum number of frames processed in one kernel launch", 1,
+                                                    MAX_BATCH_SIZE, DEFAULT_BATCH_SIZE,
+                                                    (GParamFlags)(G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS)));
+  g_object_class_install_property(gobject_class, PROP_TIMEOUT,
+                                  g_param_spec_uint("timeout", "timeout",
+                                                    "milliseconds to wait for a batch to be filled since its first "
+                                                    "frame arrives",
+                                                    0, G_MAXUINT, DEFAULT_TIMEOUT,
+                                                    (GParamFlags)(G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS)));
+
+  gst_element_class_set_details_simple(gstelement_class, "cnbatchconvert", "Generic/Convertor",
+                                       "Cambricon batched convertor of multiple streams", "Cambricon Solution SDK");
+
+  gst_element_class_add_pad_template(gstelement_class, gst_static_pad_template_get(&src_factory));
+  gst_element_class_add_pad_template(gstelement_class, gst_static_pad_template_get(&sink_factory));
+}
+
+static void
+gst_cnbatchconvert_init(GstCnbatchconvert* self)
+{
+  GstCnbatchconvertPrivate* priv = gst_cnbatchconvert_get_private(self);
+  priv->handle = nullptr;
+  priv->queue = nullptr;
+  priv->cncv_workspace = nullptr;
+  priv->device_id = DEFAULT_DEVICE_ID;
+  priv->batch_size = DEFAULT_BATCH_SIZE;
+  priv->timeout = DEFAULT_TIMEOUT;
+  priv->cpp = new GstCnbatchconvertPrivateCpp;
+}
+
+static void
+gst_cnbatchconvert_finalize(GObject* object)
+{
+  auto self = GST_CNBATCHCONVERT(object);
+  GstCnbatchconvertPrivate* priv = gst_cnbatchconvert_get_private(self);
+
+  for (auto& it : priv->cpp->streams) {
+    gst_cnbatchconvert_release_stream_pool(it.second.get());
+  }
+  delete priv->cpp;
+  priv->cpp = nullptr;
+
+  if (priv->cncv_workspace) {
+    if (!cn_syncedmem_free(priv->cncv_workspace)) {
+      GST_ERROR_OBJECT(self, "Free mlu memory failed");
+    }
+    priv->cncv_workspace = nullptr;
+  }
+  if (priv->handle) {
+    CNCV_SAFECALL(cncvDestroy(priv->handle), );
+    priv->handle = nullptr;
+  }
+  if (priv->queue) {
+    CNRT_SAFECALL(cnrtDestroyQueue(priv->queue), );
+    priv->queue = nullptr;
+  }
+  G_OBJECT_CLASS(PARENT_CLASS)->finalize(object);
+}
+
+static void
+gst_cnbatchconvert_set_property(GObject* object, guint prop_id, const GValue* value, GParamSpec* pspec)
+{
+  GstCnbatchconvertPrivate* priv = gst_cnbatchconvert_get_private(GST_CNBATCHCONVERT(object));
+  switch (prop_id) {
+    case PROP_DEVICE_ID:
+      priv->device_id = g_value_get_int(value);
+      break;
+    case PROP_BATCH_SIZE:
+      priv->batch_size = g_value_get_uint(value);
+      break;
+    case PROP_TIMEOUT:
+      priv->timeout = g_value_get_uint(value);
+      break;
+    default:
+      G_OBJECT_WARN_INVALID_PROPERTY_ID(object, prop_id, pspec);
+      break;
+  }
+}
+
+static void
+gst_cnbatchconvert_get_property(GObject* object, guint prop_id, GValue* value, GParamSpec* pspec)
+{
+  GstCnbatchconvertPrivate* priv = gst_cnbatchconvert_get_private(GST_CNBATCHCONVERT(object));
+  switch (prop_id) {
+    case PROP_DEVICE_ID:
+      g_value_set_int(value, priv->device_id);
+      break;
+    case PROP_BATCH_SIZE:
+      g_value_set_uint(value, priv->batch_size);
+      break;
+    case PROP_TIMEOUT:
+      g_value_set_uint(value, priv->timeout);
+      break;
+    default:
+      G_OBJECT_WARN_INVALID_PROPERTY_ID(object, prop_id, pspec);
+      break;
+  }
+}
+
+static std::shared_ptr<BatchStream>
+get_stream(GstCnbatchconvert* self, GstPad* pad)
+{
+  GstCnbatchconvertPrivateCpp* cpp = gst_cnbatchconvert_get_private(self)->cpp;
+  guint index = GPOINTER_TO_UINT(gst_pad_get_element_private(pad));
+  std::lock_guard<std::mutex> lk(cpp->streams_mtx);
+  auto it = cpp->streams.find(index);
+  return it == cpp->streams.end() ? nullptr : it->second;
+}
+
+static GstPad*
+gst_cnbatchconvert_request_new_pad(GstElement* element, GstPadTemplate* templ, const gchar* name,
+                                   const GstCaps* caps)
+{
+  GstCnbatchconvert* self = GST_CNBATCHCONVERT(element);
+  GstCnbatchconvertPrivateCpp* cpp = gst_cnbatchconvert_get_private(self)->cpp;
+  auto stream = std::make_shared<BatchStream>();
+
+  {
+    std::lock_guard<std::mutex> lk(cpp->streams_mtx);
+    guint index;
+    if (name && sscanf(name, "sink_%u", &index) == 1) {
+      if (cpp->streams.count(index)) {
+        GST_WARNING_OBJECT(self, "pad %s exists", name);
+        return nullptr;
+      }
+    } else {
+      index = cpp->next_index;
+    }
+    cpp->next_index = MAX(cpp->next_index, index + 1);
+
+    stream->index = index;
+    gst_video_info_init(&stream->sink_info);
+    gst_video_info_init(&stream->src_info);
+    gchar* sink_name = g_strdup_printf("sink_%u", index);
+    gchar* src_name = g_strdup_printf("src_%u", index);
+    stream->sinkpad = gst_pad_new_from_template(templ, sink_name);
+    stream->srcpad = gst_pad_new_from_static_template(&src_factory, src_name);
+    g_free(sink_name);
+    g_free(src_name);
+    cpp->streams[index] = stream;
+  }
+
+  gst_pad_set_element_private(stream->sinkpad, GUINT_TO_POINTER(stream->index));
+  gst_pad_set_element_private(stream->srcpad, GUINT_TO_POINTER(stream->index));
+  gst_pad_set_event_function(stream->sinkpad, GST_DEBUG_FUNCPTR(gst_cnbatchconvert_sink_event));
+  gst_pad_set_query_function(stream->sinkpad, GST_DEBUG_FUNCPTR(gst_cnbatchconvert_sink_query));
+  gst_pad_set_chain_function(stream->sinkpad, GST_DEBUG_FUNCPTR(gst_cnbatchconvert_chain));
+  // events and queries of a stream only go through its own pads
+  gst_pad_set_iterate_internal_links_function(stream->sinkpad,
+                                              GST_DEBUG_FUNCPTR(gst_cnbatchconvert_iterate_internal_links));
+  gst_pad_set_iterate_internal_links_function(stream->srcpad,
+                                              GST_DEBUG_FUNCPTR(gst_cnbatchconvert_iterate_internal_links));
+
+  gst_element_add_pad(element, stream->srcpad);
+  gst_element_add_pad(element, stream->sinkpad);
+  GST_DEBUG_OBJECT(self, "new stream %u", stream->index);
+  return stream->sinkpad;
+}
+
+static void
+gst_cnbatchconvert_release_pad(GstElement* element, GstPad* pad)
+{
+  GstCnbatchconvert* self = GST_CNBATCHCONVERT(element);
+  GstCnbatchconvertPrivateCpp* cpp = gst_cnbatchconvert_get_private(self)->cpp;
+  std::shared_ptr<BatchStream> stream = get_stream(self, pad);
+  if (!stream) {
+    return;
+  }
+  {
+    std::lock_guard<std::mutex> lk(cpp->streams_mtx);
+    cpp->streams.erase(stream->index);
+  }
+
+  GST_DEBUG_OBJECT(self, "release stream %u", stream->index);
+  // removing pads waits for chain of the stream to finish
+  gst_element_remove_pad(element, stream->srcpad);
+  gst_element_remove_pad(element, stream->sinkpad);
+  gst_cnbatchconvert_release_stream_pool(stream.get());
+}
+
+static void
+gst_cnbatchconvert_set_pools_flushing(GstCnbatchconvert* self, gboolean flushing)
+{
+  GstCnbatchconvertPrivateCpp* cpp = gst_cnbatchconvert_get_private(self)->cpp;
+  std::lock_guard<std::mutex> lk(cpp->streams_mtx);
+  for (auto& it : cpp->streams) {
+    if (it.second->pool) {
+      gst_buffer_pool_set_flushing(it.second->pool, flushing);
+    }
+  }
+}
+
+static GstStateChangeReturn
+gst_cnbatchconvert_change_state(GstElement* element, GstStateChange transition)
+{
+  GstCnbatchconvert* self = GST_CNBATCHCONVERT(element);
+  GstCnbatchconvertPrivateCpp* cpp = gst_cnbatchconvert_get_private(self)->cpp;
+
+  if (transition == GST_STATE_CHANGE_READY_TO_PAUSED) {
+    gst_cnbatchconvert_set_pools_flushing(self, FALSE);
+    std::lock_guard<std::mutex> lk(cpp->batch_mtx);
+    cpp->running = true;
+    cpp->worker = std::thread(&batch_loop, self);
+  } else if (transition == GST_STATE_CHANGE_PAUSED_TO_READY) {
+    // unblock chains waiting for output buffers or for their batches
+    gst_cnbatchconvert_set_pools_flushing(self, TRUE);
+    {
+      std::lock_guard<std::mutex> lk(cpp->batch_mtx);
+      cpp->running = false;
+    }
+    cpp->batch_cond.notify_all();
+    if (cpp->worker.joinable()) {
+      cpp->worker.join();
+    }
+  }
+
+  return GST_ELEMENT_CLASS(PARENT_CLASS)->change_state(element, transition);
+}
+
+static GstIterator*
+gst_cnbatchconvert_iterate_internal_links(GstPad* pad, GstObject* parent)
+{
+  std::shared_ptr<BatchStream> stream = get_stream(GST_CNBATCHCONVERT(parent), pad);
+  if (!stream) {
+    return nullptr;
+  }
+
+  GValue val = G_VALUE_INIT;
+  g_value_init(&val, GST_TYPE_PAD);
+  g_value_set_object(&val, pad == stream->sinkpad ? stream->srcpad : stream->sinkpad);
+  GstIterator* it = gst_iterator_new_single(GST_TYPE_PAD, &val);
+  g_value_unset(&val);
+  return it;
+}
+
+static gboolean
+gst_cnbatchconvert_sink_event(GstPad* pad, GstObject* parent, GstEvent* event)
+{
+  GstCnbatchconvert* self = GST_CNBATCHCONVERT(parent);
+  std::shared_ptr<BatchStream> stream = get_stream(self, pad);
+  GST_LOG_OBJECT(pad, "received %s event: %" GST_PTR_FORMAT, GST_EVENT_TYPE_NAME(event), event);
+
+  if (!stream) {
+    gst_event_unref(event);
+    return FALSE;
+  }
+
+  switch (GST_EVENT_TYPE(event)) {
+    case GST_EVENT_CAPS: {
+      GstCaps* caps;
+      gst_event_parse_caps(event, &caps);
+      gboolean ret = gst_cnbatchconvert_setcaps(self, stream.get(), caps);
+      if (!ret) {
+        GST_ERROR_OBJECT(pad, "set caps failed");
+      }
+      gst_event_unref(event);
+      return ret;
+    }
+    case GST_EVENT_FLUSH_START:
+    case GST_EVENT_FLUSH_STOP:
+      // unblock chain waiting for a free output buffer or for its frame to be batched
+      if (stream->pool) {
+        gst_buffer_pool_set_flushing(stream->pool, GST_EVENT_TYPE(event) == GST_EVENT_FLUSH_START);
+      }
+      gst_cnbatchconvert_set_stream_flushing(self, stream.get(), GST_EVENT_TYPE(event) == GST_EVENT_FLUSH_START);
+      return gst_pad_event_default(pad, parent, event);
+    default:
+      return gst_pad_event_default(pad, parent, event);
+  }
+}
+
+static gboolean
+gst_cnbatchconvert_sink_query(GstPad* pad, GstObject* parent, GstQuery* query)
+{
+  switch (GST_QUERY_TYPE(query)) {
+    case GST_QUERY_CAPS: {
+      // output caps are negotiated with downstream independently, any input in template is acceptable
+      GstCaps* filter;
+      gst_query_parse_caps(query, &filter);
+      GstCaps* caps = gst_pad_get_pad_template_caps(pad);
+      if (filter) {
+        GstCaps* intersection = gst_caps_intersect_full(filter, caps, GST_CAPS_INTERSECT_FIRST);
+        gst_caps_unref(caps);
+        caps = intersection;
+      }
+      gst_query_set_caps_result(query, caps);
+      gst_caps_unref(caps);
+      return TRUE;
+    }
+    case GST_QUERY_ALLOCATION:
+      gst_query_add_allocation_meta(query, GST_VIDEO_META_API_TYPE, NULL);
+      return TRUE;
+    default:
+      return gst_pad_query_default(pad, parent, query);
+  }
+}
+
+static void
+gst_cnbatchconvert_release_stream_pool(BatchStream* stream)
+{
+  if (stream->pool) {
+    // buffers still held by downstream are freed when they are released
+    gst_buffer_pool_set_active(stream->pool, FALSE);
+    gst_object_unref(stream->pool);
+    stream->pool = nullptr;
+  }
+}
+
+// frames of stream not taken by worker yet are given back to their chains as flushed, batches being processed are
+// waited for by their chains
+static void
+gst_cnbatchconvert_set_stream_flushing(GstCnbatchconvert* self, BatchStream* stream, bool flushing)
+{
+  GstCnbatchconvertPrivateCpp* cpp = gst_cnbatchconvert_get_private(self)->cpp;
+  std::lock_guard<std::mutex> lk(cpp->batch_mtx);
+  stream->flushing = flushing;
+  if (!flushing) {
+    return;
+  }
+  for (auto it = cpp->pending.begin(); it != cpp->pending.end();) {
+    if ((*it)->stream.get() == stream) {
+      (*it)->ret = GST_FLOW_FLUSHING;
+      (*it)->done = true;
+      it = cpp->pending.erase(it);
+    } else {
+      ++it;
+    }
+  }
+  cpp->done_cond.notify_all();
+}
+
+static gboolean
+gst_cnbatchconvert_setcaps(GstCnbatchconvert* self, BatchStream* stream, GstCaps* sinkcaps)
+{
+  g_return_val_if_fail(gst_video_info_from_caps(&stream->sink_info, sinkcaps), FALSE);
+
+  GstCaps* filter_caps = gst_static_pad_template_get_caps(&src_factory);
+  GstCaps* src_peer_caps = gst_pad_peer_query_caps(stream->srcpad, filter_caps);
+  gst_caps_unref(filter_caps);
+  if (gst_caps_is_any(src_peer_caps)) {
+    GST_ERROR_OBJECT(stream->srcpad, "srcpad not linked");
+    gst_caps_unref(src_peer_caps);
+    return FALSE;
+  }
+  if (gst_caps_is_empty(src_peer_caps)) {
+    GST_ERROR_OBJECT(stream->srcpad, "do not have intersection with downstream element");
+    gst_caps_unref(src_peer_caps);
+    return FALSE;
+  }
+
+  src_peer_caps = gst_caps_truncate(gst_caps_normalize(src_peer_caps));
+  gst_caps_set_simple(src_peer_caps, "framerate", GST_TYPE_FRACTION, stream->sink_info.fps_n,
+                      stream->sink_info.fps_d, NULL);
+
+  // if downstream have not specify resolution
+  auto caps_struct = gst_caps_get_structure(src_peer_caps, 0);
+  if (!gst_structure_has_field(caps_struct, "width") || !gst_structure_has_field(caps_struct, "height")) {
+    gst_caps_set_simple(src_peer_caps, "width", G_TYPE_INT, stream->sink_info.width, "height", G_TYPE_INT,
+                        stream->sink_info.height, NULL);
+  } else if (!gst_caps_is_fixed(src_peer_caps)) {
+    if (!gst_structure_fixate_field_nearest_int(caps_struct, "width", stream->sink_info.width) ||
+        !gst_structure_fixate_field_nearest_int(caps_struct, "height", stream->sink_info.height)) {
+      GST_ERROR_OBJECT(stream->srcpad, "can not fixate src caps");
+      gst_caps_unref(src_peer_caps);
+      return FALSE;
+    }
+  }
+
+  if (!gst_video_info_from_caps(&stream->src_info, src_peer_caps) ||
+      !gst_pad_set_caps(stream->srcpad, src_peer_caps)) {
+    GST_ERROR_OBJECT(stream->srcpad, "set caps %" GST_PTR_FORMAT " failed", src_peer_caps);
+    gst_caps_unref(src_peer_caps);
+    return FALSE;
+  }
+  GST_INFO_OBJECT(stream->srcpad, "setcaps %" GST_PTR_FORMAT, src_peer_caps);
+
+  // outputs of the stream, laid out as src caps
+  gst_cnbatchconvert_release_stream_pool(stream);
+  GstBufferPool* pool = gst_mlu_buffer_pool_new();
+  GstStructure* config = gst_buffer_pool_get_config(pool);
+  gst_buffer_pool_config_set_params(config, src_peer_caps, stream->src_info.size, DEFAULT_MIN_BUFFERS,
+                                    DEFAULT_MAX_BUFFERS);
+  gst_caps_unref(src_peer_caps);
+  if (!gst_buffer_pool_set_config(pool, config) || !gst_buffer_pool_set_active(pool, TRUE)) {
+    GST_CNBATCHCONVERT_ERROR(self, RESOURCE, SETTINGS, ("config output buffer pool failed"));
+    gst_object_unref(pool);
+    return FALSE;
+  }
+  stream->pool = pool;
+  return TRUE;
+}
+
+static GstFlowReturn
+gst_cnbatchconvert_chain(GstPad* pad, GstObject* parent, GstBuffer* buffer)
+{
+  GstCnbatchconvert* self = GST_CNBATCHCONVERT(parent);
+  GstCnbatchconvertPrivateCpp* cpp = gst_cnbatchconvert_get_private(self)->cpp;
+  std::shared_ptr<BatchStream> stream = get_stream(self, pad);
+  if (!stream) {
+    gst_buffer_unref(buffer);
+    return GST_FLOW_NOT_LINKED;
+  }
+  if (!stream->pool) {
+    gst_buffer_unref(buffer);
+    return GST_FLOW_NOT_NEGOTIATED;
+  }
+
+  MluMemoryMeta_t meta = gst_buffer_get_mlu_memory_meta(buffer);
+  if (!meta || !meta->frame) {
+    GST_CNBATCHCONVERT_ERROR(self, RESOURCE, READ, ("get meta failed"));
+    gst_buffer_unref(buffer);
+    return GST_FLOW_ERROR;
+  }
+
+  GstBuffer* outbuf = nullptr;
+  GstFlowReturn flow = gst_buffer_pool_acquire_buffer(stream->pool, &outbuf, NULL);
+  if (flow != GST_FLOW_OK) {
+    GST_DEBUG_OBJECT(pad, "acquire output buffer failed, %s", gst_flow_get_name(flow));
+    gst_buffer_unref(buffer);
+    return flow;
+  }
+
+  auto item = std::make_shared<BatchItem>();
+  item->stream = stream;
+  item->frame = meta->frame;
+  item->output = outbuf;
+  {
+    std::unique_lock<std::mutex> lk(cpp->batch_mtx);
+    if (!cpp->running || stream->flushing) {
+      flow = GST_FLOW_FLUSHING;
+    } else {
+      if (cpp->pending.empty()) {
+        cpp->first_arrival = std::chrono::steady_clock::now();
+      }
+      cpp->pending.push_back(item);
+      cpp->batch_cond.notify_one();
+      // each stream has at most one frame in batch, so batches are filled by different streams
+      cpp->done_cond.wait(lk, [&item]() { return item->done; });
+      flow = item->ret;
+    }
+  }
+  if (flow != GST_FLOW_OK) {
+    gst_buffer_unref(outbuf);
+    gst_buffer_unref(buffer);
+    return flow;
+  }
+
+  gst_buffer_copy_into(outbuf, buffer, (GstBufferCopyFlags)(GST_BUFFER_COPY_FLAGS | GST_BUFFER_COPY_TIMESTAMPS), 0,
+                       -1);
+  gst_buffer_unref(buffer);
+  return gst_pad_push(stream->srcpad, outbuf);
+}
+
+// items of a batch share pixel formats, other items are left for the next batch
+static std::vector<std::shared_ptr<BatchItem>>
+take_batch(std::deque<std::shared_ptr<BatchItem>>* pending, guint batch_size)
+{
+  std::vector<std::shared_ptr<BatchItem>> batch;
+  GstVideoFormat src_fmt = GST_VIDEO_INFO_FORMAT(&pending->front()->stream->sink_info);
+  GstVideoFormat dst_fmt = GST_VIDEO_INFO_FORMAT(&pending->front()->stream->src_info);
+  for (auto it = pending->begin(); it != pending->end() && batch.size() < batch_size;) {
+    if (GST_VIDEO_INFO_FORMAT(&(*it)->stream->sink_info) == src_fmt &&
+        GST_VIDEO_INFO_FORMAT(&(*it)->stream->src_info) == dst_fmt) {
+      batch.push_back(*it);
+      it = pending->erase(it);
+    } else {
+      ++it;
+    }
+  }
+  return batch;
+}
+
+static gboolean
+process_batch(GstCnbatchconvert* self, const std::vector<std::shared_ptr<BatchItem>>& batch, gboolean* cnrt_env)
+{
+  GstCnbatchconvertPrivate* priv = gst_cnbatchconvert_get_private(self);
+  guint n = batch.size();
+
+  // worker is started again on each READY to PAUSED, device is bound once per worker
+  if (!*cnrt_env) {
+    if (priv->device_id == -1) {
+      priv->device_id = batch[0]->frame->device_id;
+    }
+    if (!set_cnrt_env(GST_ELEMENT(self), priv->device_id)) {
+      return FALSE;
+    }
+    *cnrt_env = TRUE;
+  }
+  // queue and handle live as long as element
+  if (!priv->queue) {
+    CNRT_SAFECALL(cnrtCreateQueue(&priv->queue), FALSE);
+  }
+  if (!priv->handle) {
+    CNCV_SAFECALL(cncvCreate(&priv->handle), FALSE);
+    CNCV_SAFECALL(cncvSetQueue(priv->handle, priv->queue), FALSE);
+  }
+
+  std::vector<cncvImageDescriptor> src_descs(n), dst_descs(n);
+  std::vector<cncvRect> src_rois(n), dst_rois(n);
+  for (guint i = 0; i < n; ++i) {
+    GstMluFrame_t frame = batch[i]->frame;
+    BatchStream* stream = batch[i]->stream.get();
+    if (!gst_mlu_frame_sync(frame)) {
+      GST_CNBATCHCONVERT_ERROR(self, LIBRARY, FAILED, ("wait for device work failed"));
+      return FALSE;
+    }
+    src_descs[i] = video_info_to_desc(stream->sink_info);
+    // decoded frames may be aligned beyond caps
+    src_descs[i].stride[0] = frame->stride[0];
+    src_descs[i].stride[1] = frame->stride[1];
+    dst_descs[i] = video_info_to_desc(stream->src_info);
+    src_rois[i].x = src_rois[i].y = dst_rois[i].x = dst_rois[i].y = 0;
+    src_rois[i].w = src_descs[i].width;
+    src_rois[i].h = src_descs[i].height;
+    dst_rois[i].w = dst_descs[i].width;
+    dst_rois[i].h = dst_descs[i].height;
+  }
+
+  size_t workspace_size;
+  // y and uv planes of sources, then destinations
+  size_t extra_size = 3 * n * sizeof(void*);
+  CNCV_SAFECALL(cncvGetResizeConvertWorkspaceSize(n, src_descs.data(), src_rois.data(), dst_descs.data(),
+                                                  dst_rois.data(), &workspace_size),
+                FALSE);
+
+  // prepare mlu memory
+  if (priv->cncv_workspace && cn_syncedmem_get_size(priv->cncv_workspace) < (workspace_size + extra_size)) {
+    cn_syncedmem_free(priv->cncv_workspace);
+    priv->cncv_workspace = nullptr;
+  }
+  if (!priv->cncv_workspace) {
+    priv->cncv_workspace = cn_syncedmem_new(workspace_size + extra_size);
+  }
+
+  void** buf_host = reinterpret_cast<void**>(cn_syncedmem_get_mutable_host_data(priv->cncv_workspace));
+  for (guint i = 0; i < n; ++i) {
+    GstMluFrame_t out_frame = gst_buffer_get_mlu_memory_meta(batch[i]->output)->frame;
+    buf_host[2 * i] = cn_syncedmem_get_mutable_dev_data(batch[i]->frame->data[0]);
+    buf_host[2 * i + 1] = cn_syncedmem_get_mutable_dev_data(batch[i]->frame->data[1]);
+    buf_host[2 * n + i] = cn_syncedmem_get_mutable_dev_data(out_frame->data[0]);
+    out_frame->device_id = priv->device_id;
+    out_frame->channel_id = batch[i]->frame->channel_id;
+  }
+  buf_host = nullptr;
+  void** buf_dev = reinterpret_cast<void**>(const_cast<void*>(cn_syncedmem_get_dev_data(priv->cncv_workspace)));
+  void** src_ptr = buf_dev;
+  void** dst_ptr = buf_dev + 2 * n;
+  void* workspace = buf_dev + 3 * n;
+
+  CNCV_SAFECALL(cncvResizeConvert_V2(priv->handle, n,
+                                     src_descs.data(), src_rois.data(), src_ptr,
+                                     dst_descs.data(), dst_rois.data(), dst_ptr,
+                                     workspace_size, workspace, CNCV_INTER_BILINEAR), FALSE);
+
+  CNRT_SAFECALL(cnrtSyncQueue(priv->queue), FALSE);
+
+  GST_LOG_OBJECT(self, "processed batch of %u frames", n);
+  return TRUE;
+}
+
+static void
+batch_loop(GstCnbatchconvert* self)
+{
+  GstCnbatchconvertPrivate* priv = gst_cnbatchconvert_get_private(self);
+  GstCnbatchconvertPrivateCpp* cpp = priv->cpp;
+  gboolean cnrt_env = FALSE;
+
+  std::unique_lock<std::mutex> lk(cpp->batch_mtx);
+  while (cpp->running) {
+    cpp->batch_cond.wait(lk, [cpp]() { return !cpp->running || !cpp->pending.empty(); });
+    if (!cpp->running) {
+      break;
+    }
+
+    // wait for frames of other streams
+    guint batch_size = priv->batch_size;
+    auto deadline = cpp->first_arrival + std::chrono::milliseconds(priv->timeout);
+    cpp->batch_cond.wait_until(lk, deadline,
+                               [cpp, batch_size]() { return !cpp->running || cpp->pending.size() >= batch_size; });
+    if (!cpp->running) {
+      break;
+    }
+    // frames waited for may have been flushed
+    if (cpp->pending.empty()) {
+      continue;
+    }
+
+    auto batch = take_batch(&cpp->pending, batch_size);
+    if (!cpp->pending.empty()) {
+      cpp->first_arrival = std::chrono::steady_clock::now();
+    }
+    lk.unlock();
+
+    GstFlowReturn ret = GST_FLOW_ERROR;
+    try {
+      ret = process_batch(self, batch, &cnrt_env) ? GST_FLOW_OK : GST_FLOW_ERROR;
+    } catch (edk::Exception& e) {
+      GST_CNBATCHCONVERT_ERROR(self, RESOURCE, FAILED, ("%s", e.what()));
+    }
+
+    lk.lock();
+    for (auto& item : batch) {
+      item->ret = ret;
+      item->done = true;
+    }
+    cpp->done_cond.notify_all();
+  }
+
+  for (auto& item : cpp->pending) {
+    item->ret = GST_FLOW_FLUSHING;
+    item->done = true;
+  }
+  cpp->pending.clear();
+  cpp->done_cond.notify_all();
+}
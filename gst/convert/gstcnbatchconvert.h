@@ -0,0 +1,60 @@
+/*
+ *  Copyright (C) [2019-2020] by Cambricon, Inc.
+ *
+ *  This file is part of CNStream-Gst.
+ *
+ *  CNStream-Gst is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU Lesser General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  CNStream-Gst is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU Lesser General Public License for more details.
+ *
+ *  You should have received a copy of the GNU Lesser General Public License
+ *  along with CNStream-Gst.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#ifndef GST_CNBATCH_CONVERT_H_
+#define GST_CNBATCH_CONVERT_H_
+
+#include <gst/gst.h>
+
+#define GST_TYPE_CNBATCHCONVERT (gst_cnbatchconvert_get_type())
+#define GST_CNBATCHCONVERT(obj) (G_TYPE_CHECK_INSTANCE_CAST((obj), GST_TYPE_CNBATCHCONVERT, GstCnbatchconvert))
+#define GST_CNBATCHCONVERT_CLASS(klass)                                                                                \
+  (G_TYPE_CHECK_CLASS_CAST((klass), GST_TYPE_CNBATCHCONVERT, GstCnbatchconvertClass))
+#define GST_IS_CNBATCHCONVERT(obj) (G_TYPE_CHECK_INSTANCE_TYPE((obj), GST_TYPE_CNBATCHCONVERT))
+#define GST_IS_CNBATCHCONVERT_CLASS(klass) (G_TYPE_CHECK_CLASS_TYPE((klass), GST_TYPE_CNBATCHCONVERT))
+#define GST_CNBATCHCONVERT_GET_CLASS(obj)                                                                              \
+  (G_TYPE_INSTANCE_GET_CLASS((obj), GST_TYPE_CNBATCHCONVERT, GstCnbatchconvertClass))
+
+G_BEGIN_DECLS
+
+typedef struct _GstCnbatchconvert GstCnbatchconvert;
+typedef struct _GstCnbatchconvertClass GstCnbatchconvertClass;
+
+/**
+ * Resizes and converts frames of many streams with one kernel launch.
+ *
+ * Each request pad sink_%u has a src_%u pad with the same index. Frames arriving on sink pads within timeout are
+ * processed as a batch, outputs are pushed on the src pads of their own streams.
+ */
+struct _GstCnbatchconvert
+{
+  GstElement element;
+};
+
+struct _GstCnbatchconvertClass
+{
+  GstElementClass parent_class;
+};
+
+GType
+gst_cnbatchconvert_get_type(void);
+
+G_END_DECLS
+
+#endif // GST_CNBATCH_CONVERT_H_
@@ -21,23 +21,76 @@
 
 #include <gst/gst.h>
 #include <gst/video/video.h>
+#include <cstdio>
+#include <atomic>
 #include <cstring>
+#include <deque>
+#include <map>
+#include <memory>
 #include <mutex>
+#include <thread>
+#include <utility>
+#include <vector>
 
 #include "cncv.h"
 #include "cnrt.h"
+#include "common/gst_mlu_allocator.h"
+#include "common/frame_deallocator.h"
+#include "common/frame_syncer.h"
+#include "common/gst_mlu_buffer_pool.h"
+#include "common/gst_mlu_download.h"
+#include "common/letterbox_meta.h"
 #include "common/mlu_memory_meta.h"
 #include "common/utils.h"
+#include "convert/cncv_utils.h"
+#include "convert/cpu_convert.h"
 #include "device/mlu_context.h"
 #include "easybang/resize_and_colorcvt.h"
-#include "easyinfer/mlu_memory_op.h"
 
 enum
 {
   PROP_0,
   PROP_DEVICE_ID,
+  PROP_IN_FLIGHT,
+  PROP_CROP,
+  PROP_ROI_TYPE,
+  PROP_KEEP_ASPECT_RATIO,
+  PROP_PAD_COLOR,
+  PROP_PAD_POSITION,
+  PROP_FUSE_RGB_RESIZE,
+  PROP_BACKEND,
+  PROP_H2D_BYTES,
+  PROP_DTYPE,
+  PROP_LAYOUT,
+  PROP_MEAN,
+  PROP_STD,
+  PROP_VIDEO_DIRECTION,
 };
 static constexpr gint DEFAULT_DEVICE_ID = -1;
+// 0 means synchronous, output is ready when pushed
+static constexpr guint DEFAULT_IN_FLIGHT = 0;
+static constexpr guint MAX_IN_FLIGHT = 16;
+static constexpr gboolean DEFAULT_KEEP_ASPECT_RATIO = FALSE;
+// 0xRRGGBB
+static constexpr guint DEFAULT_PAD_COLOR = 0;
+static constexpr GstCnconvertPadPosition DEFAULT_PAD_POSITION = GST_CNCONVERT_PAD_CENTER;
+static constexpr gboolean DEFAULT_FUSE_RGB_RESIZE = FALSE;
+static constexpr GstCnconvertBackend DEFAULT_BACKEND = GST_CNCONVERT_BACKEND_AUTO;
+static constexpr GstCnconvertDtype DEFAULT_DTYPE = GST_CNCONVERT_DTYPE_UINT8;
+static constexpr GstCnconvertLayout DEFAULT_LAYOUT = GST_CNCONVERT_LAYOUT_NHWC;
+static constexpr GstVideoOrientationMethod DEFAULT_VIDEO_DIRECTION = GST_VIDEO_ORIENTATION_IDENTITY;
+// auto backend converts on cpu up to this output size, larger outputs amortize upload to MLU better
+static constexpr gint AUTO_CPU_MAX_PIXELS = 640 * 640;
+static constexpr guint MAX_CPU_THREADS = 8;
+// device copies of pointer tables kept, enough for combinations of pooled inputs and outputs in steady state
+static constexpr guint MAX_POINTER_TABLES = 64;
+// page-locked buffers inputs in system memory are staged in, the next frame is staged while the last one is uploaded
+static constexpr guint STAGING_SLOTS = 3;
+// regions converted to tensors by one kernel, batches are rounded up to powers of two to bound kernels kept
+static constexpr guint MAX_TENSOR_BATCH = 32;
+// output buffers of each stream are bounded by pool
+static constexpr guint DEFAULT_MIN_BUFFERS = 2;
+static constexpr guint DEFAULT_MAX_BUFFERS = 8;
 
 GST_DEBUG_CATEGORY_EXTERN(gst_cambricon_debug);
 #define GST_CAT_DEFAULT gst_cambricon_debug
@@ -53,6 +106,11 @@ GST_DEBUG_CATEGORY_EXTERN(gst_cambricon_debug);
     } \
   } while(0)
 
+// input of neural networks, channels of elements are ordered as components of format
+#define TENSOR_CAPS \
+  "other/tensor(memory:mlu), layout=(string){nhwc, nchw}, dtype=(string){uint8, float16, float32}, " \
+  "format=(string){RGBA, BGRA, ARGB, ABGR, RGB, BGR}"
+
 #define CNCV_SAFECALL(func, val) \
   do { \
     auto ret = func; \
@@ -69,7 +127,7 @@ static GstStaticPadTemplate sink_factory =
                           GST_PAD_ALWAYS,
                           GST_STATIC_CAPS(
                             "video/x-raw(memory:mlu), format={NV12, NV21, I420, RGB, BGR};"
-                            "video/x-raw, format={NV12, NV21, RGB, BGR, RGBA, BGRA, ARGB, ABGR}"));
+                            "video/x-raw, format={NV12, NV21, I420, RGB, BGR, RGBA, BGRA, ARGB, ABGR}"));
 
 static GstStaticPadTemplate src_factory =
   GST_STATIC_PAD_TEMPLATE("src",
@@ -77,7 +135,86 @@ static GstStaticPadTemplate src_factory =
                           GST_PAD_ALWAYS,
                           GST_STATIC_CAPS(
                             "video/x-raw(memory:mlu), format={NV12, NV21, I420, RGB, BGR, RGBA, ARGB, BGRA, ABGR};"
-                            "video/x-raw, format={NV12, NV21, I420, RGB, BGR, RGBA, ARGB, BGRA, ABGR};"));
+                            "video/x-raw, format={NV12, NV21, I420, RGB, BGR, RGBA, ARGB, BGRA, ABGR};" TENSOR_CAPS));
+
+struct InFlightFrame
+{
+  std::shared_ptr<QueueNotifier> notifier;
+  // input is borrowed by kernels until they are done
+  GstBuffer* input;
+  // device memory retired while kernels of the frame were being launched, freed when they are done
+  std::vector<GstSyncedMemory_t> retired;
+};
+
+struct StagingSlot
+{
+  void* host = nullptr;
+  size_t size = 0;
+  // upload from the slot is done
+  std::shared_ptr<QueueNotifier> uploaded;
+};
+
+struct PointerTable
+{
+  GstSyncedMemory_t mem;
+  guint64 last_use;
+};
+
+// descriptors and workspace sizes of kernels, depending only on caps and regions
+struct KernelParams
+{
+  cncvImageDescriptor sink_desc;
+  cncvImageDescriptor src_desc;
+  // rgb series resized in format of input, to outputs or to packed intermediate images
+  cncvImageDescriptor resize_dst_desc;
+  cncvImageDescriptor tmp_desc;
+  std::vector<cncvRect> rois;
+  std::vector<cncvRect> dst_rois;
+  size_t resize_convert_size = 0;
+  guint resize_rgbx_n = 0;
+  size_t resize_rgbx_size = 0;
+};
+
+struct GstCnconvertPrivateCpp
+{
+  std::mutex in_flight_mtx;
+  std::deque<InFlightFrame> in_flight;
+  KernelParams params;
+  // device copies of pointer tables of kernels, keyed by pointers in them
+  std::map<std::vector<void*>, PointerTable> tables;
+  guint64 table_clock = 0;
+  // workspace of kernels, shared by frames in flight as kernels run in order on queue
+  GstSyncedMemory_t workspace = nullptr;
+  std::vector<GstSyncedMemory_t> retired;
+  // bytes copied from host to device for current frame, and for the last frame processed
+  guint64 frame_h2d = 0;
+  std::atomic<guint64> h2d_bytes{ 0 };
+  // page-locked ring uploads of inputs in system memory go through
+  StagingSlot staging[STAGING_SLOTS];
+  guint staging_index = 0;
+  // created on first frame converted on cpu
+  std::unique_ptr<CpuConverter> cpu;
+  // resize, convert and cast yuv to tensors, one for each batch size, created on demand and run on tensor_queue
+  std::map<guint, std::unique_ptr<edk::MluResizeConvertOp>> tensor_ops;
+  edk::MluTaskQueue_t tensor_queue;
+};
+
+// tensors of a batch are written by one kernel into one device memory, freed with the last of them
+struct TensorBatchDeallocator : public FrameDeallocator
+{
+  explicit TensorBatchDeallocator(std::shared_ptr<GstSyncedMemory> batch)
+    : batch_(std::move(batch))
+  {}
+  void deallocate() override { batch_.reset(); }
+
+private:
+  TensorBatchDeallocator(const TensorBatchDeallocator&) = delete;
+  const TensorBatchDeallocator& operator=(const TensorBatchDeallocator&) = delete;
+  std::shared_ptr<GstSyncedMemory> batch_;
+};
+
+static void
+gst_cnconvert_video_direction_init(GstVideoDirectionInterface* iface);
 
 struct GstCnconvertPrivate
 {
@@ -86,20 +223,59 @@ struct GstCnconvertPrivate
   std::once_flag init_flag;
   GstVideoInfo sink_info;
   GstVideoInfo src_info;
-  GstSyncedMemory_t mlu_dst_mem;
   GstSyncedMemory_t tmp_mem;
-  GstSyncedMemory_t cncv_workspace;
+  GstBufferPool* pool;
   gint device_id;
+  guint in_flight;
+  gboolean has_crop;
+  cncvRect crop;
+  gchar* crop_str;
+  GQuark roi_type;
+  gboolean keep_aspect_ratio;
+  guint pad_color;
+  GstCnconvertPadPosition pad_position;
+  // images of padding, in layout of output and of intermediate images, filled with pad_mem_color
+  GstSyncedMemory_t pad_mem;
+  GstSyncedMemory_t pad_tmp_mem;
+  guint pad_mem_color;
+  gboolean fuse_rgb_resize;
+  GstCnconvertBackend backend;
+  // backend resolved from caps
+  gboolean use_cpu;
   gboolean input_on_mlu;
   gboolean output_on_mlu;
+  // downstream handles strided host frames described by GstVideoMeta
+  gboolean downstream_video_meta;
   gboolean disable_resize;
   gboolean disable_convert;
+  GstCnconvertDtype dtype;
+  GstCnconvertLayout layout;
+  // normalization of r, g and b of tensors, as (value - mean) / std
+  gfloat mean[3];
+  gfloat std[3];
+  gchar* mean_str;
+  gchar* std_str;
+  // outputs are tensors of pixel format in src_info, element type of tensor_dtype and order of tensor_layout
+  gboolean tensor_output;
+  GstCnconvertDtype tensor_dtype;
+  GstCnconvertLayout tensor_layout;
+  // rotation or flip, applied by cpu backend, on host copies of MLU memory
+  GstVideoOrientationMethod video_direction;
+
+  GstCnconvertPrivateCpp* cpp;
 };
 
-G_DEFINE_TYPE_WITH_PRIVATE(GstCnconvert, gst_cnconvert, GST_TYPE_ELEMENT);
+G_DEFINE_TYPE_WITH_CODE(GstCnconvert, gst_cnconvert, GST_TYPE_ELEMENT,
+                        G_ADD_PRIVATE(GstCnconvert)
+                        G_IMPLEMENT_INTERFACE(GST_TYPE_VIDEO_DIRECTION, gst_cnconvert_video_direction_init));
 // gst_cnconvert_parent_class is defined in G_DEFINE_TYPE macro
 #define PARENT_CLASS gst_cnconvert_parent_class
 
+// video-direction property of GstVideoDirection is all of the interface
+static void
+gst_cnconvert_video_direction_init(GstVideoDirectionInterface* iface)
+{}
+
 static inline GstCnconvertPrivate*
 gst_cnconvert_get_private(GstCnconvert* object)
 {
@@ -115,6 +291,10 @@ static void
 gst_cnconvert_finalize(GObject* gobject);
 static gboolean
 gst_cnconvert_sink_event(GstPad* pad, GstObject* parent, GstEvent* event);
+static gboolean
+gst_cnconvert_sink_query(GstPad* pad, GstObject* parent, GstQuery* query);
+static GstStateChangeReturn
+gst_cnconvert_change_state(GstElement* element, GstStateChange transition);
 static GstFlowReturn
 gst_cnconvert_chain(GstPad* pad, GstObject* parent, GstBuffer* buffer);
 
@@ -122,9 +302,86 @@ gst_cnconvert_chain(GstPad* pad, GstObject* parent, GstBuffer* buffer);
 static gboolean
 gst_cnconvert_setcaps(GstCnconvert* self, GstCaps* sinkcaps);
 static gboolean
-resize_convert(GstCnconvert* self, GstMluFrame_t frame);
+gst_cnconvert_decide_allocation(GstCnconvert* self, GstCaps* caps);
+static void
+gst_cnconvert_release_pool(GstCnconvert* self);
+static gboolean
+gst_cnconvert_wait_in_flight(GstCnconvert* self, guint max_pending);
+static void
+gst_cnconvert_free_workspaces(GstCnconvert* self);
+static void
+gst_cnconvert_free_pad(GstCnconvert* self);
+static void
+gst_cnconvert_free_staging(GstCnconvert* self);
 static GstBuffer*
-transform_to_cpu(GstCnconvert* self, GstBuffer* buffer, GstMluFrame_t frame, GstVideoFormat fmt);
+transform_to_cpu(GstCnconvert* self, GstBuffer* buffer, GstMluFrame_t frame);
+
+#define GST_CNCONVERT_PAD_POSITION (gst_cnconvert_pad_position_get_type())
+static GType
+gst_cnconvert_pad_position_get_type(void)
+{
+  static const GEnumValue values[] = { { GST_CNCONVERT_PAD_CENTER, "Pad both sides, image at center", "center" },
+                                       { GST_CNCONVERT_PAD_TOP_LEFT, "Pad right and bottom, image at top left",
+                                         "top-left" },
+                                       { 0, NULL, NULL } };
+  static volatile GType id = 0;
+  if (g_once_init_enter((gsize*)&id)) {
+    GType _id;
+    _id = g_enum_register_static("GstCnconvertPadPosition", values);
+    g_once_init_leave((gsize*)&id, _id);
+  }
+  return id;
+}
+
+#define GST_CNCONVERT_DTYPE (gst_cnconvert_dtype_get_type())
+static GType
+gst_cnconvert_dtype_get_type(void)
+{
+  static const GEnumValue values[] = { { GST_CNCONVERT_DTYPE_UINT8, "8 bits unsigned integer", "uint8" },
+                                       { GST_CNCONVERT_DTYPE_FLOAT16, "16 bits float", "float16" },
+                                       { GST_CNCONVERT_DTYPE_FLOAT32, "32 bits float", "float32" },
+                                       { 0, NULL, NULL } };
+  static volatile GType id = 0;
+  if (g_once_init_enter((gsize*)&id)) {
+    GType _id;
+    _id = g_enum_register_static("GstCnconvertDtype", values);
+    g_once_init_leave((gsize*)&id, _id);
+  }
+  return id;
+}
+
+#define GST_CNCONVERT_LAYOUT (gst_cnconvert_layout_get_type())
+static GType
+gst_cnconvert_layout_get_type(void)
+{
+  static const GEnumValue values[] = { { GST_CNCONVERT_LAYOUT_NHWC, "Channels interleaved in pixels", "nhwc" },
+                                       { GST_CNCONVERT_LAYOUT_NCHW, "A plane for each channel", "nchw" },
+                                       { 0, NULL, NULL } };
+  static volatile GType id = 0;
+  if (g_once_init_enter((gsize*)&id)) {
+    GType _id;
+    _id = g_enum_register_static("GstCnconvertLayout", values);
+    g_once_init_leave((gsize*)&id, _id);
+  }
+  return id;
+}
+
+#define GST_CNCONVERT_BACKEND (gst_cnconvert_backend_get_type())
+static GType
+gst_cnconvert_backend_get_type(void)
+{
+  static const GEnumValue values[] = { { GST_CNCONVERT_BACKEND_AUTO, "Choose by memory and size of frames", "auto" },
+                                       { GST_CNCONVERT_BACKEND_MLU, "Convert on MLU", "mlu" },
+                                       { GST_CNCONVERT_BACKEND_CPU, "Convert on cpu with libyuv", "cpu" },
+                                       { 0, NULL, NULL } };
+  static volatile GType id = 0;
+  if (g_once_init_enter((gsize*)&id)) {
+    GType _id;
+    _id = g_enum_register_static("GstCnconvertBackend", values);
+    g_once_init_leave((gsize*)&id, _id);
+  }
+  return id;
+}
 
 /* GObject vmethod implementations */
 
@@ -141,10 +398,86 @@ gst_cnconvert_class_init(GstCnconvertClass* klass)
   gobject_class->get_property = gst_cnconvert_get_property;
   gobject_class->finalize = gst_cnconvert_finalize;
 
+  gstelement_class->change_state = GST_DEBUG_FUNCPTR(gst_cnconvert_change_state);
+
   g_object_class_install_property(gobject_class, PROP_DEVICE_ID,
                                   g_param_spec_int("device-id", "device id", "device identification", -1, 10,
                                                    DEFAULT_DEVICE_ID,
                                                    (GParamFlags)(G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS)));
+  g_object_class_install_property(
+    gobject_class, PROP_IN_FLIGHT,
+    g_param_spec_uint("in-flight", "in flight",
+                      "number of frames processed asynchronously on MLU, 0 to wait for each frame before pushing it",
+                      0, MAX_IN_FLIGHT, DEFAULT_IN_FLIGHT,
+                      (GParamFlags)(G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS | GST_PARAM_MUTABLE_READY)));
+  g_object_class_install_property(
+    gobject_class, PROP_CROP,
+    g_param_spec_string("crop", "crop", "region of input to convert, in format of \"x,y,w,h\", overrides crop meta",
+                        NULL, (GParamFlags)(G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS)));
+  g_object_class_install_property(
+    gobject_class, PROP_ROI_TYPE,
+    g_param_spec_string("roi-type", "roi type",
+                        "type of region of interest metas on input, each of them is cropped to an output, "
+                        "inputs without such metas produce no output",
+                        NULL, (GParamFlags)(G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS | GST_PARAM_MUTABLE_READY)));
+  g_object_class_install_property(
+    gobject_class, PROP_KEEP_ASPECT_RATIO,
+    g_param_spec_boolean("keep-aspect-ratio", "keep aspect ratio",
+                         "resize with aspect ratio kept and pad the rest of output, a letterbox meta is attached",
+                         DEFAULT_KEEP_ASPECT_RATIO, (GParamFlags)(G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS)));
+  g_object_class_install_property(gobject_class, PROP_PAD_COLOR,
+                                  g_param_spec_uint("pad-color", "pad color", "color of padding, in format of 0xRRGGBB",
+                                                    0, 0xFFFFFF, DEFAULT_PAD_COLOR,
+                                                    (GParamFlags)(G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS)));
+  g_object_class_install_property(gobject_class, PROP_PAD_POSITION,
+                                  g_param_spec_enum("pad-position", "pad position",
+                                                    "position of resized image in output when aspect ratio is kept",
+                                                    GST_CNCONVERT_PAD_POSITION, DEFAULT_PAD_POSITION,
+                                                    (GParamFlags)(G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS)));
+  g_object_class_install_property(
+    gobject_class, PROP_FUSE_RGB_RESIZE,
+    g_param_spec_boolean("fuse-rgb-resize", "fuse rgb resize",
+                         "resize and convert rgb series in one kernel, otherwise resize to an intermediate image "
+                         "and convert it. Fused kernel is faster but output may differ slightly from the two steps",
+                         DEFAULT_FUSE_RGB_RESIZE, (GParamFlags)(G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS)));
+  g_object_class_install_property(
+    gobject_class, PROP_BACKEND,
+    g_param_spec_enum("backend", "backend",
+                      "where to convert, cpu converts yuv to rgb series with libyuv, mapping MLU memory to host, auto "
+                      "uses cpu for small outputs in system memory and for rotation and flip",
+                      GST_CNCONVERT_BACKEND, DEFAULT_BACKEND,
+                      (GParamFlags)(G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS | GST_PARAM_MUTABLE_READY)));
+  g_object_class_install_property(
+    gobject_class, PROP_H2D_BYTES,
+    g_param_spec_uint64("h2d-bytes", "h2d bytes",
+                        "bytes copied from host to device for the last frame, including uploads of inputs and "
+                        "pointer tables of kernels",
+                        0, G_MAXUINT64, 0, (GParamFlags)(G_PARAM_READABLE | G_PARAM_STATIC_STRINGS)));
+  g_object_class_install_property(
+    gobject_class, PROP_DTYPE,
+    g_param_spec_enum("dtype", "dtype",
+                      "element type of tensor outputs when downstream accepts several, float16 is cast by the "
+                      "resize kernel",
+                      GST_CNCONVERT_DTYPE, DEFAULT_DTYPE,
+                      (GParamFlags)(G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS | GST_PARAM_MUTABLE_READY)));
+  g_object_class_install_property(
+    gobject_class, PROP_LAYOUT,
+    g_param_spec_enum("layout", "layout", "dimension order of tensor outputs when downstream accepts both",
+                      GST_CNCONVERT_LAYOUT, DEFAULT_LAYOUT,
+                      (GParamFlags)(G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS | GST_PARAM_MUTABLE_READY)));
+  g_object_class_install_property(
+    gobject_class, PROP_MEAN,
+    g_param_spec_string("mean", "mean",
+                        "mean of r, g and b in 0-255 subtracted from float tensor outputs, in format of \"r,g,b\"",
+                        nullptr, (GParamFlags)(G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS | GST_PARAM_MUTABLE_READY)));
+  g_object_class_install_property(
+    gobject_class, PROP_STD,
+    g_param_spec_string("std", "std",
+                        "standard deviation of r, g and b in 0-255 float tensor outputs are divided by, in format "
+                        "of \"r,g,b\"",
+                        nullptr, (GParamFlags)(G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS | GST_PARAM_MUTABLE_READY)));
+  // rotations and flips of GstVideoOrientationMethod, auto and custom are taken as identity
+  g_object_class_override_property(gobject_class, PROP_VIDEO_DIRECTION, "video-direction");
 
   gst_element_class_set_details_simple(gstelement_class, "cnconvert", "Generic/Convertor", "Cambricon convertor",
                                        "Cambricon Solution SDK");
@@ -158,6 +491,7 @@ gst_cnconvert_init(GstCnconvert* self)
 {
   self->sinkpad = gst_pad_new_from_static_template(&sink_factory, "sink");
   gst_pad_set_event_function(self->sinkpad, GST_DEBUG_FUNCPTR(gst_cnconvert_sink_event));
+  gst_pad_set_query_function(self->sinkpad, GST_DEBUG_FUNCPTR(gst_cnconvert_sink_query));
   gst_pad_set_chain_function(self->sinkpad, GST_DEBUG_FUNCPTR(gst_cnconvert_chain));
   gst_element_add_pad(GST_ELEMENT(self), self->sinkpad);
 
@@ -165,12 +499,38 @@ gst_cnconvert_init(GstCnconvert* self)
   gst_element_add_pad(GST_ELEMENT(self), self->srcpad);
 
   GstCnconvertPrivate* priv = gst_cnconvert_get_private(self);
-  priv->mlu_dst_mem = nullptr;
   priv->tmp_mem = nullptr;
-  priv->cncv_workspace = nullptr;
+  priv->pool = nullptr;
   priv->handle = nullptr;
   priv->queue = nullptr;
   priv->device_id = -1;
+  priv->in_flight = DEFAULT_IN_FLIGHT;
+  priv->has_crop = FALSE;
+  priv->crop_str = nullptr;
+  priv->roi_type = 0;
+  priv->downstream_video_meta = FALSE;
+  priv->keep_aspect_ratio = DEFAULT_KEEP_ASPECT_RATIO;
+  priv->pad_color = DEFAULT_PAD_COLOR;
+  priv->pad_position = DEFAULT_PAD_POSITION;
+  priv->pad_mem = nullptr;
+  priv->pad_tmp_mem = nullptr;
+  priv->pad_mem_color = DEFAULT_PAD_COLOR;
+  priv->fuse_rgb_resize = DEFAULT_FUSE_RGB_RESIZE;
+  priv->backend = DEFAULT_BACKEND;
+  priv->use_cpu = FALSE;
+  priv->dtype = DEFAULT_DTYPE;
+  priv->layout = DEFAULT_LAYOUT;
+  for (guint i = 0; i < 3; ++i) {
+    priv->mean[i] = 0;
+    priv->std[i] = 1;
+  }
+  priv->mean_str = nullptr;
+  priv->std_str = nullptr;
+  priv->tensor_output = FALSE;
+  priv->tensor_dtype = DEFAULT_DTYPE;
+  priv->tensor_layout = DEFAULT_LAYOUT;
+  priv->video_direction = DEFAULT_VIDEO_DIRECTION;
+  priv->cpp = new GstCnconvertPrivateCpp;
 }
 
 static void
@@ -180,24 +540,25 @@ gst_cnconvert_finalize(GObject* object)
   auto self = GST_CNCONVERT(object);
   GstCnconvertPrivate* priv = gst_cnconvert_get_private(self);
 
-  if (priv->mlu_dst_mem) {
-    if (!cn_syncedmem_free(priv->mlu_dst_mem)) {
-      GST_ERROR_OBJECT(self, "Free mlu memory failed");
-    }
-    priv->mlu_dst_mem = nullptr;
-  }
+  gst_cnconvert_wait_in_flight(self, 0);
+  gst_cnconvert_release_pool(self);
   if (priv->tmp_mem) {
     if (!cn_syncedmem_free(priv->tmp_mem)) {
       GST_ERROR_OBJECT(self, "Free mlu memory failed");
     }
     priv->tmp_mem = nullptr;
   }
-  if (priv->cncv_workspace) {
-    if (!cn_syncedmem_free(priv->cncv_workspace)) {
-      GST_ERROR_OBJECT(self, "Free mlu memory failed");
-    }
-    priv->cncv_workspace = nullptr;
-  }
+  gst_cnconvert_free_workspaces(self);
+  gst_cnconvert_free_pad(self);
+  gst_cnconvert_free_staging(self);
+  g_free(priv->crop_str);
+  priv->crop_str = nullptr;
+  g_free(priv->mean_str);
+  priv->mean_str = nullptr;
+  g_free(priv->std_str);
+  priv->std_str = nullptr;
+  delete priv->cpp;
+  priv->cpp = nullptr;
   if (priv->handle) {
     CNCV_SAFECALL(cncvDestroy(priv->handle), );
     priv->handle = nullptr;
@@ -216,6 +577,86 @@ gst_cnconvert_set_property(GObject* object, guint prop_id, const GValue* value,
     case PROP_DEVICE_ID:
       priv->device_id = g_value_get_int(value);
       break;
+    case PROP_IN_FLIGHT:
+      priv->in_flight = g_value_get_uint(value);
+      break;
+    case PROP_CROP: {
+      const gchar* str = g_value_get_string(value);
+      guint x, y, w, h;
+      g_free(priv->crop_str);
+      priv->crop_str = nullptr;
+      priv->has_crop = FALSE;
+      if (str && sscanf(str, "%u,%u,%u,%u", &x, &y, &w, &h) == 4 && w > 0 && h > 0) {
+        priv->crop.x = x;
+        priv->crop.y = y;
+        priv->crop.w = w;
+        priv->crop.h = h;
+        priv->has_crop = TRUE;
+        priv->crop_str = g_strdup(str);
+      } else if (str && *str) {
+        GST_WARNING_OBJECT(object, "invalid crop \"%s\", expect \"x,y,w,h\"", str);
+      }
+      break;
+    }
+    case PROP_ROI_TYPE: {
+      const gchar* str = g_value_get_string(value);
+      priv->roi_type = str && *str ? g_quark_from_string(str) : 0;
+      break;
+    }
+    case PROP_KEEP_ASPECT_RATIO:
+      priv->keep_aspect_ratio = g_value_get_boolean(value);
+      break;
+    case PROP_PAD_COLOR:
+      // images of padding are refilled by chain
+      priv->pad_color = g_value_get_uint(value);
+      break;
+    case PROP_PAD_POSITION:
+      priv->pad_position = (GstCnconvertPadPosition)g_value_get_enum(value);
+      break;
+    case PROP_FUSE_RGB_RESIZE:
+      priv->fuse_rgb_resize = g_value_get_boolean(value);
+      break;
+    case PROP_BACKEND:
+      priv->backend = (GstCnconvertBackend)g_value_get_enum(value);
+      break;
+    case PROP_DTYPE:
+      priv->dtype = (GstCnconvertDtype)g_value_get_enum(value);
+      break;
+    case PROP_LAYOUT:
+      priv->layout = (GstCnconvertLayout)g_value_get_enum(value);
+      break;
+    case PROP_MEAN:
+    case PROP_STD: {
+      const gchar* str = g_value_get_string(value);
+      gboolean is_mean = prop_id == PROP_MEAN;
+      gfloat* values = is_mean ? priv->mean : priv->std;
+      gchar** values_str = is_mean ? &priv->mean_str : &priv->std_str;
+      gfloat v[3];
+      g_free(*values_str);
+      *values_str = nullptr;
+      for (guint i = 0; i < 3; ++i) {
+        values[i] = is_mean ? 0 : 1;
+      }
+      if (str && sscanf(str, "%f,%f,%f", &v[0], &v[1], &v[2]) == 3 && (is_mean || (v[0] && v[1] && v[2]))) {
+        for (guint i = 0; i < 3; ++i) {
+          values[i] = v[i];
+        }
+        *values_str = g_strdup(str);
+      } else if (str && *str) {
+        GST_WARNING_OBJECT(object, "invalid %s \"%s\", expect \"r,g,b\"", pspec->name, str);
+      }
+      break;
+    }
+    case PROP_VIDEO_DIRECTION: {
+      auto method = (GstVideoOrientationMethod)g_value_get_enum(value);
+      if (method == GST_VIDEO_ORIENTATION_AUTO || method == GST_VIDEO_ORIENTATION_CUSTOM) {
+        GST_WARNING_OBJECT(object, "video direction %d is not supported, taken as identity", method);
+        method = GST_VIDEO_ORIENTATION_IDENTITY;
+      }
+      // output caps are renegotiated on next caps
+      priv->video_direction = method;
+      break;
+    }
     default:
       G_OBJECT_WARN_INVALID_PROPERTY_ID(object, prop_id, pspec);
       break;
@@ -230,6 +671,48 @@ gst_cnconvert_get_property(GObject* object, guint prop_id, GValue* value, GParam
     case PROP_DEVICE_ID:
       g_value_set_int(value, priv->device_id);
       break;
+    case PROP_IN_FLIGHT:
+      g_value_set_uint(value, priv->in_flight);
+      break;
+    case PROP_CROP:
+      g_value_set_string(value, priv->crop_str);
+      break;
+    case PROP_ROI_TYPE:
+      g_value_set_string(value, priv->roi_type ? g_quark_to_string(priv->roi_type) : nullptr);
+      break;
+    case PROP_KEEP_ASPECT_RATIO:
+      g_value_set_boolean(value, priv->keep_aspect_ratio);
+      break;
+    case PROP_PAD_COLOR:
+      g_value_set_uint(value, priv->pad_color);
+      break;
+    case PROP_PAD_POSITION:
+      g_value_set_enum(value, priv->pad_position);
+      break;
+    case PROP_FUSE_RGB_RESIZE:
+      g_value_set_boolean(value, priv->fuse_rgb_resize);
+      break;
+    case PROP_BACKEND:
+      g_value_set_enum(value, priv->backend);
+      break;
+    case PROP_H2D_BYTES:
+      g_value_set_uint64(value, priv->cpp->h2d_bytes.load());
+      break;
+    case PROP_DTYPE:
+      g_value_set_enum(value, priv->dtype);
+      break;
+    case PROP_LAYOUT:
+      g_value_set_enum(value, priv->layout);
+      break;
+    case PROP_MEAN:
+      g_value_set_string(value, priv->mean_str);
+      break;
+    case PROP_STD:
+      g_value_set_string(value, priv->std_str);
+      break;
+    case PROP_VIDEO_DIRECTION:
+      g_value_set_enum(value, priv->video_direction);
+      break;
     default:
       G_OBJECT_WARN_INVALID_PROPERTY_ID(object, prop_id, pspec);
       break;
@@ -255,6 +738,22 @@ gst_cnconvert_sink_event(GstPad* pad, GstObject* parent, GstEvent* event)
       gst_event_unref(event);
       break;
     }
+    case GST_EVENT_EOS:
+      // give inputs back to upstream, outputs are synced by their consumers
+      gst_cnconvert_wait_in_flight(self, 0);
+      ret = gst_pad_event_default(pad, parent, event);
+      break;
+    case GST_EVENT_FLUSH_START:
+    case GST_EVENT_FLUSH_STOP: {
+      GstCnconvertPrivate* priv = gst_cnconvert_get_private(self);
+      gst_cnconvert_wait_in_flight(self, 0);
+      // unblock chain waiting for a free output buffer
+      if (priv->pool) {
+        gst_buffer_pool_set_flushing(priv->pool, GST_EVENT_TYPE(event) == GST_EVENT_FLUSH_START);
+      }
+      ret = gst_pad_event_default(pad, parent, event);
+      break;
+    }
     default:
       ret = gst_pad_event_default(pad, parent, event);
       break;
@@ -262,394 +761,1145 @@ gst_cnconvert_sink_event(GstPad* pad, GstObject* parent, GstEvent* event)
   return ret;
 }
 
-static inline int get_channel_num_plane0(GstVideoFormat fmt)
+static gboolean
+gst_cnconvert_sink_query(GstPad* pad, GstObject* parent, GstQuery* query)
 {
-  switch (fmt) {
-    case GST_VIDEO_FORMAT_NV12: case GST_VIDEO_FORMAT_NV21: case GST_VIDEO_FORMAT_I420:
-      return 1;
-    case GST_VIDEO_FORMAT_RGB: case GST_VIDEO_FORMAT_BGR:
-      return 3;
-    case GST_VIDEO_FORMAT_RGBA: case GST_VIDEO_FORMAT_BGRA: case GST_VIDEO_FORMAT_ARGB: case GST_VIDEO_FORMAT_ABGR:
-      return 4;
+  GstCnconvert* self = GST_CNCONVERT(parent);
+
+  switch (GST_QUERY_TYPE(query)) {
+    case GST_QUERY_ALLOCATION: {
+      GstCaps* caps;
+      gboolean need_pool;
+      GstVideoInfo info;
+      gst_query_parse_allocation(query, &caps, &need_pool);
+      if (!caps || !gst_video_info_from_caps(&info, caps)) {
+        return FALSE;
+      }
+
+      // propose pool of mlu frames to upstream producing MLU memory
+      if (need_pool && gst_caps_features_contains(gst_caps_get_features(caps, 0), GST_CAPS_FEATURE_MEMORY_MLU)) {
+        GstBufferPool* pool = gst_mlu_buffer_pool_new();
+        GstStructure* config = gst_buffer_pool_get_config(pool);
+        gst_buffer_pool_config_set_params(config, caps, info.size, DEFAULT_MIN_BUFFERS, DEFAULT_MAX_BUFFERS);
+        if (gst_buffer_pool_set_config(pool, config)) {
+          gst_query_add_allocation_pool(query, pool, info.size, DEFAULT_MIN_BUFFERS, DEFAULT_MAX_BUFFERS);
+        } else {
+          GST_WARNING_OBJECT(self, "set config of proposed pool failed");
+        }
+        gst_object_unref(pool);
+      }
+      gst_query_add_allocation_meta(query, GST_VIDEO_META_API_TYPE, NULL);
+      // crop is done along with resize, upstream needs not to crop by itself
+      gst_query_add_allocation_meta(query, GST_VIDEO_CROP_META_API_TYPE, NULL);
+      return TRUE;
+    }
     default:
-      GST_ERROR("Unsupported pixel format");
-      return 0;
+      return gst_pad_query_default(pad, parent, query);
   }
 }
 
-static inline cncvPixelFormat format_cast(GstVideoFormat fmt)
+static GstStateChangeReturn
+gst_cnconvert_change_state(GstElement* element, GstStateChange transition)
 {
-  switch (fmt) {
-    case GST_VIDEO_FORMAT_NV12:
-      return CNCV_PIX_FMT_NV12;
-    case GST_VIDEO_FORMAT_NV21:
-      return CNCV_PIX_FMT_NV21;
-    case GST_VIDEO_FORMAT_I420:
-      return CNCV_PIX_FMT_I420;
-    case GST_VIDEO_FORMAT_RGB:
-      return CNCV_PIX_FMT_RGB;
-    case GST_VIDEO_FORMAT_BGR:
-      return CNCV_PIX_FMT_BGR;
-    case GST_VIDEO_FORMAT_RGBA:
-      return CNCV_PIX_FMT_RGBA;
-    case GST_VIDEO_FORMAT_BGRA:
-      return CNCV_PIX_FMT_BGRA;
-    case GST_VIDEO_FORMAT_ARGB:
-      return CNCV_PIX_FMT_ARGB;
-    case GST_VIDEO_FORMAT_ABGR:
-      return CNCV_PIX_FMT_ABGR;
-    default:
-      GST_ERROR("unsupport pixel format");
-      return CNCV_PIX_FMT_INVALID;
+  GstCnconvertPrivate* priv = gst_cnconvert_get_private(GST_CNCONVERT(element));
+
+  if (transition == GST_STATE_CHANGE_PAUSED_TO_READY && priv->pool) {
+    // unblock chain waiting for a free output buffer
+    gst_buffer_pool_set_flushing(priv->pool, TRUE);
+  }
+
+  GstStateChangeReturn ret = GST_ELEMENT_CLASS(PARENT_CLASS)->change_state(element, transition);
+
+  if (transition == GST_STATE_CHANGE_PAUSED_TO_READY) {
+    gst_cnconvert_wait_in_flight(GST_CNCONVERT(element), 0);
+  }
+  if (transition == GST_STATE_CHANGE_READY_TO_PAUSED && priv->pool) {
+    gst_buffer_pool_set_flushing(priv->pool, FALSE);
+  }
+  return ret;
+}
+
+static void
+free_syncedmems(GstCnconvert* self, std::vector<GstSyncedMemory_t>* mems)
+{
+  for (auto mem : *mems) {
+    if (!cn_syncedmem_free(mem)) {
+      GST_ERROR_OBJECT(self, "Free mlu memory failed");
+    }
   }
+  mems->clear();
 }
 
-static inline bool isYUV420sp(GstVideoFormat fmt) {
-  if (fmt == GST_VIDEO_FORMAT_NV12 || fmt == GST_VIDEO_FORMAT_NV21)
-    return true;
+static gboolean
+gst_cnconvert_wait_in_flight(GstCnconvert* self, guint max_pending)
+{
+  GstCnconvertPrivateCpp* cpp = gst_cnconvert_get_private(self)->cpp;
+  gboolean ret = TRUE;
+
+  std::lock_guard<std::mutex> lk(cpp->in_flight_mtx);
+  while (cpp->in_flight.size() > max_pending) {
+    InFlightFrame& f = cpp->in_flight.front();
+    if (!f.notifier->wait()) {
+      GST_ERROR_OBJECT(self, "wait for in-flight frame failed");
+      ret = FALSE;
+    }
+    gst_buffer_unref(f.input);
+    free_syncedmems(self, &f.retired);
+    cpp->in_flight.pop_front();
+  }
+  return ret;
+}
 
-  return false;
+static void
+gst_cnconvert_free_workspaces(GstCnconvert* self)
+{
+  GstCnconvertPrivateCpp* cpp = gst_cnconvert_get_private(self)->cpp;
+  for (auto& it : cpp->tables) {
+    cpp->retired.push_back(it.second.mem);
+  }
+  cpp->tables.clear();
+  if (cpp->workspace) {
+    cpp->retired.push_back(cpp->workspace);
+    cpp->workspace = nullptr;
+  }
+  free_syncedmems(self, &cpp->retired);
+  cpp->params = KernelParams();
 }
 
-static inline bool isRGB(GstVideoFormat fmt) {
-  if (fmt == GST_VIDEO_FORMAT_RGB || fmt == GST_VIDEO_FORMAT_BGR ||
-      fmt == GST_VIDEO_FORMAT_RGBA || fmt == GST_VIDEO_FORMAT_BGRA ||
-      fmt == GST_VIDEO_FORMAT_ARGB || fmt == GST_VIDEO_FORMAT_ABGR)
-    return true;
+// device memory may be read by kernels in flight, it is freed after the current frame is done
+static void
+retire(GstCnconvert* self, GstSyncedMemory_t mem)
+{
+  gst_cnconvert_get_private(self)->cpp->retired.push_back(mem);
+}
 
-  return false;
+static void*
+prepare_workspace(GstCnconvert* self, size_t size)
+{
+  GstCnconvertPrivateCpp* cpp = gst_cnconvert_get_private(self)->cpp;
+  if (size == 0) {
+    return nullptr;
+  }
+  if (cpp->workspace && cn_syncedmem_get_size(cpp->workspace) < size) {
+    retire(self, cpp->workspace);
+    cpp->workspace = nullptr;
+  }
+  if (!cpp->workspace) {
+    GST_DEBUG_OBJECT(self, "new workspace syncedmem, size: %lu", size);
+    cpp->workspace = cn_syncedmem_new(size);
+  }
+  return cn_syncedmem_get_mutable_dev_data(cpp->workspace);
 }
 
-static cncvImageDescriptor video_info_to_desc(const GstVideoInfo& info)
+/**
+ * Device copy of a pointer table of kernels. Inputs and outputs are recycled by buffer pools, so tables are copied to
+ * device once for each combination of them, and kernels are launched without any copy from host in steady state.
+ */
+static void**
+pointer_table(GstCnconvert* self, const std::vector<void*>& ptrs)
 {
-  cncvImageDescriptor desc;
-  desc.width = info.width;
-  desc.height = info.height;
-  desc.pixel_fmt = format_cast(info.finfo->format);
-  desc.color_space = CNCV_COLOR_SPACE_BT_601;
-  desc.depth = CNCV_DEPTH_8U;
-  desc.stride[0] = info.stride[0];
-  desc.stride[1] = info.stride[1];
-  desc.stride[2] = info.stride[2];
-  desc.stride[3] = info.stride[3];
-  desc.stride[4] = desc.stride[5] = 0;
-  return desc;
+  GstCnconvertPrivateCpp* cpp = gst_cnconvert_get_private(self)->cpp;
+  auto it = cpp->tables.find(ptrs);
+  if (it == cpp->tables.end()) {
+    if (cpp->tables.size() >= MAX_POINTER_TABLES) {
+      auto lru = cpp->tables.begin();
+      for (auto t = cpp->tables.begin(); t != cpp->tables.end(); ++t) {
+        if (t->second.last_use < lru->second.last_use) {
+          lru = t;
+        }
+      }
+      retire(self, lru->second.mem);
+      cpp->tables.erase(lru);
+    }
+    size_t size = ptrs.size() * sizeof(void*);
+    GstSyncedMemory_t mem = cn_syncedmem_new(size);
+    memcpy(cn_syncedmem_get_mutable_host_data(mem), ptrs.data(), size);
+    cn_syncedmem_get_dev_data(mem);
+    cpp->frame_h2d += size;
+    it = cpp->tables.emplace(ptrs, PointerTable{ mem, 0 }).first;
+  }
+  it->second.last_use = ++cpp->table_clock;
+  return reinterpret_cast<void**>(const_cast<void*>(cn_syncedmem_get_dev_data(it->second.mem)));
 }
 
+// makes sure window of in-flight frames has room for a new one
 static gboolean
-resize_convert(GstCnconvert* self, GstMluFrame_t frame)
+begin_frame(GstCnconvert* self)
 {
   GstCnconvertPrivate* priv = gst_cnconvert_get_private(self);
+  return gst_cnconvert_wait_in_flight(self, MAX(priv->in_flight, 1) - 1);
+}
 
-  cncvImageDescriptor src_desc = video_info_to_desc(priv->sink_info);
-  cncvImageDescriptor dst_desc = video_info_to_desc(priv->src_info);
-
-  cncvRect src_roi, dst_roi;
-  src_roi.x = src_roi.y = dst_roi.x = dst_roi.y = 0;
-  src_roi.w = src_desc.width;
-  src_roi.h = src_desc.height;
-  dst_roi.w = dst_desc.width;
-  dst_roi.h = dst_desc.height;
+/**
+ * Synchronous mode waits for kernels here. Otherwise a notifier is placed after kernels and attached to output frames,
+ * consumers wait for it when they access the outputs, and we wait for it when the window is full.
+ */
+static gboolean
+finish_frame(GstCnconvert* self, const std::vector<GstMluFrame_t>& out_frames, GstBuffer* input)
+{
+  GstCnconvertPrivate* priv = gst_cnconvert_get_private(self);
+  GstCnconvertPrivateCpp* cpp = priv->cpp;
 
-  size_t workspace_size;
-  size_t extra_size = 3 * sizeof(void*);
-  CNCV_SAFECALL(cncvGetResizeConvertWorkspaceSize(1, &src_desc, &src_roi, &dst_desc, &dst_roi, &workspace_size), FALSE);
+  cpp->h2d_bytes.store(cpp->frame_h2d);
+  if (priv->in_flight == 0) {
+    for (auto out_frame : out_frames) {
+      gst_mlu_frame_set_syncer(out_frame, nullptr);
+    }
+    CNRT_SAFECALL(cnrtSyncQueue(priv->queue), FALSE);
+    free_syncedmems(self, &cpp->retired);
+    return TRUE;
+  }
 
-  // prepare mlu memory
-  if (priv->cncv_workspace && cn_syncedmem_get_size(priv->cncv_workspace) < (workspace_size + extra_size)) {
-    cn_syncedmem_free(priv->cncv_workspace);
-    priv->cncv_workspace = nullptr;
+  auto notifier = std::make_shared<QueueNotifier>();
+  if (!notifier->place(priv->queue)) {
+    GST_CNCONVERT_ERROR(self, LIBRARY, FAILED, ("place notifier failed"));
+    return FALSE;
   }
-  if (!priv->cncv_workspace) {
-    priv->cncv_workspace = cn_syncedmem_new(workspace_size + extra_size);
+  for (auto out_frame : out_frames) {
+    gst_mlu_frame_set_syncer(out_frame, new NotifierFrameSyncer(notifier));
   }
+  std::lock_guard<std::mutex> lk(cpp->in_flight_mtx);
+  cpp->in_flight.push_back({ notifier, gst_buffer_ref(input), std::move(cpp->retired) });
+  cpp->retired.clear();
+  return TRUE;
+}
+
+static inline cncvRect
+output_roi(const GstVideoInfo& info)
+{
+  cncvRect roi;
+  roi.x = roi.y = 0;
+  roi.w = info.width;
+  roi.h = info.height;
+  return roi;
+}
 
-  if (!priv->mlu_dst_mem) {
-    size_t out_size = 0;
-    out_size = (priv->src_info.width * priv->src_info.height) << 2;
-    GST_DEBUG_OBJECT(self, "new syncedmem, w: %d, h:%d, out size: %lu", priv->src_info.width, priv->src_info.height,
-                     out_size);
-    priv->mlu_dst_mem = cn_syncedmem_new(out_size);
+static inline bool
+same_rects(const std::vector<cncvRect>& a, const std::vector<cncvRect>& b)
+{
+  if (a.size() != b.size()) {
+    return false;
+  }
+  for (size_t i = 0; i < a.size(); ++i) {
+    if (a[i].x != b[i].x || a[i].y != b[i].y || a[i].w != b[i].w || a[i].h != b[i].h) {
+      return false;
+    }
   }
+  return true;
+}
 
-  void** buf_host = reinterpret_cast<void**>(cn_syncedmem_get_mutable_host_data(priv->cncv_workspace));
-  buf_host[0] = cn_syncedmem_get_mutable_dev_data(frame->data[0]);
-  buf_host[1] = cn_syncedmem_get_mutable_dev_data(frame->data[1]);
-  buf_host[2] = cn_syncedmem_get_mutable_dev_data(priv->mlu_dst_mem);
-  buf_host = nullptr;
-  void** buf_dev = reinterpret_cast<void**>(const_cast<void*>(cn_syncedmem_get_dev_data(priv->cncv_workspace)));
-  void** src_ptr = buf_dev;
-  void** dst_ptr = buf_dev + 2;
-  void* workspace = buf_dev + 3;
+// descriptors are made once for each caps
+static void
+prepare_kernel_params(GstCnconvert* self)
+{
+  GstCnconvertPrivate* priv = gst_cnconvert_get_private(self);
+  KernelParams& params = priv->cpp->params;
+
+  params = KernelParams();
+  params.sink_desc = video_info_to_desc(priv->sink_info);
+  params.src_desc = video_info_to_desc(priv->src_info);
+  params.resize_dst_desc = params.src_desc;
+  params.resize_dst_desc.pixel_fmt = params.sink_desc.pixel_fmt;
+  params.tmp_desc = params.resize_dst_desc;
+  params.tmp_desc.stride[0] = params.tmp_desc.width * get_channel_num_plane0(priv->sink_info.finfo->format);
+}
 
-  CNCV_SAFECALL(cncvResizeConvert_V2(priv->handle, 1,
-                                     &src_desc, &src_roi, src_ptr,
-                                     &dst_desc, &dst_roi, dst_ptr,
-                                     workspace_size, workspace, CNCV_INTER_BILINEAR), FALSE);
+/**
+ * Each of rois is resized and converted to dst_rois of an output, all in one launch. Input is yuv420sp, or rgb series
+ * when resize and channel swizzle are fused.
+ */
+static gboolean
+resize_convert(GstCnconvert* self, GstMluFrame_t frame, const std::vector<cncvRect>& rois,
+               const std::vector<cncvRect>& dst_rois, void* const* dst)
+{
+  GstCnconvertPrivate* priv = gst_cnconvert_get_private(self);
+  KernelParams& params = priv->cpp->params;
+  guint n = rois.size();
+
+  std::vector<cncvImageDescriptor> src_descs(n, params.sink_desc), dst_descs(n, params.src_desc);
+  // workspace size depends on regions, which are the same for each frame without crop
+  if (!same_rects(rois, params.rois) || !same_rects(dst_rois, params.dst_rois)) {
+    CNCV_SAFECALL(cncvGetResizeConvertWorkspaceSize(n, src_descs.data(), rois.data(), dst_descs.data(),
+                                                    dst_rois.data(), &params.resize_convert_size),
+                  FALSE);
+    params.rois = rois;
+    params.dst_rois = dst_rois;
+  }
+  void* workspace = prepare_workspace(self, params.resize_convert_size);
+
+  // planes of sources (y and uv, or packed rgb), then destinations
+  guint n_planes = GST_VIDEO_INFO_N_PLANES(&priv->sink_info);
+  std::vector<void*> ptrs((n_planes + 1) * n);
+  void* planes[GST_VIDEO_MAX_PLANES];
+  for (guint p = 0; p < n_planes; ++p) {
+    planes[p] = cn_syncedmem_get_mutable_dev_data(frame->data[p]);
+  }
+  for (guint i = 0; i < n; ++i) {
+    for (guint p = 0; p < n_planes; ++p) {
+      ptrs[n_planes * i + p] = planes[p];
+    }
+    ptrs[n_planes * n + i] = dst[i];
+  }
+  void** table = pointer_table(self, ptrs);
+  void** src_ptr = table;
+  void** dst_ptr = table + n_planes * n;
 
-  CNRT_SAFECALL(cnrtSyncQueue(priv->queue), FALSE);
+  CNCV_SAFECALL(cncvResizeConvert_V2(priv->handle, n,
+                                     src_descs.data(), rois.data(), src_ptr,
+                                     dst_descs.data(), dst_rois.data(), dst_ptr,
+                                     params.resize_convert_size, workspace, CNCV_INTER_BILINEAR), FALSE);
 
   return TRUE;
 }
 
+/**
+ * Resizes each of rois to dst_rois of an output. Outputs are laid out as src caps, or packed if they are intermediate
+ * images waiting for color conversion.
+ */
 static gboolean
-resize_rgb(GstCnconvert* self, GstMluFrame_t frame, GstSyncedMemory_t* _dst)
+resize_rgb(GstCnconvert* self, GstMluFrame_t frame, const std::vector<cncvRect>& rois,
+           const std::vector<cncvRect>& dst_rois, void* const* dst, gboolean packed)
 {
   GstCnconvertPrivate* priv = gst_cnconvert_get_private(self);
+  KernelParams& params = priv->cpp->params;
+  guint n = rois.size();
+
+  if (params.resize_rgbx_n != n) {
+    CNCV_SAFECALL(cncvGetResizeRgbxWorkspaceSize(n, &params.resize_rgbx_size), FALSE);
+    params.resize_rgbx_n = n;
+  }
+  void* workspace = prepare_workspace(self, params.resize_rgbx_size);
+
+  std::vector<void*> ptrs(2 * n);
+  void* src = cn_syncedmem_get_mutable_dev_data(frame->data[0]);
+  for (guint i = 0; i < n; ++i) {
+    ptrs[i] = src;
+    ptrs[n + i] = dst[i];
+  }
+  void** table = pointer_table(self, ptrs);
+  void** src_ptr = table;
+  void** dst_ptr = table + n;
 
-  cncvImageDescriptor src_desc = video_info_to_desc(priv->sink_info);
-  cncvImageDescriptor dst_desc = video_info_to_desc(priv->src_info);
-  dst_desc.pixel_fmt = src_desc.pixel_fmt;
-  int ch = get_channel_num_plane0(priv->sink_info.finfo->format);
-  dst_desc.stride[0] = dst_desc.width * ch;
-
-  cncvRect src_roi, dst_roi;
-  src_roi.x = src_roi.y = dst_roi.x = dst_roi.y = 0;
-  src_roi.w = src_desc.width;
-  src_roi.h = src_desc.height;
-  dst_roi.w = dst_desc.width;
-  dst_roi.h = dst_desc.height;
-
-  size_t workspace_size;
-  size_t extra_size = 2 * sizeof(void*);
-  CNCV_SAFECALL(cncvGetResizeRgbxWorkspaceSize(1, &workspace_size), FALSE);
-
-  // prepare mlu memory
-  if (priv->cncv_workspace && cn_syncedmem_get_size(priv->cncv_workspace) < (workspace_size + extra_size)) {
-    cn_syncedmem_free(priv->cncv_workspace);
-    priv->cncv_workspace = nullptr;
-  }
-  if (!priv->cncv_workspace) {
-    priv->cncv_workspace = cn_syncedmem_new(workspace_size + extra_size);
-  }
-
-  if (!*_dst) {
-    size_t out_size = 0;
-    out_size = (priv->src_info.width * priv->src_info.height) * ch;
-    GST_DEBUG_OBJECT(self, "new syncedmem, w: %d, h:%d, out size: %lu", priv->src_info.width, priv->src_info.height,
-                     out_size);
-    *_dst = cn_syncedmem_new(out_size);
-  }
-  GstSyncedMemory_t dst = *_dst;
-
-  void** buf_host = reinterpret_cast<void**>(cn_syncedmem_get_mutable_host_data(priv->cncv_workspace));
-  buf_host[0] = cn_syncedmem_get_mutable_dev_data(frame->data[0]);
-  buf_host[1] = cn_syncedmem_get_mutable_dev_data(dst);
-  buf_host = nullptr;
-  void** buf_dev = reinterpret_cast<void**>(const_cast<void*>(cn_syncedmem_get_dev_data(priv->cncv_workspace)));
-  void** src_ptr = buf_dev;
-  void** dst_ptr = buf_dev + 1;
-  void* workspace = buf_dev + 2;
-
-  CNCV_SAFECALL(cncvResizeRgbx(priv->handle, 1,
-                               src_desc, &src_roi, src_ptr,
-                               dst_desc, &dst_roi, dst_ptr,
-                               workspace_size, workspace, CNCV_INTER_BILINEAR), FALSE);
-
-  CNRT_SAFECALL(cnrtSyncQueue(priv->queue), FALSE);
+  CNCV_SAFECALL(cncvResizeRgbx(priv->handle, n,
+                               params.sink_desc, const_cast<cncvRect*>(rois.data()), src_ptr,
+                               packed ? params.tmp_desc : params.resize_dst_desc,
+                               const_cast<cncvRect*>(dst_rois.data()), dst_ptr,
+                               params.resize_rgbx_size, workspace, CNCV_INTER_BILINEAR), FALSE);
 
   return TRUE;
 }
 
+/**
+ * Converts n packed images of output size to outputs.
+ */
 static gboolean
-cvt_rgb(GstCnconvert* self, GstSyncedMemory_t src, GstSyncedMemory_t* pdst)
+cvt_rgb(GstCnconvert* self, void* const* src, guint n, void* const* dst)
 {
   GstCnconvertPrivate* priv = gst_cnconvert_get_private(self);
+  KernelParams& params = priv->cpp->params;
 
-  cncvImageDescriptor src_desc = video_info_to_desc(priv->src_info);
-  cncvImageDescriptor dst_desc = video_info_to_desc(priv->src_info);
-  src_desc.pixel_fmt = format_cast(priv->sink_info.finfo->format);
-  src_desc.stride[0] = src_desc.width * get_channel_num_plane0(priv->sink_info.finfo->format);
+  cncvRect src_roi = output_roi(priv->src_info);
+  cncvRect dst_roi = output_roi(priv->src_info);
 
-  cncvRect src_roi, dst_roi;
-  src_roi.x = src_roi.y = dst_roi.x = dst_roi.y = 0;
-  src_roi.w = src_desc.width;
-  src_roi.h = src_desc.height;
-  dst_roi.w = dst_desc.width;
-  dst_roi.h = dst_desc.height;
+  std::vector<void*> ptrs(2 * n);
+  for (guint i = 0; i < n; ++i) {
+    ptrs[i] = src[i];
+    ptrs[n + i] = dst[i];
+  }
+  void** table = pointer_table(self, ptrs);
+  void** src_ptr = table;
+  void** dst_ptr = table + n;
+
+  CNCV_SAFECALL(cncvRgbxToRgbx(priv->handle, n,
+                               params.tmp_desc, src_roi, src_ptr,
+                               params.src_desc, dst_roi, dst_ptr), FALSE);
+
+  return TRUE;
+}
 
-  size_t extra_size = 2 * sizeof(void*);
+// intermediate packed images of two pass rgb conversion
+static void**
+prepare_tmp(GstCnconvert* self, guint n, std::vector<void*>* ptrs)
+{
+  GstCnconvertPrivate* priv = gst_cnconvert_get_private(self);
+  size_t image_size = priv->src_info.width * priv->src_info.height * get_channel_num_plane0(priv->sink_info.finfo->format);
 
-  // prepare mlu memory
-  if (priv->cncv_workspace && cn_syncedmem_get_size(priv->cncv_workspace) < extra_size) {
-    cn_syncedmem_free(priv->cncv_workspace);
-    priv->cncv_workspace = nullptr;
+  if (priv->tmp_mem && cn_syncedmem_get_size(priv->tmp_mem) < image_size * n) {
+    // kernels in flight may be still using it
+    gst_cnconvert_wait_in_flight(self, 0);
+    cn_syncedmem_free(priv->tmp_mem);
+    priv->tmp_mem = nullptr;
   }
-  if (!priv->cncv_workspace) {
-    priv->cncv_workspace = cn_syncedmem_new(extra_size);
+  if (!priv->tmp_mem) {
+    GST_DEBUG_OBJECT(self, "new intermediate syncedmem of %u images, size: %lu", n, image_size * n);
+    priv->tmp_mem = cn_syncedmem_new(image_size * n);
   }
-
-  if (!*pdst) {
-    size_t out_size = 0;
-    out_size = priv->src_info.stride[0] * priv->src_info.height;
-    GST_DEBUG_OBJECT(self, "new syncedmem, w: %d, h:%d, out size: %lu", priv->src_info.width, priv->src_info.height,
-                     out_size);
-    *pdst = cn_syncedmem_new(out_size);
+  auto base = static_cast<guint8*>(cn_syncedmem_get_mutable_dev_data(priv->tmp_mem));
+  ptrs->resize(n);
+  for (guint i = 0; i < n; ++i) {
+    (*ptrs)[i] = base + i * image_size;
   }
-  GstSyncedMemory_t dst = *pdst;
-
-  void** buf_host = reinterpret_cast<void**>(cn_syncedmem_get_mutable_host_data(priv->cncv_workspace));
-  buf_host[0] = cn_syncedmem_get_mutable_dev_data(src);
-  buf_host[1] = cn_syncedmem_get_mutable_dev_data(dst);
-  buf_host = nullptr;
-  void** buf_dev = reinterpret_cast<void**>(const_cast<void*>(cn_syncedmem_get_dev_data(priv->cncv_workspace)));
-  void** src_ptr = buf_dev;
-  void** dst_ptr = buf_dev + 1;
+  return ptrs->data();
+}
 
-  CNCV_SAFECALL(cncvRgbxToRgbx(priv->handle, 1,
-                               src_desc, src_roi, src_ptr,
-                               dst_desc, dst_roi, dst_ptr), FALSE);
+/**
+ * Resized region of output for roi. Whole output without keep-aspect-ratio, otherwise the largest region of the same
+ * aspect ratio as roi, placed as pad-position.
+ */
+static cncvRect
+letterbox_roi(GstCnconvert* self, const cncvRect& roi)
+{
+  GstCnconvertPrivate* priv = gst_cnconvert_get_private(self);
+  cncvRect dst = output_roi(priv->src_info);
+  if (!priv->keep_aspect_ratio) {
+    return dst;
+  }
 
-  CNRT_SAFECALL(cnrtSyncQueue(priv->queue), FALSE);
+  guint out_w = dst.w, out_h = dst.h;
+  // aspect ratio of roi as it appears in output
+  guint roi_w = roi.w, roi_h = roi.h;
+  if (CpuConverter::transposes(priv->video_direction)) {
+    std::swap(roi_w, roi_h);
+  }
+  if ((guint64)roi_w * out_h > (guint64)roi_h * out_w) {
+    dst.h = MAX(((guint64)roi_h * out_w + roi_w / 2) / roi_w, 1);
+  } else {
+    dst.w = MAX(((guint64)roi_w * out_h + roi_h / 2) / roi_h, 1);
+  }
+  if (priv->pad_position == GST_CNCONVERT_PAD_CENTER) {
+    dst.x = (out_w - dst.w) / 2;
+    dst.y = (out_h - dst.h) / 2;
+  }
+  return dst;
+}
 
-  return TRUE;
+// bytes of a pixel in color 0xRRGGBB, alpha is opaque
+static int
+pad_pixel(GstVideoFormat fmt, guint color, guint8* pixel)
+{
+  guint8 r = (color >> 16) & 0xFF, g = (color >> 8) & 0xFF, b = color & 0xFF, a = 0xFF;
+  switch (fmt) {
+    case GST_VIDEO_FORMAT_RGB:
+      pixel[0] = r, pixel[1] = g, pixel[2] = b;
+      return 3;
+    case GST_VIDEO_FORMAT_BGR:
+      pixel[0] = b, pixel[1] = g, pixel[2] = r;
+      return 3;
+    case GST_VIDEO_FORMAT_RGBA:
+      pixel[0] = r, pixel[1] = g, pixel[2] = b, pixel[3] = a;
+      return 4;
+    case GST_VIDEO_FORMAT_BGRA:
+      pixel[0] = b, pixel[1] = g, pixel[2] = r, pixel[3] = a;
+      return 4;
+    case GST_VIDEO_FORMAT_ARGB:
+      pixel[0] = a, pixel[1] = r, pixel[2] = g, pixel[3] = b;
+      return 4;
+    case GST_VIDEO_FORMAT_ABGR:
+      pixel[0] = a, pixel[1] = b, pixel[2] = g, pixel[3] = r;
+      return 4;
+    default:
+      return 0;
+  }
 }
 
 static void
-clear_alignment(GstMemory* out_mem, const GstMapInfo& info, GstMluFrame_t frame, GstVideoFormat fmt) {
-  GstMapInfo cp_info;
-  gst_memory_map(out_mem, &cp_info, GST_MAP_WRITE);
-  if (fmt == GST_VIDEO_FORMAT_NV12 || fmt == GST_VIDEO_FORMAT_NV21) {
-    guint8* dst_y = cp_info.data;
-    guint8* dst_uv = cp_info.data + frame->width * frame->height;
-    guint8* src_y = info.data;
-    guint8* src_uv = info.data + frame->stride[0] * frame->height;
-    for (uint32_t i = 0; i < frame->height; i++) {
-      memcpy(dst_y + i * frame->width, src_y + i * frame->stride[0], frame->width);
-      if (i % 2 == 0) {
-        memcpy(dst_uv + i * frame->width / 2, src_uv + i * frame->stride[1] / 2, frame->width);
-      }
+gst_cnconvert_free_pad(GstCnconvert* self)
+{
+  GstCnconvertPrivate* priv = gst_cnconvert_get_private(self);
+  for (auto mem : { &priv->pad_mem, &priv->pad_tmp_mem }) {
+    if (*mem && !cn_syncedmem_free(*mem)) {
+      GST_ERROR_OBJECT(self, "Free mlu memory failed");
     }
-  } else if (fmt == GST_VIDEO_FORMAT_I420) {
-    guint8* dst_y = cp_info.data;
-    guint8* dst_u = cp_info.data + frame->width * frame->height;
-    guint8* dst_v = cp_info.data + frame->width * frame->height + (frame->width * frame->height >> 2);
-    guint8* src_y = info.data;
-    guint8* src_u = info.data + frame->stride[0] * frame->height;
-    guint8* src_v = info.data + frame->stride[0] * frame->height + (frame->stride[1] * frame->height >> 1);
-    for (uint32_t i = 0; i < frame->height; i++) {
-      memcpy(dst_y + i * frame->width, src_y + i * frame->stride[0], frame->width);
-      if (i % 2 == 0) {
-        memcpy(dst_u + i * frame->width / 4, src_u + i * frame->stride[1] / 2, frame->width / 2);
-        memcpy(dst_v + i * frame->width / 4, src_v + i * frame->stride[2] / 2, frame->width / 2);
-      }
+    *mem = nullptr;
+  }
+}
+
+/**
+ * Fills n images with padding before resized image is written into them. Padding is copied on queue from an image of
+ * pad color, built once for each layout, so no extra kernel is launched.
+ */
+static gboolean
+fill_pad(GstCnconvert* self, GstSyncedMemory_t* pad_mem, GstVideoFormat fmt, guint stride, guint height,
+         void* const* dst, guint n)
+{
+  GstCnconvertPrivate* priv = gst_cnconvert_get_private(self);
+  size_t size = (size_t)stride * height;
+
+  if (priv->pad_mem_color != priv->pad_color) {
+    // kernels in flight may be still reading them
+    gst_cnconvert_wait_in_flight(self, 0);
+    gst_cnconvert_free_pad(self);
+    priv->pad_mem_color = priv->pad_color;
+  }
+  if (!*pad_mem) {
+    guint8 pixel[4];
+    int ch = pad_pixel(fmt, priv->pad_mem_color, pixel);
+    if (!ch) {
+      GST_CNCONVERT_ERROR(self, LIBRARY, FAILED, ("unsupported pixel format of padding"));
+      return FALSE;
     }
-  } else {
-    int ch = 4;
-    if (fmt == GST_VIDEO_FORMAT_RGB || fmt == GST_VIDEO_FORMAT_BGR) ch = 3;
-    for (uint32_t i = 0; i < frame->height; i++) {
-      memcpy(cp_info.data + i * frame->width * ch, info.data + i * frame->stride[0], frame->width * ch);
+    GST_DEBUG_OBJECT(self, "new padding syncedmem of color 0x%06x, size: %lu", priv->pad_mem_color, size);
+    *pad_mem = cn_syncedmem_new(size);
+    auto host = static_cast<guint8*>(cn_syncedmem_get_mutable_host_data(*pad_mem));
+    for (size_t i = 0; i < size; ++i) {
+      host[i] = pixel[(i % stride) % ch];
     }
+    priv->cpp->frame_h2d += size;
+  }
+
+  void* src = const_cast<void*>(cn_syncedmem_get_dev_data(*pad_mem));
+  for (guint i = 0; i < n; ++i) {
+    CNRT_SAFECALL(cnrtMemcpyAsync(dst[i], src, size, priv->queue, CNRT_MEM_TRANS_DIR_DEV2DEV), FALSE);
   }
-  gst_memory_unmap(out_mem, &cp_info);
+  return TRUE;
 }
 
+/**
+ * Downloads frame to a new buffer of host memory, strided as on device if downstream accepts video meta.
+ */
 static GstBuffer*
-transform_to_cpu(GstCnconvert* self, GstBuffer* buffer, GstMluFrame_t frame, GstVideoFormat fmt)
+transform_to_cpu(GstCnconvert* self, GstBuffer* buffer, GstMluFrame_t frame)
 {
-  GstMemory* mem = nullptr;
-  thread_local GstMapInfo info;
-  using mem_op = edk::MluMemoryOp;
+  GstCnconvertPrivate* priv = gst_cnconvert_get_private(self);
+  void* planes[MAXIMUM_PLANE];
 
   GST_DEBUG_OBJECT(self, "transform from device(MLU) memory to host memory");
 
-  // prepare memory
-  float scale = 1;
-  if (fmt == GST_VIDEO_FORMAT_NV12 || fmt == GST_VIDEO_FORMAT_NV21 || fmt == GST_VIDEO_FORMAT_I420) {
-    scale = 1.5;
-  } else if (fmt == GST_VIDEO_FORMAT_RGB || fmt == GST_VIDEO_FORMAT_BGR) {
-    scale = 1;
-  }
-  int ch = get_channel_num_plane0(fmt);
-  mem = gst_allocator_alloc(NULL, frame->stride[0] * frame->height * scale * ch, NULL);
-  gst_memory_map(mem, &info, (GstMapFlags)GST_MAP_READWRITE);
-
-  // copy data from device to host
-  if (fmt == GST_VIDEO_FORMAT_NV12 || fmt == GST_VIDEO_FORMAT_NV21) {
-    mem_op::MemcpyD2H(info.data, cn_syncedmem_get_mutable_dev_data(frame->data[0]), frame->stride[0] * frame->height);
-    mem_op::MemcpyD2H(info.data + frame->stride[0] * frame->height, cn_syncedmem_get_mutable_dev_data(frame->data[1]),
-                     (frame->stride[1] * frame->height) >> 1);
-  } else if (fmt == GST_VIDEO_FORMAT_I420) {
-    mem_op::MemcpyD2H(info.data, cn_syncedmem_get_mutable_dev_data(frame->data[0]), frame->stride[0] * frame->height);
-    mem_op::MemcpyD2H(info.data + frame->stride[0] * frame->height, cn_syncedmem_get_mutable_dev_data(frame->data[1]),
-                     (frame->stride[1] * frame->height) >> 1);
-    mem_op::MemcpyD2H(info.data + frame->stride[0] * frame->height + (frame->stride[1] * frame->height >> 1), cn_syncedmem_get_mutable_dev_data(frame->data[2]),
-                     (frame->stride[2] * frame->height) >> 1);
-  } else {
-    mem_op::MemcpyD2H(info.data, cn_syncedmem_get_mutable_dev_data(frame->data[0]), frame->stride[0] * frame->height);
+  for (guint i = 0; i < GST_VIDEO_INFO_N_PLANES(&priv->src_info); ++i) {
+    planes[i] = cn_syncedmem_get_mutable_dev_data(frame->data[i]);
   }
-
-  GST_DEBUG_OBJECT(self, "stride = %d, width = %d\n", frame->stride[0], frame->width);
-
-  // clear alignment
-  if (frame->stride[0] != frame->width * ch) {
-    GST_INFO_OBJECT(self, "clear frame alignment");
-    GstMemory* cp_mem = gst_allocator_alloc(NULL, frame->width * frame->height * scale * ch, NULL);
-    clear_alignment(cp_mem, info, frame, fmt);
-    gst_memory_unmap(mem, &info);
-    gst_memory_unref(mem);
-    mem = cp_mem;
-  } else {
-    gst_memory_unmap(mem, &info);
+  GstBuffer* outbuf = gst_mlu_download_frame(&priv->src_info, planes, frame->stride, priv->downstream_video_meta);
+  if (outbuf) {
+    gst_buffer_copy_into(outbuf, buffer, (GstBufferCopyFlags)(GST_BUFFER_COPY_FLAGS | GST_BUFFER_COPY_TIMESTAMPS), 0,
+                         -1);
   }
-
-  auto pts = GST_BUFFER_PTS(buffer);
-  auto duration = GST_BUFFER_DURATION(buffer);
   gst_buffer_unref(buffer);
+  return outbuf;
+}
 
-  buffer = gst_buffer_new();
-  gst_buffer_append_memory(buffer, mem);
-  GST_BUFFER_PTS(buffer) = pts;
-  GST_BUFFER_DURATION(buffer) = duration;
-
-  return buffer;
+static void
+gst_cnconvert_free_staging(GstCnconvert* self)
+{
+  GstCnconvertPrivateCpp* cpp = gst_cnconvert_get_private(self)->cpp;
+  for (auto& slot : cpp->staging) {
+    if (slot.uploaded && !slot.uploaded->wait()) {
+      GST_ERROR_OBJECT(self, "wait for upload failed");
+    }
+    slot.uploaded.reset();
+    if (slot.host && cnrtFreeHost(slot.host) != CNRT_RET_SUCCESS) {
+      GST_ERROR_OBJECT(self, "Free page-locked memory failed");
+    }
+    slot.host = nullptr;
+    slot.size = 0;
+  }
+  cpp->staging_index = 0;
 }
 
-static gboolean
-transform_to_mlu(GstCnconvert* self, GstBuffer* buffer, GstMluFrame_t frame, GstVideoFormat fmt) {
-  if (fmt == GST_VIDEO_FORMAT_I420) {
-    GST_ERROR_OBJECT(self, "unsupported pixel format!");
-    return FALSE;
+// takes the next slot of the ring once uploads from it are done
+static StagingSlot*
+staging_slot(GstCnconvert* self, size_t size)
+{
+  GstCnconvertPrivateCpp* cpp = gst_cnconvert_get_private(self)->cpp;
+  StagingSlot* slot = &cpp->staging[cpp->staging_index];
+  cpp->staging_index = (cpp->staging_index + 1) % STAGING_SLOTS;
+
+  if (slot->uploaded && !slot->uploaded->wait()) {
+    GST_CNCONVERT_ERROR(self, LIBRARY, FAILED, ("wait for upload failed"));
+    return nullptr;
   }
+  slot->uploaded.reset();
+  if (slot->size < size) {
+    if (slot->host) {
+      CNRT_SAFECALL(cnrtFreeHost(slot->host), nullptr);
+      slot->host = nullptr;
+      slot->size = 0;
+    }
+    CNRT_SAFECALL(cnrtMallocHost(&slot->host, size, CNRT_MEMTYPE_LOCKED), nullptr);
+    slot->size = size;
+  }
+  return slot;
+}
 
+// uploads are issued on the queue of kernels and ordered before them, others wait for syncer of frame
+static gboolean
+transform_to_mlu(GstCnconvert* self, GstBuffer* buffer, GstMluFrame_t frame, GstVideoFormat fmt)
+{
   GstCnconvertPrivate* priv = gst_cnconvert_get_private(self);
-  using mem_op = edk::MluMemoryOp;
   GstVideoFrame host_frame;
 
-  g_return_val_if_fail(gst_video_frame_map(&host_frame, &priv->sink_info, buffer, GST_MAP_READ), FALSE);
+  if (!gst_video_frame_map(&host_frame, &priv->sink_info, buffer, GST_MAP_READ)) {
+    GST_CNCONVERT_ERROR(self, RESOURCE, READ, ("map input buffer failed"));
+    return FALSE;
+  }
   auto unmap_func = [&host_frame]() { gst_video_frame_unmap(&host_frame); };
   ScopeGuard<decltype(unmap_func)> map_guard(std::move(unmap_func));
   GST_DEBUG_OBJECT(self, "transform from host memory to device(MLU) memory");
-  frame->width = host_frame.info.width;
-  frame->height = host_frame.info.height;
-  frame->n_planes = 1;
+  frame->width = GST_VIDEO_FRAME_WIDTH(&host_frame);
+  frame->height = GST_VIDEO_FRAME_HEIGHT(&host_frame);
+  frame->n_planes = GST_VIDEO_FRAME_N_PLANES(&host_frame);
   frame->device_id = priv->device_id;
-  frame->stride[0] = host_frame.info.stride[0];
-
-  if (fmt == GST_VIDEO_FORMAT_NV12 || fmt == GST_VIDEO_FORMAT_NV21) {
-    frame->n_planes = 2;
-    frame->stride[1] = host_frame.info.stride[1];
-    size_t y_len = frame->height * frame->stride[0];
-    size_t uv_len = frame->height * frame->stride[1] >> 1;
-    frame->data[0] = cn_syncedmem_new(y_len);
-    frame->data[1] = cn_syncedmem_new(uv_len);
-    mem_op::MemcpyH2D(cn_syncedmem_get_mutable_dev_data(frame->data[0]), host_frame.data[0], y_len);
-    mem_op::MemcpyH2D(cn_syncedmem_get_mutable_dev_data(frame->data[1]), host_frame.data[1], uv_len);
+
+  size_t plane_len[MAXIMUM_PLANE];
+  size_t total = 0;
+  for (guint i = 0; i < frame->n_planes; ++i) {
+    // planes of these formats hold one component each, or interleaved chroma of the same height
+    frame->stride[i] = GST_VIDEO_FRAME_PLANE_STRIDE(&host_frame, i);
+    plane_len[i] = frame->stride[i] * GST_VIDEO_FRAME_COMP_HEIGHT(&host_frame, i);
+    total += plane_len[i];
+  }
+
+  StagingSlot* slot = staging_slot(self, total);
+  if (!slot) {
+    return FALSE;
+  }
+  guint8* staged = static_cast<guint8*>(slot->host);
+  for (guint i = 0; i < frame->n_planes; ++i) {
+    memcpy(staged, GST_VIDEO_FRAME_PLANE_DATA(&host_frame, i), plane_len[i]);
+    frame->data[i] = cn_syncedmem_new(plane_len[i]);
+    CNRT_SAFECALL(cnrtMemcpyAsync(cn_syncedmem_get_mutable_dev_data(frame->data[i]), staged, plane_len[i], priv->queue,
+                                  CNRT_MEM_TRANS_DIR_HOST2DEV),
+                  FALSE);
+    staged += plane_len[i];
+  }
+  slot->uploaded = std::make_shared<QueueNotifier>();
+  if (!slot->uploaded->place(priv->queue)) {
+    GST_CNCONVERT_ERROR(self, LIBRARY, FAILED, ("place notifier failed"));
+    slot->uploaded.reset();
+    return FALSE;
+  }
+  gst_mlu_frame_set_syncer(frame, new NotifierFrameSyncer(slot->uploaded));
+  priv->cpp->frame_h2d += total;
+  return TRUE;
+}
+
+static inline gboolean
+clip_roi(cncvRect* roi, guint width, guint height, gboolean yuv)
+{
+  guint x = MIN(roi->x, width), y = MIN(roi->y, height);
+  guint w = MIN(roi->w, width - x), h = MIN(roi->h, height - y);
+  if (yuv) {
+    // chroma is subsampled by 2
+    x &= ~1u;
+    y &= ~1u;
+    w &= ~1u;
+    h &= ~1u;
+  }
+  roi->x = x;
+  roi->y = y;
+  roi->w = w;
+  roi->h = h;
+  return w > 0 && h > 0;
+}
+
+/**
+ * Collects regions of input to process. With roi-type, each matching region of interest meta is a region, otherwise
+ * the crop property, upstream crop meta or the full frame, in that order.
+ */
+static void
+collect_rois(GstCnconvert* self, GstBuffer* buffer, std::vector<cncvRect>* rois,
+             std::vector<GstVideoRegionOfInterestMeta*>* roi_metas)
+{
+  GstCnconvertPrivate* priv = gst_cnconvert_get_private(self);
+  guint width = priv->sink_info.width, height = priv->sink_info.height;
+  gboolean yuv = !isRGB(priv->sink_info.finfo->format);
+  cncvRect roi = output_roi(priv->sink_info);
+
+  // resize of yuv without color convert is not supported by kernels, crop and roi-type are refused in setcaps, crop
+  // meta of upstream stays on the buffer passed on
+  if (yuv && priv->disable_convert) {
+    rois->push_back(roi);
+    return;
+  }
+
+  if (priv->roi_type) {
+    gpointer state = nullptr;
+    GstMeta* meta;
+    while ((meta = gst_buffer_iterate_meta_filtered(buffer, &state, GST_VIDEO_REGION_OF_INTEREST_META_API_TYPE))) {
+      auto roi_meta = reinterpret_cast<GstVideoRegionOfInterestMeta*>(meta);
+      if (roi_meta->roi_type != priv->roi_type) {
+        continue;
+      }
+      roi.x = roi_meta->x;
+      roi.y = roi_meta->y;
+      roi.w = roi_meta->w;
+      roi.h = roi_meta->h;
+      if (clip_roi(&roi, width, height, yuv)) {
+        rois->push_back(roi);
+        roi_metas->push_back(roi_meta);
+      }
+    }
+    return;
+  }
+
+  if (priv->has_crop) {
+    roi = priv->crop;
+  } else if (GstVideoCropMeta* crop_meta = gst_buffer_get_video_crop_meta(buffer)) {
+    roi.x = crop_meta->x;
+    roi.y = crop_meta->y;
+    roi.w = crop_meta->width;
+    roi.h = crop_meta->height;
+  }
+  if (!clip_roi(&roi, width, height, yuv)) {
+    GST_WARNING_OBJECT(self, "crop region is out of frame, use full frame");
+    roi = output_roi(priv->sink_info);
+  }
+  rois->push_back(roi);
+}
+
+static GstFlowReturn
+push_output(GstCnconvert* self, GstBuffer* buffer, GstMluFrame_t frame, gboolean processed)
+{
+  GstCnconvertPrivate* priv = gst_cnconvert_get_private(self);
+
+  if (priv->output_on_mlu) {
+    if (!processed && !gst_buffer_set_mlu_frame_memory(buffer, frame, &priv->src_info)) {
+      gst_buffer_unref(buffer);
+      GST_CNCONVERT_ERROR(self, RESOURCE, FAILED, ("set mlu memory to buffer failed"));
+      return GST_FLOW_ERROR;
+    }
+  } else if (processed && gst_mlu_frame_match_video_info(frame, &priv->src_info)) {
+    // pooled frame could be mapped as host memory directly, data is copied to host when downstream maps it.
+    // other frames may be borrowed from decoder and must be given back soon, copy them out eagerly
+    GST_DEBUG_OBJECT(self, "output device(MLU) memory mapped to host lazily");
   } else {
-    size_t len = frame->height * frame->stride[0];
-    frame->data[0] = cn_syncedmem_new(len);
-    mem_op::MemcpyH2D(cn_syncedmem_get_mutable_dev_data(frame->data[0]), host_frame.data[0], len);
+    // copyout
+    if (!gst_mlu_frame_sync(frame)) {
+      gst_buffer_unref(buffer);
+      GST_CNCONVERT_ERROR(self, LIBRARY, FAILED, ("wait for device work failed"));
+      return GST_FLOW_ERROR;
+    }
+    buffer = transform_to_cpu(self, buffer, frame);
+    if (!buffer) {
+      GST_CNCONVERT_ERROR(self, RESOURCE, OPEN_READ_WRITE, ("copy frame from device(MLU) to host failed"));
+      return GST_FLOW_ERROR;
+    }
+  }
+
+  return gst_pad_push(self->srcpad, buffer);
+}
+
+/**
+ * Region roi of a width x height input, as it appears in the input rotated or flipped by method.
+ */
+static cncvRect
+oriented_roi(GstVideoOrientationMethod method, const cncvRect& roi, guint width, guint height)
+{
+  cncvRect r = roi;
+  if (CpuConverter::transposes(method)) {
+    std::swap(r.w, r.h);
+  }
+  switch (method) {
+    case GST_VIDEO_ORIENTATION_90R:
+      r.x = height - roi.y - roi.h, r.y = roi.x;
+      break;
+    case GST_VIDEO_ORIENTATION_90L:
+      r.x = roi.y, r.y = width - roi.x - roi.w;
+      break;
+    case GST_VIDEO_ORIENTATION_180:
+      r.x = width - roi.x - roi.w, r.y = height - roi.y - roi.h;
+      break;
+    case GST_VIDEO_ORIENTATION_HORIZ:
+      r.x = width - roi.x - roi.w;
+      break;
+    case GST_VIDEO_ORIENTATION_VERT:
+      r.y = height - roi.y - roi.h;
+      break;
+    case GST_VIDEO_ORIENTATION_UL_LR:
+      r.x = roi.y, r.y = roi.x;
+      break;
+    case GST_VIDEO_ORIENTATION_UR_LL:
+      r.x = height - roi.y - roi.h, r.y = width - roi.x - roi.w;
+      break;
+    default:
+      break;
   }
+  return r;
+}
+
+static void
+decorate_output(GstCnconvert* self, GstBuffer* outbuf, GstBuffer* input, const cncvRect& roi, const cncvRect& dst_roi,
+                GstVideoRegionOfInterestMeta* src_meta)
+{
+  GstCnconvertPrivate* priv = gst_cnconvert_get_private(self);
+  gst_buffer_copy_into(outbuf, input, (GstBufferCopyFlags)(GST_BUFFER_COPY_FLAGS | GST_BUFFER_COPY_TIMESTAMPS), 0, -1);
+  if (src_meta) {
+    // tells downstream which object the output belongs to
+    GstVideoRegionOfInterestMeta* roi_meta = gst_buffer_add_video_region_of_interest_meta_id(
+      outbuf, src_meta->roi_type, src_meta->x, src_meta->y, src_meta->w, src_meta->h);
+    roi_meta->id = src_meta->id;
+    roi_meta->parent_id = src_meta->parent_id;
+  }
+  if (priv->keep_aspect_ratio) {
+    // maps boxes on output back to input, rotated or flipped as output is
+    cncvRect src_roi = oriented_roi(priv->video_direction, roi, priv->sink_info.width, priv->sink_info.height);
+    gst_buffer_add_letterbox_meta(outbuf, src_roi.x, src_roi.y, src_roi.w, src_roi.h, dst_roi.x, dst_roi.y, dst_roi.w,
+                                  dst_roi.h);
+  }
+}
+
+static GstFlowReturn
+cpu_chain(GstCnconvert* self, GstBuffer* buffer, const std::vector<cncvRect>& rois,
+          const std::vector<GstVideoRegionOfInterestMeta*>& roi_metas)
+{
+  GstCnconvertPrivate* priv = gst_cnconvert_get_private(self);
+  GstCnconvertPrivateCpp* cpp = priv->cpp;
+
+  if (!cpp->cpu) {
+    guint n_threads = CLAMP(std::thread::hardware_concurrency(), 1, MAX_CPU_THREADS);
+    GST_INFO_OBJECT(self, "convert on cpu with %u threads", n_threads);
+    cpp->cpu.reset(new CpuConverter(n_threads));
+  }
+
+  // input in MLU memory is downloaded as it is mapped
+  GstVideoFrame src;
+  if (!gst_video_frame_map(&src, &priv->sink_info, buffer, GST_MAP_READ)) {
+    GST_CNCONVERT_ERROR(self, RESOURCE, READ, ("map input buffer failed"));
+    gst_buffer_unref(buffer);
+    return GST_FLOW_ERROR;
+  }
+
+  guint8 pad[4];
+  pad_pixel(priv->src_info.finfo->format, priv->pad_color, pad);
+  cncvRect out_full = output_roi(priv->src_info);
+  GstFlowReturn ret = GST_FLOW_OK;
+  guint64 h2d = 0;
+  for (guint i = 0; i < rois.size() && ret == GST_FLOW_OK; ++i) {
+    cncvRect dst_roi = letterbox_roi(self, rois[i]);
+    gboolean letterboxed = dst_roi.w != out_full.w || dst_roi.h != out_full.h;
+    GstBuffer* outbuf = nullptr;
+    ret = gst_buffer_pool_acquire_buffer(priv->pool, &outbuf, NULL);
+    if (ret != GST_FLOW_OK) {
+      GST_DEBUG_OBJECT(self, "acquire output buffer failed, %s", gst_flow_get_name(ret));
+      break;
+    }
+    GstVideoFrame dst;
+    if (!gst_video_frame_map(&dst, &priv->src_info, outbuf, GST_MAP_WRITE)) {
+      GST_CNCONVERT_ERROR(self, RESOURCE, WRITE, ("map output buffer failed"));
+      gst_buffer_unref(outbuf);
+      ret = GST_FLOW_ERROR;
+      break;
+    }
+    GstVideoRectangle src_rect = { static_cast<gint>(rois[i].x), static_cast<gint>(rois[i].y),
+                                   static_cast<gint>(rois[i].w), static_cast<gint>(rois[i].h) };
+    GstVideoRectangle dst_rect = { static_cast<gint>(dst_roi.x), static_cast<gint>(dst_roi.y),
+                                   static_cast<gint>(dst_roi.w), static_cast<gint>(dst_roi.h) };
+    bool ok = cpp->cpu->convert(&src, src_rect, &dst, dst_rect, letterboxed ? pad : nullptr, priv->video_direction);
+    gst_video_frame_unmap(&dst);
+    if (!ok) {
+      GST_CNCONVERT_ERROR(self, LIBRARY, FAILED, ("convert on cpu failed"));
+      gst_buffer_unref(outbuf);
+      ret = GST_FLOW_ERROR;
+      break;
+    }
+    if (priv->output_on_mlu) {
+      // written on host through mapping, uploaded when downstream takes device data
+      GstMluFrame_t out_frame = gst_buffer_get_mlu_memory_meta(outbuf)->frame;
+      out_frame->device_id = priv->device_id;
+      h2d += GST_VIDEO_INFO_SIZE(&priv->src_info);
+    }
+    decorate_output(self, outbuf, buffer, rois[i], dst_roi, roi_metas.empty() ? nullptr : roi_metas[i]);
+    ret = gst_pad_push(self->srcpad, outbuf);
+  }
+  gst_video_frame_unmap(&src);
+  gst_buffer_unref(buffer);
+  cpp->h2d_bytes.store(h2d);
+  return ret;
+}
+
+static inline guint
+dtype_size(GstCnconvertDtype dtype)
+{
+  switch (dtype) {
+    case GST_CNCONVERT_DTYPE_FLOAT16:
+      return 2;
+    case GST_CNCONVERT_DTYPE_FLOAT32:
+      return 4;
+    default:
+      return 1;
+  }
+}
+
+// resize convert op writes 4 channels, alpha is dropped from its outputs for formats of 3 channels
+static inline GstVideoFormat
+tensor_op_format(GstVideoFormat fmt)
+{
+  switch (fmt) {
+    case GST_VIDEO_FORMAT_RGB:
+      return GST_VIDEO_FORMAT_RGBA;
+    case GST_VIDEO_FORMAT_BGR:
+      return GST_VIDEO_FORMAT_BGRA;
+    default:
+      return fmt;
+  }
+}
+
+// tensors resize convert op can not write, its kernel is prebuilt, are finished on host from its uint8 outputs
+static inline gboolean
+tensor_on_host(GstCnconvertPrivate* priv)
+{
+  GstVideoFormat fmt = priv->src_info.finfo->format;
+  return priv->tensor_layout == GST_CNCONVERT_LAYOUT_NCHW || priv->tensor_dtype == GST_CNCONVERT_DTYPE_FLOAT32 ||
+         priv->mean_str || priv->std_str || tensor_op_format(fmt) != fmt;
+}
+
+static edk::MluResizeConvertOp*
+prepare_tensor_op(GstCnconvert* self, guint batch_size)
+{
+  GstCnconvertPrivate* priv = gst_cnconvert_get_private(self);
+  GstCnconvertPrivateCpp* cpp = priv->cpp;
+  using Op = edk::MluResizeConvertOp;
+  int pad_method = priv->pad_position == GST_CNCONVERT_PAD_TOP_LEFT ? 1 : 0;
+  if (!cpp->tensor_ops.empty()) {
+    const Op::Attr& attr = cpp->tensor_ops.begin()->second->GetAttr();
+    if (attr.keep_aspect_ratio != static_cast<bool>(priv->keep_aspect_ratio) || attr.padMethod != pad_method) {
+      cpp->tensor_ops.clear();
+    }
+  }
+  auto it = cpp->tensor_ops.find(batch_size);
+  if (it != cpp->tensor_ops.end()) {
+    return it->second.get();
+  }
+
+  gboolean nv12 = priv->sink_info.finfo->format == GST_VIDEO_FORMAT_NV12;
+  Op::Attr attr;
+  switch (tensor_op_format(priv->src_info.finfo->format)) {
+    case GST_VIDEO_FORMAT_RGBA:
+      attr.color_mode = nv12 ? Op::ColorMode::YUV2RGBA_NV12 : Op::ColorMode::YUV2RGBA_NV21;
+      break;
+    case GST_VIDEO_FORMAT_BGRA:
+      attr.color_mode = nv12 ? Op::ColorMode::YUV2BGRA_NV12 : Op::ColorMode::YUV2BGRA_NV21;
+      break;
+    case GST_VIDEO_FORMAT_ARGB:
+      attr.color_mode = nv12 ? Op::ColorMode::YUV2ARGB_NV12 : Op::ColorMode::YUV2ARGB_NV21;
+      break;
+    default:
+      attr.color_mode = nv12 ? Op::ColorMode::YUV2ABGR_NV12 : Op::ColorMode::YUV2ABGR_NV21;
+      break;
+  }
+  attr.data_mode = priv->tensor_dtype == GST_CNCONVERT_DTYPE_FLOAT16 && !tensor_on_host(priv)
+                     ? Op::DataMode::UINT8ToFP16
+                     : Op::DataMode::UINT8ToUINT8;
+  attr.dst_w = priv->src_info.width;
+  attr.dst_h = priv->src_info.height;
+  attr.batch_size = batch_size;
+  attr.core_version = edk::MluContext(priv->device_id).GetCoreVersion();
+  attr.keep_aspect_ratio = priv->keep_aspect_ratio;
+  attr.padMethod = pad_method;
+
+  if (!cpp->tensor_queue) {
+    cpp->tensor_queue = edk::MluTaskQueue::Create();
+  }
+  std::unique_ptr<Op> op(new Op);
+  op->SetMluQueue(cpp->tensor_queue);
+  if (!op->Init(attr)) {
+    GST_CNCONVERT_ERROR(self, LIBRARY, INIT, ("init resize convert op failed, %s", op->GetLastError().c_str()));
+    return nullptr;
+  }
+  Op* ret = op.get();
+  cpp->tensor_ops[batch_size] = std::move(op);
+  return ret;
+}
+
+// normalizes, reorders and casts an output of resize convert op into a tensor, which is uploaded at once
+static GstMluFrame_t
+finish_tensor(GstCnconvert* self, const guint8* pixels)
+{
+  GstCnconvertPrivate* priv = gst_cnconvert_get_private(self);
+  const GstVideoFormatInfo* finfo = priv->src_info.finfo;
+  GstVideoFormat op_format = tensor_op_format(GST_VIDEO_FORMAT_INFO_FORMAT(finfo));
+  const GstVideoFormatInfo* op_finfo = gst_video_format_get_info(op_format);
+  gsize n_pixels = (gsize)priv->src_info.width * priv->src_info.height;
+  guint n_channels = GST_VIDEO_FORMAT_INFO_N_COMPONENTS(finfo);
+  gsize n_elems = n_pixels * n_channels;
+  gboolean nchw = priv->tensor_layout == GST_CNCONVERT_LAYOUT_NCHW;
+
+  std::vector<gfloat> values(n_elems);
+  for (guint comp = 0; comp < n_channels; ++comp) {
+    // components are r, g, b and alpha, alpha is not normalized
+    gfloat mean = comp < 3 ? priv->mean[comp] : 0, scale = comp < 3 ? 1 / priv->std[comp] : 1;
+    guint channel = GST_VIDEO_FORMAT_INFO_POFFSET(finfo, comp);
+    const guint8* src = pixels + GST_VIDEO_FORMAT_INFO_POFFSET(op_finfo, comp);
+    for (gsize i = 0; i < n_pixels; ++i) {
+      values[nchw ? channel * n_pixels + i : i * n_channels + channel] = (src[i * 4] - mean) * scale;
+    }
+  }
+
+  gsize size = n_elems * dtype_size(priv->tensor_dtype);
+  GstSyncedMemory_t mem = cn_syncedmem_new(size);
+  void* host = cn_syncedmem_get_mutable_host_data(mem);
+  if (priv->tensor_dtype == GST_CNCONVERT_DTYPE_FLOAT32) {
+    memcpy(host, values.data(), size);
+  } else if (priv->tensor_dtype == GST_CNCONVERT_DTYPE_FLOAT16) {
+    if (cnrtCastDataType(values.data(), CNRT_FLOAT32, host, CNRT_FLOAT16, n_elems, nullptr) != CNRT_RET_SUCCESS) {
+      GST_CNCONVERT_ERROR(self, LIBRARY, FAILED, ("cast tensor to float16 failed"));
+      cn_syncedmem_free(mem);
+      return nullptr;
+    }
+  } else {
+    // not normalized, values are integers
+    auto dst = static_cast<guint8*>(host);
+    for (gsize i = 0; i < n_elems; ++i) {
+      dst[i] = static_cast<guint8>(values[i]);
+    }
+  }
+  cn_syncedmem_get_dev_data(mem);
+  priv->cpp->frame_h2d += size;
+
+  GstMluFrame_t tensor = gst_mlu_frame_new();
+  tensor->device_id = priv->device_id;
+  tensor->width = priv->src_info.width;
+  tensor->height = priv->src_info.height;
+  tensor->n_planes = 1;
+  tensor->stride[0] = priv->src_info.width * (nchw ? 1 : n_channels) * dtype_size(priv->tensor_dtype);
+  tensor->data[0] = mem;
+  return tensor;
+}
+
+// yuv is resized, converted and cast into tensors by one kernel for each batch of regions, then synced once
+static gboolean
+convert_to_tensors(GstCnconvert* self, GstMluFrame_t frame, const std::vector<cncvRect>& rois,
+                   std::vector<GstMluFrame_t>* tensors)
+{
+  GstCnconvertPrivate* priv = gst_cnconvert_get_private(self);
+  GstCnconvertPrivateCpp* cpp = priv->cpp;
+  gboolean on_host = tensor_on_host(priv);
+  // outputs of op, which are the tensors unless they are finished on host
+  guint elem_size = on_host ? 1 : dtype_size(priv->tensor_dtype);
+  guint stride = priv->src_info.width * 4 * elem_size;
+  gsize tensor_size = (gsize)stride * priv->src_info.height;
+
+  edk::MluResizeConvertOp::InputData input;
+  input.src_w = frame->width;
+  input.src_h = frame->height;
+  input.src_stride = frame->stride[0];
+  input.planes[0] = cn_syncedmem_get_mutable_dev_data(frame->data[0]);
+  input.planes[1] = cn_syncedmem_get_mutable_dev_data(frame->data[1]);
+
+  for (guint begin = 0; begin < rois.size(); begin += MAX_TENSOR_BATCH) {
+    guint n = MIN(rois.size() - begin, MAX_TENSOR_BATCH);
+    guint batch_size = 1;
+    while (batch_size < n) {
+      batch_size <<= 1;
+    }
+    edk::MluResizeConvertOp* op = prepare_tensor_op(self, batch_size);
+    if (!op) {
+      return FALSE;
+    }
+    // kernel parameters on device are rewritten by the next batch
+    if (begin > 0) {
+      cpp->tensor_queue->Sync();
+    }
+
+    // rest of batch repeats the first region, into the tail of batch memory not taken by tensors
+    std::shared_ptr<GstSyncedMemory> batch(cn_syncedmem_new(tensor_size * batch_size), cn_syncedmem_free);
+    auto dst = static_cast<guint8*>(cn_syncedmem_get_mutable_dev_data(batch.get()));
+    for (guint i = 0; i < n; ++i) {
+      const cncvRect& roi = rois[begin + i];
+      input.crop_x = roi.x;
+      input.crop_y = roi.y;
+      input.crop_w = roi.w;
+      input.crop_h = roi.h;
+      op->BatchingUp(input);
+      if (on_host) {
+        continue;
+      }
+
+      GstMluFrame_t tensor = gst_mlu_frame_new();
+      tensor->device_id = priv->device_id;
+      tensor->channel_id = frame->channel_id;
+      tensor->width = priv->src_info.width;
+      tensor->height = priv->src_info.height;
+      tensor->n_planes = 1;
+      tensor->stride[0] = stride;
+      tensor->data[0] = cn_syncedmem_new(tensor_size);
+      cn_syncedmem_set_dev_data(tensor->data[0], dst + i * tensor_size);
+      tensor->deallocator = new TensorBatchDeallocator(batch);
+      tensors->push_back(tensor);
+    }
+    if (!op->SyncOneOutput(dst)) {
+      GST_CNCONVERT_ERROR(self, LIBRARY, FAILED, ("resize convert to tensor failed, %s", op->GetLastError().c_str()));
+      return FALSE;
+    }
+    if (on_host) {
+      cpp->tensor_queue->Sync();
+      auto pixels = static_cast<const guint8*>(cn_syncedmem_get_host_data(batch.get()));
+      for (guint i = 0; i < n; ++i) {
+        GstMluFrame_t tensor = finish_tensor(self, pixels + i * tensor_size);
+        if (!tensor) {
+          return FALSE;
+        }
+        tensor->channel_id = frame->channel_id;
+        tensors->push_back(tensor);
+      }
+    }
+  }
+  cpp->tensor_queue->Sync();
   return TRUE;
 }
 
+static GstFlowReturn
+tensor_chain(GstCnconvert* self, GstBuffer* buffer, GstMluFrame_t frame, const std::vector<cncvRect>& rois,
+             const std::vector<GstVideoRegionOfInterestMeta*>& roi_metas)
+{
+  GstCnconvertPrivate* priv = gst_cnconvert_get_private(self);
+
+  std::vector<GstMluFrame_t> tensors;
+  gboolean ok = FALSE;
+  try {
+    // input may be produced asynchronously on another queue
+    ok = gst_mlu_frame_sync(frame) && convert_to_tensors(self, frame, rois, &tensors);
+  } catch (edk::Exception& e) {
+    GST_CNCONVERT_ERROR(self, RESOURCE, FAILED, ("%s", e.what()));
+  }
+  priv->cpp->h2d_bytes.store(priv->cpp->frame_h2d);
+  if (!ok) {
+    for (auto tensor : tensors) {
+      gst_mlu_frame_unref(tensor);
+    }
+    gst_buffer_unref(buffer);
+    return GST_FLOW_ERROR;
+  }
+
+  GstFlowReturn ret = GST_FLOW_OK;
+  for (guint i = 0; i < tensors.size(); ++i) {
+    GstMluFrame_t tensor = tensors[i];
+    if (ret != GST_FLOW_OK) {
+      gst_mlu_frame_unref(tensor);
+      continue;
+    }
+    GstBuffer* outbuf = gst_buffer_new();
+    gst_buffer_append_memory(outbuf, gst_mlu_memory_new(tensor, 0, cn_syncedmem_get_size(tensor->data[0])));
+    // meta takes the reference of tensor
+    gst_buffer_add_mlu_memory_meta(outbuf, tensor, "convert");
+    decorate_output(self, outbuf, buffer, rois[i], letterbox_roi(self, rois[i]),
+                    roi_metas.empty() ? nullptr : roi_metas[i]);
+    ret = gst_pad_push(self->srcpad, outbuf);
+  }
+  gst_buffer_unref(buffer);
+  return ret;
+}
+
 static GstFlowReturn
 gst_cnconvert_chain(GstPad* pad, GstObject* parent, GstBuffer* buffer)
 {
   GstCnconvert* self = GST_CNCONVERT(parent);
   GstCnconvertPrivate* priv = gst_cnconvert_get_private(self);
 
-  gboolean pass_through = priv->disable_resize && priv->disable_convert && (priv->output_on_mlu == priv->input_on_mlu);
+  std::vector<cncvRect> rois;
+  std::vector<GstVideoRegionOfInterestMeta*> roi_metas;
+  collect_rois(self, buffer, &rois, &roi_metas);
+  if (rois.empty()) {
+    GST_LOG_OBJECT(self, "no region of interest in buffer %" GST_PTR_FORMAT, buffer);
+    gst_buffer_unref(buffer);
+    return GST_FLOW_OK;
+  }
+  cncvRect full = output_roi(priv->sink_info);
+  gboolean cropped = rois.size() > 1 || rois[0].x != full.x || rois[0].y != full.y || rois[0].w != full.w ||
+                     rois[0].h != full.h;
+
+  gboolean pass_through = priv->disable_resize && priv->disable_convert && !cropped &&
+                          priv->video_direction == GST_VIDEO_ORIENTATION_IDENTITY &&
+                          (priv->output_on_mlu == priv->input_on_mlu);
   if (pass_through) {
     GST_DEBUG_OBJECT(self, "pass through");
     gst_pad_push(self->srcpad, buffer);
@@ -664,6 +1914,8 @@ gst_cnconvert_chain(GstPad* pad, GstObject* parent, GstBuffer* buffer)
 
     if (!meta || !meta->frame) {
       GST_CNCONVERT_ERROR(self, RESOURCE, READ, ("get meta failed"));
+      gst_buffer_unref(buffer);
+      return GST_FLOW_ERROR;
     }
 
     frame = meta->frame;
@@ -673,79 +1925,312 @@ gst_cnconvert_chain(GstPad* pad, GstObject* parent, GstBuffer* buffer)
       g_return_val_if_fail(set_cnrt_env(GST_ELEMENT(self), priv->device_id), GST_FLOW_ERROR);
       cnrt_env = true;
     }
-  } else {
+  } else if (!priv->use_cpu || priv->output_on_mlu) {
     if (!cnrt_env) {
       priv->device_id = priv->device_id == -1 ? 0 : priv->device_id;
       g_return_val_if_fail(set_cnrt_env(GST_ELEMENT(self), priv->device_id), GST_FLOW_ERROR);
       cnrt_env = true;
     }
-    frame = gst_mlu_frame_new();
-    g_return_val_if_fail(transform_to_mlu(self, buffer, frame, priv->sink_info.finfo->format), GST_FLOW_ERROR);
-    meta = gst_buffer_add_mlu_memory_meta(buffer, frame, "convert");
   }
+  if (priv->use_cpu) {
+    return cpu_chain(self, buffer, rois, roi_metas);
+  }
+  priv->cpp->frame_h2d = 0;
 
-  // init cncvHandle and cnrtQueue
+  // init cncvHandle and cnrtQueue, inputs in system memory are uploaded on the queue
   std::call_once(priv->init_flag, [self, priv]() {
     CNRT_SAFECALL(cnrtCreateQueue(&priv->queue), );
     CNCV_SAFECALL(cncvCreate(&priv->handle), );
     CNCV_SAFECALL(cncvSetQueue(priv->handle, priv->queue), );
   });
 
-  // process
-  do {
-    if (priv->disable_convert && priv->disable_resize) {
-      break;
+  if (!priv->input_on_mlu) {
+    frame = gst_mlu_frame_new();
+    if (!transform_to_mlu(self, buffer, frame, priv->sink_info.finfo->format)) {
+      gst_mlu_frame_unref(frame);
+      gst_buffer_unref(buffer);
+      return GST_FLOW_ERROR;
+    }
+    // memories of buffer may be replaced by the uploaded frame
+    buffer = gst_buffer_make_writable(buffer);
+    meta = gst_buffer_add_mlu_memory_meta(buffer, frame, "convert");
+  }
+
+  if (priv->tensor_output) {
+    return tensor_chain(self, buffer, frame, rois, roi_metas);
+  }
+
+  gboolean processed = !(priv->disable_convert && priv->disable_resize) || cropped;
+  if (!processed) {
+    priv->cpp->h2d_bytes.store(priv->cpp->frame_h2d);
+    return push_output(self, buffer, frame, FALSE);
+  }
+
+  // process, each region produces an output
+  // input may be produced asynchronously on another queue, uploads are already ordered on ours
+  if (!begin_frame(self) || (priv->input_on_mlu && !gst_mlu_frame_sync(frame))) {
+    GST_CNCONVERT_ERROR(self, LIBRARY, FAILED, ("wait for device work failed"));
+    gst_buffer_unref(buffer);
+    return GST_FLOW_ERROR;
+  }
+  guint n = rois.size();
+  std::vector<cncvRect> dst_rois;
+  gboolean letterboxed = FALSE;
+  cncvRect out_full = output_roi(priv->src_info);
+  for (const auto& roi : rois) {
+    cncvRect dst_roi = letterbox_roi(self, roi);
+    letterboxed = letterboxed || dst_roi.w != out_full.w || dst_roi.h != out_full.h;
+    dst_rois.push_back(dst_roi);
+  }
+  std::vector<GstBuffer*> outbufs;
+  std::vector<GstMluFrame_t> out_frames;
+  std::vector<void*> dst;
+  auto release_outputs = [&outbufs]() {
+    for (auto outbuf : outbufs) {
+      gst_buffer_unref(outbuf);
+    }
+  };
+  for (guint i = 0; i < n; ++i) {
+    GstBuffer* outbuf = nullptr;
+    GstFlowReturn flow = gst_buffer_pool_acquire_buffer(priv->pool, &outbuf, NULL);
+    if (flow != GST_FLOW_OK) {
+      GST_DEBUG_OBJECT(self, "acquire output buffer failed, %s", gst_flow_get_name(flow));
+      release_outputs();
+      gst_buffer_unref(buffer);
+      return flow;
     }
+    GstMluFrame_t out_frame = gst_buffer_get_mlu_memory_meta(outbuf)->frame;
+    out_frame->device_id = priv->device_id;
+    out_frame->channel_id = frame->channel_id;
+    outbufs.push_back(outbuf);
+    out_frames.push_back(out_frame);
+    dst.push_back(cn_syncedmem_get_mutable_dev_data(out_frame->data[0]));
+  }
+
+  GstVideoFormat sink_fmt = priv->sink_info.finfo->format, src_fmt = priv->src_info.finfo->format;
+  gboolean ok = TRUE;
+  // padding of outputs written by resize kernels directly
+  auto pad_outputs = [&]() {
+    return !letterboxed ||
+           fill_pad(self, &priv->pad_mem, src_fmt, priv->src_info.stride[0], priv->src_info.height, dst.data(), n);
+  };
+  if (isYUV420sp(sink_fmt) && isRGB(src_fmt)) {
+    ok = pad_outputs() && resize_convert(self, frame, rois, dst_rois, dst.data());
+  } else if (isRGB(sink_fmt) && isRGB(src_fmt)) {
     if (priv->disable_convert) {
-      // resize, rgb/bgr supported
-      if (!resize_rgb(self, frame, &priv->mlu_dst_mem))
-        return GST_FLOW_ERROR;
-    } else if (priv->disable_resize) {
-      if (!cvt_rgb(self, frame->data[0], &priv->mlu_dst_mem))
-        return GST_FLOW_ERROR;
+      ok = pad_outputs() && resize_rgb(self, frame, rois, dst_rois, dst.data(), FALSE);
+    } else if (!cropped && priv->disable_resize) {
+      void* src = cn_syncedmem_get_mutable_dev_data(frame->data[0]);
+      ok = cvt_rgb(self, &src, 1, dst.data());
+    } else if (priv->fuse_rgb_resize) {
+      ok = pad_outputs() && resize_convert(self, frame, rois, dst_rois, dst.data());
     } else {
-      // resize and convert
-      if (isYUV420sp(priv->sink_info.finfo->format) && isRGB(priv->src_info.finfo->format)) {
-        if (!resize_convert(self, frame))
-          return GST_FLOW_ERROR;
-      } else if (isRGB(priv->sink_info.finfo->format) && isRGB(priv->src_info.finfo->format)) {
-        if (!resize_rgb(self, frame, &priv->tmp_mem) || !cvt_rgb(self, priv->tmp_mem, &priv->mlu_dst_mem))
-          return GST_FLOW_ERROR;
-      } else {
-        GST_CNCONVERT_ERROR(self, LIBRARY, FAILED, ("unsupported resize and color convert mode"));
-        return GST_FLOW_ERROR;
-      }
+      std::vector<void*> tmp;
+      void** tmp_ptrs = prepare_tmp(self, n, &tmp);
+      // padding is converted along with intermediate images
+      ok = (!letterboxed || fill_pad(self, &priv->pad_tmp_mem, sink_fmt,
+                                     priv->src_info.width * get_channel_num_plane0(sink_fmt), priv->src_info.height,
+                                     tmp_ptrs, n)) &&
+           resize_rgb(self, frame, rois, dst_rois, tmp_ptrs, TRUE) && cvt_rgb(self, tmp_ptrs, n, dst.data());
+    }
+  } else {
+    GST_CNCONVERT_ERROR(self, LIBRARY, FAILED, ("unsupported resize and color convert mode"));
+    ok = FALSE;
+  }
+  ok = ok && finish_frame(self, out_frames, buffer);
+  if (!ok) {
+    release_outputs();
+    gst_buffer_unref(buffer);
+    return GST_FLOW_ERROR;
+  }
+
+  GstFlowReturn ret = GST_FLOW_OK;
+  for (guint i = 0; i < n; ++i) {
+    GstBuffer* outbuf = outbufs[i];
+    if (ret != GST_FLOW_OK) {
+      gst_buffer_unref(outbuf);
+      continue;
     }
+    decorate_output(self, outbuf, buffer, rois[i], dst_rois[i], roi_metas.empty() ? nullptr : roi_metas[i]);
+    ret = push_output(self, outbuf, out_frames[i], TRUE);
+  }
+  gst_buffer_unref(buffer);
+  return ret;
+}
 
-    // update mlu memory meta
-    guint channel_id = frame->channel_id;
-    gst_mlu_frame_unref(frame);
+static gboolean
+choose_backend(GstCnconvert* self)
+{
+  GstCnconvertPrivate* priv = gst_cnconvert_get_private(self);
+  GstVideoFormat sink_fmt = priv->sink_info.finfo->format, src_fmt = priv->src_info.finfo->format;
+  // MLU memory is mapped to host, which downloads input and uploads output
+  gboolean cpu_ok = CpuConverter::supports(sink_fmt, src_fmt);
+  gboolean host_only = !priv->input_on_mlu && !priv->output_on_mlu;
+  // MLU kernels have no planar yuv to rgb series, nor rotation and flip
+  gboolean oriented = priv->video_direction != GST_VIDEO_ORIENTATION_IDENTITY;
+  gboolean mlu_ok = !(sink_fmt == GST_VIDEO_FORMAT_I420 && isRGB(src_fmt)) && !oriented;
+
+  switch (priv->backend) {
+    case GST_CNCONVERT_BACKEND_CPU:
+      if (!cpu_ok) {
+        GST_CNCONVERT_ERROR(self, LIBRARY, SETTINGS, ("cpu backend only converts yuv420 to rgb series"));
+        return FALSE;
+      }
+      priv->use_cpu = TRUE;
+      break;
+    case GST_CNCONVERT_BACKEND_MLU:
+      if (!mlu_ok) {
+        GST_CNCONVERT_ERROR(self, LIBRARY, SETTINGS,
+                            ("I420 to rgb series, rotation and flip are not supported by mlu backend"));
+        return FALSE;
+      }
+      priv->use_cpu = FALSE;
+      break;
+    default:
+      if (!cpu_ok && !mlu_ok) {
+        GST_CNCONVERT_ERROR(self, LIBRARY, SETTINGS,
+                            ("rotation and flip are only supported from yuv420 to rgb series"));
+        return FALSE;
+      }
+      // copies between host and device cost more than converting on MLU, unless the MLU can not do it
+      priv->use_cpu =
+        cpu_ok && (!mlu_ok || (host_only && priv->src_info.width * priv->src_info.height <= AUTO_CPU_MAX_PIXELS));
+      break;
+  }
+  GST_INFO_OBJECT(self, "convert on %s", priv->use_cpu ? "cpu" : "mlu");
+  return TRUE;
+}
 
-    meta->meta_src = "convert";
-    meta->frame = gst_mlu_frame_new();
-    frame = meta->frame;
-    frame->device_id = priv->device_id;
-    frame->channel_id = channel_id;
-    frame->data[0] = priv->mlu_dst_mem;
-    priv->mlu_dst_mem = nullptr;
-    frame->height = priv->src_info.height;
-    frame->width = priv->src_info.width;
-    frame->stride[0] = priv->src_info.width * get_channel_num_plane0(priv->src_info.finfo->format);
-    frame->n_planes = 1;
-  } while (0);
-
-  if (!priv->output_on_mlu) {
-    // copyout
-    try {
-      buffer = transform_to_cpu(self, buffer, frame, priv->src_info.finfo->format);
-    } catch (edk::Exception& e) {
-      gst_buffer_unref(buffer);
-      GST_CNCONVERT_ERROR(self, RESOURCE, OPEN_READ_WRITE, ("%s", e.what()));
-      return GST_FLOW_ERROR;
+// tensor is described by src_info in the pixel layout of its elements
+// enum types are registered statically, so their classes and nicks are never freed
+static const GEnumValue*
+enum_value(GType type, gint value, const gchar* nick)
+{
+  GEnumClass* klass = G_ENUM_CLASS(g_type_class_ref(type));
+  const GEnumValue* ret = nick ? g_enum_get_value_by_nick(klass, nick) : g_enum_get_value(klass, value);
+  g_type_class_unref(klass);
+  return ret;
+}
+
+static gboolean
+tensor_info_from_caps(GstCnconvert* self, GstStructure* caps_struct)
+{
+  GstCnconvertPrivate* priv = gst_cnconvert_get_private(self);
+  const gchar* dtype_nick = enum_value(GST_CNCONVERT_DTYPE, priv->dtype, NULL)->value_nick;
+  const gchar* layout_nick = enum_value(GST_CNCONVERT_LAYOUT, priv->layout, NULL)->value_nick;
+  gint width = 0, height = 0;
+  if (!gst_structure_fixate_field_string(caps_struct, "dtype", dtype_nick) ||
+      !gst_structure_fixate_field_string(caps_struct, "layout", layout_nick) ||
+      !gst_structure_fixate_field_string(caps_struct, "format", "RGBA") ||
+      !gst_structure_get_int(caps_struct, "width", &width) || !gst_structure_get_int(caps_struct, "height", &height)) {
+    GST_ERROR_OBJECT(self, "can not fixate tensor caps %" GST_PTR_FORMAT, caps_struct);
+    return FALSE;
+  }
+  if (!isYUV420sp(priv->sink_info.finfo->format)) {
+    GST_CNCONVERT_ERROR(self, LIBRARY, SETTINGS, ("tensors are only converted from yuv420sp"));
+    return FALSE;
+  }
+  priv->tensor_dtype = static_cast<GstCnconvertDtype>(
+    enum_value(GST_CNCONVERT_DTYPE, 0, gst_structure_get_string(caps_struct, "dtype"))->value);
+  priv->tensor_layout = static_cast<GstCnconvertLayout>(
+    enum_value(GST_CNCONVERT_LAYOUT, 0, gst_structure_get_string(caps_struct, "layout"))->value);
+  if (priv->tensor_dtype == GST_CNCONVERT_DTYPE_UINT8 && (priv->mean_str || priv->std_str)) {
+    GST_CNCONVERT_ERROR(self, LIBRARY, SETTINGS, ("normalized tensors need dtype float16 or float32"));
+    return FALSE;
+  }
+  GstVideoFormat fmt = gst_video_format_from_string(gst_structure_get_string(caps_struct, "format"));
+  gst_video_info_set_format(&priv->src_info, fmt, width, height);
+  return TRUE;
+}
+
+// fixates src caps queried from downstream and chooses backend for them, then sets them and prepares resources
+static gboolean
+gst_cnconvert_set_src_caps(GstCnconvert* self, GstCaps* src_peer_caps)
+{
+  GstCnconvertPrivate* priv = gst_cnconvert_get_private(self);
+
+  gst_caps_set_simple(src_peer_caps, "framerate", GST_TYPE_FRACTION, priv->sink_info.fps_n, priv->sink_info.fps_d,
+                      NULL);
+
+  // if downstream have not specify resolution, input is rotated as a whole
+  gint width = priv->sink_info.width, height = priv->sink_info.height;
+  if (CpuConverter::transposes(priv->video_direction)) {
+    std::swap(width, height);
+  }
+  auto caps_struct = gst_caps_get_structure(src_peer_caps, 0);
+  if (!gst_structure_has_field(caps_struct, "width") || !gst_structure_has_field(caps_struct, "height")) {
+    gst_caps_set_simple(src_peer_caps, "width", G_TYPE_INT, width, "height", G_TYPE_INT, height, NULL);
+  } else if (!gst_caps_is_fixed(src_peer_caps)) {
+    if (!gst_structure_fixate_field_nearest_int(caps_struct, "width", width) ||
+        !gst_structure_fixate_field_nearest_int(caps_struct, "height", height)) {
+      GST_ERROR_OBJECT(self, "can not fixate src caps");
+      return FALSE;
     }
   }
 
-  return gst_pad_push(self->srcpad, buffer);
+  priv->tensor_output = gst_structure_has_name(caps_struct, "other/tensor");
+  if (priv->tensor_output) {
+    if (!tensor_info_from_caps(self, caps_struct)) {
+      return FALSE;
+    }
+  } else if (!gst_video_info_from_caps(&priv->src_info, src_peer_caps)) {
+    GST_ERROR_OBJECT(self, "Get video info from src caps failed");
+    return FALSE;
+  }
+
+  // get information from src caps
+  auto feat_str = gst_caps_features_to_string(gst_caps_get_features(src_peer_caps, 0));
+  priv->output_on_mlu = g_strcmp0(feat_str, GST_CAPS_FEATURE_MEMORY_MLU) == 0;
+  g_free(feat_str);
+
+  priv->disable_resize =
+    priv->sink_info.width == priv->src_info.width && priv->sink_info.height == priv->src_info.height;
+  priv->disable_convert = priv->sink_info.finfo->format == priv->src_info.finfo->format;
+
+  // yuv is only passed through as a whole without color convert, regions can not be taken out of it
+  if (!isRGB(priv->sink_info.finfo->format) && priv->disable_convert && (priv->has_crop || priv->roi_type)) {
+    GST_CNCONVERT_ERROR(self, LIBRARY, SETTINGS, ("crop and roi-type need yuv to be converted to rgb series"));
+    return FALSE;
+  }
+  // caps are refused before downstream is told about them
+  if (!choose_backend(self)) {
+    return FALSE;
+  }
+  // limits of MLU kernels, tensors are produced by a kernel of their own
+  if (!priv->tensor_output && !priv->use_cpu && priv->disable_resize && !priv->disable_convert &&
+      (!isRGB(priv->sink_info.finfo->format) || !isRGB(priv->src_info.finfo->format))) {
+    GST_CNCONVERT_ERROR(self, LIBRARY, SETTINGS, ("without resize, only rgb series to rgb series convert is supported"));
+    return FALSE;
+  }
+  if (!priv->tensor_output && !priv->use_cpu && !priv->disable_resize && priv->disable_convert &&
+      (!isRGB(priv->sink_info.finfo->format))) {
+    GST_CNCONVERT_ERROR(self, LIBRARY, SETTINGS, ("without color convert, only rgb series resize is supported"));
+    return FALSE;
+  }
+
+  GST_INFO_OBJECT(self, "cnconvert setcaps %" GST_PTR_FORMAT, src_peer_caps);
+  gst_pad_use_fixed_caps(self->srcpad);
+  if (!gst_pad_set_caps(self->srcpad, src_peer_caps)) {
+    GST_ERROR_OBJECT(self, "set caps failed");
+    return FALSE;
+  }
+
+  if (priv->tmp_mem) {
+    if (!cn_syncedmem_free(priv->tmp_mem)) {
+      GST_CNCONVERT_ERROR(self, RESOURCE, CLOSE, ("Free mlu memory failed"));
+      return FALSE;
+    }
+    priv->tmp_mem = nullptr;
+  }
+  // layouts of padding images are changed
+  gst_cnconvert_free_pad(self);
+  // pointer tables refer to outputs of the old pool
+  gst_cnconvert_free_workspaces(self);
+  gst_cnconvert_free_staging(self);
+  prepare_kernel_params(self);
+  priv->cpp->tensor_ops.clear();
+
+  return gst_cnconvert_decide_allocation(self, src_peer_caps);
 }
 
 static gboolean
@@ -755,6 +2240,9 @@ gst_cnconvert_setcaps(GstCnconvert* self, GstCaps* sinkcaps)
   gboolean ret = FALSE;
   GstCnconvertPrivate* priv = gst_cnconvert_get_private(self);
 
+  // intermediate memory and pool may be released below
+  gst_cnconvert_wait_in_flight(self, 0);
+
   // get information from sink caps
   g_return_val_if_fail(gst_video_info_from_caps(&priv->sink_info, sinkcaps), FALSE);
 
@@ -768,14 +2256,18 @@ gst_cnconvert_setcaps(GstCnconvert* self, GstCaps* sinkcaps)
   switch (priv->sink_info.finfo->format) {
     case GST_VIDEO_FORMAT_NV12:
       filter_caps = gst_caps_from_string("video/x-raw, format={NV12, RGB, BGR, ARGB, ABGR, BGRA, RGBA};"
-                                         "video/x-raw(memory:mlu), format={NV12, RGB, BGR, ARGB, ABGR, BGRA, RGBA};");
+                                         "video/x-raw(memory:mlu), format={NV12, RGB, BGR, ARGB, ABGR, BGRA, RGBA};"
+                                         TENSOR_CAPS);
       break;
     case GST_VIDEO_FORMAT_NV21:
       filter_caps = gst_caps_from_string("video/x-raw, format={NV21, RGB, BGR, ARGB, ABGR, BGRA, RGBA};"
-                                         "video/x-raw(memory:mlu), format={NV21, RGB, BGR, ARGB, ABGR, BGRA, RGBA};");
+                                         "video/x-raw(memory:mlu), format={NV21, RGB, BGR, ARGB, ABGR, BGRA, RGBA};"
+                                         TENSOR_CAPS);
       break;
     case GST_VIDEO_FORMAT_I420:
-      filter_caps = gst_caps_from_string("video/x-raw(memory:mlu), format={I420};video/x-raw, format={I420};");
+      // converted to rgb series by cpu backend only
+      filter_caps = gst_caps_from_string("video/x-raw, format={I420, RGB, BGR, ARGB, ABGR, BGRA, RGBA};"
+                                         "video/x-raw(memory:mlu), format={I420, RGB, BGR, ARGB, ABGR, BGRA, RGBA};");
       break;
     case GST_VIDEO_FORMAT_RGB: case GST_VIDEO_FORMAT_BGR:
     case GST_VIDEO_FORMAT_RGBA: case GST_VIDEO_FORMAT_BGRA: case GST_VIDEO_FORMAT_ARGB: case GST_VIDEO_FORMAT_ABGR:
@@ -800,72 +2292,75 @@ gst_cnconvert_setcaps(GstCnconvert* self, GstCaps* sinkcaps)
   }
 
   src_peer_caps = gst_caps_truncate(gst_caps_normalize(src_peer_caps));
-  gst_caps_set_simple(src_peer_caps, "framerate", GST_TYPE_FRACTION, priv->sink_info.fps_n, priv->sink_info.fps_d,
-                      NULL);
+  ret = gst_cnconvert_set_src_caps(self, src_peer_caps);
+  gst_caps_unref(src_peer_caps);
 
-  // if downstream have not specify resolution
-  auto caps_struct = gst_caps_get_structure(src_peer_caps, 0);
-  if (!gst_structure_has_field(caps_struct, "width") || !gst_structure_has_field(caps_struct, "height")) {
-    gst_caps_set_simple(src_peer_caps, "width", G_TYPE_INT, priv->sink_info.width, "height", G_TYPE_INT,
-                        priv->sink_info.height, NULL);
-  } else if (!gst_caps_is_fixed(src_peer_caps)) {
-    if (!gst_structure_fixate_field_nearest_int(caps_struct, "width", priv->sink_info.width) ||
-        !gst_structure_fixate_field_nearest_int(caps_struct, "height", priv->sink_info.height)) {
-      GST_ERROR_OBJECT(self, "can not fixate src caps");
-      gst_caps_unref(src_peer_caps);
-      return FALSE;
-    }
-  }
+  return ret;
+}
 
-  if (!gst_video_info_from_caps(&priv->src_info, src_peer_caps)) {
-    GST_ERROR_OBJECT(self, "Get video info from src caps failed");
-    gst_caps_unref(src_peer_caps);
-    return FALSE;
+static void
+gst_cnconvert_release_pool(GstCnconvert* self)
+{
+  GstCnconvertPrivate* priv = gst_cnconvert_get_private(self);
+  if (priv->pool) {
+    // buffers still held by downstream are freed when they are released
+    gst_buffer_pool_set_active(priv->pool, FALSE);
+    gst_object_unref(priv->pool);
+    priv->pool = nullptr;
   }
-  GST_INFO_OBJECT(self, "cnconvert setcaps %" GST_PTR_FORMAT, src_peer_caps);
-  gst_pad_use_fixed_caps(self->srcpad);
-  ret = gst_pad_set_caps(self->srcpad, src_peer_caps);
-
-  if (!ret) {
-    GST_ERROR_OBJECT(self, "set caps failed");
-  } else {
-    // get information from src caps
-    auto feat_str = gst_caps_features_to_string(gst_caps_get_features(src_peer_caps, 0));
-    priv->output_on_mlu = g_strcmp0(feat_str, GST_CAPS_FEATURE_MEMORY_MLU) == 0;
-    g_free(feat_str);
-
-    priv->disable_resize =
-      priv->sink_info.width == priv->src_info.width && priv->sink_info.height == priv->src_info.height;
-    priv->disable_convert = priv->sink_info.finfo->format == priv->src_info.finfo->format;
+}
 
-    if (priv->disable_resize && !priv->disable_convert &&
-        (!isRGB(priv->sink_info.finfo->format) || !isRGB(priv->src_info.finfo->format))) {
-      GST_CNCONVERT_ERROR(self, LIBRARY, SETTINGS, ("without resize, only rgb series to rgb series convert is supported"));
-      return FALSE;
-    }
-    if (!priv->disable_resize && priv->disable_convert &&
-        (!isRGB(priv->sink_info.finfo->format))) {
-      GST_CNCONVERT_ERROR(self, LIBRARY, SETTINGS, ("without color convert, only rgb series resize is supported"));
-      return FALSE;
-    }
+static gboolean
+gst_cnconvert_decide_allocation(GstCnconvert* self, GstCaps* caps)
+{
+  GstCnconvertPrivate* priv = gst_cnconvert_get_private(self);
+  GstBufferPool* pool = nullptr;
+  guint size = 0, min_buffers = DEFAULT_MIN_BUFFERS, max_buffers = DEFAULT_MAX_BUFFERS;
+  gboolean mlu_pool = !priv->use_cpu || priv->output_on_mlu;
+
+  gst_cnconvert_release_pool(self);
+  if (priv->tensor_output) {
+    // tensors are not video frames, their device memory is taken from the memory pool per frame
+    return TRUE;
+  }
 
-    if (priv->mlu_dst_mem) {
-      if (cn_syncedmem_free(priv->mlu_dst_mem)) {
-        GST_CNCONVERT_ERROR(self, RESOURCE, CLOSE, ("Free mlu memory failed"));
-        return FALSE;
-      }
-      priv->mlu_dst_mem = nullptr;
-    }
-    if (priv->tmp_mem) {
-      if (cn_syncedmem_free(priv->tmp_mem)) {
-        GST_CNCONVERT_ERROR(self, RESOURCE, CLOSE, ("Free mlu memory failed"));
-        return FALSE;
-      }
-      priv->tmp_mem = nullptr;
+  GstQuery* query = gst_query_new_allocation(caps, TRUE);
+  if (!gst_pad_peer_query(self->srcpad, query)) {
+    GST_DEBUG_OBJECT(self, "peer ALLOCATION query failed");
+  }
+  priv->downstream_video_meta = gst_query_find_allocation_meta(query, GST_VIDEO_META_API_TYPE, NULL);
+  if (gst_query_get_n_allocation_pools(query) > 0) {
+    guint peer_min, peer_max;
+    gst_query_parse_nth_allocation_pool(query, 0, &pool, &size, &peer_min, &peer_max);
+    // pools of host memory could not hold outputs of MLU kernels, and cpu backend writes host memory unless output
+    // is on MLU, where it maps MLU memory
+    if (pool && (mlu_pool ? !GST_IS_MLU_BUFFER_POOL(pool) : GST_IS_MLU_BUFFER_POOL(pool))) {
+      gst_object_unref(pool);
+      pool = nullptr;
     }
+    // buffers held by downstream are not available to us
+    min_buffers = MAX(min_buffers, peer_min);
+    max_buffers = peer_max ? MAX(peer_max, min_buffers) : MAX(max_buffers, min_buffers);
+  }
+  gst_query_unref(query);
+  if (priv->roi_type) {
+    // number of outputs of an input is not bounded
+    max_buffers = 0;
   }
 
-  gst_caps_unref(src_peer_caps);
+  if (!pool) {
+    pool = mlu_pool ? gst_mlu_buffer_pool_new() : gst_video_buffer_pool_new();
+  }
+  GstStructure* config = gst_buffer_pool_get_config(pool);
+  gst_buffer_pool_config_set_params(config, caps, size, min_buffers, max_buffers);
+  gst_buffer_pool_config_add_option(config, GST_BUFFER_POOL_OPTION_VIDEO_META);
+  if (!gst_buffer_pool_set_config(pool, config) || !gst_buffer_pool_set_active(pool, TRUE)) {
+    GST_CNCONVERT_ERROR(self, RESOURCE, SETTINGS, ("config output buffer pool failed"));
+    gst_object_unref(pool);
+    return FALSE;
+  }
+  GST_INFO_OBJECT(self, "output buffer pool %" GST_PTR_FORMAT ", min %u, max %u", pool, min_buffers, max_buffers);
 
-  return ret;
+  priv->pool = pool;
+  return TRUE;
 }
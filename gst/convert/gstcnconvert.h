@@ -34,6 +34,36 @@ G_BEGIN_DECLS
 typedef struct _GstCnconvert GstCnconvert;
 typedef struct _GstCnconvertClass GstCnconvertClass;
 
+// where resized image is placed in output when aspect ratio is kept
+typedef enum
+{
+  GST_CNCONVERT_PAD_CENTER = 0,
+  GST_CNCONVERT_PAD_TOP_LEFT,
+} GstCnconvertPadPosition;
+
+// where conversion runs, auto chooses cpu for small outputs in system memory, and for what MLU kernels can not do
+typedef enum
+{
+  GST_CNCONVERT_BACKEND_AUTO = 0,
+  GST_CNCONVERT_BACKEND_MLU,
+  GST_CNCONVERT_BACKEND_CPU,
+} GstCnconvertBackend;
+
+// element type of tensor outputs
+typedef enum
+{
+  GST_CNCONVERT_DTYPE_UINT8 = 0,
+  GST_CNCONVERT_DTYPE_FLOAT16,
+  GST_CNCONVERT_DTYPE_FLOAT32,
+} GstCnconvertDtype;
+
+// dimension order of tensor outputs
+typedef enum
+{
+  GST_CNCONVERT_LAYOUT_NHWC = 0,
+  GST_CNCONVERT_LAYOUT_NCHW,
+} GstCnconvertLayout;
+
 struct _GstCnconvert
 {
   GstElement element;
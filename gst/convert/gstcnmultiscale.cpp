@@ -0,0 +1,660 @@
+/*
+ *  Copyright (C) [2019-2020] by Cambricon, Inc.
+ *
+ *  This file is part of CNStream-Gst.
+ *
+ *  CNStream-Gst is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU Lesser General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  CNStream-Gst is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU Lesser General Public License for more details.
+ *
+ *  You should have received a copy of the GNU Lesser General Public License
+ *  along with CNStream-Gst.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#include "gstcnmultiscale.h"
+
+#include <gst/gst.h>
+#include <gst/video/video.h>
+#include <cstdio>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <vector>
+
+#include "cncv.h"
+#include "cnrt.h"
+#include "common/gst_mlu_buffer_pool.h"
+#include "common/mlu_memory_meta.h"
+#include "common/utils.h"
+#include "convert/cncv_utils.h"
+
+enum
+{
+  PROP_0,
+  PROP_DEVICE_ID,
+};
+static constexpr gint DEFAULT_DEVICE_ID = -1;
+static constexpr guint DEFAULT_MIN_BUFFERS = 2;
+static constexpr guint DEFAULT_MAX_BUFFERS = 8;
+
+GST_DEBUG_CATEGORY_EXTERN(gst_cambricon_debug);
+#define GST_CAT_DEFAULT gst_cambricon_debug
+
+#define GST_CNMULTISCALE_ERROR(el, domain, code, msg) GST_ELEMENT_ERROR(el, domain, code, msg, ("None"))
+
+#define CNRT_SAFECALL(func, val) \
+  do { \
+    auto ret = func; \
+    if (ret != CNRT_RET_SUCCESS) { \
+      GST_CNMULTISCALE_ERROR(self, LIBRARY, FAILED, ("Call [" #func "] failed")); \
+      return val; \
+    } \
+  } while(0)
+
+#define CNCV_SAFECALL(func, val) \
+  do { \
+    auto ret = func; \
+    if (ret != CNCV_STATUS_SUCCESS) { \
+      GST_CNMULTISCALE_ERROR(self, LIBRARY, FAILED, ("Call [" #func "] failed")); \
+      return val; \
+    } \
+  } while(0)
+
+/* the capabilities of the inputs and outputs. */
+static GstStaticPadTemplate sink_factory =
+  GST_STATIC_PAD_TEMPLATE("sink",
+                          GST_PAD_SINK,
+                          GST_PAD_ALWAYS,
+                          GST_STATIC_CAPS("video/x-raw(memory:mlu), format={NV12, NV21}"));
+
+static GstStaticPadTemplate src_factory =
+  GST_STATIC_PAD_TEMPLATE("src_%u",
+                          GST_PAD_SRC,
+                          GST_PAD_REQUEST,
+                          GST_STATIC_CAPS("video/x-raw(memory:mlu), format={RGB, BGR, RGBA, ARGB, BGRA, ABGR};"
+                                          "video/x-raw, format={RGB, BGR, RGBA, ARGB, BGRA, ABGR};"));
+
+struct ScaleOutput
+{
+  guint index;
+  GstPad* srcpad;
+  GstVideoInfo src_info;
+  // null until caps are negotiated with downstream
+  GstBufferPool* pool = nullptr;
+};
+
+struct GstCnmultiscalePrivateCpp
+{
+  std::mutex outputs_mtx;
+  std::map<guint, std::shared_ptr<ScaleOutput>> outputs;
+  guint next_index = 0;
+};
+
+struct GstCnmultiscalePrivate
+{
+  cncvHandle_t handle;
+  cnrtQueue_t queue;
+  GstSyncedMemory_t cncv_workspace;
+  gint device_id;
+  GstVideoInfo sink_info;
+
+  GstCnmultiscalePrivateCpp* cpp;
+};
+
+G_DEFINE_TYPE_WITH_PRIVATE(GstCnmultiscale, gst_cnmultiscale, GST_TYPE_ELEMENT);
+// gst_cnmultiscale_parent_class is defined in G_DEFINE_TYPE macro
+#define PARENT_CLASS gst_cnmultiscale_parent_class
+
+static inline GstCnmultiscalePrivate*
+gst_cnmultiscale_get_private(GstCnmultiscale* object)
+{
+  return reinterpret_cast<GstCnmultiscalePrivate*>(gst_cnmultiscale_get_instance_private(object));
+}
+
+// GObject vmethod
+static void
+gst_cnmultiscale_set_property(GObject* object, guint prop_id, const GValue* value, GParamSpec* pspec);
+static void
+gst_cnmultiscale_get_property(GObject* object, guint prop_id, GValue* value, GParamSpec* pspec);
+static void
+gst_cnmultiscale_finalize(GObject* gobject);
+static GstPad*
+gst_cnmultiscale_request_new_pad(GstElement* element, GstPadTemplate* templ, const gchar* name, const GstCaps* caps);
+static void
+gst_cnmultiscale_release_pad(GstElement* element, GstPad* pad);
+static GstStateChangeReturn
+gst_cnmultiscale_change_state(GstElement* element, GstStateChange transition);
+static gboolean
+gst_cnmultiscale_sink_event(GstPad* pad, GstObject* parent, GstEvent* event);
+static gboolean
+gst_cnmultiscale_sink_query(GstPad* pad, GstObject* parent, GstQuery* query);
+static GstFlowReturn
+gst_cnmultiscale_chain(GstPad* pad, GstObject* parent, GstBuffer* buffer);
+
+// GstCnmultiscale private method
+static gboolean
+gst_cnmultiscale_setcaps(GstCnmultiscale* self, ScaleOutput* output);
+static void
+gst_cnmultiscale_release_output_pool(ScaleOutput* output);
+
+/* GObject vmethod implementations */
+
+static void
+gst_cnmultiscale_class_init(GstCnmultiscaleClass* klass)
+{
+  GObjectClass* gobject_class;
+  GstElementClass* gstelement_class;
+
+  gobject_class = (GObjectClass*)klass;
+  gstelement_class = (GstElementClass*)klass;
+
+  gobject_class->set_property = gst_cnmultiscale_set_property;
+  gobject_class->get_property = gst_cnmultiscale_get_property;
+  gobject_class->finalize = gst_cnmultiscale_finalize;
+
+  gstelement_class->request_new_pad = GST_DEBUG_FUNCPTR(gst_cnmultiscale_request_new_pad);
+  gstelement_class->release_pad = GST_DEBUG_FUNCPTR(gst_cnmultiscale_release_pad);
+  gstelement_class->change_state = GST_DEBUG_FUNCPTR(gst_cnmultiscale_change_state);
+
+  g_object_class_install_property(gobject_class, PROP_DEVICE_ID,
+                                  g_param_spec_int("device-id", "device id",
+                                                   "device identification, -1 to use device of input frames", -1, 10,
+                                                   DEFAULT_DEVICE_ID,
+                                                   (GParamFlags)(G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS)));
+
+  gst_element_class_set_details_simple(gstelement_class, "cnmultiscale", "Generic/Convertor",
+                                       "Cambricon convertor of one input to many resolutions",
+                                       "Cambricon Solution SDK");
+
+  gst_element_class_add_pad_template(gstelement_class, gst_static_pad_template_get(&src_factory));
+  gst_element_class_add_pad_template(gstelement_class, gst_static_pad_template_get(&sink_factory));
+}
+
+static void
+gst_cnmultiscale_init(GstCnmultiscale* self)
+{
+  GstCnmultiscalePrivate* priv = gst_cnmultiscale_get_private(self);
+
+  self->sinkpad = gst_pad_new_from_static_template(&sink_factory, "sink");
+  gst_pad_set_event_function(self->sinkpad, GST_DEBUG_FUNCPTR(gst_cnmultiscale_sink_event));
+  gst_pad_set_query_function(self->sinkpad, GST_DEBUG_FUNCPTR(gst_cnmultiscale_sink_query));
+  gst_pad_set_chain_function(self->sinkpad, GST_DEBUG_FUNCPTR(gst_cnmultiscale_chain));
+  gst_element_add_pad(GST_ELEMENT(self), self->sinkpad);
+
+  priv->handle = nullptr;
+  priv->queue = nullptr;
+  priv->cncv_workspace = nullptr;
+  priv->device_id = DEFAULT_DEVICE_ID;
+  gst_video_info_init(&priv->sink_info);
+  priv->cpp = new GstCnmultiscalePrivateCpp;
+}
+
+static void
+gst_cnmultiscale_finalize(GObject* object)
+{
+  auto self = GST_CNMULTISCALE(object);
+  GstCnmultiscalePrivate* priv = gst_cnmultiscale_get_private(self);
+
+  for (auto& it : priv->cpp->outputs) {
+    gst_cnmultiscale_release_output_pool(it.second.get());
+  }
+  delete priv->cpp;
+  priv->cpp = nullptr;
+
+  if (priv->cncv_workspace) {
+    if (!cn_syncedmem_free(priv->cncv_workspace)) {
+      GST_ERROR_OBJECT(self, "Free mlu memory failed");
+    }
+    priv->cncv_workspace = nullptr;
+  }
+  if (priv->handle) {
+    CNCV_SAFECALL(cncvDestroy(priv->handle), );
+    priv->handle = nullptr;
+  }
+  if (priv->queue) {
+    CNRT_SAFECALL(cnrtDestroyQueue(priv->queue), );
+    priv->queue = nullptr;
+  }
+  G_OBJECT_CLASS(PARENT_CLASS)->finalize(object);
+}
+
+static void
+gst_cnmultiscale_set_property(GObject* object, guint prop_id, const GValue* value, GParamSpec* pspec)
+{
+  GstCnmultiscalePrivate* priv = gst_cnmultiscale_get_private(GST_CNMULTISCALE(object));
+  switch (prop_id) {
+    case PROP_DEVICE_ID:
+      priv->device_id = g_value_get_int(value);
+      break;
+    default:
+      G_OBJECT_WARN_INVALID_PROPERTY_ID(object, prop_id, pspec);
+      break;
+  }
+}
+
+static void
+gst_cnmultiscale_get_property(GObject* object, guint prop_id, GValue* value, GParamSpec* pspec)
+{
+  GstCnmultiscalePrivate* priv = gst_cnmultiscale_get_private(GST_CNMULTISCALE(object));
+  switch (prop_id) {
+    case PROP_DEVICE_ID:
+      g_value_set_int(value, priv->device_id);
+      break;
+    default:
+      G_OBJECT_WARN_INVALID_PROPERTY_ID(object, prop_id, pspec);
+      break;
+  }
+}
+
+static std::vector<std::shared_ptr<ScaleOutput>>
+get_outputs(GstCnmultiscale* self)
+{
+  GstCnmultiscalePrivateCpp* cpp = gst_cnmultiscale_get_private(self)->cpp;
+  std::vector<std::shared_ptr<ScaleOutput>> outputs;
+  std::lock_guard<std::mutex> lk(cpp->outputs_mtx);
+  for (auto& it : cpp->outputs) {
+    outputs.push_back(it.second);
+  }
+  return outputs;
+}
+
+static GstPad*
+gst_cnmultiscale_request_new_pad(GstElement* element, GstPadTemplate* templ, const gchar* name, const GstCaps* caps)
+{
+  GstCnmultiscale* self = GST_CNMULTISCALE(element);
+  GstCnmultiscalePrivateCpp* cpp = gst_cnmultiscale_get_private(self)->cpp;
+  auto output = std::make_shared<ScaleOutput>();
+
+  {
+    std::lock_guard<std::mutex> lk(cpp->outputs_mtx);
+    guint index;
+    if (name && sscanf(name, "src_%u", &index) == 1) {
+      if (cpp->outputs.count(index)) {
+        GST_WARNING_OBJECT(self, "pad %s exists", name);
+        return nullptr;
+      }
+    } else {
+      index = cpp->next_index;
+    }
+    cpp->next_index = MAX(cpp->next_index, index + 1);
+
+    output->index = index;
+    gst_video_info_init(&output->src_info);
+    gchar* src_name = g_strdup_printf("src_%u", index);
+    output->srcpad = gst_pad_new_from_template(templ, src_name);
+    g_free(src_name);
+    cpp->outputs[index] = output;
+  }
+
+  gst_pad_set_element_private(output->srcpad, GUINT_TO_POINTER(output->index));
+  gst_pad_set_active(output->srcpad, TRUE);
+  gst_element_add_pad(element, output->srcpad);
+  GST_DEBUG_OBJECT(self, "new output %u", output->index);
+  return output->srcpad;
+}
+
+static void
+gst_cnmultiscale_release_pad(GstElement* element, GstPad* pad)
+{
+  GstCnmultiscale* self = GST_CNMULTISCALE(element);
+  GstCnmultiscalePrivateCpp* cpp = gst_cnmultiscale_get_private(self)->cpp;
+  guint index = GPOINTER_TO_UINT(gst_pad_get_element_private(pad));
+  std::shared_ptr<ScaleOutput> output;
+  {
+    std::lock_guard<std::mutex> lk(cpp->outputs_mtx);
+    auto it = cpp->outputs.find(index);
+    if (it == cpp->outputs.end()) {
+      return;
+    }
+    output = it->second;
+    cpp->outputs.erase(it);
+  }
+
+  GST_DEBUG_OBJECT(self, "release output %u", output->index);
+  // chain holding the output keeps it alive, its pushes fail once pad is removed
+  gst_pad_set_active(output->srcpad, FALSE);
+  gst_element_remove_pad(element, output->srcpad);
+  gst_cnmultiscale_release_output_pool(output.get());
+}
+
+static void
+gst_cnmultiscale_set_pools_flushing(GstCnmultiscale* self, gboolean flushing)
+{
+  for (auto& output : get_outputs(self)) {
+    if (output->pool) {
+      gst_buffer_pool_set_flushing(output->pool, flushing);
+    }
+  }
+}
+
+static GstStateChangeReturn
+gst_cnmultiscale_change_state(GstElement* element, GstStateChange transition)
+{
+  GstCnmultiscale* self = GST_CNMULTISCALE(element);
+
+  if (transition == GST_STATE_CHANGE_READY_TO_PAUSED) {
+    gst_cnmultiscale_set_pools_flushing(self, FALSE);
+  } else if (transition == GST_STATE_CHANGE_PAUSED_TO_READY) {
+    // unblock chain waiting for output buffers
+    gst_cnmultiscale_set_pools_flushing(self, TRUE);
+  }
+
+  return GST_ELEMENT_CLASS(PARENT_CLASS)->change_state(element, transition);
+}
+
+static gboolean
+gst_cnmultiscale_sink_event(GstPad* pad, GstObject* parent, GstEvent* event)
+{
+  GstCnmultiscale* self = GST_CNMULTISCALE(parent);
+  GstCnmultiscalePrivate* priv = gst_cnmultiscale_get_private(self);
+  GST_LOG_OBJECT(pad, "received %s event: %" GST_PTR_FORMAT, GST_EVENT_TYPE_NAME(event), event);
+
+  switch (GST_EVENT_TYPE(event)) {
+    case GST_EVENT_CAPS: {
+      GstCaps* caps;
+      gst_event_parse_caps(event, &caps);
+      gboolean ret = gst_video_info_from_caps(&priv->sink_info, caps);
+      // each output negotiates its own caps, outputs requested later negotiate on their first frame
+      for (auto& output : get_outputs(self)) {
+        ret = ret && gst_cnmultiscale_setcaps(self, output.get());
+      }
+      if (!ret) {
+        GST_ERROR_OBJECT(pad, "set caps failed");
+      }
+      gst_event_unref(event);
+      return ret;
+    }
+    case GST_EVENT_FLUSH_START:
+    case GST_EVENT_FLUSH_STOP:
+      // unblock chain waiting for a free output buffer
+      gst_cnmultiscale_set_pools_flushing(self, GST_EVENT_TYPE(event) == GST_EVENT_FLUSH_START);
+      return gst_pad_event_default(pad, parent, event);
+    default:
+      return gst_pad_event_default(pad, parent, event);
+  }
+}
+
+static gboolean
+gst_cnmultiscale_sink_query(GstPad* pad, GstObject* parent, GstQuery* query)
+{
+  switch (GST_QUERY_TYPE(query)) {
+    case GST_QUERY_CAPS: {
+      // output caps are negotiated with downstream independently, any input in template is acceptable
+      GstCaps* filter;
+      gst_query_parse_caps(query, &filter);
+      GstCaps* caps = gst_pad_get_pad_template_caps(pad);
+      if (filter) {
+        GstCaps* intersection = gst_caps_intersect_full(filter, caps, GST_CAPS_INTERSECT_FIRST);
+        gst_caps_unref(caps);
+        caps = intersection;
+      }
+      gst_query_set_caps_result(query, caps);
+      gst_caps_unref(caps);
+      return TRUE;
+    }
+    case GST_QUERY_ALLOCATION:
+      gst_query_add_allocation_meta(query, GST_VIDEO_META_API_TYPE, NULL);
+      return TRUE;
+    default:
+      return gst_pad_query_default(pad, parent, query);
+  }
+}
+
+static void
+gst_cnmultiscale_release_output_pool(ScaleOutput* output)
+{
+  if (output->pool) {
+    // buffers still held by downstream are freed when they are released
+    gst_buffer_pool_set_active(output->pool, FALSE);
+    gst_object_unref(output->pool);
+    output->pool = nullptr;
+  }
+}
+
+// output pads requested after stream starts have missed sticky events of input
+static void
+forward_sticky_event(GstCnmultiscale* self, ScaleOutput* output, GstEventType type)
+{
+  GstEvent* event = gst_pad_get_sticky_event(output->srcpad, type, 0);
+  if (event) {
+    gst_event_unref(event);
+    return;
+  }
+  event = gst_pad_get_sticky_event(self->sinkpad, type, 0);
+  if (event) {
+    gst_pad_push_event(output->srcpad, event);
+  }
+}
+
+static gboolean
+gst_cnmultiscale_setcaps(GstCnmultiscale* self, ScaleOutput* output)
+{
+  GstCnmultiscalePrivate* priv = gst_cnmultiscale_get_private(self);
+
+  forward_sticky_event(self, output, GST_EVENT_STREAM_START);
+
+  GstCaps* filter_caps = gst_static_pad_template_get_caps(&src_factory);
+  GstCaps* src_peer_caps = gst_pad_peer_query_caps(output->srcpad, filter_caps);
+  gst_caps_unref(filter_caps);
+  if (gst_caps_is_any(src_peer_caps)) {
+    GST_ERROR_OBJECT(output->srcpad, "srcpad not linked");
+    gst_caps_unref(src_peer_caps);
+    return FALSE;
+  }
+  if (gst_caps_is_empty(src_peer_caps)) {
+    GST_ERROR_OBJECT(output->srcpad, "do not have intersection with downstream element");
+    gst_caps_unref(src_peer_caps);
+    return FALSE;
+  }
+
+  src_peer_caps = gst_caps_truncate(gst_caps_normalize(src_peer_caps));
+  gst_caps_set_simple(src_peer_caps, "framerate", GST_TYPE_FRACTION, priv->sink_info.fps_n, priv->sink_info.fps_d,
+                      NULL);
+
+  // if downstream have not specify resolution
+  auto caps_struct = gst_caps_get_structure(src_peer_caps, 0);
+  if (!gst_structure_has_field(caps_struct, "width") || !gst_structure_has_field(caps_struct, "height")) {
+    gst_caps_set_simple(src_peer_caps, "width", G_TYPE_INT, priv->sink_info.width, "height", G_TYPE_INT,
+                        priv->sink_info.height, NULL);
+  } else if (!gst_caps_is_fixed(src_peer_caps)) {
+    if (!gst_structure_fixate_field_nearest_int(caps_struct, "width", priv->sink_info.width) ||
+        !gst_structure_fixate_field_nearest_int(caps_struct, "height", priv->sink_info.height)) {
+      GST_ERROR_OBJECT(output->srcpad, "can not fixate src caps");
+      gst_caps_unref(src_peer_caps);
+      return FALSE;
+    }
+  }
+
+  if (!gst_video_info_from_caps(&output->src_info, src_peer_caps) ||
+      !gst_pad_set_caps(output->srcpad, src_peer_caps)) {
+    GST_ERROR_OBJECT(output->srcpad, "set caps %" GST_PTR_FORMAT " failed", src_peer_caps);
+    gst_caps_unref(src_peer_caps);
+    return FALSE;
+  }
+  GST_INFO_OBJECT(output->srcpad, "setcaps %" GST_PTR_FORMAT, src_peer_caps);
+
+  // outputs of the pad, laid out as src caps
+  gst_cnmultiscale_release_output_pool(output);
+  GstBufferPool* pool = gst_mlu_buffer_pool_new();
+  GstStructure* config = gst_buffer_pool_get_config(pool);
+  gst_buffer_pool_config_set_params(config, src_peer_caps, output->src_info.size, DEFAULT_MIN_BUFFERS,
+                                    DEFAULT_MAX_BUFFERS);
+  gst_caps_unref(src_peer_caps);
+  if (!gst_buffer_pool_set_config(pool, config) || !gst_buffer_pool_set_active(pool, TRUE)) {
+    GST_CNMULTISCALE_ERROR(self, RESOURCE, SETTINGS, ("config output buffer pool failed"));
+    gst_object_unref(pool);
+    return FALSE;
+  }
+  output->pool = pool;
+
+  forward_sticky_event(self, output, GST_EVENT_SEGMENT);
+  return TRUE;
+}
+
+/**
+ * Source is read once by one launch writing all of outputs, each of them has its own size and pixel format.
+ */
+static gboolean
+scale(GstCnmultiscale* self, GstMluFrame_t frame, const std::vector<std::shared_ptr<ScaleOutput>>& outputs,
+      const std::vector<GstBuffer*>& outbufs)
+{
+  GstCnmultiscalePrivate* priv = gst_cnmultiscale_get_private(self);
+  guint n = outputs.size();
+
+  thread_local bool cnrt_env = false;
+  if (!cnrt_env) {
+    if (priv->device_id == -1) {
+      priv->device_id = frame->device_id;
+    }
+    if (!set_cnrt_env(GST_ELEMENT(self), priv->device_id)) {
+      return FALSE;
+    }
+    cnrt_env = true;
+  }
+  if (!priv->handle) {
+    CNRT_SAFECALL(cnrtCreateQueue(&priv->queue), FALSE);
+    CNCV_SAFECALL(cncvCreate(&priv->handle), FALSE);
+    CNCV_SAFECALL(cncvSetQueue(priv->handle, priv->queue), FALSE);
+  }
+
+  cncvImageDescriptor src_desc = video_info_to_desc(priv->sink_info);
+  // decoded frames may be aligned beyond caps
+  src_desc.stride[0] = frame->stride[0];
+  src_desc.stride[1] = frame->stride[1];
+  cncvRect src_roi;
+  src_roi.x = src_roi.y = 0;
+  src_roi.w = src_desc.width;
+  src_roi.h = src_desc.height;
+  std::vector<cncvImageDescriptor> src_descs(n, src_desc), dst_descs(n);
+  std::vector<cncvRect> src_rois(n, src_roi), dst_rois(n);
+  for (guint i = 0; i < n; ++i) {
+    dst_descs[i] = video_info_to_desc(outputs[i]->src_info);
+    dst_rois[i].x = dst_rois[i].y = 0;
+    dst_rois[i].w = dst_descs[i].width;
+    dst_rois[i].h = dst_descs[i].height;
+  }
+
+  size_t workspace_size;
+  // y and uv planes of sources, then destinations
+  size_t extra_size = 3 * n * sizeof(void*);
+  CNCV_SAFECALL(cncvGetResizeConvertWorkspaceSize(n, src_descs.data(), src_rois.data(), dst_descs.data(),
+                                                  dst_rois.data(), &workspace_size),
+                FALSE);
+
+  // prepare mlu memory
+  if (priv->cncv_workspace && cn_syncedmem_get_size(priv->cncv_workspace) < (workspace_size + extra_size)) {
+    cn_syncedmem_free(priv->cncv_workspace);
+    priv->cncv_workspace = nullptr;
+  }
+  if (!priv->cncv_workspace) {
+    priv->cncv_workspace = cn_syncedmem_new(workspace_size + extra_size);
+  }
+
+  void* y = cn_syncedmem_get_mutable_dev_data(frame->data[0]);
+  void* uv = cn_syncedmem_get_mutable_dev_data(frame->data[1]);
+  void** buf_host = reinterpret_cast<void**>(cn_syncedmem_get_mutable_host_data(priv->cncv_workspace));
+  for (guint i = 0; i < n; ++i) {
+    GstMluFrame_t out_frame = gst_buffer_get_mlu_memory_meta(outbufs[i])->frame;
+    buf_host[2 * i] = y;
+    buf_host[2 * i + 1] = uv;
+    buf_host[2 * n + i] = cn_syncedmem_get_mutable_dev_data(out_frame->data[0]);
+    out_frame->device_id = priv->device_id;
+    out_frame->channel_id = frame->channel_id;
+  }
+  buf_host = nullptr;
+  void** buf_dev = reinterpret_cast<void**>(const_cast<void*>(cn_syncedmem_get_dev_data(priv->cncv_workspace)));
+  void** src_ptr = buf_dev;
+  void** dst_ptr = buf_dev + 2 * n;
+  void* workspace = buf_dev + 3 * n;
+
+  CNCV_SAFECALL(cncvResizeConvert_V2(priv->handle, n,
+                                     src_descs.data(), src_rois.data(), src_ptr,
+                                     dst_descs.data(), dst_rois.data(), dst_ptr,
+                                     workspace_size, workspace, CNCV_INTER_BILINEAR), FALSE);
+
+  CNRT_SAFECALL(cnrtSyncQueue(priv->queue), FALSE);
+
+  GST_LOG_OBJECT(self, "scaled frame to %u outputs", n);
+  return TRUE;
+}
+
+static GstFlowReturn
+gst_cnmultiscale_chain(GstPad* pad, GstObject* parent, GstBuffer* buffer)
+{
+  GstCnmultiscale* self = GST_CNMULTISCALE(parent);
+
+  MluMemoryMeta_t meta = gst_buffer_get_mlu_memory_meta(buffer);
+  if (!meta || !meta->frame) {
+    GST_CNMULTISCALE_ERROR(self, RESOURCE, READ, ("get meta failed"));
+    gst_buffer_unref(buffer);
+    return GST_FLOW_ERROR;
+  }
+
+  std::vector<std::shared_ptr<ScaleOutput>> outputs;
+  for (auto& output : get_outputs(self)) {
+    if (!gst_pad_is_linked(output->srcpad)) {
+      continue;
+    }
+    if (!output->pool && !gst_cnmultiscale_setcaps(self, output.get())) {
+      gst_buffer_unref(buffer);
+      return GST_FLOW_NOT_NEGOTIATED;
+    }
+    outputs.push_back(output);
+  }
+  if (outputs.empty()) {
+    gst_buffer_unref(buffer);
+    return GST_FLOW_NOT_LINKED;
+  }
+
+  std::vector<GstBuffer*> outbufs;
+  auto release_outputs = [&outbufs]() {
+    for (auto outbuf : outbufs) {
+      gst_buffer_unref(outbuf);
+    }
+  };
+  for (auto& output : outputs) {
+    GstBuffer* outbuf = nullptr;
+    GstFlowReturn flow = gst_buffer_pool_acquire_buffer(output->pool, &outbuf, NULL);
+    if (flow != GST_FLOW_OK) {
+      GST_DEBUG_OBJECT(output->srcpad, "acquire output buffer failed, %s", gst_flow_get_name(flow));
+      release_outputs();
+      gst_buffer_unref(buffer);
+      return flow;
+    }
+    outbufs.push_back(outbuf);
+  }
+
+  // input may be produced asynchronously on another queue
+  gboolean ok = FALSE;
+  try {
+    ok = gst_mlu_frame_sync(meta->frame) && scale(self, meta->frame, outputs, outbufs);
+  } catch (edk::Exception& e) {
+    GST_CNMULTISCALE_ERROR(self, RESOURCE, FAILED, ("%s", e.what()));
+  }
+  if (!ok) {
+    release_outputs();
+    gst_buffer_unref(buffer);
+    return GST_FLOW_ERROR;
+  }
+
+  // not linked only if none of outputs is linked, other failures stop the stream
+  GstFlowReturn ret = GST_FLOW_NOT_LINKED;
+  for (guint i = 0; i < outputs.size(); ++i) {
+    gst_buffer_copy_into(outbufs[i], buffer, (GstBufferCopyFlags)(GST_BUFFER_COPY_FLAGS | GST_BUFFER_COPY_TIMESTAMPS),
+                         0, -1);
+    GstFlowReturn flow = gst_pad_push(outputs[i]->srcpad, outbufs[i]);
+    if (flow == GST_FLOW_OK && ret == GST_FLOW_NOT_LINKED) {
+      ret = GST_FLOW_OK;
+    } else if (flow != GST_FLOW_OK && flow != GST_FLOW_NOT_LINKED && ret >= GST_FLOW_NOT_LINKED) {
+      ret = flow;
+    }
+  }
+  gst_buffer_unref(buffer);
+  return ret;
+}
@@ -0,0 +1,62 @@
+/*
+ *  Copyright (C) [2019-2020] by Cambricon, Inc.
+ *
+ *  This file is part of CNStream-Gst.
+ *
+ *  CNStream-Gst is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU Lesser General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  CNStream-Gst is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU Lesser General Public License for more details.
+ *
+ *  You should have received a copy of the GNU Lesser General Public License
+ *  along with CNStream-Gst.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#ifndef GST_CNMULTISCALE_H_
+#define GST_CNMULTISCALE_H_
+
+#include <gst/gst.h>
+
+#define GST_TYPE_CNMULTISCALE (gst_cnmultiscale_get_type())
+#define GST_CNMULTISCALE(obj) (G_TYPE_CHECK_INSTANCE_CAST((obj), GST_TYPE_CNMULTISCALE, GstCnmultiscale))
+#define GST_CNMULTISCALE_CLASS(klass)                                                                                  \
+  (G_TYPE_CHECK_CLASS_CAST((klass), GST_TYPE_CNMULTISCALE, GstCnmultiscaleClass))
+#define GST_IS_CNMULTISCALE(obj) (G_TYPE_CHECK_INSTANCE_TYPE((obj), GST_TYPE_CNMULTISCALE))
+#define GST_IS_CNMULTISCALE_CLASS(klass) (G_TYPE_CHECK_CLASS_TYPE((klass), GST_TYPE_CNMULTISCALE))
+#define GST_CNMULTISCALE_GET_CLASS(obj)                                                                                \
+  (G_TYPE_INSTANCE_GET_CLASS((obj), GST_TYPE_CNMULTISCALE, GstCnmultiscaleClass))
+
+G_BEGIN_DECLS
+
+typedef struct _GstCnmultiscale GstCnmultiscale;
+typedef struct _GstCnmultiscaleClass GstCnmultiscaleClass;
+
+/**
+ * Resizes and converts one input to many outputs with one kernel launch.
+ *
+ * Each request pad src_%u negotiates its own caps with downstream, e.g. a ladder of resolutions. An input frame is
+ * read once by a kernel writing all of the outputs, which are pushed on their pads after one queue sync.
+ */
+struct _GstCnmultiscale
+{
+  GstElement element;
+
+  GstPad* sinkpad;
+};
+
+struct _GstCnmultiscaleClass
+{
+  GstElementClass parent_class;
+};
+
+GType
+gst_cnmultiscale_get_type(void);
+
+G_END_DECLS
+
+#endif // GST_CNMULTISCALE_H_
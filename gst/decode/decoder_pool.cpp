@@ -0,0 +1,233 @@
+/*
+ *  Copyright (C) [2019-2020] by Cambricon, Inc.
+ *
+ *  This file is part of CNStream-Gst.
+ *
+ *  CNStream-Gst is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU Lesser General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  CNStream-Gst is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU Lesser General Public License for more details.
+ *
+ *  You should have received a copy of the GNU Lesser General Public License
+ *  along with CNStream-Gst.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#include "decoder_pool.h"
+
+#include <cstring>
+#include <vector>
+
+#include "device/mlu_context.h"
+
+GST_DEBUG_CATEGORY_STATIC(decoder_pool_debug);
+#define GST_CAT_DEFAULT decoder_pool_debug
+
+// idle and pending decoders of all settings
+static constexpr guint MAX_POOLED_DECODERS = 32;
+static constexpr std::chrono::seconds IDLE_TIMEOUT{ 60 };
+
+// settings a decoder is created with, resolution is the maximum it takes. Instance is taken from the decoder by the
+// element checking it out, output buffers are set again when the decoder is started
+static bool
+compatible(const cnvideoDecCreateInfo& created, const cnvideoDecCreateInfo& wanted)
+{
+  return created.deviceId == wanted.deviceId && created.codec == wanted.codec && created.pixelFmt == wanted.pixelFmt &&
+         created.colorSpace == wanted.colorSpace && created.bitDepthMinus8 == wanted.bitDepthMinus8 &&
+         created.progressive == wanted.progressive && created.inputBufNum == wanted.inputBufNum &&
+         created.allocType == wanted.allocType && created.width >= wanted.width && created.height >= wanted.height;
+}
+
+// worker thread creates and destroys decoders on the device they belong to
+static bool
+bind_device(gint device_id, gint* bound_id)
+{
+  if (*bound_id == device_id) {
+    return true;
+  }
+  try {
+    edk::MluContext context;
+    context.SetDeviceId(device_id);
+    context.BindDevice();
+  } catch (edk::Exception& err) {
+    GST_WARNING("bind device %d failed, %s", device_id, err.what());
+    return false;
+  }
+  *bound_id = device_id;
+  return true;
+}
+
+static i32_t
+slot_event_handler(cncodecCbEventType type, void* user_data, void* package)
+{
+  auto slot = reinterpret_cast<DecoderSlot*>(user_data);
+  DecoderEventHandler handler = slot->handler.load();
+  // no stream is fed to idle decoders
+  if (!handler) {
+    GST_WARNING("event %d of idle decoder %p", type, slot->decode);
+    return 0;
+  }
+  return handler(type, slot->user_data.load(), package);
+}
+
+DecoderPool*
+DecoderPool::get()
+{
+  // lives until process exits, together with its worker
+  static DecoderPool* pool = [] {
+    GST_DEBUG_CATEGORY_INIT(decoder_pool_debug, "decoder_pool", 0, "pool of cnvideo_dec decoders");
+    return new DecoderPool;
+  }();
+  return pool;
+}
+
+guint
+DecoderPool::count(const cnvideoDecCreateInfo& params)
+{
+  guint n = 0;
+  for (auto slot : idle_) {
+    n += compatible(slot->params, params);
+  }
+  for (const auto& pending : pending_) {
+    n += compatible(pending, params);
+  }
+  if (creating_) {
+    n += compatible(*creating_, params);
+  }
+  return n;
+}
+
+DecoderSlot*
+DecoderPool::checkout(const cnvideoDecCreateInfo& params, DecoderEventHandler handler, void* user_data)
+{
+  std::lock_guard<std::mutex> lk(mutex_);
+  for (auto it = idle_.begin(); it != idle_.end(); ++it) {
+    if (compatible((*it)->params, params)) {
+      DecoderSlot* slot = *it;
+      idle_.erase(it);
+      slot->user_data = user_data;
+      slot->handler = handler;
+      GST_DEBUG("check out decoder %p, %zu idle", slot->decode, idle_.size());
+      return slot;
+    }
+  }
+  return nullptr;
+}
+
+void
+DecoderPool::reserve(const cnvideoDecCreateInfo& params, guint n_idle)
+{
+  std::lock_guard<std::mutex> lk(mutex_);
+  gsize n_pooled = idle_.size() + pending_.size() + (creating_ ? 1 : 0);
+  for (guint n = count(params); n < n_idle && n_pooled < MAX_POOLED_DECODERS; ++n, ++n_pooled) {
+    pending_.push_back(params);
+  }
+  if (!pending_.empty() && !worker_.joinable()) {
+    worker_ = std::thread(&DecoderPool::loop, this);
+  }
+  cond_.notify_one();
+}
+
+void
+DecoderPool::release(DecoderSlot* slot)
+{
+  delete slot;
+}
+
+void
+DecoderPool::attach()
+{
+  std::lock_guard<std::mutex> lk(mutex_);
+  n_users_++;
+}
+
+void
+DecoderPool::detach()
+{
+  std::lock_guard<std::mutex> lk(mutex_);
+  if (n_users_ > 0 && --n_users_ == 0) {
+    pending_.clear();
+    cond_.notify_one();
+  }
+}
+
+guint
+DecoderPool::n_idle()
+{
+  std::lock_guard<std::mutex> lk(mutex_);
+  return idle_.size();
+}
+
+void
+DecoderPool::loop()
+{
+  gint device_id = -1;
+  std::unique_lock<std::mutex> lk(mutex_);
+  while (true) {
+    // idle decoders timed out, or all of them once no element uses pool, are destroyed first
+    auto now = std::chrono::steady_clock::now();
+    std::vector<DecoderSlot*> expired;
+    while (!idle_.empty() && (n_users_ == 0 || now - idle_.front()->idle_since >= IDLE_TIMEOUT)) {
+      expired.push_back(idle_.front());
+      idle_.pop_front();
+    }
+    if (!expired.empty()) {
+      lk.unlock();
+      for (auto slot : expired) {
+        GST_DEBUG("destroy idle decoder %p", slot->decode);
+        if (bind_device(slot->params.deviceId, &device_id) && cnvideoDecDestroy(slot->decode) != CNCODEC_SUCCESS) {
+          GST_WARNING("destroy idle decoder %p failed", slot->decode);
+        }
+        delete slot;
+      }
+      lk.lock();
+      continue;
+    }
+    if (pending_.empty()) {
+      // idle decoders are in the order they are created, the first one times out first
+      if (idle_.empty()) {
+        cond_.wait(lk);
+      } else {
+        cond_.wait_until(lk, idle_.front()->idle_since + IDLE_TIMEOUT);
+      }
+      continue;
+    }
+    cnvideoDecCreateInfo params = pending_.front();
+    pending_.pop_front();
+    creating_ = &params;
+    lk.unlock();
+
+    auto slot = new DecoderSlot;
+    slot->params = params;
+    slot->params.userContext = slot;
+    bool created = false;
+    if (bind_device(params.deviceId, &device_id)) {
+      auto ret = cnvideoDecCreate(&slot->decode, &slot_event_handler, &slot->params);
+      if (ret == CNCODEC_SUCCESS) {
+        int stride_align = 1;
+        cnvideoDecSetAttributes(slot->decode, CNVIDEO_DEC_ATTR_OUT_BUF_ALIGNMENT, &stride_align);
+        created = true;
+      } else {
+        GST_WARNING("create decoder for pool failed, error code: %d", ret);
+      }
+    }
+
+    lk.lock();
+    creating_ = nullptr;
+    if (created) {
+      slot->idle_since = std::chrono::steady_clock::now();
+      idle_.push_back(slot);
+      GST_DEBUG("created decoder %p, %zu idle", slot->decode, idle_.size());
+    } else {
+      delete slot;
+      // settings that failed are not retried until reserved again
+      for (auto it = pending_.begin(); it != pending_.end();) {
+        it = compatible(*it, params) ? pending_.erase(it) : it + 1;
+      }
+    }
+  }
+}
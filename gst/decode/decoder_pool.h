@@ -0,0 +1,86 @@
+/*
+ *  Copyright (C) [2019-2020] by Cambricon, Inc.
+ *
+ *  This file is part of CNStream-Gst.
+ *
+ *  CNStream-Gst is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU Lesser General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  CNStream-Gst is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU Lesser General Public License for more details.
+ *
+ *  You should have received a copy of the GNU Lesser General Public License
+ *  along with CNStream-Gst.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#ifndef GST_DECODE_DECODER_POOL_H_
+#define GST_DECODE_DECODER_POOL_H_
+
+#include <gst/gst.h>
+
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <deque>
+#include <mutex>
+#include <thread>
+
+#include "cn_codec_common.h"
+#include "cn_video_dec.h"
+
+typedef i32_t (*DecoderEventHandler)(cncodecCbEventType type, void* user_data, void* package);
+
+// decoder created by pool, events are forwarded to the element holding it
+struct DecoderSlot
+{
+  cnvideoDecoder decode = nullptr;
+  cnvideoDecCreateInfo params;
+  std::atomic<DecoderEventHandler> handler{ nullptr };
+  std::atomic<void*> user_data{ nullptr };
+  // when it was put into pool, idle decoders are destroyed after a timeout
+  std::chrono::steady_clock::time_point idle_since;
+};
+
+/**
+ * Process-wide pool of decoders created ahead of time, so that a restarting stream checks out a decoder instead of
+ * waiting for one to be created. Decoders are created in a background thread and handed out to streams with the same
+ * settings and no larger resolution. Decoders of the pool are bounded in number, destroyed after staying idle for a
+ * while, and all destroyed once no element uses the pool.
+ */
+class DecoderPool
+{
+public:
+  static DecoderPool* get();
+
+  // takes an idle decoder compatible with params and binds its events to handler, nullptr if there is none
+  DecoderSlot* checkout(const cnvideoDecCreateInfo& params, DecoderEventHandler handler, void* user_data);
+  // keeps n_idle decoders created with params ready, missing ones are created in background
+  void reserve(const cnvideoDecCreateInfo& params, guint n_idle);
+  // frees slot after its decoder is destroyed by the element holding it
+  void release(DecoderSlot* slot);
+  // elements using the pool, idle decoders are destroyed when the last one detaches
+  void attach();
+  void detach();
+  guint n_idle();
+
+private:
+  DecoderPool() = default;
+  void loop();
+  guint count(const cnvideoDecCreateInfo& params);
+
+  std::mutex mutex_;
+  std::condition_variable cond_;
+  std::deque<DecoderSlot*> idle_;
+  // settings of decoders waiting to be created
+  std::deque<cnvideoDecCreateInfo> pending_;
+  // settings of decoder being created by worker, nullptr if there is none
+  const cnvideoDecCreateInfo* creating_ = nullptr;
+  guint n_users_ = 0;
+  std::thread worker_;
+};
+
+#endif // GST_DECODE_DECODER_POOL_H_
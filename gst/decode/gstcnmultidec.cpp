@@ -0,0 +1,1133 @@
+/*
+ *  Copyright (C) [2019-2020] by Cambricon, Inc.
+ *
+ *  This file is part of CNStream-Gst.
+ *
+ *  CNStream-Gst is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU Lesser General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  CNStream-Gst is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU Lesser General Public License for more details.
+ *
+ *  You should have received a copy of the GNU Lesser General Public License
+ *  along with CNStream-Gst.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#include "gstcnmultidec.h"
+
+#include <gst/gst.h>
+#include <gst/video/video.h>
+#include <condition_variable>
+#include <cstdio>
+#include <cstring>
+#include <deque>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+#include "cn_codec_common.h"
+#include "cn_video_dec.h"
+#include "common/frame_deallocator.h"
+#include "common/gst_mlu_download.h"
+#include "common/mlu_memory_meta.h"
+#include "common/utils.h"
+
+GST_DEBUG_CATEGORY_EXTERN(gst_cambricon_debug);
+#define GST_CAT_DEFAULT gst_cambricon_debug
+
+#define GST_CNMULTIDEC_ERROR(el, domain, code, msg) GST_ELEMENT_ERROR(el, domain, code, msg, ("None"))
+
+// cncodec add version macro since v1.6.0
+#ifndef CNCODEC_VERSION
+#define CNCODEC_VERSION 0
+#endif
+
+enum
+{
+  PROP_0,
+  PROP_DEVICE_ID,
+  PROP_INPUT_BUFFER_NUM,
+  PROP_OUTPUT_BUFFER_NUM,
+  PROP_OUTPUT_QUEUE_SIZE,
+  PROP_EVENT_THREADS,
+  PROP_OUTPUT_THREADS,
+};
+
+static constexpr gint DEFAULT_DEVICE_ID = 0;
+static constexpr guint DEFAULT_INPUT_BUFFER_NUM = 4;
+static constexpr guint DEFAULT_OUTPUT_BUFFER_NUM = 4;
+static constexpr guint DEFAULT_OUTPUT_QUEUE_SIZE = 4;
+static constexpr guint DEFAULT_EVENT_THREADS = 1;
+static constexpr guint DEFAULT_OUTPUT_THREADS = 2;
+
+/* the capabilities of the inputs and outputs. */
+static GstStaticPadTemplate sink_factory =
+  GST_STATIC_PAD_TEMPLATE("sink_%u",
+                          GST_PAD_SINK,
+                          GST_PAD_REQUEST,
+                          GST_STATIC_CAPS("video/x-h264, stream-format=byte-stream, alignment=au;"
+                                          "video/x-h265, stream-format=byte-stream;"));
+
+static GstStaticPadTemplate src_factory =
+  GST_STATIC_PAD_TEMPLATE("src_%u",
+                          GST_PAD_SRC,
+                          GST_PAD_SOMETIMES,
+                          GST_STATIC_CAPS("video/x-raw(memory:mlu), format={NV12, NV21, I420};"
+                                          "video/x-raw, format={NV12, NV21, I420};"));
+
+// decoded frame waiting for an output thread to wrap or download it, or EOS after the last frame
+struct StreamOutput
+{
+  // referenced in callback of decoder, released when the frame is dropped or its buffer is freed
+  cncodecFrame* frame;
+  u64_t pts;
+  bool eos;
+};
+
+// a sink_%u and src_%u pair with its decoder
+struct DecodeStream
+{
+  GstCnmultidec* element;
+  guint index;
+  GstPad* sinkpad;
+  GstPad* srcpad;
+  cnvideoDecoder decode = nullptr;
+  cnvideoDecCreateInfo params;
+  GstVideoInfo sink_info;
+  GstVideoInfo src_info;
+  bool output_on_cpu = false;
+  // downstream handles strided host frames described by GstVideoMeta
+  bool downstream_video_meta = false;
+  GstClockTime duration = GST_CLOCK_TIME_NONE;
+
+  // guarded by mutex of element
+  std::deque<StreamOutput> outputs;
+  // in ready list, or being wrapped by an output thread
+  bool scheduled = false;
+  // buffers made by output threads for the task of src pad, nullptr stands for EOS
+  std::deque<GstBuffer*> pending;
+  std::condition_variable pending_cond;
+  // task of src pad is pushing a buffer or EOS taken from pending
+  bool pushing = false;
+  // frames are released instead of queued
+  bool flushing = false;
+  bool send_eos = false;
+  bool got_eos = false;
+  // decoder is destroyed to be created again, its EOS is not pushed downstream
+  bool restarting = false;
+};
+
+// event of a decoder other than new frame and sequence, which are handled in callback
+struct StreamEvent
+{
+  DecodeStream* stream;
+  cncodecCbEventType type;
+};
+
+struct GstCnmultidecPrivateCpp
+{
+  std::mutex streams_mtx;
+  std::map<guint, std::shared_ptr<DecodeStream>> streams;
+  guint next_index = 0;
+
+  std::mutex mtx;
+  // streams having frames to wrap, each taken by one output thread at a time to keep order
+  std::deque<DecodeStream*> ready;
+  std::condition_variable ready_cond;
+  // room in output queues, streams left by output threads, pushes done and EOS of decoders
+  std::condition_variable stream_cond;
+  std::deque<StreamEvent> events;
+  std::condition_variable event_cond;
+  bool running = false;
+  std::vector<std::thread> event_threads;
+  std::vector<std::thread> output_threads;
+};
+
+struct GstCnmultidecPrivate
+{
+  gint device_id;
+  guint input_buffer_num;
+  guint output_buffer_num;
+  guint output_queue_size;
+  guint n_event_threads;
+  guint n_output_threads;
+
+  GstCnmultidecPrivateCpp* cpp;
+};
+
+G_DEFINE_TYPE_WITH_PRIVATE(GstCnmultidec, gst_cnmultidec, GST_TYPE_ELEMENT);
+// gst_cnmultidec_parent_class is defined in G_DEFINE_TYPE macro
+#define PARENT_CLASS gst_cnmultidec_parent_class
+
+static inline GstCnmultidecPrivate*
+gst_cnmultidec_get_private(GstCnmultidec* object)
+{
+  return reinterpret_cast<GstCnmultidecPrivate*>(gst_cnmultidec_get_instance_private(object));
+}
+
+struct StreamFrameDeallocator : public FrameDeallocator
+{
+  StreamFrameDeallocator(cnvideoDecoder decode, cncodecFrame* frame)
+    : decode_(decode)
+    , frame_(frame)
+  {}
+  void deallocate() override { cnvideoDecReleaseReference(decode_, frame_); }
+
+private:
+  StreamFrameDeallocator(const StreamFrameDeallocator&) = delete;
+  const StreamFrameDeallocator& operator=(const StreamFrameDeallocator&) = delete;
+  cnvideoDecoder decode_;
+  cncodecFrame* frame_;
+};
+
+// GObject vmethod
+static void
+gst_cnmultidec_set_property(GObject* object, guint prop_id, const GValue* value, GParamSpec* pspec);
+static void
+gst_cnmultidec_get_property(GObject* object, guint prop_id, GValue* value, GParamSpec* pspec);
+static void
+gst_cnmultidec_finalize(GObject* gobject);
+static GstPad*
+gst_cnmultidec_request_new_pad(GstElement* element, GstPadTemplate* templ, const gchar* name, const GstCaps* caps);
+static void
+gst_cnmultidec_release_pad(GstElement* element, GstPad* pad);
+static GstStateChangeReturn
+gst_cnmultidec_change_state(GstElement* element, GstStateChange transition);
+static gboolean
+gst_cnmultidec_sink_event(GstPad* pad, GstObject* parent, GstEvent* event);
+static GstFlowReturn
+gst_cnmultidec_chain(GstPad* pad, GstObject* parent, GstBuffer* buffer);
+static GstIterator*
+gst_cnmultidec_iterate_internal_links(GstPad* pad, GstObject* parent);
+static gboolean
+gst_cnmultidec_src_activate_mode(GstPad* pad, GstObject* parent, GstPadMode mode, gboolean active);
+
+// GstCnmultidec private method
+static i32_t
+stream_event_handler(cncodecCbEventType type, void* user_data, void* package);
+static gboolean
+destroy_stream_decoder(GstCnmultidec* self, DecodeStream* stream);
+static void
+set_stream_flushing(GstCnmultidec* self, DecodeStream* stream, bool flushing);
+static void
+push_loop(DecodeStream* stream);
+
+/* GObject vmethod implementations */
+
+static void
+gst_cnmultidec_class_init(GstCnmultidecClass* klass)
+{
+  GObjectClass* gobject_class;
+  GstElementClass* gstelement_class;
+
+  gobject_class = (GObjectClass*)klass;
+  gstelement_class = (GstElementClass*)klass;
+
+  gobject_class->set_property = gst_cnmultidec_set_property;
+  gobject_class->get_property = gst_cnmultidec_get_property;
+  gobject_class->finalize = gst_cnmultidec_finalize;
+
+  gstelement_class->request_new_pad = GST_DEBUG_FUNCPTR(gst_cnmultidec_request_new_pad);
+  gstelement_class->release_pad = GST_DEBUG_FUNCPTR(gst_cnmultidec_release_pad);
+  gstelement_class->change_state = GST_DEBUG_FUNCPTR(gst_cnmultidec_change_state);
+
+  g_object_class_install_property(gobject_class, PROP_DEVICE_ID,
+                                  g_param_spec_int("device-id", "device id", "device identification", -1, 10,
+                                                   DEFAULT_DEVICE_ID,
+                                                   (GParamFlags)(G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS)));
+  g_object_class_install_property(gobject_class, PROP_INPUT_BUFFER_NUM,
+                                  g_param_spec_uint("input-buffer-num", "input buffer num",
+                                                    "input buffer number of each decoder", 1, 20,
+                                                    DEFAULT_INPUT_BUFFER_NUM,
+                                                    (GParamFlags)(G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS)));
+  g_object_class_install_property(gobject_class, PROP_OUTPUT_BUFFER_NUM,
+                                  g_param_spec_uint("output-buffer-num", "output buffer num",
+                                                    "output buffer number of each decoder", 1, 20,
+                                                    DEFAULT_OUTPUT_BUFFER_NUM,
+                                                    (GParamFlags)(G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS)));
+  g_object_class_install_property(gobject_class, PROP_OUTPUT_QUEUE_SIZE,
+                                  g_param_spec_uint("output-queue-size", "output queue size",
+                                                    "number of decoded frames queued for output per stream, "
+                                                    "decoder of the stream waits when its queue is full",
+                                                    1, 64, DEFAULT_OUTPUT_QUEUE_SIZE,
+                                                    (GParamFlags)(G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS)));
+  g_object_class_install_property(gobject_class, PROP_EVENT_THREADS,
+                                  g_param_spec_uint("event-threads", "event threads",
+                                                    "threads handling EOS and error events of all decoders", 1, 16,
+                                                    DEFAULT_EVENT_THREADS,
+                                                    (GParamFlags)(G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS)));
+  g_object_class_install_property(gobject_class, PROP_OUTPUT_THREADS,
+                                  g_param_spec_uint("output-threads", "output threads",
+                                                    "threads wrapping or downloading decoded frames of all streams, "
+                                                    "each src pad pushes them from a task of its own",
+                                                    1, 64, DEFAULT_OUTPUT_THREADS,
+                                                    (GParamFlags)(G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS)));
+
+  gst_element_class_set_details_simple(gstelement_class, "cnmultidec", "Generic/Decoder",
+                                       "Cambricon video decoder of many streams", "Cambricon Solution SDK");
+
+  gst_element_class_add_pad_template(gstelement_class, gst_static_pad_template_get(&src_factory));
+  gst_element_class_add_pad_template(gstelement_class, gst_static_pad_template_get(&sink_factory));
+}
+
+static void
+gst_cnmultidec_init(GstCnmultidec* self)
+{
+  GstCnmultidecPrivate* priv = gst_cnmultidec_get_private(self);
+  priv->device_id = DEFAULT_DEVICE_ID;
+  priv->input_buffer_num = DEFAULT_INPUT_BUFFER_NUM;
+  priv->output_buffer_num = DEFAULT_OUTPUT_BUFFER_NUM;
+  priv->output_queue_size = DEFAULT_OUTPUT_QUEUE_SIZE;
+  priv->n_event_threads = DEFAULT_EVENT_THREADS;
+  priv->n_output_threads = DEFAULT_OUTPUT_THREADS;
+  priv->cpp = new GstCnmultidecPrivateCpp;
+}
+
+static void
+gst_cnmultidec_finalize(GObject* object)
+{
+  GstCnmultidecPrivate* priv = gst_cnmultidec_get_private(GST_CNMULTIDEC(object));
+  delete priv->cpp;
+  priv->cpp = nullptr;
+  G_OBJECT_CLASS(PARENT_CLASS)->finalize(object);
+}
+
+static void
+gst_cnmultidec_set_property(GObject* object, guint prop_id, const GValue* value, GParamSpec* pspec)
+{
+  GstCnmultidecPrivate* priv = gst_cnmultidec_get_private(GST_CNMULTIDEC(object));
+  switch (prop_id) {
+    case PROP_DEVICE_ID:
+      priv->device_id = g_value_get_int(value);
+      break;
+    case PROP_INPUT_BUFFER_NUM:
+      priv->input_buffer_num = g_value_get_uint(value);
+      break;
+    case PROP_OUTPUT_BUFFER_NUM:
+      priv->output_buffer_num = g_value_get_uint(value);
+      break;
+    case PROP_OUTPUT_QUEUE_SIZE: {
+      std::lock_guard<std::mutex> lk(priv->cpp->mtx);
+      priv->output_queue_size = g_value_get_uint(value);
+      priv->cpp->stream_cond.notify_all();
+      break;
+    }
+    case PROP_EVENT_THREADS:
+      priv->n_event_threads = g_value_get_uint(value);
+      break;
+    case PROP_OUTPUT_THREADS:
+      priv->n_output_threads = g_value_get_uint(value);
+      break;
+    default:
+      G_OBJECT_WARN_INVALID_PROPERTY_ID(object, prop_id, pspec);
+      break;
+  }
+}
+
+static void
+gst_cnmultidec_get_property(GObject* object, guint prop_id, GValue* value, GParamSpec* pspec)
+{
+  GstCnmultidecPrivate* priv = gst_cnmultidec_get_private(GST_CNMULTIDEC(object));
+  switch (prop_id) {
+    case PROP_DEVICE_ID:
+      g_value_set_int(value, priv->device_id);
+      break;
+    case PROP_INPUT_BUFFER_NUM:
+      g_value_set_uint(value, priv->input_buffer_num);
+      break;
+    case PROP_OUTPUT_BUFFER_NUM:
+      g_value_set_uint(value, priv->output_buffer_num);
+      break;
+    case PROP_OUTPUT_QUEUE_SIZE:
+      g_value_set_uint(value, priv->output_queue_size);
+      break;
+    case PROP_EVENT_THREADS:
+      g_value_set_uint(value, priv->n_event_threads);
+      break;
+    case PROP_OUTPUT_THREADS:
+      g_value_set_uint(value, priv->n_output_threads);
+      break;
+    default:
+      G_OBJECT_WARN_INVALID_PROPERTY_ID(object, prop_id, pspec);
+      break;
+  }
+}
+
+/* GstElement vmethod implementations */
+
+static std::vector<std::shared_ptr<DecodeStream>>
+get_streams(GstCnmultidec* self)
+{
+  GstCnmultidecPrivateCpp* cpp = gst_cnmultidec_get_private(self)->cpp;
+  std::vector<std::shared_ptr<DecodeStream>> streams;
+  std::lock_guard<std::mutex> lk(cpp->streams_mtx);
+  for (auto& it : cpp->streams) {
+    streams.push_back(it.second);
+  }
+  return streams;
+}
+
+static GstPad*
+gst_cnmultidec_request_new_pad(GstElement* element, GstPadTemplate* templ, const gchar* name, const GstCaps* caps)
+{
+  GstCnmultidec* self = GST_CNMULTIDEC(element);
+  GstCnmultidecPrivateCpp* cpp = gst_cnmultidec_get_private(self)->cpp;
+  auto stream = std::make_shared<DecodeStream>();
+
+  {
+    std::lock_guard<std::mutex> lk(cpp->streams_mtx);
+    guint index;
+    if (name && sscanf(name, "sink_%u", &index) == 1) {
+      if (cpp->streams.count(index)) {
+        GST_WARNING_OBJECT(self, "pad %s exists", name);
+        return nullptr;
+      }
+    } else {
+      index = cpp->next_index;
+    }
+    cpp->next_index = MAX(cpp->next_index, index + 1);
+
+    stream->element = self;
+    stream->index = index;
+    gst_video_info_init(&stream->sink_info);
+    gst_video_info_init(&stream->src_info);
+    gchar* pad_name = g_strdup_printf("sink_%u", index);
+    stream->sinkpad = gst_pad_new_from_template(templ, pad_name);
+    g_free(pad_name);
+    pad_name = g_strdup_printf("src_%u", index);
+    stream->srcpad = gst_pad_new_from_static_template(&src_factory, pad_name);
+    g_free(pad_name);
+    cpp->streams[index] = stream;
+  }
+
+  for (GstPad* pad : { stream->sinkpad, stream->srcpad }) {
+    gst_pad_set_element_private(pad, stream.get());
+    gst_pad_set_iterate_internal_links_function(pad, GST_DEBUG_FUNCPTR(gst_cnmultidec_iterate_internal_links));
+  }
+  gst_pad_set_event_function(stream->sinkpad, GST_DEBUG_FUNCPTR(gst_cnmultidec_sink_event));
+  gst_pad_set_chain_function(stream->sinkpad, GST_DEBUG_FUNCPTR(gst_cnmultidec_chain));
+  gst_pad_set_activatemode_function(stream->srcpad, GST_DEBUG_FUNCPTR(gst_cnmultidec_src_activate_mode));
+  gst_pad_use_fixed_caps(stream->srcpad);
+
+  gst_pad_set_active(stream->srcpad, TRUE);
+  gst_element_add_pad(element, stream->srcpad);
+  gst_pad_set_active(stream->sinkpad, TRUE);
+  gst_element_add_pad(element, stream->sinkpad);
+  GST_DEBUG_OBJECT(self, "new stream %u", stream->index);
+  return stream->sinkpad;
+}
+
+static void
+gst_cnmultidec_release_pad(GstElement* element, GstPad* pad)
+{
+  GstCnmultidec* self = GST_CNMULTIDEC(element);
+  GstCnmultidecPrivateCpp* cpp = gst_cnmultidec_get_private(self)->cpp;
+  auto stream_ptr = reinterpret_cast<DecodeStream*>(gst_pad_get_element_private(pad));
+  std::shared_ptr<DecodeStream> stream;
+  {
+    std::lock_guard<std::mutex> lk(cpp->streams_mtx);
+    auto it = cpp->streams.find(stream_ptr->index);
+    if (it == cpp->streams.end()) {
+      return;
+    }
+    stream = it->second;
+    cpp->streams.erase(it);
+  }
+
+  GST_DEBUG_OBJECT(self, "release stream %u", stream->index);
+  // chain and pushes of the stream return once its pads are inactive
+  gst_pad_set_active(stream->sinkpad, FALSE);
+  gst_pad_set_active(stream->srcpad, FALSE);
+  set_stream_flushing(self, stream.get(), true);
+  destroy_stream_decoder(self, stream.get());
+  gst_element_remove_pad(element, stream->srcpad);
+  gst_element_remove_pad(element, stream->sinkpad);
+}
+
+static GstIterator*
+gst_cnmultidec_iterate_internal_links(GstPad* pad, GstObject* parent)
+{
+  auto stream = reinterpret_cast<DecodeStream*>(gst_pad_get_element_private(pad));
+  GstPad* other = pad == stream->sinkpad ? stream->srcpad : stream->sinkpad;
+  GValue value = G_VALUE_INIT;
+  g_value_init(&value, GST_TYPE_PAD);
+  g_value_set_object(&value, other);
+  GstIterator* it = gst_iterator_new_single(GST_TYPE_PAD, &value);
+  g_value_unset(&value);
+  return it;
+}
+
+// buffers are pushed by a task of each src pad, so a push blocked downstream, e.g. by preroll of a sink, holds
+// neither an output thread nor the other streams
+static gboolean
+gst_cnmultidec_src_activate_mode(GstPad* pad, GstObject* parent, GstPadMode mode, gboolean active)
+{
+  // pad is activated on request before it is added to element
+  auto stream = reinterpret_cast<DecodeStream*>(gst_pad_get_element_private(pad));
+  GstCnmultidecPrivateCpp* cpp = gst_cnmultidec_get_private(stream->element)->cpp;
+  if (mode != GST_PAD_MODE_PUSH) {
+    return FALSE;
+  }
+
+  if (active) {
+    return gst_pad_start_task(pad, (GstTaskFunction)push_loop, stream, NULL);
+  }
+
+  {
+    std::lock_guard<std::mutex> lk(cpp->mtx);
+    stream->flushing = true;
+    stream->pending_cond.notify_all();
+    cpp->stream_cond.notify_all();
+  }
+  return gst_pad_stop_task(pad);
+}
+
+static void
+event_loop(GstCnmultidec* self);
+static void
+output_loop(GstCnmultidec* self);
+
+static void
+start_threads(GstCnmultidec* self)
+{
+  GstCnmultidecPrivate* priv = gst_cnmultidec_get_private(self);
+  GstCnmultidecPrivateCpp* cpp = priv->cpp;
+  std::lock_guard<std::mutex> lk(cpp->mtx);
+  cpp->running = true;
+  for (guint i = 0; i < priv->n_event_threads; ++i) {
+    cpp->event_threads.emplace_back(&event_loop, self);
+  }
+  for (guint i = 0; i < priv->n_output_threads; ++i) {
+    cpp->output_threads.emplace_back(&output_loop, self);
+  }
+}
+
+static void
+stop_threads(GstCnmultidec* self)
+{
+  GstCnmultidecPrivateCpp* cpp = gst_cnmultidec_get_private(self)->cpp;
+  {
+    std::lock_guard<std::mutex> lk(cpp->mtx);
+    cpp->running = false;
+    cpp->event_cond.notify_all();
+    cpp->ready_cond.notify_all();
+  }
+  for (auto& thread : cpp->event_threads) {
+    thread.join();
+  }
+  for (auto& thread : cpp->output_threads) {
+    thread.join();
+  }
+  cpp->event_threads.clear();
+  cpp->output_threads.clear();
+}
+
+static GstStateChangeReturn
+gst_cnmultidec_change_state(GstElement* element, GstStateChange transition)
+{
+  GstCnmultidec* self = GST_CNMULTIDEC(element);
+
+  if (transition == GST_STATE_CHANGE_NULL_TO_READY) {
+    start_threads(self);
+  }
+
+  GstStateChangeReturn ret = GST_ELEMENT_CLASS(PARENT_CLASS)->change_state(element, transition);
+  if (ret == GST_STATE_CHANGE_FAILURE) {
+    if (transition == GST_STATE_CHANGE_NULL_TO_READY) {
+      stop_threads(self);
+    }
+    return ret;
+  }
+
+  switch (transition) {
+    case GST_STATE_CHANGE_PAUSED_TO_READY:
+      // pads are inactive, tasks of src pads are stopped
+      for (auto& stream : get_streams(self)) {
+        set_stream_flushing(self, stream.get(), true);
+        destroy_stream_decoder(self, stream.get());
+        set_stream_flushing(self, stream.get(), false);
+      }
+      break;
+    case GST_STATE_CHANGE_READY_TO_NULL:
+      stop_threads(self);
+      break;
+    default:
+      break;
+  }
+  return ret;
+}
+
+/* GstCnmultidec method implementations */
+
+static gboolean
+bind_device(GstCnmultidec* self)
+{
+  thread_local gint bound_device_id = -1;
+  gint device_id = gst_cnmultidec_get_private(self)->device_id;
+  if (bound_device_id != device_id) {
+    if (!set_cnrt_env(GST_ELEMENT(self), device_id)) {
+      return FALSE;
+    }
+    bound_device_id = device_id;
+  }
+  return TRUE;
+}
+
+static inline cncodecPixelFormat
+video_format_cast(const GstVideoFormat fmt)
+{
+  switch (fmt) {
+    case GST_VIDEO_FORMAT_NV21:
+      return CNCODEC_PIX_FMT_NV21;
+    case GST_VIDEO_FORMAT_I420:
+      return CNCODEC_PIX_FMT_I420;
+    default:
+      return CNCODEC_PIX_FMT_NV12;
+  }
+}
+
+// called with mutex of element held
+static void
+schedule_stream(GstCnmultidecPrivateCpp* cpp, DecodeStream* stream)
+{
+  if (!stream->scheduled) {
+    stream->scheduled = true;
+    cpp->ready.push_back(stream);
+    cpp->ready_cond.notify_one();
+  }
+}
+
+static void
+set_stream_flushing(GstCnmultidec* self, DecodeStream* stream, bool flushing)
+{
+  GstCnmultidecPrivateCpp* cpp = gst_cnmultidec_get_private(self)->cpp;
+  std::unique_lock<std::mutex> lk(cpp->mtx);
+  stream->flushing = flushing;
+  if (!flushing) {
+    stream->send_eos = false;
+    stream->got_eos = false;
+    return;
+  }
+  std::deque<StreamOutput> outputs;
+  outputs.swap(stream->outputs);
+  std::deque<GstBuffer*> pending;
+  pending.swap(stream->pending);
+  stream->pending_cond.notify_all();
+  cpp->stream_cond.notify_all();
+  // output thread wrapping frame of the stream leaves it
+  cpp->stream_cond.wait(lk, [stream] { return !stream->scheduled; });
+  lk.unlock();
+
+  for (const auto& item : outputs) {
+    if (!item.eos) {
+      cnvideoDecReleaseReference(stream->decode, item.frame);
+    }
+  }
+  for (GstBuffer* buffer : pending) {
+    if (buffer) {
+      gst_buffer_unref(buffer);
+    }
+  }
+}
+
+static void
+feed_eos(GstCnmultidec* self, DecodeStream* stream)
+{
+  cnvideoDecInput input;
+  memset(&input, 0, sizeof(cnvideoDecInput));
+  input.flags = CNVIDEODEC_FLAG_EOS;
+  auto ret = cnvideoDecFeedData(stream->decode, &input, 10000);
+  if (ret != CNCODEC_SUCCESS) {
+    GST_CNMULTIDEC_ERROR(self, STREAM, DECODE, ("stream %u feed EOS failed, error code: %d", stream->index, ret));
+  }
+}
+
+static gboolean
+create_stream_decoder(GstCnmultidec* self, DecodeStream* stream, cncodecType codec)
+{
+  GstCnmultidecPrivate* priv = gst_cnmultidec_get_private(self);
+  if (!bind_device(self)) {
+    return FALSE;
+  }
+
+  cnvideoDecCreateInfo& params = stream->params;
+  memset(&params, 0, sizeof(cnvideoDecCreateInfo));
+  params.instance = CNVIDEODEC_INSTANCE_AUTO;
+  params.codec = codec;
+  params.pixelFmt = video_format_cast(GST_VIDEO_INFO_FORMAT(&stream->src_info));
+  params.colorSpace = CNCODEC_COLOR_SPACE_BT_709;
+  params.width = stream->sink_info.width;
+  params.height = stream->sink_info.height;
+  params.bitDepthMinus8 = 0;
+  params.progressive = stream->sink_info.interlace_mode != GST_VIDEO_INTERLACE_MODE_PROGRESSIVE ? 0 : 1;
+  params.inputBufNum = priv->input_buffer_num;
+  params.outputBufNum = priv->output_buffer_num;
+  params.deviceId = priv->device_id;
+  params.allocType = CNCODEC_BUF_ALLOC_LIB;
+  params.userContext = reinterpret_cast<void*>(stream);
+
+  auto ret = cnvideoDecCreate(&stream->decode, &stream_event_handler, &params);
+  if (ret != CNCODEC_SUCCESS) {
+    GST_CNMULTIDEC_ERROR(self, LIBRARY, INIT, ("Create decoder of stream %u failed, error code: %d", stream->index, ret));
+    stream->decode = nullptr;
+    return FALSE;
+  }
+  int stride_align = 1;
+  ret = cnvideoDecSetAttributes(stream->decode, CNVIDEO_DEC_ATTR_OUT_BUF_ALIGNMENT, &stride_align);
+  if (ret != CNCODEC_SUCCESS) {
+    GST_WARNING_OBJECT(self, "stream %u set output alignment failed, error code: %d", stream->index, ret);
+  }
+  return TRUE;
+}
+
+static gboolean
+destroy_stream_decoder(GstCnmultidec* self, DecodeStream* stream)
+{
+  GstCnmultidecPrivateCpp* cpp = gst_cnmultidec_get_private(self)->cpp;
+  if (!stream->decode) {
+    return TRUE;
+  }
+  if (!bind_device(self)) {
+    return FALSE;
+  }
+
+  std::unique_lock<std::mutex> lk(cpp->mtx);
+  if (!stream->got_eos && !stream->send_eos) {
+    stream->send_eos = true;
+    lk.unlock();
+    feed_eos(self, stream);
+    lk.lock();
+  }
+  cpp->stream_cond.wait(lk, [stream] { return stream->got_eos; });
+  // frames decoded before EOS are pushed unless the stream is flushing
+  cpp->stream_cond.wait(lk, [stream] {
+    return stream->flushing ||
+           (stream->outputs.empty() && !stream->scheduled && stream->pending.empty() && !stream->pushing);
+  });
+  lk.unlock();
+
+  auto ecode = cnvideoDecStop(stream->decode);
+  if (CNCODEC_SUCCESS != ecode) {
+    GST_ERROR_OBJECT(self, "stream %u decoder stop failed, error code: %d", stream->index, ecode);
+  }
+  ecode = cnvideoDecDestroy(stream->decode);
+  if (CNCODEC_SUCCESS != ecode) {
+    GST_ERROR_OBJECT(self, "stream %u decoder destroy failed, error code: %d", stream->index, ecode);
+  }
+  stream->decode = nullptr;
+  return TRUE;
+}
+
+static gboolean
+set_stream_caps(GstCnmultidec* self, DecodeStream* stream, GstCaps* target_caps)
+{
+  auto sinkcaps = gst_pad_get_pad_template_caps(stream->sinkpad);
+  auto caps = gst_caps_intersect(sinkcaps, target_caps);
+  gst_caps_unref(sinkcaps);
+  if (gst_caps_is_empty(caps)) {
+    gst_caps_unref(caps);
+    return FALSE;
+  }
+
+  cncodecType codec = CNCODEC_H264;
+  if (g_strcmp0(gst_structure_get_name(gst_caps_get_structure(caps, 0)), "video/x-h265") == 0) {
+    codec = CNCODEC_HEVC;
+  }
+  gboolean ok = gst_video_info_from_caps(&stream->sink_info, caps);
+  gst_caps_unref(caps);
+  if (!ok || stream->sink_info.width == 0 || stream->sink_info.height == 0) {
+    GST_ERROR_OBJECT(self, "stream %u get invalid width or height from upstream", stream->index);
+    return FALSE;
+  }
+
+  GstCaps* src_caps = gst_pad_get_pad_template_caps(stream->srcpad);
+  GstCaps* peer_caps = gst_pad_peer_query_caps(stream->srcpad, src_caps);
+  gst_caps_unref(src_caps);
+  if (gst_caps_is_empty(peer_caps)) {
+    GST_ERROR_OBJECT(self, "stream %u do not have intersection with downstream element", stream->index);
+    gst_caps_unref(peer_caps);
+    return FALSE;
+  }
+  peer_caps = gst_caps_truncate(gst_caps_normalize(peer_caps));
+  peer_caps = gst_caps_fixate(peer_caps);
+  gst_caps_set_simple(peer_caps, "width", G_TYPE_INT, stream->sink_info.width, "height", G_TYPE_INT,
+                      stream->sink_info.height, "framerate", GST_TYPE_FRACTION, stream->sink_info.fps_n,
+                      stream->sink_info.fps_d, NULL);
+  GST_INFO_OBJECT(self, "stream %u setcaps %" GST_PTR_FORMAT, stream->index, peer_caps);
+
+  if (stream->decode) {
+    // frames of previous caps are pushed before caps change
+    stream->restarting = true;
+    destroy_stream_decoder(self, stream);
+    stream->restarting = false;
+  }
+
+  if (!gst_pad_set_caps(stream->srcpad, peer_caps) || !gst_video_info_from_caps(&stream->src_info, peer_caps)) {
+    gst_caps_unref(peer_caps);
+    return FALSE;
+  }
+  stream->output_on_cpu = !gst_caps_features_contains(gst_caps_get_features(peer_caps, 0), "memory:mlu");
+  stream->downstream_video_meta = false;
+  if (stream->output_on_cpu) {
+    GstQuery* query = gst_query_new_allocation(peer_caps, FALSE);
+    if (gst_pad_peer_query(stream->srcpad, query)) {
+      stream->downstream_video_meta = gst_query_find_allocation_meta(query, GST_VIDEO_META_API_TYPE, NULL);
+    }
+    gst_query_unref(query);
+  }
+  gst_caps_unref(peer_caps);
+
+  {
+    GstCnmultidecPrivateCpp* cpp = gst_cnmultidec_get_private(self)->cpp;
+    std::lock_guard<std::mutex> lk(cpp->mtx);
+    stream->send_eos = false;
+    stream->got_eos = false;
+  }
+  return create_stream_decoder(self, stream, codec);
+}
+
+static gboolean
+gst_cnmultidec_sink_event(GstPad* pad, GstObject* parent, GstEvent* event)
+{
+  GstCnmultidec* self = GST_CNMULTIDEC(parent);
+  auto stream = reinterpret_cast<DecodeStream*>(gst_pad_get_element_private(pad));
+  gboolean ret = FALSE;
+
+  GST_LOG_OBJECT(pad, "Received %s event: %" GST_PTR_FORMAT, GST_EVENT_TYPE_NAME(event), event);
+
+  switch (GST_EVENT_TYPE(event)) {
+    case GST_EVENT_CAPS: {
+      GstCaps* caps;
+      gst_event_parse_caps(event, &caps);
+      ret = set_stream_caps(self, stream, caps);
+      if (!ret) {
+        GST_ERROR_OBJECT(self, "stream %u set caps failed", stream->index);
+      }
+      gst_event_unref(event);
+      break;
+    }
+    case GST_EVENT_EOS: {
+      if (!stream->decode) {
+        ret = gst_pad_push_event(stream->srcpad, event);
+        break;
+      }
+      GstCnmultidecPrivateCpp* cpp = gst_cnmultidec_get_private(self)->cpp;
+      {
+        std::lock_guard<std::mutex> lk(cpp->mtx);
+        stream->send_eos = true;
+      }
+      // pushed on src pad after the last frame, as EOS comes from decoder
+      feed_eos(self, stream);
+      gst_event_unref(event);
+      ret = TRUE;
+      break;
+    }
+    default:
+      ret = gst_pad_event_default(pad, parent, event);
+      break;
+  }
+  return ret;
+}
+
+static GstFlowReturn
+gst_cnmultidec_chain(GstPad* pad, GstObject* parent, GstBuffer* buffer)
+{
+  GstCnmultidec* self = GST_CNMULTIDEC(parent);
+  auto stream = reinterpret_cast<DecodeStream*>(gst_pad_get_element_private(pad));
+  if (!stream->decode) {
+    gst_buffer_unref(buffer);
+    return GST_FLOW_NOT_NEGOTIATED;
+  }
+  if (stream->send_eos || !bind_device(self)) {
+    gst_buffer_unref(buffer);
+    return stream->send_eos ? GST_FLOW_EOS : GST_FLOW_ERROR;
+  }
+
+  GstMapInfo info;
+  if (!gst_buffer_map(buffer, &info, GST_MAP_READ)) {
+    GST_CNMULTIDEC_ERROR(self, RESOURCE, READ, ("stream %u buffer map failed", stream->index));
+    gst_buffer_unref(buffer);
+    return GST_FLOW_ERROR;
+  }
+  stream->duration = GST_BUFFER_DURATION(buffer);
+
+  GstFlowReturn ret = GST_FLOW_OK;
+  if (info.size > 0) {
+    cnvideoDecInput input;
+    memset(&input, 0, sizeof(cnvideoDecInput));
+    input.streamBuf = reinterpret_cast<u8_t*>(info.data);
+    input.streamLength = info.size;
+    input.pts = GST_BUFFER_PTS(buffer);
+    input.flags = CNVIDEODEC_FLAG_TIMESTAMP;
+#if CNCODEC_VERSION >= 10600
+    input.flags |= CNVIDEODEC_FLAG_END_OF_FRAME;
+#endif
+    auto ecode = cnvideoDecFeedData(stream->decode, &input, 10000);
+    if (CNCODEC_SUCCESS != ecode) {
+      GST_ERROR_OBJECT(self, "stream %u send data failed, error code: %d", stream->index, ecode);
+      ret = GST_FLOW_ERROR;
+    }
+  }
+  gst_buffer_unmap(buffer, &info);
+  gst_buffer_unref(buffer);
+  return ret;
+}
+
+/* callbacks and threads */
+
+// NEW_FRAME callback, frame is referenced and handed over to output threads
+static void
+handle_frame(DecodeStream* stream, cnvideoDecOutput* out)
+{
+  GstCnmultidecPrivate* priv = gst_cnmultidec_get_private(stream->element);
+  GstCnmultidecPrivateCpp* cpp = priv->cpp;
+  std::unique_lock<std::mutex> lk(cpp->mtx);
+  cpp->stream_cond.wait(lk, [priv, stream] {
+    return stream->flushing || stream->outputs.size() + stream->pending.size() < priv->output_queue_size;
+  });
+  // frame not referenced goes back to decoder when callback returns
+  if (stream->flushing) {
+    return;
+  }
+  cnvideoDecAddReference(stream->decode, &out->frame);
+  stream->outputs.push_back({ &out->frame, out->pts, false });
+  schedule_stream(cpp, stream);
+}
+
+static void
+handle_sequence(DecodeStream* stream, cnvideoDecSequenceInfo* info)
+{
+  auto& params = stream->params;
+  params.codec = info->codec;
+  params.width = info->width;
+  params.height = info->height;
+  params.inputBufNum = MAX(params.inputBufNum, info->minInputBufNum);
+  params.outputBufNum = MAX(params.outputBufNum, info->minOutputBufNum);
+  params.userContext = reinterpret_cast<void*>(stream);
+
+  auto ecode = cnvideoDecStart(stream->decode, &params);
+  if (ecode != CNCODEC_SUCCESS) {
+    GST_CNMULTIDEC_ERROR(stream->element, LIBRARY, INIT,
+                         ("Start decoder of stream %u failed, error code: %d", stream->index, ecode));
+  }
+}
+
+static void
+handle_eos(DecodeStream* stream)
+{
+  GstCnmultidecPrivateCpp* cpp = gst_cnmultidec_get_private(stream->element)->cpp;
+  std::lock_guard<std::mutex> lk(cpp->mtx);
+  GST_INFO_OBJECT(stream->element, "stream %u receive EOS from cncodec", stream->index);
+  stream->got_eos = true;
+  if (!stream->restarting && !stream->flushing) {
+    stream->outputs.push_back({ nullptr, 0, true });
+    schedule_stream(cpp, stream);
+  }
+  cpp->stream_cond.notify_all();
+}
+
+static void
+handle_event(DecodeStream* stream, cncodecCbEventType type)
+{
+  GstCnmultidec* self = stream->element;
+  switch (type) {
+    case CNCODEC_CB_EVENT_EOS:
+      handle_eos(stream);
+      return;
+#if CNCODEC_VERSION >= 10600
+    case CNCODEC_CB_EVENT_STREAM_CORRUPT:
+      GST_WARNING_OBJECT(self, "stream %u corrupt, discard frame", stream->index);
+      return;
+#endif
+    case CNCODEC_CB_EVENT_SW_RESET:
+    case CNCODEC_CB_EVENT_HW_RESET:
+      GST_CNMULTIDEC_ERROR(self, LIBRARY, FAILED, ("Decode firmware crash event of stream %u", stream->index));
+      break;
+    case CNCODEC_CB_EVENT_OUT_OF_MEMORY:
+      GST_CNMULTIDEC_ERROR(self, LIBRARY, FAILED, ("Out of memory error of stream %u", stream->index));
+      break;
+    default:
+      GST_CNMULTIDEC_ERROR(self, LIBRARY, FAILED, ("Error event %d of stream %u", type, stream->index));
+      break;
+  }
+  if (stream->decode) {
+    GST_WARNING_OBJECT(self, "Abort decoder of stream %u", stream->index);
+    cnvideoDecAbort(stream->decode);
+    stream->decode = nullptr;
+  }
+  handle_eos(stream);
+}
+
+static i32_t
+stream_event_handler(cncodecCbEventType type, void* user_data, void* package)
+{
+  auto stream = reinterpret_cast<DecodeStream*>(user_data);
+  // NEW_FRAME and SEQUENCE event must be handled in callback thread, the others in a different thread
+  switch (type) {
+    case CNCODEC_CB_EVENT_NEW_FRAME:
+      handle_frame(stream, reinterpret_cast<cnvideoDecOutput*>(package));
+      break;
+    case CNCODEC_CB_EVENT_SEQUENCE:
+      handle_sequence(stream, reinterpret_cast<cnvideoDecSequenceInfo*>(package));
+      break;
+    default: {
+      GstCnmultidecPrivateCpp* cpp = gst_cnmultidec_get_private(stream->element)->cpp;
+      std::lock_guard<std::mutex> lk(cpp->mtx);
+      cpp->events.push_back({ stream, type });
+      cpp->event_cond.notify_one();
+      break;
+    }
+  }
+  return 0;
+}
+
+static void
+event_loop(GstCnmultidec* self)
+{
+  GstCnmultidecPrivateCpp* cpp = gst_cnmultidec_get_private(self)->cpp;
+  std::unique_lock<std::mutex> lk(cpp->mtx);
+  while (true) {
+    cpp->event_cond.wait(lk, [cpp] { return !cpp->running || !cpp->events.empty(); });
+    if (cpp->events.empty()) {
+      break;
+    }
+    StreamEvent event = cpp->events.front();
+    cpp->events.pop_front();
+    lk.unlock();
+    handle_event(event.stream, event.type);
+    lk.lock();
+  }
+}
+
+// wraps or downloads a decoded frame into a buffer, the reference of frame is taken over
+static GstBuffer*
+make_buffer(GstCnmultidec* self, DecodeStream* stream, const StreamOutput& item)
+{
+  cncodecFrame* frame = item.frame;
+  GstBuffer* buffer = nullptr;
+  if (stream->output_on_cpu) {
+    void* planes[GST_VIDEO_MAX_PLANES];
+    for (guint i = 0; i < frame->planeNum && i < GST_VIDEO_MAX_PLANES; ++i) {
+      planes[i] = reinterpret_cast<void*>(frame->plane[i].addr);
+    }
+    buffer = gst_mlu_download_frame(&stream->src_info, planes, frame->stride, stream->downstream_video_meta);
+    cnvideoDecReleaseReference(stream->decode, frame);
+    if (!buffer) {
+      GST_CNMULTIDEC_ERROR(self, RESOURCE, READ, ("stream %u copy frame from device to host failed", stream->index));
+      return nullptr;
+    }
+  } else {
+    buffer = gst_buffer_new();
+    GstMluFrame_t mlu_frame = gst_mlu_frame_new();
+    for (guint i = 0; i < frame->planeNum; ++i) {
+      size_t plane_size = frame->stride[i] * frame->height;
+      plane_size = i == 0 ? plane_size : plane_size >> 1;
+      mlu_frame->data[i] = cn_syncedmem_new(plane_size);
+      cn_syncedmem_set_dev_data(mlu_frame->data[i], reinterpret_cast<void*>(frame->plane[i].addr));
+      mlu_frame->stride[i] = frame->stride[i];
+    }
+    mlu_frame->device_id = gst_cnmultidec_get_private(self)->device_id;
+    mlu_frame->channel_id = frame->channel;
+    mlu_frame->n_planes = frame->planeNum;
+    mlu_frame->height = frame->height;
+    mlu_frame->width = frame->width;
+    mlu_frame->deallocator = new StreamFrameDeallocator(stream->decode, frame);
+
+    if (!gst_buffer_add_mlu_memory_meta(buffer, mlu_frame, "cnmultidec")) {
+      gst_mlu_frame_unref(mlu_frame);
+      gst_buffer_unref(buffer);
+      return nullptr;
+    }
+    if (!gst_buffer_set_mlu_frame_memory(buffer, mlu_frame, &stream->src_info)) {
+      GST_WARNING_OBJECT(self, "stream %u set mlu memory to buffer failed", stream->index);
+    }
+  }
+  GST_BUFFER_PTS(buffer) = item.pts;
+  GST_BUFFER_DURATION(buffer) = stream->duration;
+  return buffer;
+}
+
+static void
+output_loop(GstCnmultidec* self)
+{
+  GstCnmultidecPrivateCpp* cpp = gst_cnmultidec_get_private(self)->cpp;
+  std::unique_lock<std::mutex> lk(cpp->mtx);
+  while (true) {
+    cpp->ready_cond.wait(lk, [cpp] { return !cpp->running || !cpp->ready.empty(); });
+    if (!cpp->running) {
+      break;
+    }
+    DecodeStream* stream = cpp->ready.front();
+    cpp->ready.pop_front();
+    while (!stream->outputs.empty() && !stream->flushing) {
+      StreamOutput item = stream->outputs.front();
+      stream->outputs.pop_front();
+      lk.unlock();
+      GstBuffer* buffer = nullptr;
+      if (!item.eos) {
+        if (bind_device(self)) {
+          buffer = make_buffer(self, stream, item);
+        } else {
+          cnvideoDecReleaseReference(stream->decode, item.frame);
+        }
+      }
+      lk.lock();
+      if (!item.eos && !buffer) {
+        cpp->stream_cond.notify_all();
+        continue;
+      }
+      if (stream->flushing) {
+        lk.unlock();
+        if (buffer) {
+          gst_buffer_unref(buffer);
+        }
+        lk.lock();
+        break;
+      }
+      stream->pending.push_back(buffer);
+      stream->pending_cond.notify_one();
+    }
+    stream->scheduled = false;
+    cpp->stream_cond.notify_all();
+  }
+}
+
+static void
+push_loop(DecodeStream* stream)
+{
+  GstCnmultidec* self = stream->element;
+  GstCnmultidecPrivateCpp* cpp = gst_cnmultidec_get_private(self)->cpp;
+  std::unique_lock<std::mutex> lk(cpp->mtx);
+  stream->pending_cond.wait(lk, [stream] { return stream->flushing || !stream->pending.empty(); });
+  if (stream->flushing) {
+    lk.unlock();
+    gst_pad_pause_task(stream->srcpad);
+    return;
+  }
+  GstBuffer* buffer = stream->pending.front();
+  stream->pending.pop_front();
+  stream->pushing = true;
+  // room for decoder waiting
+  cpp->stream_cond.notify_all();
+  lk.unlock();
+
+  if (!buffer) {
+    gst_pad_push_event(stream->srcpad, gst_event_new_eos());
+  } else {
+    GstFlowReturn ret = gst_pad_push(stream->srcpad, buffer);
+    if (ret != GST_FLOW_OK && ret != GST_FLOW_FLUSHING && ret != GST_FLOW_EOS) {
+      GST_ERROR_OBJECT(self, "stream %u push error: %s", stream->index, gst_flow_get_name(ret));
+    }
+  }
+
+  lk.lock();
+  stream->pushing = false;
+  // destroy waiting for frames of the stream to be pushed
+  cpp->stream_cond.notify_all();
+}
@@ -0,0 +1,60 @@
+/*
+ *  Copyright (C) [2019-2020] by Cambricon, Inc.
+ *
+ *  This file is part of CNStream-Gst.
+ *
+ *  CNStream-Gst is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU Lesser General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  CNStream-Gst is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU Lesser General Public License for more details.
+ *
+ *  You should have received a copy of the GNU Lesser General Public License
+ *  along with CNStream-Gst.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#ifndef GST_CNMULTIDEC_H_
+#define GST_CNMULTIDEC_H_
+
+#include <gst/gst.h>
+
+#define GST_TYPE_CNMULTIDEC (gst_cnmultidec_get_type())
+#define GST_CNMULTIDEC(obj) (G_TYPE_CHECK_INSTANCE_CAST((obj), GST_TYPE_CNMULTIDEC, GstCnmultidec))
+#define GST_CNMULTIDEC_CLASS(klass) (G_TYPE_CHECK_CLASS_CAST((klass), GST_TYPE_CNMULTIDEC, GstCnmultidecClass))
+#define GST_IS_CNMULTIDEC(obj) (G_TYPE_CHECK_INSTANCE_TYPE((obj), GST_TYPE_CNMULTIDEC))
+#define GST_IS_CNMULTIDEC_CLASS(klass) (G_TYPE_CHECK_CLASS_TYPE((klass), GST_TYPE_CNMULTIDEC))
+#define GST_CNMULTIDEC_GET_CLASS(obj) (G_TYPE_INSTANCE_GET_CLASS((obj), GST_TYPE_CNMULTIDEC, GstCnmultidecClass))
+
+G_BEGIN_DECLS
+
+typedef struct _GstCnmultidec GstCnmultidec;
+typedef struct _GstCnmultidecClass GstCnmultidecClass;
+
+/**
+ * Decodes many streams in one element.
+ *
+ * Each request pad sink_%u gets its own decoder and a src_%u pad, which negotiates caps and forwards EOS as
+ * cnvideo_dec does. Events of all decoders are handled by a few shared threads, and decoded frames are wrapped or
+ * downloaded by a shared pool of output threads. Each src pad pushes its buffers from a task of its own, so a stream
+ * blocked downstream, e.g. by preroll of a sink, does not hold the threads of the other streams.
+ */
+struct _GstCnmultidec
+{
+  GstElement element;
+};
+
+struct _GstCnmultidecClass
+{
+  GstElementClass parent_class;
+};
+
+GType
+gst_cnmultidec_get_type(void);
+
+G_END_DECLS
+
+#endif // GST_CNMULTIDEC_H_
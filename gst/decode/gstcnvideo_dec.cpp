@@ -23,19 +23,28 @@
 #include <gst/video/video.h>
 #include <condition_variable>
 #include <cstring>
+#include <deque>
 #include <functional>
+#include <memory>
 #include <mutex>
 #include <queue>
 #include <set>
 #include <thread>
+#include <vector>
 
 #include "cn_codec_common.h"
 #include "cn_video_dec.h"
 #include "common/frame_deallocator.h"
+#include "common/gst_mlu_allocator.h"
+#include "common/gst_mlu_download.h"
+#include "common/gst_pinned_allocator.h"
+#include "common/h26x_parser.h"
 #include "common/mlu_memory_meta.h"
 #include "common/utils.h"
+#include "decoder_pool.h"
 #include "device/mlu_context.h"
-#include "easyinfer/mlu_memory_op.h"
+#include "nal_parser.h"
+#include "vpu_scheduler.h"
 
 GST_DEBUG_CATEGORY_EXTERN(gst_cambricon_debug);
 #define GST_CAT_DEFAULT gst_cambricon_debug
@@ -52,6 +61,19 @@ static constexpr gint DEFAULT_DEVICE_ID = 0;
 static constexpr guint DEFAULT_STREAM_ID = 0;
 static constexpr guint DEFAULT_INPUT_BUFFER_NUM = 4;
 static constexpr guint DEFAULT_OUTPUT_BUFFER_NUM = 4;
+static constexpr guint DEFAULT_OUTPUT_QUEUE_SIZE = 4;
+static constexpr GstCnvideodecLeaky DEFAULT_OUTPUT_LEAKY = GST_CNVIDEODEC_LEAKY_NO;
+static constexpr GstCnvideodecDecodeMode DEFAULT_DECODE_MODE = GST_CNVIDEODEC_DECODE_MODE_ALL;
+static constexpr guint DEFAULT_OUTPUT_INTERVAL = 1;
+static constexpr guint DEFAULT_DECODER_POOL_SIZE = 0;
+static constexpr gboolean DEFAULT_LOW_LATENCY = FALSE;
+static constexpr guint DEFAULT_INPUT_POOL_SIZE = 0;
+// input buffers smaller than this are checked for carrying only parameter sets
+static constexpr gsize HEADER_SIZE_LIMIT = 4096;
+// bitstream buffer proposed to upstream for streams of unknown resolution, half of a 1080p NV12 frame
+static constexpr gsize DEFAULT_BITSTREAM_SIZE = 1920 * 1080 * 3 / 2 / 2;
+// taken as frame rate of streams without one in caps when weighing load of VPU instances
+static constexpr guint DEFAULT_FRAMERATE = 30;
 
 // use set to avoid duplicated id
 static guint g_stream_id = 0;
@@ -67,8 +89,22 @@ enum
   PROP_STREAM_ID,
   PROP_INPUT_BUFFER_NUM,
   PROP_OUTPUT_BUFFER_NUM,
+  PROP_OUTPUT_QUEUE_SIZE,
+  PROP_OUTPUT_LEAKY,
+  PROP_OUTPUT_HIGH_WATER,
+  PROP_VPU_INSTANCE,
+  PROP_DECODE_MODE,
+  PROP_OUTPUT_INTERVAL,
+  PROP_DECODER_POOL_SIZE,
+  PROP_LOW_LATENCY,
+  PROP_INPUT_POOL_SIZE,
 };
 
+// instances VpuScheduler assigns decoders to
+static const cnvideoDecInstance VPU_INSTANCE_IDS[] = { CNVIDEODEC_INSTANCE_0, CNVIDEODEC_INSTANCE_1,
+                                                       CNVIDEODEC_INSTANCE_2, CNVIDEODEC_INSTANCE_3,
+                                                       CNVIDEODEC_INSTANCE_4, CNVIDEODEC_INSTANCE_5 };
+
 static inline void
 release_buffer(GstCnvideodec* self, cnvideoDecoder decode, uint64_t buf_id)
 {
@@ -104,8 +140,37 @@ private:
   uint64_t buf_id_ = 0;
 };
 
+// decoded frame waiting for the streaming thread of src pad, or EOS after the last frame
+struct OutputFrame
+{
+  // referenced in callback of decoder, released when the frame is dropped or its buffer is freed
+  cncodecFrame* frame;
+  u64_t pts;
+  bool eos;
+};
+
 struct GstCnvideodecPrivateCpp
 {
+  std::deque<OutputFrame> out_queue;
+  std::mutex out_mtx;
+  std::condition_variable out_cond;
+  // src pad is inactive, frames are released instead of queued
+  bool out_flushing = true;
+  guint out_high_water = 0;
+  // caps of a sequence the decoder is reused for, set on src pad along with the first frame of that size
+  GstCaps* next_caps = nullptr;
+  // after flush, frames decoded from data fed before it are released until the frame of resume_pts comes
+  bool discarding = false;
+  GstClockTime resume_pts = GST_CLOCK_TIME_NONE;
+  // frames the decoder may still hold from before flush, discarding stops when they are out
+  guint discard_left = 0;
+
+  // filters NAL units in decode modes other than all
+  std::unique_ptr<NalFilter> nal_filter;
+  std::vector<guint8> filtered;
+  // parameter sets of input buffers without picture, fed along with the next picture
+  std::vector<guint8> pending_headers;
+
   std::mutex eos_mtx;
   std::condition_variable eos_cond;
 
@@ -122,11 +187,40 @@ struct GstCnvideodecPrivate
   cncodecType codec_type;
 
   GstVideoInfo sink_info;
+  // caps on src pad, frames are wrapped or downloaded with it. Changed by streaming thread of src pad while decoding
   GstVideoInfo src_info;
   guint channel_id;
   gboolean output_on_cpu;
+  // downstream handles strided host frames described by GstVideoMeta
+  gboolean downstream_video_meta;
   gboolean send_eos;
   gboolean got_eos;
+  // instance taken from VpuScheduler and load put on it, -1 if chosen by cncodec
+  gint vpu_instance;
+  guint64 vpu_pixel_rate;
+  // frames decoded since decoder is created, output one in output_interval of them
+  guint64 n_decoded;
+  // resolution decoder is created with, streams up to it reuse the decoder on caps change
+  guint max_width;
+  guint max_height;
+  // set if decoder is checked out of DecoderPool
+  DecoderSlot* pool_slot;
+  // element is counted as a user of DecoderPool until it is finalized
+  gboolean pool_attached;
+  // decoder is created on the first buffer, sized by its SPS
+  gboolean pending_init;
+  // decoded picture buffer size of stream, 0 if unknown
+  guint dpb_size;
+  // frames decoder holds back for reordering, -1 if unknown
+  gint num_reorder_frames;
+  // decoder is destroyed to be created again, its EOS is not pushed downstream
+  gboolean restarting;
+  // between FLUSH_START and FLUSH_STOP, buffers are refused
+  gboolean flushing;
+  // after FLUSH_STOP, delta units are dropped until a key frame
+  gboolean wait_keyframe;
+  // page-locked memory proposed to upstream, created on the first ALLOCATION query
+  GstAllocator* input_allocator;
 
   GstCnvideodecPrivateCpp* cpp;
   GstClockTime duration;
@@ -170,6 +264,12 @@ gst_cnvideodec_get_property(GObject* object, guint prop_id, GValue* value, GPara
 
 static gboolean
 gst_cnvideodec_sink_event(GstPad* pad, GstObject* parent, GstEvent* event);
+static gboolean
+gst_cnvideodec_sink_query(GstPad* pad, GstObject* parent, GstQuery* query);
+static gboolean
+gst_cnvideodec_src_activate_mode(GstPad* pad, GstObject* parent, GstPadMode mode, gboolean active);
+static gboolean
+gst_cnvideodec_src_query(GstPad* pad, GstObject* parent, GstQuery* query);
 static GstFlowReturn
 gst_cnvideodec_chain(GstPad* pad, GstObject* parent, GstBuffer* buf);
 static GstStateChangeReturn
@@ -203,6 +303,50 @@ static void
 handle_eos(GstCnvideodec* self);
 static void
 handle_frame(GstCnvideodec* self, cnvideoDecOutput* out);
+static void
+output_loop(GstCnvideodec* self);
+static void
+flush_output_queue(GstCnvideodec* self);
+static gboolean
+prepare_decoder(GstCnvideodec* self, GstBuffer* buf);
+
+#define GST_CNVIDEODEC_LEAKY (gst_cnvideodec_leaky_get_type())
+static GType
+gst_cnvideodec_leaky_get_type(void)
+{
+  static const GEnumValue values[] = { { GST_CNVIDEODEC_LEAKY_NO, "Not Leaky, wait for room in queue", "no" },
+                                       { GST_CNVIDEODEC_LEAKY_UPSTREAM, "Leaky on upstream, drop new frames",
+                                         "upstream" },
+                                       { GST_CNVIDEODEC_LEAKY_DOWNSTREAM, "Leaky on downstream, drop old frames",
+                                         "downstream" },
+                                       { 0, NULL, NULL } };
+  static volatile GType id = 0;
+  if (g_once_init_enter((gsize*)&id)) {
+    GType _id;
+    _id = g_enum_register_static("GstCnvideodecLeaky", values);
+    g_once_init_leave((gsize*)&id, _id);
+  }
+  return id;
+}
+
+#define GST_CNVIDEODEC_DECODE_MODE (gst_cnvideodec_decode_mode_get_type())
+static GType
+gst_cnvideodec_decode_mode_get_type(void)
+{
+  static const GEnumValue values[] = {
+    { GST_CNVIDEODEC_DECODE_MODE_ALL, "Decode all pictures", "all" },
+    { GST_CNVIDEODEC_DECODE_MODE_KEYFRAMES, "Decode intra pictures only", "keyframes" },
+    { GST_CNVIDEODEC_DECODE_MODE_REFERENCE_ONLY, "Decode pictures used as reference only", "reference-only" },
+    { 0, NULL, NULL }
+  };
+  static volatile GType id = 0;
+  if (g_once_init_enter((gsize*)&id)) {
+    GType _id;
+    _id = g_enum_register_static("GstCnvideodecDecodeMode", values);
+    g_once_init_leave((gsize*)&id, _id);
+  }
+  return id;
+}
 
 /* 1. GObject vmethod implementations */
 
@@ -211,7 +355,14 @@ gst_cnvideodec_finalize(GObject* object)
 {
   g_stream_id_set.erase(GST_CNVIDEODEC(object)->stream_id);
   GstCnvideodecPrivate* priv = gst_cnvideodec_get_private(GST_CNVIDEODEC(object));
+  if (priv->pool_attached) {
+    DecoderPool::get()->detach();
+  }
+  gst_caps_replace(&priv->cpp->next_caps, NULL);
   delete priv->cpp;
+  if (priv->input_allocator) {
+    gst_object_unref(priv->input_allocator);
+  }
 
   G_OBJECT_CLASS(PARENT_CLASS)->finalize(object);
 }
@@ -253,6 +404,61 @@ gst_cnvideodec_class_init(GstCnvideodecClass* klass)
                                   g_param_spec_uint("output-buffer-num", "output buffer num", "output buffer number", 0,
                                                     20, DEFAULT_OUTPUT_BUFFER_NUM,
                                                     (GParamFlags)(G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS)));
+  g_object_class_install_property(
+    gobject_class, PROP_OUTPUT_QUEUE_SIZE,
+    g_param_spec_uint("output-queue-size", "output queue size",
+                      "number of decoded frames queued for the streaming thread of src pad", 1, 64,
+                      DEFAULT_OUTPUT_QUEUE_SIZE, (GParamFlags)(G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS)));
+  g_object_class_install_property(
+    gobject_class, PROP_OUTPUT_LEAKY,
+    g_param_spec_enum("output-leaky", "output leaky",
+                      "where frames are dropped when output queue is full, no blocks the decoder until there is room",
+                      GST_CNVIDEODEC_LEAKY, DEFAULT_OUTPUT_LEAKY,
+                      (GParamFlags)(G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS)));
+  g_object_class_install_property(
+    gobject_class, PROP_OUTPUT_HIGH_WATER,
+    g_param_spec_uint("output-high-water", "output high water",
+                      "maximum number of frames in output queue since src pad is activated", 0, G_MAXUINT, 0,
+                      (GParamFlags)(G_PARAM_READABLE | G_PARAM_STATIC_STRINGS)));
+  g_object_class_install_property(
+    gobject_class, PROP_VPU_INSTANCE,
+    g_param_spec_int("vpu-instance", "vpu instance",
+                     "VPU instance decoder runs on, assigned by load when VPU_TURBO_MODE is set, -1 if chosen by cncodec",
+                     -1, G_MAXINT, -1, (GParamFlags)(G_PARAM_READABLE | G_PARAM_STATIC_STRINGS)));
+  g_object_class_install_property(
+    gobject_class, PROP_DECODE_MODE,
+    g_param_spec_enum("decode-mode", "decode mode",
+                      "pictures fed to decoder, others are dropped from stream before decoding. "
+                      "reference-only drops non-reference pictures",
+                      GST_CNVIDEODEC_DECODE_MODE, DEFAULT_DECODE_MODE,
+                      (GParamFlags)(G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS | GST_PARAM_MUTABLE_READY)));
+  g_object_class_install_property(
+    gobject_class, PROP_OUTPUT_INTERVAL,
+    g_param_spec_uint("output-interval", "output interval",
+                      "output one in every N decoded frames, others are released without being pushed", 1, G_MAXUINT,
+                      DEFAULT_OUTPUT_INTERVAL, (GParamFlags)(G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS)));
+  g_object_class_install_property(
+    gobject_class, PROP_DECODER_POOL_SIZE,
+    g_param_spec_uint("decoder-pool-size", "decoder pool size",
+                      "number of idle decoders with the same settings created ahead of time in a process-wide pool, "
+                      "so that restarted streams do not wait for decoder creation, 0 disables the pool. The pool holds "
+                      "at most 32 decoders, destroys those idle for 60 seconds and empties when its last user is freed",
+                      0, 16, DEFAULT_DECODER_POOL_SIZE,
+                      (GParamFlags)(G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS | GST_PARAM_MUTABLE_READY)));
+  g_object_class_install_property(
+    gobject_class, PROP_LOW_LATENCY,
+    g_param_spec_boolean("low-latency", "low latency",
+                         "use the fewest input and output buffers the stream needs, so that frames of streams without "
+                         "B-frames are output as soon as they are decoded",
+                         DEFAULT_LOW_LATENCY,
+                         (GParamFlags)(G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS | GST_PARAM_MUTABLE_READY)));
+  g_object_class_install_property(
+    gobject_class, PROP_INPUT_POOL_SIZE,
+    g_param_spec_uint("input-pool-size", "input pool size",
+                      "number of page-locked bitstream buffers proposed to upstream, so that stream is fed to decoder "
+                      "without staging copies, 0 proposes none",
+                      0, 64, DEFAULT_INPUT_POOL_SIZE,
+                      (GParamFlags)(G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS | GST_PARAM_MUTABLE_READY)));
   gst_element_class_set_details_simple(gstelement_class, "cnvideo_dec", "Generic/Decoder", "Cambricon video decoder",
                                        "Cambricon Solution SDK");
 
@@ -286,10 +492,13 @@ gst_cnvideodec_init(GstCnvideodec* self)
   self->sinkpad = gst_pad_new_from_static_template(&sink_factory, "sink");
   gst_pad_set_event_function(self->sinkpad, GST_DEBUG_FUNCPTR(gst_cnvideodec_sink_event));
   gst_pad_set_chain_function(self->sinkpad, GST_DEBUG_FUNCPTR(gst_cnvideodec_chain));
+  gst_pad_set_query_function(self->sinkpad, GST_DEBUG_FUNCPTR(gst_cnvideodec_sink_query));
   GST_PAD_SET_ACCEPT_INTERSECT(self->sinkpad);
   gst_element_add_pad(GST_ELEMENT(self), self->sinkpad);
 
   self->srcpad = gst_pad_new_from_static_template(&src_factory, "src");
+  gst_pad_set_activatemode_function(self->srcpad, GST_DEBUG_FUNCPTR(gst_cnvideodec_src_activate_mode));
+  gst_pad_set_query_function(self->srcpad, GST_DEBUG_FUNCPTR(gst_cnvideodec_src_query));
   GST_PAD_SET_ACCEPT_INTERSECT(self->srcpad);
   gst_element_add_pad(GST_ELEMENT(self), self->srcpad);
 
@@ -299,12 +508,34 @@ gst_cnvideodec_init(GstCnvideodec* self)
   self->device_id = DEFAULT_DEVICE_ID;
   self->input_buffer_num = DEFAULT_INPUT_BUFFER_NUM;
   self->output_buffer_num = DEFAULT_OUTPUT_BUFFER_NUM;
+  self->output_queue_size = DEFAULT_OUTPUT_QUEUE_SIZE;
+  self->output_leaky = DEFAULT_OUTPUT_LEAKY;
+  self->decode_mode = DEFAULT_DECODE_MODE;
+  self->output_interval = DEFAULT_OUTPUT_INTERVAL;
+  self->decoder_pool_size = DEFAULT_DECODER_POOL_SIZE;
+  self->low_latency = DEFAULT_LOW_LATENCY;
+  self->input_pool_size = DEFAULT_INPUT_POOL_SIZE;
   priv->channel_id = 0;
   priv->codec_type = CNCODEC_H264;
   priv->duration = GST_CLOCK_TIME_NONE;
   priv->output_on_cpu = FALSE;
+  priv->downstream_video_meta = FALSE;
   priv->send_eos = FALSE;
   priv->got_eos = FALSE;
+  priv->vpu_instance = -1;
+  priv->vpu_pixel_rate = 0;
+  priv->n_decoded = 0;
+  priv->max_width = 0;
+  priv->max_height = 0;
+  priv->pool_slot = nullptr;
+  priv->pool_attached = FALSE;
+  priv->pending_init = FALSE;
+  priv->dpb_size = 0;
+  priv->num_reorder_frames = -1;
+  priv->restarting = FALSE;
+  priv->flushing = FALSE;
+  priv->wait_keyframe = FALSE;
+  priv->input_allocator = nullptr;
   priv->cpp = new GstCnvideodecPrivateCpp;
   std::unique_lock<std::mutex> lk(stream_id_mutex);
   do {
@@ -345,6 +576,36 @@ gst_cnvideodec_set_property(GObject* object, guint prop_id, const GValue* value,
     case PROP_OUTPUT_BUFFER_NUM:
       self->output_buffer_num = g_value_get_uint(value);
       break;
+    case PROP_OUTPUT_QUEUE_SIZE: {
+      GstCnvideodecPrivateCpp* cpp = gst_cnvideodec_get_private(self)->cpp;
+      std::lock_guard<std::mutex> lk(cpp->out_mtx);
+      self->output_queue_size = g_value_get_uint(value);
+      // decoder waiting for room may go on
+      cpp->out_cond.notify_all();
+      break;
+    }
+    case PROP_OUTPUT_LEAKY: {
+      GstCnvideodecPrivateCpp* cpp = gst_cnvideodec_get_private(self)->cpp;
+      std::lock_guard<std::mutex> lk(cpp->out_mtx);
+      self->output_leaky = (GstCnvideodecLeaky)g_value_get_enum(value);
+      cpp->out_cond.notify_all();
+      break;
+    }
+    case PROP_DECODE_MODE:
+      self->decode_mode = (GstCnvideodecDecodeMode)g_value_get_enum(value);
+      break;
+    case PROP_OUTPUT_INTERVAL:
+      self->output_interval = g_value_get_uint(value);
+      break;
+    case PROP_DECODER_POOL_SIZE:
+      self->decoder_pool_size = g_value_get_uint(value);
+      break;
+    case PROP_LOW_LATENCY:
+      self->low_latency = g_value_get_boolean(value);
+      break;
+    case PROP_INPUT_POOL_SIZE:
+      self->input_pool_size = g_value_get_uint(value);
+      break;
     default:
       G_OBJECT_WARN_INVALID_PROPERTY_ID(object, prop_id, pspec);
       break;
@@ -372,6 +633,36 @@ gst_cnvideodec_get_property(GObject* object, guint prop_id, GValue* value, GPara
     case PROP_OUTPUT_BUFFER_NUM:
       g_value_set_uint(value, self->output_buffer_num);
       break;
+    case PROP_OUTPUT_QUEUE_SIZE:
+      g_value_set_uint(value, self->output_queue_size);
+      break;
+    case PROP_OUTPUT_LEAKY:
+      g_value_set_enum(value, self->output_leaky);
+      break;
+    case PROP_OUTPUT_HIGH_WATER: {
+      GstCnvideodecPrivateCpp* cpp = gst_cnvideodec_get_private(self)->cpp;
+      std::lock_guard<std::mutex> lk(cpp->out_mtx);
+      g_value_set_uint(value, cpp->out_high_water);
+      break;
+    }
+    case PROP_VPU_INSTANCE:
+      g_value_set_int(value, gst_cnvideodec_get_private(self)->vpu_instance);
+      break;
+    case PROP_DECODE_MODE:
+      g_value_set_enum(value, self->decode_mode);
+      break;
+    case PROP_OUTPUT_INTERVAL:
+      g_value_set_uint(value, self->output_interval);
+      break;
+    case PROP_DECODER_POOL_SIZE:
+      g_value_set_uint(value, self->decoder_pool_size);
+      break;
+    case PROP_LOW_LATENCY:
+      g_value_set_boolean(value, self->low_latency);
+      break;
+    case PROP_INPUT_POOL_SIZE:
+      g_value_set_uint(value, self->input_pool_size);
+      break;
     default:
       G_OBJECT_WARN_INVALID_PROPERTY_ID(object, prop_id, pspec);
       break;
@@ -408,6 +699,174 @@ gst_cnvideodec_change_state(GstElement* element, GstStateChange transition)
   return ret;
 }
 
+// frames are pushed by a task of src pad, so that slow downstream never blocks callback thread of decoder
+static gboolean
+gst_cnvideodec_src_activate_mode(GstPad* pad, GstObject* parent, GstPadMode mode, gboolean active)
+{
+  GstCnvideodec* self = GST_CNVIDEODEC(parent);
+  GstCnvideodecPrivateCpp* cpp = gst_cnvideodec_get_private(self)->cpp;
+  if (mode != GST_PAD_MODE_PUSH) {
+    return FALSE;
+  }
+
+  if (active) {
+    std::unique_lock<std::mutex> lk(cpp->out_mtx);
+    cpp->out_flushing = false;
+    cpp->out_high_water = 0;
+    lk.unlock();
+    return gst_pad_start_task(pad, (GstTaskFunction)output_loop, self, NULL);
+  }
+
+  std::unique_lock<std::mutex> lk(cpp->out_mtx);
+  cpp->out_flushing = true;
+  cpp->out_cond.notify_all();
+  lk.unlock();
+  gboolean ret = gst_pad_stop_task(pad);
+  flush_output_queue(self);
+  lk.lock();
+  gst_caps_replace(&cpp->next_caps, NULL);
+  return ret;
+}
+
+/* reports frames held for reordering as latency, and frames waiting in output queue as the most it may take */
+static gboolean
+gst_cnvideodec_src_query(GstPad* pad, GstObject* parent, GstQuery* query)
+{
+  GstCnvideodec* self = GST_CNVIDEODEC(parent);
+  GstCnvideodecPrivate* priv = gst_cnvideodec_get_private(self);
+  if (GST_QUERY_TYPE(query) != GST_QUERY_LATENCY) {
+    return gst_pad_query_default(pad, parent, query);
+  }
+  if (!gst_pad_peer_query(self->sinkpad, query)) {
+    return FALSE;
+  }
+
+  gboolean live;
+  GstClockTime min, max;
+  gst_query_parse_latency(query, &live, &min, &max);
+  GstClockTime frame_duration = priv->duration;
+  if (priv->sink_info.fps_n > 0 && priv->sink_info.fps_d > 0) {
+    frame_duration = gst_util_uint64_scale_int(GST_SECOND, priv->sink_info.fps_d, priv->sink_info.fps_n);
+  }
+  if (GST_CLOCK_TIME_IS_VALID(frame_duration)) {
+    guint reorder = priv->num_reorder_frames >= 0 ? priv->num_reorder_frames : priv->dpb_size;
+    min += reorder * frame_duration;
+    if (GST_CLOCK_TIME_IS_VALID(max)) {
+      max += (reorder + self->output_queue_size) * frame_duration;
+    }
+  }
+  GST_DEBUG_OBJECT(self, "latency min %" GST_TIME_FORMAT " max %" GST_TIME_FORMAT, GST_TIME_ARGS(min),
+                   GST_TIME_ARGS(max));
+  gst_query_set_latency(query, live, min, max);
+  return TRUE;
+}
+
+/* proposes a pool of page-locked buffers, bitstream written there by upstream is fed to decoder as it is */
+static gboolean
+gst_cnvideodec_sink_query(GstPad* pad, GstObject* parent, GstQuery* query)
+{
+  GstCnvideodec* self = GST_CNVIDEODEC(parent);
+  GstCnvideodecPrivate* priv = gst_cnvideodec_get_private(self);
+  if (GST_QUERY_TYPE(query) != GST_QUERY_ALLOCATION || self->input_pool_size == 0) {
+    return gst_pad_query_default(pad, parent, query);
+  }
+
+  GstCaps* caps;
+  gboolean need_pool;
+  gst_query_parse_allocation(query, &caps, &need_pool);
+  if (!caps) {
+    return FALSE;
+  }
+  if (!priv->input_allocator) {
+    priv->input_allocator = gst_pinned_allocator_new(self->device_id);
+  }
+
+  // a coded picture is far below the raw frame except for near lossless intra coding, so half of NV12 frame holds
+  // any access unit of usual streams. Pinned memory is taken input-pool-size times, larger access units do not fit
+  // pool buffers and are fed from memory of upstream as without the pool
+  gint width = 0, height = 0;
+  GstStructure* structure = gst_caps_get_structure(caps, 0);
+  gsize size = DEFAULT_BITSTREAM_SIZE;
+  if (gst_structure_get_int(structure, "width", &width) && gst_structure_get_int(structure, "height", &height) &&
+      width > 0 && height > 0) {
+    size = (gsize)width * height * 3 / 2 / 2;
+  }
+
+  if (need_pool) {
+    // buffers are recycled, so that memory is locked once
+    GstBufferPool* pool = gst_buffer_pool_new();
+    GstStructure* config = gst_buffer_pool_get_config(pool);
+    gst_buffer_pool_config_set_params(config, caps, size, self->input_pool_size, self->input_pool_size);
+    gst_buffer_pool_config_set_allocator(config, priv->input_allocator, NULL);
+    if (gst_buffer_pool_set_config(pool, config)) {
+      gst_query_add_allocation_pool(query, pool, size, self->input_pool_size, self->input_pool_size);
+    } else {
+      GST_WARNING_OBJECT(self, "set config of proposed input pool failed");
+    }
+    gst_object_unref(pool);
+  }
+  gst_query_add_allocation_param(query, priv->input_allocator, NULL);
+  return TRUE;
+}
+
+/* stops output and releases queued frames. Decoder is kept, it goes on decoding data fed before flush */
+static gboolean
+flush_start(GstCnvideodec* self, GstEvent* event)
+{
+  GstCnvideodecPrivate* priv = gst_cnvideodec_get_private(self);
+  GstCnvideodecPrivateCpp* cpp = priv->cpp;
+  priv->flushing = TRUE;
+  gboolean ret = gst_pad_push_event(self->srcpad, event);
+
+  std::unique_lock<std::mutex> lk(cpp->out_mtx);
+  cpp->out_flushing = true;
+  cpp->out_cond.notify_all();
+  lk.unlock();
+  gst_pad_pause_task(self->srcpad);
+  flush_output_queue(self);
+  return ret;
+}
+
+/* resumes output from the next key frame, frames still in decoder from before flush are discarded as they come out */
+static gboolean
+flush_stop(GstCnvideodec* self, GstEvent* event)
+{
+  GstCnvideodecPrivate* priv = gst_cnvideodec_get_private(self);
+  GstCnvideodecClass* klass = GST_CNVIDEODEC_GET_CLASS(self);
+  GstCnvideodecPrivateCpp* cpp = priv->cpp;
+
+  if (priv->decode && (priv->send_eos || priv->got_eos)) {
+    // decoder takes no data after EOS, it is created again on the next buffer
+    GST_INFO_OBJECT(self, "Flush after EOS, create decoder again");
+    priv->restarting = TRUE;
+    gboolean destroyed = klass->destroy_decoder(self);
+    priv->restarting = FALSE;
+    g_return_val_if_fail(destroyed, FALSE);
+    priv->pending_init = TRUE;
+  }
+  priv->send_eos = FALSE;
+  priv->got_eos = FALSE;
+  priv->n_decoded = 0;
+  if (priv->cpp->nal_filter) {
+    priv->cpp->nal_filter->reset();
+  }
+  priv->cpp->pending_headers.clear();
+
+  std::unique_lock<std::mutex> lk(cpp->out_mtx);
+  cpp->out_flushing = false;
+  cpp->discarding = priv->decode != nullptr;
+  cpp->resume_pts = GST_CLOCK_TIME_NONE;
+  lk.unlock();
+  priv->wait_keyframe = TRUE;
+  priv->flushing = FALSE;
+
+  gboolean ret = gst_pad_push_event(self->srcpad, event);
+  if (GST_PAD_MODE(self->srcpad) == GST_PAD_MODE_PUSH) {
+    gst_pad_start_task(self->srcpad, (GstTaskFunction)output_loop, self, NULL);
+  }
+  return ret;
+}
+
 /* this function handles sink events */
 static gboolean
 gst_cnvideodec_sink_event(GstPad* pad, GstObject* parent, GstEvent* event)
@@ -434,6 +893,11 @@ gst_cnvideodec_sink_event(GstPad* pad, GstObject* parent, GstEvent* event)
     case GST_EVENT_EOS: {
       GstCnvideodecPrivate* priv = gst_cnvideodec_get_private(self);
       GST_INFO_OBJECT(self, "stream id %d receive EOS event", self->stream_id);
+      if (!priv->decode) {
+        // no buffer came, decoder is not created
+        ret = gst_pad_push_event(self->srcpad, event);
+        break;
+      }
       std::unique_lock<std::mutex> lk(priv->cpp->eos_mtx);
       priv->send_eos = TRUE;
       cnvideoDecInput input;
@@ -448,6 +912,12 @@ gst_cnvideodec_sink_event(GstPad* pad, GstObject* parent, GstEvent* event)
       gst_event_unref(event);
       break;
     }
+    case GST_EVENT_FLUSH_START:
+      ret = flush_start(self, event);
+      break;
+    case GST_EVENT_FLUSH_STOP:
+      ret = flush_stop(self, event);
+      break;
     default:
       ret = gst_pad_event_default(pad, parent, event);
       break;
@@ -518,40 +988,73 @@ gst_cnvideodec_set_caps(GstCnvideodec* self, GstCaps* target_caps)
   gst_caps_set_simple(peer_caps, "framerate", GST_TYPE_FRACTION, priv->sink_info.fps_n, priv->sink_info.fps_d, NULL);
   GST_INFO_OBJECT(self, "cnvideo_dec setcaps %" GST_PTR_FORMAT, peer_caps);
   gst_pad_use_fixed_caps(self->srcpad);
-  if (!gst_pad_set_caps(self->srcpad, peer_caps)) {
-    gst_caps_unref(peer_caps);
-    return FALSE;
-  }
 
   // get information from intersection caps
-  if (!gst_video_info_from_caps(&priv->src_info, peer_caps)) {
+  GstVideoInfo src_info;
+  if (!gst_video_info_from_caps(&src_info, peer_caps)) {
     GST_ERROR_OBJECT(self, "Get video info from src caps failed");
     gst_caps_unref(peer_caps);
     return FALSE;
   }
 
-  if (priv->src_info.finfo->format != GST_VIDEO_FORMAT_NV12 && priv->src_info.finfo->format != GST_VIDEO_FORMAT_NV21 &&
-      priv->src_info.finfo->format != GST_VIDEO_FORMAT_I420) {
+  if (src_info.finfo->format != GST_VIDEO_FORMAT_NV12 && src_info.finfo->format != GST_VIDEO_FORMAT_NV21 &&
+      src_info.finfo->format != GST_VIDEO_FORMAT_I420) {
     GST_ERROR_OBJECT(self, "Unsupport Pixel Format");
     gst_caps_unref(peer_caps);
     return FALSE;
   }
 
   GST_INFO_OBJECT(self, "fixed caps: %" GST_PTR_FORMAT, peer_caps);
-  priv->output_on_cpu = !gst_caps_features_contains(gst_caps_get_features(peer_caps, 0), "memory:mlu");
+  gboolean output_on_cpu = !gst_caps_features_contains(gst_caps_get_features(peer_caps, 0), "memory:mlu");
+  gboolean downstream_video_meta = FALSE;
+  if (output_on_cpu) {
+    // frames are downloaded with strides of decoder if downstream could handle them
+    GstQuery* query = gst_query_new_allocation(peer_caps, FALSE);
+    if (gst_pad_peer_query(self->srcpad, query)) {
+      downstream_video_meta = gst_query_find_allocation_meta(query, GST_VIDEO_META_API_TYPE, NULL);
+    }
+    gst_query_unref(query);
+  }
 
-  gst_caps_unref(peer_caps);
+  // new sequence is started by decoder when parameter sets of the stream change. Frames of the old sequence may be
+  // still queued or held by decoder, so caps are set by the streaming thread when frames of the new size come out
+  if (priv->decode && !priv->send_eos && !priv->got_eos && priv->params.codec == priv->codec_type &&
+      priv->params.pixelFmt == video_format_cast(src_info.finfo->format) && priv->output_on_cpu == output_on_cpu &&
+      priv->downstream_video_meta == downstream_video_meta && (guint)priv->sink_info.width <= priv->max_width &&
+      (guint)priv->sink_info.height <= priv->max_height) {
+    GST_INFO_OBJECT(self, "Reuse decoder for %dx%d, created for up to %ux%u", priv->sink_info.width,
+                    priv->sink_info.height, priv->max_width, priv->max_height);
+    std::lock_guard<std::mutex> lk(priv->cpp->out_mtx);
+    gst_caps_replace(&priv->cpp->next_caps, peer_caps);
+    gst_caps_unref(peer_caps);
+    return TRUE;
+  }
 
+  // frames of previous decoder are pushed with caps they are decoded for
   if (priv->decode) {
     GST_INFO_OBJECT(self, "Destroy previous decoder before Init");
-    g_return_val_if_fail(klass->destroy_decoder(self), FALSE);
+    priv->restarting = TRUE;
+    gboolean destroyed = klass->destroy_decoder(self);
+    priv->restarting = FALSE;
+    g_return_val_if_fail(destroyed, FALSE);
+  }
+
+  if (!gst_pad_set_caps(self->srcpad, peer_caps)) {
+    gst_caps_unref(peer_caps);
+    return FALSE;
   }
+  gst_caps_unref(peer_caps);
+  priv->src_info = src_info;
+  priv->output_on_cpu = output_on_cpu;
+  priv->downstream_video_meta = downstream_video_meta;
 
   priv->send_eos = FALSE;
   priv->got_eos = FALSE;
-  GST_INFO_OBJECT(self, "Init and start decoder");
-
-  g_return_val_if_fail(klass->init_decoder(self), FALSE);
+  priv->dpb_size = 0;
+  priv->num_reorder_frames = -1;
+  // SPS in the first buffer tells whether stream is decodable and how many buffers it needs
+  GST_INFO_OBJECT(self, "Init decoder on first buffer");
+  priv->pending_init = TRUE;
 
   return TRUE;
 }
@@ -566,9 +1069,34 @@ gst_cnvideodec_chain(GstPad* pad, GstObject* parent, GstBuffer* buf)
   self = GST_CNVIDEODEC(parent);
   GstCnvideodecPrivate* priv = gst_cnvideodec_get_private(self);
 
+  if (priv->flushing) {
+    gst_buffer_unref(buf);
+    return GST_FLOW_FLUSHING;
+  }
+  if (priv->wait_keyframe) {
+    if (GST_BUFFER_FLAG_IS_SET(buf, GST_BUFFER_FLAG_DELTA_UNIT)) {
+      GST_LOG_OBJECT(self, "Drop delta unit before key frame after flush");
+      gst_buffer_unref(buf);
+      return GST_FLOW_OK;
+    }
+    priv->wait_keyframe = FALSE;
+    GstCnvideodecPrivateCpp* cpp = priv->cpp;
+    std::lock_guard<std::mutex> lk(cpp->out_mtx);
+    if (cpp->discarding) {
+      // frames come out in order of pts from here, without a pts the first frame after flush is unknown
+      cpp->resume_pts = GST_BUFFER_PTS(buf);
+      cpp->discarding = GST_CLOCK_TIME_IS_VALID(cpp->resume_pts);
+      cpp->discard_left = priv->params.inputBufNum + priv->params.outputBufNum;
+    }
+  }
+
   if (!priv->send_eos) {
     // save duration and pass it to next plugin
     priv->duration = GST_BUFFER_DURATION(buf);
+    if (!prepare_decoder(self, buf)) {
+      gst_buffer_unref(buf);
+      return GST_FLOW_ERROR;
+    }
     GST_TRACE_OBJECT(self, "cnvideodec feed one package\n");
     if (!feed_data(self, buf))
       return GST_FLOW_ERROR;
@@ -579,6 +1107,96 @@ gst_cnvideodec_chain(GstPad* pad, GstObject* parent, GstBuffer* buf)
 
 /* 3. GstCnvideodec method implementations */
 
+// posts loads of VPU instances on the device as element message "vpu-load"
+static void
+post_vpu_load(GstCnvideodec* self)
+{
+  GstCnvideodecPrivate* priv = gst_cnvideodec_get_private(self);
+  GValue streams = G_VALUE_INIT, pixel_rates = G_VALUE_INIT;
+  g_value_init(&streams, GST_TYPE_ARRAY);
+  g_value_init(&pixel_rates, GST_TYPE_ARRAY);
+  for (const auto& load : VpuScheduler::get(self->device_id)->loads()) {
+    GValue v = G_VALUE_INIT;
+    g_value_init(&v, G_TYPE_UINT);
+    g_value_set_uint(&v, load.streams);
+    gst_value_array_append_and_take_value(&streams, &v);
+    g_value_init(&v, G_TYPE_UINT64);
+    g_value_set_uint64(&v, load.pixel_rate);
+    gst_value_array_append_and_take_value(&pixel_rates, &v);
+  }
+  GstStructure* s = gst_structure_new("vpu-load", "device-id", G_TYPE_INT, self->device_id, "instance", G_TYPE_INT,
+                                      priv->vpu_instance, NULL);
+  gst_structure_take_value(s, "streams", &streams);
+  gst_structure_take_value(s, "pixel-rates", &pixel_rates);
+  gst_element_post_message(GST_ELEMENT(self), gst_message_new_element(GST_OBJECT(self), s));
+}
+
+// pixels the stream decodes per second at a resolution
+static guint64
+stream_pixel_rate(GstCnvideodec* self, guint width, guint height)
+{
+  GstCnvideodecPrivate* priv = gst_cnvideodec_get_private(self);
+  guint fps = priv->sink_info.fps_n > 0 && priv->sink_info.fps_d > 0
+                ? (priv->sink_info.fps_n + priv->sink_info.fps_d - 1) / priv->sink_info.fps_d
+                : DEFAULT_FRAMERATE;
+  return (guint64)width * height * fps;
+}
+
+// decoder reused for a new resolution stays on its instance, the load put there follows the resolution
+static void
+update_vpu_load(GstCnvideodec* self, guint width, guint height)
+{
+  GstCnvideodecPrivate* priv = gst_cnvideodec_get_private(self);
+  guint64 pixel_rate = stream_pixel_rate(self, width, height);
+  if (priv->vpu_instance < 0 || pixel_rate == priv->vpu_pixel_rate) {
+    return;
+  }
+  VpuScheduler* scheduler = VpuScheduler::get(self->device_id);
+  scheduler->release(priv->vpu_instance, priv->vpu_pixel_rate);
+  scheduler->take(priv->vpu_instance, pixel_rate);
+  priv->vpu_pixel_rate = pixel_rate;
+  post_vpu_load(self);
+}
+
+static void
+release_vpu_instance(GstCnvideodec* self)
+{
+  GstCnvideodecPrivate* priv = gst_cnvideodec_get_private(self);
+  if (priv->vpu_instance < 0) {
+    return;
+  }
+  VpuScheduler::get(self->device_id)->release(priv->vpu_instance, priv->vpu_pixel_rate);
+  post_vpu_load(self);
+  priv->vpu_instance = -1;
+  priv->vpu_pixel_rate = 0;
+}
+
+// pooled decoder stays on the instance it is created on, load taken from scheduler is moved there
+static void
+take_pooled_instance(GstCnvideodec* self)
+{
+  GstCnvideodecPrivate* priv = gst_cnvideodec_get_private(self);
+  cnvideoDecInstance instance = priv->pool_slot->params.instance;
+  if (priv->params.instance == instance) {
+    return;
+  }
+  priv->params.instance = instance;
+  if (priv->vpu_instance < 0) {
+    return;
+  }
+  guint64 pixel_rate = priv->vpu_pixel_rate;
+  release_vpu_instance(self);
+  for (guint i = 0; i < G_N_ELEMENTS(VPU_INSTANCE_IDS); ++i) {
+    if (VPU_INSTANCE_IDS[i] == instance) {
+      priv->vpu_instance = i;
+      priv->vpu_pixel_rate = pixel_rate;
+      VpuScheduler::get(self->device_id)->take(i, pixel_rate);
+      post_vpu_load(self);
+      break;
+    }
+  }
+}
+
 static gboolean
 gst_cnvideodec_init_decoder(GstCnvideodec* self)
 {
@@ -596,33 +1214,10 @@ gst_cnvideodec_init_decoder(GstCnvideodec* self)
   memset(&params, 0, sizeof(cnvideoDecCreateInfo));
   if (const char* turbo_env_p = std::getenv("VPU_TURBO_MODE")) {
     GST_INFO_OBJECT(self, "VPU Turbo mode : %s", turbo_env_p);
-    static std::mutex vpu_instance_mutex;
-    std::unique_lock<std::mutex> lk(vpu_instance_mutex);
-    static int _vpu_inst_cnt = 0;
-    static cnvideoDecInstance _instances[] = {
-      // 100 channels:20+14+15+15+14+22
-      CNVIDEODEC_INSTANCE_0, CNVIDEODEC_INSTANCE_1, CNVIDEODEC_INSTANCE_2, CNVIDEODEC_INSTANCE_3, CNVIDEODEC_INSTANCE_4,
-      CNVIDEODEC_INSTANCE_5, CNVIDEODEC_INSTANCE_0, CNVIDEODEC_INSTANCE_1, CNVIDEODEC_INSTANCE_2, CNVIDEODEC_INSTANCE_3,
-      CNVIDEODEC_INSTANCE_4, CNVIDEODEC_INSTANCE_5, CNVIDEODEC_INSTANCE_0, CNVIDEODEC_INSTANCE_1, CNVIDEODEC_INSTANCE_2,
-      CNVIDEODEC_INSTANCE_3, CNVIDEODEC_INSTANCE_4, CNVIDEODEC_INSTANCE_5, CNVIDEODEC_INSTANCE_0, CNVIDEODEC_INSTANCE_1,
-      CNVIDEODEC_INSTANCE_2, CNVIDEODEC_INSTANCE_3, CNVIDEODEC_INSTANCE_4, CNVIDEODEC_INSTANCE_5, CNVIDEODEC_INSTANCE_0,
-      CNVIDEODEC_INSTANCE_1, CNVIDEODEC_INSTANCE_2, CNVIDEODEC_INSTANCE_3, CNVIDEODEC_INSTANCE_4, CNVIDEODEC_INSTANCE_5,
-      CNVIDEODEC_INSTANCE_0, CNVIDEODEC_INSTANCE_1, CNVIDEODEC_INSTANCE_2, CNVIDEODEC_INSTANCE_3, CNVIDEODEC_INSTANCE_4,
-      CNVIDEODEC_INSTANCE_5, CNVIDEODEC_INSTANCE_0, CNVIDEODEC_INSTANCE_1, CNVIDEODEC_INSTANCE_2, CNVIDEODEC_INSTANCE_3,
-      CNVIDEODEC_INSTANCE_4, CNVIDEODEC_INSTANCE_5, CNVIDEODEC_INSTANCE_0, CNVIDEODEC_INSTANCE_1, CNVIDEODEC_INSTANCE_2,
-      CNVIDEODEC_INSTANCE_3, CNVIDEODEC_INSTANCE_4, CNVIDEODEC_INSTANCE_5, CNVIDEODEC_INSTANCE_0, CNVIDEODEC_INSTANCE_1,
-      CNVIDEODEC_INSTANCE_2, CNVIDEODEC_INSTANCE_3, CNVIDEODEC_INSTANCE_4, CNVIDEODEC_INSTANCE_5, CNVIDEODEC_INSTANCE_0,
-      CNVIDEODEC_INSTANCE_1, CNVIDEODEC_INSTANCE_2, CNVIDEODEC_INSTANCE_3, CNVIDEODEC_INSTANCE_4, CNVIDEODEC_INSTANCE_5,
-      CNVIDEODEC_INSTANCE_0, CNVIDEODEC_INSTANCE_1, CNVIDEODEC_INSTANCE_2, CNVIDEODEC_INSTANCE_3, CNVIDEODEC_INSTANCE_4,
-      CNVIDEODEC_INSTANCE_5, CNVIDEODEC_INSTANCE_0, CNVIDEODEC_INSTANCE_1, CNVIDEODEC_INSTANCE_2, CNVIDEODEC_INSTANCE_3,
-      CNVIDEODEC_INSTANCE_4, CNVIDEODEC_INSTANCE_5, CNVIDEODEC_INSTANCE_0, CNVIDEODEC_INSTANCE_1, CNVIDEODEC_INSTANCE_2,
-      CNVIDEODEC_INSTANCE_3, CNVIDEODEC_INSTANCE_4, CNVIDEODEC_INSTANCE_5, CNVIDEODEC_INSTANCE_0, CNVIDEODEC_INSTANCE_1,
-      CNVIDEODEC_INSTANCE_3, CNVIDEODEC_INSTANCE_4, CNVIDEODEC_INSTANCE_5, CNVIDEODEC_INSTANCE_0, CNVIDEODEC_INSTANCE_5,
-      CNVIDEODEC_INSTANCE_0, CNVIDEODEC_INSTANCE_5, CNVIDEODEC_INSTANCE_0, CNVIDEODEC_INSTANCE_5, CNVIDEODEC_INSTANCE_0,
-      CNVIDEODEC_INSTANCE_5, CNVIDEODEC_INSTANCE_0, CNVIDEODEC_INSTANCE_5, CNVIDEODEC_INSTANCE_0, CNVIDEODEC_INSTANCE_5,
-      CNVIDEODEC_INSTANCE_3, CNVIDEODEC_INSTANCE_5, CNVIDEODEC_INSTANCE_5, CNVIDEODEC_INSTANCE_2, CNVIDEODEC_INSTANCE_2
-    };
-    params.instance = _instances[_vpu_inst_cnt++ % 100];
+    priv->vpu_pixel_rate = stream_pixel_rate(self, priv->sink_info.width, priv->sink_info.height);
+    priv->vpu_instance = VpuScheduler::get(self->device_id)->acquire(priv->vpu_pixel_rate);
+    params.instance = VPU_INSTANCE_IDS[priv->vpu_instance % G_N_ELEMENTS(VPU_INSTANCE_IDS)];
+    post_vpu_load(self);
   } else {
     params.instance = CNVIDEODEC_INSTANCE_AUTO;
   }
@@ -635,19 +1230,52 @@ gst_cnvideodec_init_decoder(GstCnvideodec* self)
   params.bitDepthMinus8 = 0;
   params.progressive = priv->sink_info.interlace_mode != GST_VIDEO_INTERLACE_MODE_PROGRESSIVE ? 0 : 1;
   params.inputBufNum = self->input_buffer_num;
-  params.outputBufNum = self->output_buffer_num;
+  // frames held by decoder for reference and reordering, and one being output
+  params.outputBufNum = MAX(self->output_buffer_num, priv->dpb_size + 1);
+  if (self->low_latency && priv->dpb_size > 0) {
+    params.outputBufNum = priv->dpb_size + 1;
+  }
   params.deviceId = self->device_id;
   params.allocType = CNCODEC_BUF_ALLOC_LIB;
   params.userContext = reinterpret_cast<void*>(self);
 
+  priv->n_decoded = 0;
+  if (self->decode_mode != GST_CNVIDEODEC_DECODE_MODE_ALL) {
+    priv->cpp->nal_filter.reset(new NalFilter(priv->codec_type == CNCODEC_HEVC, self->decode_mode));
+  } else {
+    priv->cpp->nal_filter.reset();
+  }
+
   if (!self->silent) {
     print_create_attr(&params);
   }
 
-  auto ret = cnvideoDecCreate(&priv->decode, &event_handler, &params);
+  priv->max_width = params.width;
+  priv->max_height = params.height;
+  if (self->decoder_pool_size > 0) {
+    if (!priv->pool_attached) {
+      DecoderPool::get()->attach();
+      priv->pool_attached = TRUE;
+    }
+    priv->pool_slot = DecoderPool::get()->checkout(params, &event_handler, self);
+    // spare decoders for the next restart
+    DecoderPool::get()->reserve(params, self->decoder_pool_size);
+  }
+
+  cncodecRetCode ret = CNCODEC_SUCCESS;
+  if (priv->pool_slot) {
+    GST_INFO_OBJECT(self, "Use decoder created ahead of time in pool");
+    priv->decode = priv->pool_slot->decode;
+    priv->max_width = priv->pool_slot->params.width;
+    priv->max_height = priv->pool_slot->params.height;
+    take_pooled_instance(self);
+  } else {
+    ret = cnvideoDecCreate(&priv->decode, &event_handler, &params);
+  }
   if (ret != CNCODEC_SUCCESS) {
     GST_CNVIDEODEC_ERROR(self, LIBRARY, INIT, ("Create video decode instance failed, error code: %d", ret));
     priv->decode = nullptr;
+    release_vpu_instance(self);
     return FALSE;
   }
 
@@ -655,7 +1283,16 @@ gst_cnvideodec_init_decoder(GstCnvideodec* self)
   ret = cnvideoDecSetAttributes(priv->decode, CNVIDEO_DEC_ATTR_OUT_BUF_ALIGNMENT, &stride_align);
   if (ret != CNCODEC_SUCCESS) {
     GST_CNVIDEODEC_ERROR(self, LIBRARY, INIT, ("cnvideo decode set attributes faild, error code: %d", ret));
+    // decoder has not started, nothing is fed to it or waited for
+    if (cnvideoDecDestroy(priv->decode) != CNCODEC_SUCCESS) {
+      GST_ERROR_OBJECT(self, "Decoder destroy failed");
+    }
     priv->decode = nullptr;
+    if (priv->pool_slot) {
+      DecoderPool::get()->release(priv->pool_slot);
+      priv->pool_slot = nullptr;
+    }
+    release_vpu_instance(self);
     return FALSE;
   }
 
@@ -705,6 +1342,15 @@ gst_cnvideodec_destroy_decoder(GstCnvideodec* self)
   if (priv->cpp->event_loop.joinable()) {
     priv->cpp->event_loop.join();
   }
+  eos_lk.unlock();
+
+  // frames queued before EOS are pushed, the rest are given back before decoder is gone
+  {
+    std::unique_lock<std::mutex> lk(priv->cpp->out_mtx);
+    priv->cpp->out_cond.wait(lk, [priv] { return priv->cpp->out_queue.empty() || priv->cpp->out_flushing; });
+    gst_caps_replace(&priv->cpp->next_caps, NULL);
+  }
+  flush_output_queue(self);
 
   if (priv->decode) {
     // destroy vpu decoder
@@ -721,6 +1367,11 @@ gst_cnvideodec_destroy_decoder(GstCnvideodec* self)
     }
     priv->decode = nullptr;
   }
+  if (priv->pool_slot) {
+    DecoderPool::get()->release(priv->pool_slot);
+    priv->pool_slot = nullptr;
+  }
+  release_vpu_instance(self);
 
   return TRUE;
 }
@@ -730,8 +1381,9 @@ feed_data(GstCnvideodec* self, GstBuffer* buf)
 {
   GstMapInfo info;
 
-  if (!gst_buffer_map(buf, &info, (GstMapFlags)GST_MAP_READWRITE)) {
-    GST_CNVIDEODEC_ERROR(self, RESOURCE, OPEN_READ_WRITE, ("buffer map failed%" GST_PTR_FORMAT, buf));
+  // decoder only reads stream, mapping for write would copy buffers shared with upstream
+  if (!gst_buffer_map(buf, &info, GST_MAP_READ)) {
+    GST_CNVIDEODEC_ERROR(self, RESOURCE, OPEN_READ, ("buffer map failed%" GST_PTR_FORMAT, buf));
     return FALSE;
   }
 
@@ -743,11 +1395,37 @@ feed_data(GstCnvideodec* self, GstBuffer* buf)
 
   GstCnvideodecPrivate* priv = gst_cnvideodec_get_private(self);
 
-  if (info.data != NULL && info.size > 0) {
+  u8_t* data = reinterpret_cast<u8_t*>(info.data);
+  gsize size = info.size;
+  NalFilter* nal_filter = priv->cpp->nal_filter.get();
+  if (nal_filter && data != NULL && size > 0) {
+    priv->cpp->filtered.clear();
+    guint dropped = nal_filter->filter(data, size, &priv->cpp->filtered);
+    GST_LOG_OBJECT(self, "%u slices dropped in decode mode %d", dropped, self->decode_mode);
+    data = priv->cpp->filtered.data();
+    size = priv->cpp->filtered.size();
+  }
+
+  // parameter sets sent apart from picture are held and fed in one call with it
+  std::vector<guint8>& headers = priv->cpp->pending_headers;
+  if (data != NULL && size > 0 && size < HEADER_SIZE_LIMIT &&
+      !annexb_has_slice(priv->codec_type == CNCODEC_HEVC, data, size)) {
+    GST_LOG_OBJECT(self, "Hold %" G_GSIZE_FORMAT " bytes of parameter sets for the next picture", size);
+    headers.insert(headers.end(), data, data + size);
+    gst_buffer_unmap(buf, &info);
+    return TRUE;
+  }
+  if (!headers.empty() && data != NULL && size > 0) {
+    headers.insert(headers.end(), data, data + size);
+    data = headers.data();
+    size = headers.size();
+  }
+
+  if (data != NULL && size > 0) {
     cnvideoDecInput input;
     memset(&input, 0, sizeof(cnvideoDecInput));
-    input.streamBuf = reinterpret_cast<u8_t*>(info.data);
-    input.streamLength = info.size;
+    input.streamBuf = data;
+    input.streamLength = size;
     input.pts = GST_BUFFER_PTS(buf);
     input.flags = CNVIDEODEC_FLAG_TIMESTAMP;
 #if CNCODEC_VERSION >= 10600
@@ -757,6 +1435,7 @@ feed_data(GstCnvideodec* self, GstBuffer* buf)
                      input.pts);
 
     auto ecode = cnvideoDecFeedData(priv->decode, &input, 10000);
+    headers.clear();
     if (CNCODEC_SUCCESS != ecode) {
       GST_ERROR_OBJECT(self, "send data failed. Error code: %d", ecode);
       gst_buffer_unmap(buf, &info);
@@ -769,6 +1448,118 @@ feed_data(GstCnvideodec* self, GstBuffer* buf)
   return TRUE;
 }
 
+/* follows resolution of stream in SPS. Caps are set at once when no frame is waiting for output, or deferred to the
+ * first frame of the new sequence when decoder keeps running.
+ */
+static gboolean
+update_resolution(GstCnvideodec* self, const H26xSequenceInfo& sps, gboolean deferred)
+{
+  GstCnvideodecPrivate* priv = gst_cnvideodec_get_private(self);
+  GstCaps* caps = nullptr;
+  if (deferred) {
+    std::lock_guard<std::mutex> lk(priv->cpp->out_mtx);
+    if (priv->cpp->next_caps) {
+      caps = gst_caps_ref(priv->cpp->next_caps);
+    }
+  }
+  if (!caps) {
+    caps = gst_pad_get_current_caps(self->srcpad);
+  }
+  if (!caps) {
+    return FALSE;
+  }
+  caps = gst_caps_make_writable(caps);
+  gst_caps_set_simple(caps, "width", G_TYPE_INT, sps.width, "height", G_TYPE_INT, sps.height, NULL);
+  GST_INFO_OBJECT(self, "stream resolution %ux%u, update caps %" GST_PTR_FORMAT, sps.width, sps.height, caps);
+  gboolean ret = TRUE;
+  if (deferred) {
+    // decoder keeps running, caps are set by streaming thread of src pad with the first frame of new sequence
+    std::lock_guard<std::mutex> lk(priv->cpp->out_mtx);
+    gst_caps_replace(&priv->cpp->next_caps, caps);
+  } else {
+    ret = gst_pad_set_caps(self->srcpad, caps) && gst_video_info_from_caps(&priv->src_info, caps);
+  }
+  gst_caps_unref(caps);
+  priv->sink_info.width = sps.width;
+  priv->sink_info.height = sps.height;
+  return ret;
+}
+
+/* creates decoder deferred by set_caps, or creates it again for a larger resolution, as told by SPS in buffer.
+ * Parameter sets precede key frames, so delta units are not parsed once decoder is created.
+ */
+static gboolean
+prepare_decoder(GstCnvideodec* self, GstBuffer* buf)
+{
+  GstCnvideodecPrivate* priv = gst_cnvideodec_get_private(self);
+  GstCnvideodecClass* klass = GST_CNVIDEODEC_GET_CLASS(self);
+  if (!priv->pending_init && GST_BUFFER_FLAG_IS_SET(buf, GST_BUFFER_FLAG_DELTA_UNIT)) {
+    return TRUE;
+  }
+
+  H26xSequenceInfo sps;
+  GstMapInfo info;
+  bool found = false;
+  if (gst_buffer_map(buf, &info, GST_MAP_READ)) {
+    found = h26x_find_sps(priv->codec_type == CNCODEC_HEVC, info.data, info.size, &sps);
+    gst_buffer_unmap(buf, &info);
+  }
+  if (!found) {
+    if (priv->pending_init) {
+      // parameter sets are not in band, decoder is sized by caps
+      priv->pending_init = FALSE;
+      return klass->init_decoder(self);
+    }
+    return TRUE;
+  }
+
+  GST_DEBUG_OBJECT(self, "SPS profile %u level %u, chroma format %u, bit depth %u/%u, %ux%u, dpb size %u",
+                   sps.profile_idc, sps.level_idc, sps.chroma_format_idc, sps.bit_depth_luma, sps.bit_depth_chroma,
+                   sps.width, sps.height, sps.dpb_size);
+  if (sps.chroma_format_idc > 1 || sps.bit_depth_luma != 8 || sps.bit_depth_chroma != 8) {
+    GST_CNVIDEODEC_ERROR(self, STREAM, WRONG_TYPE,
+                         ("Unsupported stream, profile %u, chroma format %u, bit depth %u", sps.profile_idc,
+                          sps.chroma_format_idc, sps.bit_depth_luma));
+    return FALSE;
+  }
+  priv->dpb_size = sps.dpb_size;
+  if (priv->num_reorder_frames != (gint)sps.num_reorder_frames) {
+    GST_INFO_OBJECT(self, "%u frames reordered by decoder", sps.num_reorder_frames);
+    priv->num_reorder_frames = sps.num_reorder_frames;
+    gst_element_post_message(GST_ELEMENT(self), gst_message_new_latency(GST_OBJECT(self)));
+  }
+
+  bool resized = sps.width != (guint)priv->sink_info.width || sps.height != (guint)priv->sink_info.height;
+  if (!priv->pending_init) {
+    if (!resized) {
+      return TRUE;
+    }
+    if (sps.width <= priv->max_width && sps.height <= priv->max_height) {
+      GST_INFO_OBJECT(self, "Resolution changes to %ux%u, new sequence is started by decoder", sps.width, sps.height);
+      if (!update_resolution(self, sps, TRUE)) {
+        GST_CNVIDEODEC_ERROR(self, CORE, NEGOTIATION, ("Set caps of %ux%u failed", sps.width, sps.height));
+        return FALSE;
+      }
+      return TRUE;
+    }
+    GST_INFO_OBJECT(self, "Resolution changes to %ux%u, larger than %ux%u of decoder, create decoder again", sps.width,
+                    sps.height, priv->max_width, priv->max_height);
+    priv->restarting = TRUE;
+    gboolean destroyed = klass->destroy_decoder(self);
+    priv->restarting = FALSE;
+    g_return_val_if_fail(destroyed, FALSE);
+    priv->send_eos = FALSE;
+    priv->got_eos = FALSE;
+  }
+
+  if (resized && !update_resolution(self, sps, FALSE)) {
+    GST_CNVIDEODEC_ERROR(self, CORE, NEGOTIATION, ("Set caps of %ux%u failed", sps.width, sps.height));
+    return FALSE;
+  }
+  priv->pending_init = FALSE;
+  return klass->init_decoder(self);
+}
+
 static void
 print_create_attr(cnvideoDecCreateInfo* p_attr)
 {
@@ -887,7 +1678,14 @@ handle_sequence(GstCnvideodec* self, cnvideoDecSequenceInfo* info)
   params.pixelFmt = video_format_cast(priv->src_info.finfo->format);
   params.width = info->width;
   params.height = info->height;
+  // resolution changes in band or by caps without a new decoder
+  update_vpu_load(self, info->width, info->height);
 
+  if (self->low_latency) {
+    // fewest buffers of the stream, each queued buffer delays the frames after it
+    params.inputBufNum = info->minInputBufNum;
+    params.outputBufNum = info->minOutputBufNum + 1;
+  }
   if (info->minInputBufNum > params.inputBufNum) {
     params.inputBufNum = info->minInputBufNum;
   }
@@ -895,7 +1693,8 @@ handle_sequence(GstCnvideodec* self, cnvideoDecSequenceInfo* info)
     params.outputBufNum = info->minOutputBufNum;
   }
 
-  params.userContext = reinterpret_cast<void*>(self);
+  // events of pooled decoder go through its slot, which forwards them to the element holding it
+  params.userContext = priv->pool_slot ? reinterpret_cast<void*>(priv->pool_slot) : reinterpret_cast<void*>(self);
 
   auto ecode = cnvideoDecStart(priv->decode, &params);
   if (ecode != CNCODEC_SUCCESS) {
@@ -912,6 +1711,91 @@ handle_event(GstCnvideodec* self, cncodecCbEventType type)
   priv->cpp->event_cond.notify_one();
 }
 
+// queues an item, waiting for room or dropping frames by leaky policy when queue is full. EOS is never dropped
+static void
+queue_output(GstCnvideodec* self, const OutputFrame& item)
+{
+  GstCnvideodecPrivate* priv = gst_cnvideodec_get_private(self);
+  GstCnvideodecPrivateCpp* cpp = priv->cpp;
+  std::unique_lock<std::mutex> lk(cpp->out_mtx);
+  auto full = [self, cpp] { return cpp->out_queue.size() >= self->output_queue_size; };
+  cncodecFrame* dropped = nullptr;
+
+  if (!item.eos && full()) {
+    switch (self->output_leaky) {
+      case GST_CNVIDEODEC_LEAKY_UPSTREAM:
+        dropped = item.frame;
+        break;
+      case GST_CNVIDEODEC_LEAKY_DOWNSTREAM:
+        for (auto it = cpp->out_queue.begin(); it != cpp->out_queue.end(); ++it) {
+          if (!it->eos) {
+            dropped = it->frame;
+            cpp->out_queue.erase(it);
+            break;
+          }
+        }
+        break;
+      default:
+        cpp->out_cond.wait(lk, [cpp, &full] { return cpp->out_flushing || !full(); });
+        break;
+    }
+  }
+  if (cpp->out_flushing) {
+    lk.unlock();
+    if (!item.eos) {
+      release_buffer(self, priv->decode, reinterpret_cast<uint64_t>(item.frame));
+    }
+    return;
+  }
+  if (dropped != item.frame) {
+    cpp->out_queue.push_back(item);
+    cpp->out_high_water = MAX(cpp->out_high_water, (guint)cpp->out_queue.size());
+    cpp->out_cond.notify_all();
+  }
+  lk.unlock();
+
+  if (dropped) {
+    GST_DEBUG_OBJECT(self, "output queue is full, drop frame %p", dropped);
+    release_buffer(self, priv->decode, reinterpret_cast<uint64_t>(dropped));
+  }
+}
+
+// whether frame was fed before flush, such frames are released without output
+static gboolean
+discard_flushed_frame(GstCnvideodec* self, u64_t pts)
+{
+  GstCnvideodecPrivateCpp* cpp = gst_cnvideodec_get_private(self)->cpp;
+  std::lock_guard<std::mutex> lk(cpp->out_mtx);
+  if (!cpp->discarding) {
+    return FALSE;
+  }
+  if (GST_CLOCK_TIME_IS_VALID(cpp->resume_pts)) {
+    // key frame after flush may be lost in a broken stream, then no more than buffers of decoder are discarded
+    if (pts == cpp->resume_pts || cpp->discard_left == 0) {
+      cpp->discarding = false;
+      return FALSE;
+    }
+    cpp->discard_left--;
+  }
+  return TRUE;
+}
+
+static void
+flush_output_queue(GstCnvideodec* self)
+{
+  GstCnvideodecPrivate* priv = gst_cnvideodec_get_private(self);
+  std::unique_lock<std::mutex> lk(priv->cpp->out_mtx);
+  std::deque<OutputFrame> frames;
+  frames.swap(priv->cpp->out_queue);
+  priv->cpp->out_cond.notify_all();
+  lk.unlock();
+  for (const auto& item : frames) {
+    if (!item.eos) {
+      release_buffer(self, priv->decode, reinterpret_cast<uint64_t>(item.frame));
+    }
+  }
+}
+
 static void
 handle_eos(GstCnvideodec* self)
 {
@@ -921,127 +1805,78 @@ handle_eos(GstCnvideodec* self)
   priv->got_eos = TRUE;
   priv->cpp->eos_cond.notify_all();
 
-  if (GST_STATE(GST_ELEMENT_CAST(self)) <= GST_STATE_READY)
+  if (GST_STATE(GST_ELEMENT_CAST(self)) <= GST_STATE_READY || priv->restarting)
     return;
 
-  gst_pad_push_event(self->srcpad, gst_event_new_eos());
+  // pushed after frames decoded before it
+  queue_output(self, { nullptr, 0, true });
 }
 
-static void
-clear_alignment(GstMemory* out_mem, const GstMapInfo& info, cncodecFrame* frame, GstVideoFormat fmt) {
-  GstMapInfo cp_info;
-  gst_memory_map(out_mem, &cp_info, GST_MAP_WRITE);
-  if (fmt == GST_VIDEO_FORMAT_I420) {
-    guint8* dst_y = cp_info.data;
-    guint8* dst_u = cp_info.data + frame->width * frame->height;
-    guint8* dst_v = cp_info.data + frame->width * frame->height + (frame->width * frame->height >> 2);
-    guint8* src_y = info.data;
-    guint8* src_u = info.data + frame->stride[0] * frame->height;
-    guint8* src_v = info.data + frame->stride[0] * frame->height + (frame->stride[1] * frame->height >> 1);
-    for (uint32_t i = 0; i < frame->height; i++) {
-      memcpy(dst_y + i * frame->width, src_y + i * frame->stride[0], frame->width);
-      if (i % 2 == 0) {
-        memcpy(dst_u + i * frame->width / 4, src_u + i * frame->stride[1] / 2, frame->width / 2);
-        memcpy(dst_v + i * frame->width / 4, src_v + i * frame->stride[2] / 2, frame->width / 2);
-      }
-    }
-  } else {
-    // (fmt == GST_VIDEO_FORMAT_NV12 || fmt == GST_VIDEO_FORMAT_NV21)
-    guint8* dst_y = cp_info.data;
-    guint8* dst_uv = cp_info.data + frame->width * frame->height;
-    guint8* src_y = info.data;
-    guint8* src_uv = info.data + frame->stride[0] * frame->height;
-    for (uint32_t i = 0; i < frame->height; i++) {
-      memcpy(dst_y + i * frame->width, src_y + i * frame->stride[0], frame->width);
-      if (i % 2 == 0) {
-        memcpy(dst_uv + i * frame->width / 2, src_uv + i * frame->stride[1] / 2, frame->width);
-      }
-    }
-  }
-  gst_memory_unmap(out_mem, &cp_info);
-}
-
-static GstMemory*
+static GstBuffer*
 copy_frame_d2h(GstCnvideodec* self, cncodecFrame* frame)
 {
-  GstMemory* mem = nullptr;
-  thread_local GstMapInfo info;
-  using mem_op = edk::MluMemoryOp;
+  GstCnvideodecPrivate* priv = gst_cnvideodec_get_private(self);
+  void* planes[MAXIMUM_PLANE];
   GST_DEBUG_OBJECT(self, "transform from device(MLU) memory to host memory");
 
-  // prepare memory
-  mem = gst_allocator_alloc(NULL, frame->stride[0] * frame->height * 3 / 2, NULL);
-  gst_memory_map(mem, &info, (GstMapFlags)GST_MAP_READWRITE);
+  for (uint32_t i = 0; i < frame->planeNum; ++i) {
+    planes[i] = reinterpret_cast<void*>(frame->plane[i].addr);
+  }
+  GstBuffer* buffer = gst_mlu_download_frame(&priv->src_info, planes, frame->stride, priv->downstream_video_meta);
+  if (!buffer) {
+    GST_CNVIDEODEC_ERROR(self, RESOURCE, READ, ("copy frame from device(MLU) to host failed"));
+  }
+  return buffer;
+}
 
+// NEW_FRAME callback, frame is referenced and handed over to the streaming thread of src pad
+static void
+handle_frame(GstCnvideodec* self, cnvideoDecOutput* out)
+{
   GstCnvideodecPrivate* priv = gst_cnvideodec_get_private(self);
-  auto fmt = priv->src_info.finfo->format;
-
-  // copy data from device to host
-#define CNCODEC_PLANE_DATA(frame, index) reinterpret_cast<void*>(frame->plane[index].addr)
-  if (fmt == GST_VIDEO_FORMAT_NV12 || fmt == GST_VIDEO_FORMAT_NV21) {
-    mem_op::MemcpyD2H(info.data, CNCODEC_PLANE_DATA(frame, 0), frame->stride[0] * frame->height);
-    mem_op::MemcpyD2H(info.data + frame->stride[0] * frame->height, CNCODEC_PLANE_DATA(frame, 1),
-                     (frame->stride[1] * frame->height) >> 1);
-  } else if (fmt == GST_VIDEO_FORMAT_I420) {
-    mem_op::MemcpyD2H(info.data, CNCODEC_PLANE_DATA(frame, 0), frame->stride[0] * frame->height);
-    mem_op::MemcpyD2H(info.data + frame->stride[0] * frame->height, CNCODEC_PLANE_DATA(frame, 1),
-                     (frame->stride[1] * frame->height) >> 1);
-    mem_op::MemcpyD2H(info.data + frame->stride[0] * frame->height + (frame->stride[1] * frame->height >> 1), CNCODEC_PLANE_DATA(frame, 2),
-                     (frame->stride[2] * frame->height) >> 1);
-  } else {
-    gst_memory_unmap(mem, &info);
-    gst_memory_unref(mem);
-    GST_CNVIDEODEC_ERROR(self, STREAM, FORMAT, ("unsupport pixel format"));
-    return nullptr;
-  }
-#undef CNCODEC_PLANE_DATA
-  // clear alignment
-  if (frame->stride[0] != frame->width) {
-    GST_INFO_OBJECT(self, "clear frame alignment");
-    GstMemory* cp_mem = gst_allocator_alloc(NULL, frame->width * frame->height * 3 / 2, NULL);
-    clear_alignment(cp_mem, info, frame, fmt);
-    gst_memory_unmap(mem, &info);
-    gst_memory_unref(mem);
-    mem = cp_mem;
-  } else {
-    gst_memory_unmap(mem, &info);
+  cncodecFrame* frame = &out->frame;
+  if (GST_STATE(GST_ELEMENT_CAST(self)) <= GST_STATE_READY) {
+    release_buffer(self, priv->decode, reinterpret_cast<uint64_t>(frame));
+    return;
+  }
+  // frame not referenced goes back to decoder when callback returns
+  if (discard_flushed_frame(self, out->pts)) {
+    GST_LOG_OBJECT(self, "Discard frame decoded before flush, pts %" GST_TIME_FORMAT, GST_TIME_ARGS(out->pts));
+    return;
+  }
+  if (priv->n_decoded++ % self->output_interval != 0) {
+    return;
   }
 
-  return mem;
+  cnvideoDecAddReference(priv->decode, frame);
+  queue_output(self, { frame, out->pts, false });
 }
 
-static void
-handle_frame(GstCnvideodec* self, cnvideoDecOutput* out)
+// wraps or downloads a decoded frame into a buffer, the reference of frame is taken over
+static GstBuffer*
+make_buffer(GstCnvideodec* self, const OutputFrame& item)
 {
   GstBuffer* buffer = nullptr;
   thread_local bool cnrt_env = false;
   GstCnvideodecPrivate* priv = gst_cnvideodec_get_private(self);
-  auto tick = g_get_monotonic_time();
+  cncodecFrame* frame = item.frame;
 
   if (!cnrt_env) {
-    g_return_if_fail(set_cnrt_env(GST_ELEMENT(self), self->device_id));
+    if (!set_cnrt_env(GST_ELEMENT(self), self->device_id)) {
+      release_buffer(self, priv->decode, reinterpret_cast<uint64_t>(frame));
+      return nullptr;
+    }
     cnrt_env = true;
   }
 
-  cncodecFrame* frame = &out->frame;
-  if (GST_STATE(GST_ELEMENT_CAST(self)) <= GST_STATE_READY) {
-    release_buffer(self, priv->decode, reinterpret_cast<uint64_t>(frame));
-    return;
-  }
-
-  // prepare data
-  buffer = gst_buffer_new();
   if (priv->output_on_cpu) {
-    auto mem = copy_frame_d2h(self, frame);
-    cnvideoDecAddReference(priv->decode, frame);
-    cnvideoDecReleaseReference(priv->decode, frame);
-    if (mem) {
-      gst_buffer_append_memory(buffer, mem);
-    } else {
-      gst_buffer_unref(buffer);
-      return;
+    buffer = copy_frame_d2h(self, frame);
+    release_buffer(self, priv->decode, reinterpret_cast<uint64_t>(frame));
+    if (!buffer) {
+      return nullptr;
     }
   } else {
+    buffer = gst_buffer_new();
     GstMluFrame_t mlu_frame = gst_mlu_frame_new();
     for (uint32_t i = 0; i < frame->planeNum; ++i) {
       size_t plane_size = frame->stride[i] * frame->height;
@@ -1059,24 +1894,93 @@ handle_frame(GstCnvideodec* self, cnvideoDecOutput* out)
     }
     mlu_frame->deallocator = new DecodeFrameDeallocator(self, priv->decode, reinterpret_cast<uint64_t>(frame));
 
-    cnvideoDecAddReference(priv->decode, frame);
-
     auto meta = gst_buffer_add_mlu_memory_meta(buffer, mlu_frame, "cnvideo_dec");
     if (!meta) {
       GST_WARNING_OBJECT(self, "since pipeline stopped, request GstMluFrame failed\n");
       gst_mlu_frame_unref(mlu_frame);
       gst_buffer_unref(buffer);
-      return;
+      return nullptr;
+    }
+    // planes are also exposed as memories, so that they could be mapped by elements unaware of MluMemoryMeta
+    if (!gst_buffer_set_mlu_frame_memory(buffer, mlu_frame, &priv->src_info)) {
+      GST_WARNING_OBJECT(self, "set mlu memory to buffer failed");
     }
   }
 
-  GST_BUFFER_PTS(buffer) = out->pts;
+  GST_BUFFER_PTS(buffer) = item.pts;
   GST_BUFFER_DURATION(buffer) = priv->duration;
+  return buffer;
+}
 
+// sets caps of a new sequence on src pad before its first frame, frames before it keep caps they are decoded for
+static gboolean
+update_output_caps(GstCnvideodec* self, const cncodecFrame* frame)
+{
+  GstCnvideodecPrivate* priv = gst_cnvideodec_get_private(self);
+  GstCaps* caps = nullptr;
+  {
+    std::lock_guard<std::mutex> lk(priv->cpp->out_mtx);
+    GstVideoInfo info;
+    if (priv->cpp->next_caps && gst_video_info_from_caps(&info, priv->cpp->next_caps) &&
+        (guint)info.width == frame->width && (guint)info.height == frame->height) {
+      caps = priv->cpp->next_caps;
+      priv->cpp->next_caps = nullptr;
+    }
+  }
+  if (!caps) {
+    if ((guint)priv->src_info.width == frame->width && (guint)priv->src_info.height == frame->height) {
+      return TRUE;
+    }
+    // resolution is changed by parameter sets in band
+    caps = gst_pad_get_current_caps(self->srcpad);
+    if (!caps) {
+      return FALSE;
+    }
+    caps = gst_caps_make_writable(caps);
+    gst_caps_set_simple(caps, "width", G_TYPE_INT, frame->width, "height", G_TYPE_INT, frame->height, NULL);
+  }
+  GST_INFO_OBJECT(self, "frame of %ux%u, update caps %" GST_PTR_FORMAT, frame->width, frame->height, caps);
+  gboolean ret = gst_pad_set_caps(self->srcpad, caps) && gst_video_info_from_caps(&priv->src_info, caps);
+  gst_caps_unref(caps);
+  return ret;
+}
+
+static void
+output_loop(GstCnvideodec* self)
+{
+  GstCnvideodecPrivateCpp* cpp = gst_cnvideodec_get_private(self)->cpp;
+  std::unique_lock<std::mutex> lk(cpp->out_mtx);
+  cpp->out_cond.wait(lk, [cpp] { return cpp->out_flushing || !cpp->out_queue.empty(); });
+  if (cpp->out_flushing) {
+    lk.unlock();
+    gst_pad_pause_task(self->srcpad);
+    return;
+  }
+  OutputFrame item = cpp->out_queue.front();
+  cpp->out_queue.pop_front();
+  // room for decoder waiting, and for destroy waiting for queue to be drained
+  cpp->out_cond.notify_all();
+  lk.unlock();
+
+  if (item.eos) {
+    gst_pad_push_event(self->srcpad, gst_event_new_eos());
+    return;
+  }
+
+  auto tick = g_get_monotonic_time();
+  if (!update_output_caps(self, item.frame)) {
+    GST_CNVIDEODEC_ERROR(self, CORE, NEGOTIATION, ("Set caps of %ux%u failed", item.frame->width, item.frame->height));
+    release_buffer(self, gst_cnvideodec_get_private(self)->decode, reinterpret_cast<uint64_t>(item.frame));
+    return;
+  }
+  GstBuffer* buffer = make_buffer(self, item);
+  if (!buffer) {
+    return;
+  }
   if (!GST_PAD_IS_EOS(self->srcpad)) {
     GST_TRACE_OBJECT(self, "Push frame to srcpad");
     GstFlowReturn ret = gst_pad_push(self->srcpad, buffer);
-    if (GST_FLOW_OK != ret) {
+    if (GST_FLOW_OK != ret && GST_FLOW_FLUSHING != ret) {
       GST_ERROR_OBJECT(self, "gst pad push error: %d", ret);
     }
   } else {
@@ -1088,6 +1992,6 @@ handle_frame(GstCnvideodec* self, cnvideoDecOutput* out)
 
   tick = (g_get_monotonic_time() - tick) / G_TIME_SPAN_MILLISECOND;
   if (tick > 60) {
-    GST_WARNING_OBJECT(self, "%s(%d,%p) takes %ldms\n", __FUNCTION__, self->stream_id, buffer, tick);
+    GST_WARNING_OBJECT(self, "%s(%d) takes %ldms\n", __FUNCTION__, self->stream_id, tick);
   }
 }
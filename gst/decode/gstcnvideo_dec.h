@@ -34,6 +34,22 @@ G_BEGIN_DECLS
 typedef struct _GstCnvideodec GstCnvideodec;
 typedef struct _GstCnvideodecClass GstCnvideodecClass;
 
+// what to do with decoded frames when output queue is full
+typedef enum
+{
+  GST_CNVIDEODEC_LEAKY_NO = 0,
+  GST_CNVIDEODEC_LEAKY_UPSTREAM,
+  GST_CNVIDEODEC_LEAKY_DOWNSTREAM,
+} GstCnvideodecLeaky;
+
+// pictures fed to decoder
+typedef enum
+{
+  GST_CNVIDEODEC_DECODE_MODE_ALL = 0,
+  GST_CNVIDEODEC_DECODE_MODE_KEYFRAMES,
+  GST_CNVIDEODEC_DECODE_MODE_REFERENCE_ONLY,
+} GstCnvideodecDecodeMode;
+
 struct _GstCnvideodec
 {
   GstElement element;
@@ -45,6 +61,13 @@ struct _GstCnvideodec
   guint stream_id;
   guint input_buffer_num;
   guint output_buffer_num;
+  guint output_queue_size;
+  GstCnvideodecLeaky output_leaky;
+  GstCnvideodecDecodeMode decode_mode;
+  guint output_interval;
+  guint decoder_pool_size;
+  gboolean low_latency;
+  guint input_pool_size;
 };
 
 struct _GstCnvideodecClass
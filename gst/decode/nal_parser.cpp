@@ -0,0 +1,107 @@
+/*
+ *  Copyright (C) [2019-2020] by Cambricon, Inc.
+ *
+ *  This file is part of CNStream-Gst.
+ *
+ *  CNStream-Gst is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU Lesser General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  CNStream-Gst is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU Lesser General Public License for more details.
+ *
+ *  You should have received a copy of the GNU Lesser General Public License
+ *  along with CNStream-Gst.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#include "nal_parser.h"
+
+bool
+NalFilter::keep_h264(const NalUnit& nal)
+{
+  guint type = nal.data[0] & 0x1f;
+  guint ref_idc = (nal.data[0] >> 5) & 0x3;
+  // coded slice of non-IDR and IDR picture
+  if (type != 1 && type != 5) {
+    return true;
+  }
+  if (mode_ == GST_CNVIDEODEC_DECODE_MODE_REFERENCE_ONLY) {
+    return ref_idc != 0;
+  }
+
+  NalBitReader reader(nal.data + 1, nal.size - 1);
+  guint first_mb_in_slice = reader.read_ue();
+  guint slice_type = reader.read_ue();
+  if (reader.failed()) {
+    return keep_picture_;
+  }
+  if (first_mb_in_slice == 0) {
+    // I and SI slices
+    keep_picture_ = type == 5 || slice_type % 5 == 2 || slice_type % 5 == 4;
+  }
+  return keep_picture_;
+}
+
+bool
+NalFilter::keep_h265(const NalUnit& nal)
+{
+  if (nal.size < 2) {
+    return true;
+  }
+  guint type = (nal.data[0] >> 1) & 0x3f;
+  guint temporal_id = (nal.data[1] & 0x7) - 1;
+  // VCL units are 0 - 31
+  if (type > 31) {
+    return true;
+  }
+  if (mode_ == GST_CNVIDEODEC_DECODE_MODE_KEYFRAMES) {
+    // IRAP pictures, BLA, IDR and CRA
+    return type >= 16 && type <= 23;
+  }
+
+  max_temporal_id_ = MAX(max_temporal_id_, temporal_id);
+  // TRAIL_N, TSA_N, STSA_N, RADL_N, RASL_N and reserved, not referenced by pictures of the same sub-layer
+  bool sub_layer_non_reference = type <= 14 && type % 2 == 0;
+  return !(sub_layer_non_reference && temporal_id >= max_temporal_id_);
+}
+
+guint
+NalFilter::filter(const guint8* data, gsize size, std::vector<guint8>* out)
+{
+  static const guint8 start_code[] = { 0, 0, 0, 1 };
+  guint dropped = 0;
+  for (const auto& nal : split_annexb(data, size)) {
+    bool keep = mode_ == GST_CNVIDEODEC_DECODE_MODE_ALL || (hevc_ ? keep_h265(nal) : keep_h264(nal));
+    if (!keep) {
+      dropped++;
+      continue;
+    }
+    out->insert(out->end(), start_code, start_code + sizeof(start_code));
+    out->insert(out->end(), nal.data, nal.data + nal.size);
+  }
+  return dropped;
+}
+
+void
+NalFilter::reset()
+{
+  keep_picture_ = true;
+  max_temporal_id_ = 0;
+}
+
+bool
+annexb_has_slice(bool hevc, const guint8* data, gsize size)
+{
+  auto units = split_annexb(data, size);
+  for (const auto& nal : units) {
+    guint type = hevc ? (nal.data[0] >> 1) & 0x3f : nal.data[0] & 0x1f;
+    if (hevc ? type < 32 : type >= 1 && type <= 5) {
+      return true;
+    }
+  }
+  // data without start code is not understood, it is taken as a picture
+  return units.empty();
+}
@@ -0,0 +1,62 @@
+/*
+ *  Copyright (C) [2019-2020] by Cambricon, Inc.
+ *
+ *  This file is part of CNStream-Gst.
+ *
+ *  CNStream-Gst is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU Lesser General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  CNStream-Gst is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU Lesser General Public License for more details.
+ *
+ *  You should have received a copy of the GNU Lesser General Public License
+ *  along with CNStream-Gst.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#ifndef GST_DECODE_NAL_PARSER_H_
+#define GST_DECODE_NAL_PARSER_H_
+
+#include <gst/gst.h>
+
+#include <vector>
+
+#include "common/h26x_parser.h"
+#include "gstcnvideo_dec.h"
+
+/**
+ * Drops NAL units of pictures not needed in decode mode before they reach the decoder. Parameter sets and other
+ * non-VCL units always pass.
+ */
+class NalFilter
+{
+public:
+  NalFilter(bool hevc, GstCnvideodecDecodeMode mode)
+    : hevc_(hevc)
+    , mode_(mode)
+  {}
+
+  // appends units kept to out with 4 bytes start codes, returns number of slices dropped
+  guint filter(const guint8* data, gsize size, std::vector<guint8>* out);
+  void reset();
+
+private:
+  bool keep_h264(const NalUnit& nal);
+  bool keep_h265(const NalUnit& nal);
+
+  bool hevc_;
+  GstCnvideodecDecodeMode mode_;
+  // decision made on the first slice of picture, applied to the rest of its slices
+  bool keep_picture_ = true;
+  // highest temporal id seen, sub-layer non-reference pictures below it may still be referenced
+  guint max_temporal_id_ = 0;
+};
+
+// whether Annex-B data has a VCL unit, data of only parameter sets and SEI carries no picture
+bool
+annexb_has_slice(bool hevc, const guint8* data, gsize size);
+
+#endif // GST_DECODE_NAL_PARSER_H_
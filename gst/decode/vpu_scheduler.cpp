@@ -0,0 +1,90 @@
+/*
+ *  Copyright (C) [2019-2020] by Cambricon, Inc.
+ *
+ *  This file is part of CNStream-Gst.
+ *
+ *  CNStream-Gst is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU Lesser General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  CNStream-Gst is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU Lesser General Public License for more details.
+ *
+ *  You should have received a copy of the GNU Lesser General Public License
+ *  along with CNStream-Gst.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#include "vpu_scheduler.h"
+
+#include <map>
+#include <memory>
+
+// instances of decoder on each device
+static constexpr guint VPU_INSTANCES = 6;
+
+VpuScheduler::VpuScheduler(guint n_instances)
+  : loads_(MAX(n_instances, 1))
+{}
+
+VpuScheduler*
+VpuScheduler::get(gint device_id)
+{
+  static std::mutex mutex;
+  static std::map<gint, std::unique_ptr<VpuScheduler>> schedulers;
+  std::lock_guard<std::mutex> lk(mutex);
+  auto& scheduler = schedulers[device_id];
+  if (!scheduler) {
+    scheduler.reset(new VpuScheduler(VPU_INSTANCES));
+  }
+  return scheduler.get();
+}
+
+guint
+VpuScheduler::acquire(guint64 pixel_rate)
+{
+  std::lock_guard<std::mutex> lk(mutex_);
+  guint best = 0;
+  for (guint i = 1; i < loads_.size(); ++i) {
+    const Load& a = loads_[i];
+    const Load& b = loads_[best];
+    if (a.pixel_rate < b.pixel_rate || (a.pixel_rate == b.pixel_rate && a.streams < b.streams)) {
+      best = i;
+    }
+  }
+  loads_[best].streams++;
+  loads_[best].pixel_rate += pixel_rate;
+  return best;
+}
+
+void
+VpuScheduler::take(guint instance, guint64 pixel_rate)
+{
+  std::lock_guard<std::mutex> lk(mutex_);
+  if (instance >= loads_.size()) {
+    return;
+  }
+  loads_[instance].streams++;
+  loads_[instance].pixel_rate += pixel_rate;
+}
+
+void
+VpuScheduler::release(guint instance, guint64 pixel_rate)
+{
+  std::lock_guard<std::mutex> lk(mutex_);
+  if (instance >= loads_.size() || loads_[instance].streams == 0) {
+    return;
+  }
+  Load& load = loads_[instance];
+  load.streams--;
+  load.pixel_rate = load.streams ? load.pixel_rate - MIN(load.pixel_rate, pixel_rate) : 0;
+}
+
+std::vector<VpuScheduler::Load>
+VpuScheduler::loads() const
+{
+  std::lock_guard<std::mutex> lk(mutex_);
+  return loads_;
+}
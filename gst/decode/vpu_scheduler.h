@@ -0,0 +1,62 @@
+/*
+ *  Copyright (C) [2019-2020] by Cambricon, Inc.
+ *
+ *  This file is part of CNStream-Gst.
+ *
+ *  CNStream-Gst is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU Lesser General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  CNStream-Gst is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU Lesser General Public License for more details.
+ *
+ *  You should have received a copy of the GNU Lesser General Public License
+ *  along with CNStream-Gst.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#ifndef GST_DECODE_VPU_SCHEDULER_H_
+#define GST_DECODE_VPU_SCHEDULER_H_
+
+#include <gst/gst.h>
+
+#include <mutex>
+#include <vector>
+
+/**
+ * Assigns decoders to VPU instances of a device by load. Decoders stay on the instance they are created on, slots
+ * released on teardown are taken by the next decoders. Instances are plain indexes, so that policy is tested without
+ * hardware.
+ */
+class VpuScheduler
+{
+public:
+  struct Load
+  {
+    guint streams = 0;
+    // pixels decoded per second
+    guint64 pixel_rate = 0;
+  };
+
+  explicit VpuScheduler(guint n_instances);
+  VpuScheduler(const VpuScheduler&) = delete;
+  VpuScheduler& operator=(const VpuScheduler&) = delete;
+
+  // scheduler of a device, created on first use
+  static VpuScheduler* get(gint device_id);
+
+  // takes a slot on the instance with the lowest pixel rate, then the fewest streams, returns index of the instance
+  guint acquire(guint64 pixel_rate);
+  // takes a slot on instance a decoder is already bound to
+  void take(guint instance, guint64 pixel_rate);
+  void release(guint instance, guint64 pixel_rate);
+  std::vector<Load> loads() const;
+
+private:
+  mutable std::mutex mutex_;
+  std::vector<Load> loads_;
+};
+
+#endif // GST_DECODE_VPU_SCHEDULER_H_
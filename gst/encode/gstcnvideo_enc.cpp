@@ -321,7 +321,9 @@ static GstStaticPadTemplate sink_factory =
   GST_STATIC_PAD_TEMPLATE("sink",
                           GST_PAD_SINK,
                           GST_PAD_ALWAYS,
-                          GST_STATIC_CAPS(GST_VIDEO_CAPS_MAKE("{ NV12, NV21, I420, BGRA, RGBA, ABGR, ARGB, RGB, BGR }")));
+                          GST_STATIC_CAPS(GST_VIDEO_CAPS_MAKE_WITH_FEATURES(
+                            GST_CAPS_FEATURE_MEMORY_MLU, "{ NV12, NV21, I420, BGRA, RGBA, ABGR, ARGB, RGB, BGR }") ";"
+                            GST_VIDEO_CAPS_MAKE("{ NV12, NV21, I420, BGRA, RGBA, ABGR, ARGB, RGB, BGR }")));
 
 static GstStaticPadTemplate src_factory =
   GST_STATIC_PAD_TEMPLATE("src",
@@ -350,6 +352,7 @@ struct GstCnvideoencPrivate
   gboolean send_eos;
   gboolean got_eos;
   gboolean first_frame;
+  gboolean input_on_mlu;
   guint64 frame_id;
   GstSyncedMemory_t cncv_workspace;
   GstSyncedMemory_t tmp_rgb;
@@ -593,6 +596,7 @@ gst_cnvideoenc_init(GstCnvideoenc* self)
   priv->rate_control.constPQP = DEFAULT_P_QP;
   priv->rate_control.constBQP = DEFAULT_B_QP;
   priv->cncv_workspace = nullptr;
+  priv->input_on_mlu = FALSE;
   priv->tmp_rgb = nullptr;
   priv->handle = nullptr;
   priv->queue = nullptr;
@@ -824,6 +828,9 @@ gst_cnvideoenc_set_caps(GstCnvideoenc* self, GstCaps* caps)
   if (priv->pixel_format == CNCODEC_PIX_FMT_RAW)
     return FALSE;
 
+  priv->input_on_mlu = gst_caps_features_contains(gst_caps_get_features(caps, 0), GST_CAPS_FEATURE_MEMORY_MLU);
+  GST_INFO_OBJECT(self, "input frames on %s", priv->input_on_mlu ? "mlu" : "host");
+
   // invalid fps
   if (self->video_info.fps_n == 0 || self->video_info.fps_d == 0) {
     GST_INFO_OBJECT(self, "use default framerate 30000/1001");
@@ -1006,8 +1013,10 @@ gst_cnvideoenc_init_encoder(GstCnvideoenc* self)
 
   g_return_val_if_fail(set_cnrt_env(GST_ELEMENT(self), self->device_id), FALSE);
 
-  if (self->video_info.finfo->format == GST_VIDEO_FORMAT_BGR ||
-      self->video_info.finfo->format == GST_VIDEO_FORMAT_RGB) {
+  gboolean is_rgb = self->video_info.finfo->format == GST_VIDEO_FORMAT_BGR ||
+                    self->video_info.finfo->format == GST_VIDEO_FORMAT_RGB;
+  // frames on mlu are converted or copied straight into encoder input buffers, no staging needed
+  if (is_rgb && !priv->input_on_mlu) {
     size_t frame_size = self->video_info.stride[0] * self->video_info.height;
     if (priv->tmp_rgb && cn_syncedmem_get_size(priv->tmp_rgb) < frame_size) {
       cn_syncedmem_free(priv->tmp_rgb);
@@ -1016,12 +1025,16 @@ gst_cnvideoenc_init_encoder(GstCnvideoenc* self)
     if (!priv->tmp_rgb) {
       priv->tmp_rgb = cn_syncedmem_new(frame_size);
     }
-    if (!priv->handle) {
-      CNCV_SAFECALL(cncvCreate(&priv->handle), FALSE);
-    }
+  }
+  if (is_rgb || priv->input_on_mlu) {
     if (!priv->queue) {
       CNRT_SAFECALL(cnrtCreateQueue(&priv->queue), FALSE);
     }
+  }
+  if (is_rgb) {
+    if (!priv->handle) {
+      CNCV_SAFECALL(cncvCreate(&priv->handle), FALSE);
+    }
     CNCV_SAFECALL(cncvSetQueue(priv->handle, priv->queue), FALSE);
   }
 
@@ -1204,6 +1217,49 @@ copy_frame(GstCnvideoenc* self, cncodecFrame* dst, const GstVideoFrame& src)
   return TRUE;
 }
 
+// copies planes into input buffer laid out with strides of encoder, which may differ from strides of the frame
+static gboolean
+copy_mlu_frame(GstCnvideoenc* self, cncodecFrame* dst, GstMluFrame_t src)
+{
+  auto priv = gst_cnvideoenc_get_private(self);
+  const GstVideoInfo* info = &self->video_info;
+  // planes of formats on MLU starts with the component of the same index, e.g. y and uv of NV12
+  for (guint i = 0; i < src->n_planes; ++i) {
+    auto dst_plane = reinterpret_cast<guint8*>(dst->plane[i].addr);
+    auto src_plane = static_cast<guint8*>(const_cast<void*>(cn_syncedmem_get_dev_data(src->data[i])));
+    gsize rows = GST_VIDEO_INFO_COMP_HEIGHT(info, i);
+    gsize row_size = GST_VIDEO_INFO_COMP_WIDTH(info, i) * GST_VIDEO_INFO_COMP_PSTRIDE(info, i);
+    gsize dst_stride = dst->stride[i];
+    gsize src_stride = src->stride[i];
+    if (dst_stride < row_size || src_stride < row_size) {
+      GST_CNVIDEOENC_ERROR(self, STREAM, FORMAT,
+                           ("plane %u of %lu bytes per row, stride %lu of frame, %lu of encoder", i, row_size,
+                            src_stride, dst_stride));
+      return FALSE;
+    }
+    GST_DEBUG_OBJECT(self, "Copy frame plane %u on device, stride %lu to %lu", i, src_stride, dst_stride);
+    if (dst_stride == src_stride) {
+      CNRT_SAFECALL(cnrtMemcpyAsync(dst_plane, src_plane, src_stride * rows, priv->queue, CNRT_MEM_TRANS_DIR_DEV2DEV),
+                    FALSE);
+      continue;
+    }
+#if CNRT_MAJOR_VERSION < 5
+    // no 2D copy, rows are queued one by one and waited for together
+    for (gsize row = 0; row < rows; ++row) {
+      CNRT_SAFECALL(cnrtMemcpyAsync(dst_plane + row * dst_stride, src_plane + row * src_stride, row_size, priv->queue,
+                                    CNRT_MEM_TRANS_DIR_DEV2DEV),
+                    FALSE);
+    }
+#else
+    CNRT_SAFECALL(cnrtMemcpy2D(dst_plane, dst_stride, src_plane, src_stride, row_size, rows,
+                               CNRT_MEM_TRANS_DIR_DEV2DEV),
+                  FALSE);
+#endif
+  }
+  CNRT_SAFECALL(cnrtSyncQueue(priv->queue), FALSE);
+  return TRUE;
+}
+
 static inline cncvPixelFormat format_cast(GstVideoFormat fmt)
 {
   switch (fmt) {
@@ -1248,11 +1304,12 @@ static inline cncvImageDescriptor video_info_to_desc(const GstVideoInfo& info)
 }
 
 static gboolean
-rgb2rgba(GstCnvideoenc* self, GstSyncedMemory_t src, cncodecFrame* dst)
+rgb2rgba(GstCnvideoenc* self, void* src, guint src_stride, cncodecFrame* dst)
 {
   GstCnvideoencPrivate* priv = gst_cnvideoenc_get_private(self);
 
   cncvImageDescriptor src_desc = video_info_to_desc(self->video_info);
+  src_desc.stride[0] = src_stride;
   cncvImageDescriptor dst_desc = src_desc;
   dst_desc.pixel_fmt = g_default_pix_fmt_cncv;
   dst_desc.stride[0] = dst_desc.width * 4;
@@ -1276,7 +1333,7 @@ rgb2rgba(GstCnvideoenc* self, GstSyncedMemory_t src, cncodecFrame* dst)
   }
 
   void** buf_host = reinterpret_cast<void**>(cn_syncedmem_get_mutable_host_data(priv->cncv_workspace));
-  buf_host[0] = cn_syncedmem_get_mutable_dev_data(src);
+  buf_host[0] = src;
   buf_host[1] = reinterpret_cast<void*>(dst->plane[0].addr);
   buf_host = nullptr;
   void** buf_dev = reinterpret_cast<void**>(const_cast<void*>(cn_syncedmem_get_dev_data(priv->cncv_workspace)));
@@ -1308,12 +1365,37 @@ encode_frame(GstCnvideoenc* self, GstBuffer* buf)
     cnrt_env = true;
   }
 
-  if (!gst_video_frame_map(&gst_frame, &self->video_info, buf, GST_MAP_READ)) {
+  gboolean is_rgb = self->video_info.finfo->format == GST_VIDEO_FORMAT_RGB ||
+                    self->video_info.finfo->format == GST_VIDEO_FORMAT_BGR;
+  GstMluFrame_t mlu_frame = nullptr;
+  gst_frame.buffer = nullptr;
+  auto unmap_func = [&gst_frame]() {
+    if (gst_frame.buffer)
+      gst_video_frame_unmap(&gst_frame);
+  };
+  ScopeGuard<decltype(unmap_func)> map_guard(std::move(unmap_func));
+
+  if (priv->input_on_mlu) {
+    MluMemoryMeta_t meta = gst_buffer_get_mlu_memory_meta(buf);
+    if (!meta || !meta->frame) {
+      GST_CNVIDEOENC_ERROR(self, RESOURCE, READ, ("get meta failed"));
+      return FALSE;
+    }
+    mlu_frame = meta->frame;
+    if (mlu_frame->device_id != self->device_id) {
+      GST_CNVIDEOENC_ERROR(self, RESOURCE, SETTINGS,
+                           ("frame on device %d, encoder on device %d", mlu_frame->device_id, self->device_id));
+      return FALSE;
+    }
+    // wait for the producer, e.g. cnconvert, to finish writing the frame
+    if (!gst_mlu_frame_sync(mlu_frame)) {
+      GST_CNVIDEOENC_ERROR(self, RESOURCE, READ, ("sync mlu frame failed"));
+      return FALSE;
+    }
+  } else if (!gst_video_frame_map(&gst_frame, &self->video_info, buf, GST_MAP_READ)) {
     GST_WARNING_OBJECT(self, "buffer map failed %" GST_PTR_FORMAT, buf);
     return FALSE;
   }
-  auto unmap_func = [&gst_frame]() { gst_video_frame_unmap(&gst_frame); };
-  ScopeGuard<decltype(unmap_func)> map_guard(std::move(unmap_func));
 
   int ecode = cnvideoEncWaitAvailInputBuf(priv->encode, &input.frame, 10000);
   if (CNCODEC_SUCCESS != ecode) {
@@ -1321,11 +1403,20 @@ encode_frame(GstCnvideoenc* self, GstBuffer* buf)
     return FALSE;
   }
 
-  if (self->video_info.finfo->format == GST_VIDEO_FORMAT_RGB ||
-      self->video_info.finfo->format == GST_VIDEO_FORMAT_BGR) {
+  if (mlu_frame) {
+    // device to device only, rgb is converted by cncv straight into the encoder input buffer
+    if (is_rgb) {
+      void* src = const_cast<void*>(cn_syncedmem_get_dev_data(mlu_frame->data[0]));
+      if (!rgb2rgba(self, src, mlu_frame->stride[0], &input.frame)) {
+        return FALSE;
+      }
+    } else if (!copy_mlu_frame(self, &input.frame, mlu_frame)) {
+      return FALSE;
+    }
+  } else if (is_rgb) {
     size_t frame_size = gst_frame.info.stride[0] * gst_frame.info.height;
     edk::MluMemoryOp::MemcpyH2D(cn_syncedmem_get_mutable_dev_data(priv->tmp_rgb), gst_frame.data[0], frame_size);
-    if (!rgb2rgba(self, priv->tmp_rgb, &input.frame)) {
+    if (!rgb2rgba(self, cn_syncedmem_get_mutable_dev_data(priv->tmp_rgb), gst_frame.info.stride[0], &input.frame)) {
       return FALSE;
     }
   } else {
@@ -1335,15 +1426,21 @@ encode_frame(GstCnvideoenc* self, GstBuffer* buf)
   }
   input.frame.pixelFmt = priv->pixel_format;
   input.frame.colorSpace = COLOR_SPACE;
-  input.frame.width = gst_frame.info.width;
-  input.frame.height = gst_frame.info.height;
+  input.frame.width = self->video_info.width;
+  input.frame.height = self->video_info.height;
   input.pts = GST_BUFFER_PTS(buf);
-  for (uint32_t i = 0; i < GST_VIDEO_INFO_N_PLANES(&(gst_frame.info)); ++i) {
-    input.frame.stride[i] = gst_frame.info.stride[i];
+  // frames on MLU are copied with strides of input buffer, which stay as encoder reports them
+  if (is_rgb) {
+    // converted to g_default_pix_fmt_cncv by rgb2rgba
+    input.frame.stride[0] = self->video_info.width * 4;
+  } else if (!mlu_frame) {
+    for (uint32_t i = 0; i < GST_VIDEO_INFO_N_PLANES(&self->video_info); ++i) {
+      input.frame.stride[i] = gst_frame.info.stride[i];
+    }
   }
 
-  GST_DEBUG_OBJECT(self, "Feed video frame info) data: %p, length: %lu, ptr: %lu", gst_frame.data[0],
-                   gst_frame.info.size, input.pts);
+  GST_DEBUG_OBJECT(self, "Feed video frame from %s, length: %lu, pts: %lu", mlu_frame ? "mlu" : "host",
+                   self->video_info.size, input.pts);
   // send data to codec
   if (priv->encode) {
     ecode = cnvideoEncFeedFrame(priv->encode, &input, 10000);
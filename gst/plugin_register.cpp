@@ -20,10 +20,13 @@
 #include <gst/gst.h>
 
 #ifdef WITH_DECODE
+#include "decode/gstcnmultidec.h"
 #include "decode/gstcnvideo_dec.h"
 #endif
 #ifdef WITH_CONVERT
+#include "convert/gstcnbatchconvert.h"
 #include "convert/gstcnconvert.h"
+#include "convert/gstcnmultiscale.h"
 #endif
 #ifdef WITH_ENCODE
 #include "encode/gstcnvideo_enc.h"
@@ -56,9 +59,12 @@ plugin_init(GstPlugin* plugin)
                           "Cambricon Neuware Stream Kit debug category");
 #ifdef WITH_DECODE
   ret &= gst_element_register(plugin, "cnvideo_dec", GST_RANK_NONE, GST_TYPE_CNVIDEODEC);
+  ret &= gst_element_register(plugin, "cnmultidec", GST_RANK_NONE, GST_TYPE_CNMULTIDEC);
 #endif
 #ifdef WITH_CONVERT
   ret &= gst_element_register(plugin, "cnconvert", GST_RANK_NONE, GST_TYPE_CNCONVERT);
+  ret &= gst_element_register(plugin, "cnbatchconvert", GST_RANK_NONE, GST_TYPE_CNBATCHCONVERT);
+  ret &= gst_element_register(plugin, "cnmultiscale", GST_RANK_NONE, GST_TYPE_CNMULTISCALE);
 #endif
 #ifdef WITH_ENCODE
   ret &= gst_element_register(plugin, "cnvideo_enc", GST_RANK_NONE, GST_TYPE_CNVIDEOENC);
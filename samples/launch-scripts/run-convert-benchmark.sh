@@ -0,0 +1,24 @@
+#!/bin/bash
+# Compares fused and two-pass rgb resize of cnconvert, 1080p RGBA to 416x416 BGR on MLU.
+# $1: number of frames, 1000 by default
+# $2: debug level
+CURRENT_DIR=$(readlink -f $(dirname $0))
+NUM_FRAMES=${1:-1000}
+
+if [ -n "${NEUWARE_HOME}" ]; then
+  export LD_LIBRARY_PATH=$LD_LIBRARY_PATH:$NEUWARE_HOME/lib64
+else
+  export LD_LIBRARY_PATH=$LD_LIBRARY_PATH:/usr/local/neuware/lib64
+fi
+
+export GST_DEBUG=$2
+export GST_PLUGIN_PATH=$GST_PLUGIN_PATH:$CURRENT_DIR/../../lib
+
+# the first cnconvert only uploads frames, so both runs pay the same upload cost
+for FUSE in true false; do
+  echo "fuse-rgb-resize=${FUSE}, ${NUM_FRAMES} frames"
+  gst-launch-1.0 videotestsrc num-buffers=${NUM_FRAMES} pattern=black ! \
+    "video/x-raw, format=RGBA, width=1920, height=1080" ! cnconvert ! \
+    "video/x-raw(memory:mlu), format=RGBA, width=1920, height=1080" ! cnconvert fuse-rgb-resize=${FUSE} ! \
+    "video/x-raw(memory:mlu), format=BGR, width=416, height=416" ! fakesink sync=false | grep "Execution ended"
+done
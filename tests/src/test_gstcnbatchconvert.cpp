@@ -0,0 +1,198 @@
+/* 
+ *  Copyright (C) [2019-2020] by Cambricon, Inc.
+ * 
+ *  This file is part of CNStream-Gst.
+ *
+ *  CNStream-Gst is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU Lesser General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ * 
+ *  CNStream-Gst is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU Lesser General Public License for more details.
+ * 
+ *  You should have received a copy of the GNU Lesser General Public License
+ *  along with CNStream-Gst.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#ifdef WITH_CONVERT
+
+#include <gst/check/gstcheck.h>
+#include <unistd.h>
+
+GST_START_TEST(test_create_and_destroy)
+{
+  GstElement* convert;
+
+  convert = gst_check_setup_element("cnbatchconvert");
+  fail_if(!convert);
+
+  gst_check_teardown_element(convert);
+}
+GST_END_TEST;
+
+GST_START_TEST(test_request_pads)
+{
+  GstElement* convert = gst_check_setup_element("cnbatchconvert");
+  fail_if(!convert);
+
+  // each sink pad has its own src pad
+  GstPad* sink0 = gst_element_get_request_pad(convert, "sink_%u");
+  GstPad* sink1 = gst_element_get_request_pad(convert, "sink_5");
+  fail_unless(sink0 && sink1);
+  fail_unless(g_strcmp0(GST_PAD_NAME(sink0), "sink_0") == 0);
+  fail_unless(g_strcmp0(GST_PAD_NAME(sink1), "sink_5") == 0);
+  fail_unless(gst_element_get_request_pad(convert, "sink_5") == NULL);
+
+  GstPad* src1 = gst_element_get_static_pad(convert, "src_5");
+  fail_unless(src1 != NULL);
+  GstIterator* it = gst_pad_iterate_internal_links(src1);
+  GValue val = G_VALUE_INIT;
+  fail_unless(gst_iterator_next(it, &val) == GST_ITERATOR_OK);
+  fail_unless(g_value_get_object(&val) == sink1);
+  g_value_unset(&val);
+  gst_iterator_free(it);
+  gst_object_unref(src1);
+
+  gst_element_release_request_pad(convert, sink1);
+  gst_object_unref(sink1);
+  GstPad* removed = gst_element_get_static_pad(convert, "src_5");
+  fail_unless(removed == NULL);
+
+  GstPad* sink2 = gst_element_get_request_pad(convert, "sink_%u");
+  fail_unless(g_strcmp0(GST_PAD_NAME(sink2), "sink_6") == 0);
+
+  gst_element_release_request_pad(convert, sink0);
+  gst_element_release_request_pad(convert, sink2);
+  gst_object_unref(sink0);
+  gst_object_unref(sink2);
+  gst_check_teardown_element(convert);
+}
+GST_END_TEST;
+
+GST_START_TEST(test_properties)
+{
+  GstElement* convert = gst_check_setup_element("cnbatchconvert");
+  fail_if(!convert);
+
+  guint batch_size = 0, timeout = 0;
+  g_object_set(convert, "batch-size", 32, "timeout", 5, NULL);
+  g_object_get(convert, "batch-size", &batch_size, "timeout", &timeout, NULL);
+  fail_unless(batch_size == 32 && timeout == 5);
+
+  // worker is started and stopped with element
+  ASSERT_SET_STATE(convert, GST_STATE_PAUSED, GST_STATE_CHANGE_SUCCESS);
+  ASSERT_SET_STATE(convert, GST_STATE_NULL, GST_STATE_CHANGE_SUCCESS);
+  gst_check_teardown_element(convert);
+}
+GST_END_TEST;
+
+#ifdef WITH_DECODE
+static void
+count_handoff(GstElement* sink, GstBuffer* buffer, GstPad* pad, gpointer user_data)
+{
+  g_atomic_int_inc(reinterpret_cast<gint*>(user_data));
+}
+
+// worker started again after PAUSED -> READY -> PAUSED binds device as the first one did
+GST_START_TEST(test_restart)
+{
+  gchar current_path[128];
+  memset(current_path, 0x00, sizeof(current_path));
+  fail_unless(getcwd(current_path, sizeof(current_path) - 1));
+  gchar* desc = g_strdup_printf("filesrc location=%s/../samples/data/videos/1080P.h264 ! h264parse ! cnvideo_dec ! "
+                                "cnbatchconvert batch-size=1 ! video/x-raw(memory:mlu), format=RGBA, width=320, "
+                                "height=240 ! fakesink name=sink signal-handoffs=true sync=false",
+                                current_path);
+  GstElement* pipeline = gst_parse_launch(desc, NULL);
+  g_free(desc);
+  fail_unless(pipeline != NULL);
+  GstElement* sink = gst_bin_get_by_name(GST_BIN(pipeline), "sink");
+  gint n_frames = 0;
+  g_signal_connect(sink, "handoff", G_CALLBACK(count_handoff), &n_frames);
+  GstBus* bus = gst_element_get_bus(pipeline);
+
+  for (int pass = 0; pass < 2; ++pass) {
+    g_atomic_int_set(&n_frames, 0);
+    fail_unless(gst_element_set_state(pipeline, GST_STATE_PLAYING) != GST_STATE_CHANGE_FAILURE);
+    GstMessage* msg =
+      gst_bus_timed_pop_filtered(bus, GST_CLOCK_TIME_NONE, (GstMessageType)(GST_MESSAGE_EOS | GST_MESSAGE_ERROR));
+    fail_unless(msg && GST_MESSAGE_TYPE(msg) == GST_MESSAGE_EOS);
+    gst_message_unref(msg);
+    fail_unless(g_atomic_int_get(&n_frames) > 0);
+    ASSERT_SET_STATE(pipeline, GST_STATE_READY, GST_STATE_CHANGE_SUCCESS);
+  }
+
+  gst_element_set_state(pipeline, GST_STATE_NULL);
+  gst_object_unref(bus);
+  gst_object_unref(sink);
+  gst_object_unref(pipeline);
+}
+GST_END_TEST;
+
+// frames of two streams fill batches of two, each stream gets all its frames back on its own src pad
+GST_START_TEST(test_two_streams)
+{
+  gchar current_path[128];
+  memset(current_path, 0x00, sizeof(current_path));
+  fail_unless(getcwd(current_path, sizeof(current_path) - 1));
+  gchar* location = g_strdup_printf("%s/../samples/data/videos/1080P.h264", current_path);
+  gchar* desc = g_strdup_printf(
+    "cnbatchconvert name=batch batch-size=2 timeout=100 "
+    "filesrc location=%s ! h264parse ! cnvideo_dec ! batch.sink_0 "
+    "filesrc location=%s ! h264parse ! cnvideo_dec ! batch.sink_1 "
+    "batch.src_0 ! video/x-raw(memory:mlu), format=RGBA, width=320, height=240 ! "
+    "fakesink name=sink0 signal-handoffs=true sync=false "
+    "batch.src_1 ! video/x-raw(memory:mlu), format=RGBA, width=320, height=240 ! "
+    "fakesink name=sink1 signal-handoffs=true sync=false",
+    location, location);
+  g_free(location);
+  GstElement* pipeline = gst_parse_launch(desc, NULL);
+  g_free(desc);
+  fail_unless(pipeline != NULL);
+  gint n_frames[2] = { 0, 0 };
+  for (gint i = 0; i < 2; ++i) {
+    gchar* name = g_strdup_printf("sink%d", i);
+    GstElement* sink = gst_bin_get_by_name(GST_BIN(pipeline), name);
+    g_free(name);
+    fail_unless(sink != NULL);
+    g_signal_connect(sink, "handoff", G_CALLBACK(count_handoff), &n_frames[i]);
+    gst_object_unref(sink);
+  }
+
+  GstBus* bus = gst_element_get_bus(pipeline);
+  fail_unless(gst_element_set_state(pipeline, GST_STATE_PLAYING) != GST_STATE_CHANGE_FAILURE);
+  GstMessage* msg =
+    gst_bus_timed_pop_filtered(bus, GST_CLOCK_TIME_NONE, (GstMessageType)(GST_MESSAGE_EOS | GST_MESSAGE_ERROR));
+  fail_unless(msg && GST_MESSAGE_TYPE(msg) == GST_MESSAGE_EOS);
+  gst_message_unref(msg);
+  gst_element_set_state(pipeline, GST_STATE_NULL);
+  gst_object_unref(bus);
+  gst_object_unref(pipeline);
+
+  fail_unless(n_frames[0] > 0);
+  fail_unless_equals_int(n_frames[1], n_frames[0]);
+}
+GST_END_TEST;
+#endif  // WITH_DECODE
+
+Suite*
+cnbatchconvert_suite(void)
+{
+  Suite* s = suite_create("cnbatchconvert");
+  TCase* tc_chain = tcase_create("general");
+
+  suite_add_tcase(s, tc_chain);
+  tcase_add_test(tc_chain, test_create_and_destroy);
+  tcase_add_test(tc_chain, test_request_pads);
+  tcase_add_test(tc_chain, test_properties);
+#ifdef WITH_DECODE
+  tcase_add_test(tc_chain, test_restart);
+  tcase_add_test(tc_chain, test_two_streams);
+#endif
+  return s;
+}
+
+#endif  // WITH_CONVERT
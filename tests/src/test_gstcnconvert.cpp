@@ -21,10 +21,14 @@
 
 #include <gst/check/gstbufferstraw.h>
 #include <gst/check/gstcheck.h>
+#include <gst/video/video.h>
 #include <unistd.h>
 #include <atomic>
 #include <cstdio>
 #include <cstring>
+#include <string>
+#include <vector>
+#include "common/letterbox_meta.h"
 #include "common/mlu_memory_meta.h"
 #include "convert/gstcnconvert.h"
 
@@ -57,6 +61,527 @@ GST_START_TEST(test_create_and_destroy)
 }
 GST_END_TEST;
 
+GST_START_TEST(test_in_flight_property)
+{
+  GstElement* convert = gst_check_setup_element("cnconvert");
+  fail_if(!convert);
+
+  guint in_flight = 1;
+  g_object_get(convert, "in-flight", &in_flight, NULL);
+  fail_unless(in_flight == 0);
+  g_object_set(convert, "in-flight", 4, NULL);
+  g_object_get(convert, "in-flight", &in_flight, NULL);
+  fail_unless(in_flight == 4);
+
+  gst_check_teardown_element(convert);
+}
+GST_END_TEST;
+
+GST_START_TEST(test_crop_property)
+{
+  GstElement* convert = gst_check_setup_element("cnconvert");
+  fail_if(!convert);
+
+  gchar* crop = NULL;
+  g_object_set(convert, "crop", "16,8,320,240", NULL);
+  g_object_get(convert, "crop", &crop, NULL);
+  fail_unless(g_strcmp0(crop, "16,8,320,240") == 0);
+  g_free(crop);
+
+  // invalid region is ignored
+  g_object_set(convert, "crop", "16,8,0,240", NULL);
+  g_object_get(convert, "crop", &crop, NULL);
+  fail_unless(crop == NULL);
+
+  gchar* roi_type = NULL;
+  g_object_set(convert, "roi-type", "face", NULL);
+  g_object_get(convert, "roi-type", &roi_type, NULL);
+  fail_unless(g_strcmp0(roi_type, "face") == 0);
+  g_free(roi_type);
+
+  gst_check_teardown_element(convert);
+}
+GST_END_TEST;
+
+GST_START_TEST(test_keep_aspect_ratio_property)
+{
+  GstElement* convert = gst_check_setup_element("cnconvert");
+  fail_if(!convert);
+
+  gboolean keep_aspect_ratio = TRUE;
+  guint pad_color = 1;
+  gint pad_position = -1;
+  g_object_get(convert, "keep-aspect-ratio", &keep_aspect_ratio, "pad-color", &pad_color, "pad-position",
+               &pad_position, NULL);
+  fail_unless(!keep_aspect_ratio && pad_color == 0 && pad_position == GST_CNCONVERT_PAD_CENTER);
+
+  gst_util_set_object_arg(G_OBJECT(convert), "pad-position", "top-left");
+  g_object_set(convert, "keep-aspect-ratio", TRUE, "pad-color", 0x727272, NULL);
+  g_object_get(convert, "keep-aspect-ratio", &keep_aspect_ratio, "pad-color", &pad_color, "pad-position",
+               &pad_position, NULL);
+  fail_unless(keep_aspect_ratio && pad_color == 0x727272 && pad_position == GST_CNCONVERT_PAD_TOP_LEFT);
+
+  gst_check_teardown_element(convert);
+}
+GST_END_TEST;
+
+GST_START_TEST(test_fuse_rgb_resize_property)
+{
+  GstElement* convert = gst_check_setup_element("cnconvert");
+  fail_if(!convert);
+
+  // opt-in, output of the fused kernel is not bit exact to resize then convert
+  gboolean fuse = TRUE;
+  g_object_get(convert, "fuse-rgb-resize", &fuse, NULL);
+  fail_unless(!fuse);
+  g_object_set(convert, "fuse-rgb-resize", TRUE, NULL);
+  g_object_get(convert, "fuse-rgb-resize", &fuse, NULL);
+  fail_unless(fuse);
+
+  gst_check_teardown_element(convert);
+}
+GST_END_TEST;
+
+GST_START_TEST(test_backend_property)
+{
+  GstElement* convert = gst_check_setup_element("cnconvert");
+  fail_if(!convert);
+
+  gint backend = -1;
+  g_object_get(convert, "backend", &backend, NULL);
+  fail_unless(backend == GST_CNCONVERT_BACKEND_AUTO);
+  gst_util_set_object_arg(G_OBJECT(convert), "backend", "cpu");
+  g_object_get(convert, "backend", &backend, NULL);
+  fail_unless(backend == GST_CNCONVERT_BACKEND_CPU);
+
+  gst_check_teardown_element(convert);
+}
+GST_END_TEST;
+
+GST_START_TEST(test_dtype_property)
+{
+  GstElement* convert = gst_check_setup_element("cnconvert");
+  fail_if(!convert);
+
+  gint dtype = -1;
+  g_object_get(convert, "dtype", &dtype, NULL);
+  fail_unless(dtype == GST_CNCONVERT_DTYPE_UINT8);
+  gst_util_set_object_arg(G_OBJECT(convert), "dtype", "float16");
+  g_object_get(convert, "dtype", &dtype, NULL);
+  fail_unless(dtype == GST_CNCONVERT_DTYPE_FLOAT16);
+
+  // tensors are offered on src pad
+  GstPad* srcpad = gst_element_get_static_pad(convert, "src");
+  GstCaps* tmpl_caps = gst_pad_get_pad_template_caps(srcpad);
+  GstCaps* tensor_caps = gst_caps_from_string("other/tensor(memory:mlu), dtype=(string)float16");
+  fail_unless(gst_caps_can_intersect(tmpl_caps, tensor_caps));
+  gst_caps_unref(tensor_caps);
+  gst_caps_unref(tmpl_caps);
+  gst_object_unref(srcpad);
+
+  gst_check_teardown_element(convert);
+}
+GST_END_TEST;
+
+GST_START_TEST(test_tensor_normalize_property)
+{
+  GstElement* convert = gst_check_setup_element("cnconvert");
+  fail_if(!convert);
+
+  gint layout = -1;
+  g_object_get(convert, "layout", &layout, NULL);
+  fail_unless(layout == GST_CNCONVERT_LAYOUT_NHWC);
+  gst_util_set_object_arg(G_OBJECT(convert), "layout", "nchw");
+  g_object_get(convert, "layout", &layout, NULL);
+  fail_unless(layout == GST_CNCONVERT_LAYOUT_NCHW);
+
+  gchar* mean = NULL;
+  g_object_set(convert, "mean", "123.7,116.3,103.5", "std", "58.4,57.1,57.4", NULL);
+  g_object_get(convert, "mean", &mean, NULL);
+  fail_unless(g_strcmp0(mean, "123.7,116.3,103.5") == 0);
+  g_free(mean);
+
+  // zero std is ignored
+  gchar* std = NULL;
+  g_object_set(convert, "std", "58.4,0,57.4", NULL);
+  g_object_get(convert, "std", &std, NULL);
+  fail_unless(std == NULL);
+
+  GstPad* srcpad = gst_element_get_static_pad(convert, "src");
+  GstCaps* tmpl_caps = gst_pad_get_pad_template_caps(srcpad);
+  GstCaps* tensor_caps = gst_caps_from_string("other/tensor(memory:mlu), layout=nchw, dtype=float32, format=RGB");
+  fail_unless(gst_caps_can_intersect(tmpl_caps, tensor_caps));
+  gst_caps_unref(tensor_caps);
+  gst_caps_unref(tmpl_caps);
+  gst_object_unref(srcpad);
+
+  gst_check_teardown_element(convert);
+}
+GST_END_TEST;
+
+GST_START_TEST(test_h2d_bytes_property)
+{
+  GstElement* convert = gst_check_setup_element("cnconvert");
+  fail_if(!convert);
+
+  // nothing is copied before the first frame, and the counter is read only
+  guint64 bytes = G_MAXUINT64;
+  g_object_get(convert, "h2d-bytes", &bytes, NULL);
+  fail_unless(bytes == 0);
+  GParamSpec* pspec = g_object_class_find_property(G_OBJECT_GET_CLASS(convert), "h2d-bytes");
+  fail_unless(pspec && !(pspec->flags & G_PARAM_WRITABLE));
+
+  gst_check_teardown_element(convert);
+}
+GST_END_TEST;
+
+#ifdef WITH_LIBYUV
+static GstStaticPadTemplate host_sink_template =
+  GST_STATIC_PAD_TEMPLATE("sink",
+                          GST_PAD_SINK,
+                          GST_PAD_ALWAYS,
+                          GST_STATIC_CAPS("video/x-raw, format=RGBA, width=32, height=24"));
+
+static GstStaticPadTemplate host_src_template =
+  GST_STATIC_PAD_TEMPLATE("src", GST_PAD_SRC, GST_PAD_ALWAYS, GST_STATIC_CAPS("video/x-raw, format=NV12"));
+
+GST_START_TEST(test_cpu_backend)
+{
+  GstElement* convert = gst_check_setup_element("cnconvert");
+  fail_if(!convert);
+  g_object_set(convert, "backend", GST_CNCONVERT_BACKEND_CPU, NULL);
+  GstPad* srcpad = gst_check_setup_src_pad(convert, &host_src_template);
+  GstPad* sinkpad = gst_check_setup_sink_pad(convert, &host_sink_template);
+  gst_pad_set_active(srcpad, TRUE);
+  gst_pad_set_active(sinkpad, TRUE);
+  ASSERT_SET_STATE(convert, GST_STATE_PLAYING, GST_STATE_CHANGE_SUCCESS);
+
+  GstCaps* caps = gst_caps_from_string("video/x-raw, format=NV12, width=64, height=48, framerate=30/1");
+  gst_check_setup_events(srcpad, convert, caps, GST_FORMAT_TIME);
+
+  // gray frame, resized to half and converted to RGBA without MLU
+  gsize size = 64 * 48 * 3 / 2;
+  GstBuffer* buffer = gst_buffer_new_allocate(NULL, size, NULL);
+  gst_buffer_memset(buffer, 0, 128, size);
+  GST_BUFFER_PTS(buffer) = 0;
+  fail_unless(gst_pad_push(srcpad, buffer) == GST_FLOW_OK);
+
+  fail_unless(g_list_length(buffers) == 1);
+  GstBuffer* outbuf = GST_BUFFER(buffers->data);
+  fail_unless(gst_buffer_get_size(outbuf) == 32 * 24 * 4);
+  fail_unless(GST_BUFFER_PTS(outbuf) == 0);
+  GstMapInfo map;
+  fail_unless(gst_buffer_map(outbuf, &map, GST_MAP_READ));
+  for (gsize i = 0; i < map.size; i += 4) {
+    fail_unless(ABS(map.data[i] - 130) <= 3 && ABS(map.data[i + 1] - 130) <= 3 && ABS(map.data[i + 2] - 130) <= 3);
+    fail_unless(map.data[i + 3] == 255);
+  }
+  gst_buffer_unmap(outbuf, &map);
+  gst_check_drop_buffers();
+
+  gst_caps_unref(caps);
+  ASSERT_SET_STATE(convert, GST_STATE_NULL, GST_STATE_CHANGE_SUCCESS);
+  gst_pad_set_active(srcpad, FALSE);
+  gst_pad_set_active(sinkpad, FALSE);
+  gst_check_teardown_sink_pad(convert);
+  gst_check_teardown_src_pad(convert);
+  gst_check_teardown_element(convert);
+}
+GST_END_TEST;
+
+static GstStaticPadTemplate host_any_size_sink_template =
+  GST_STATIC_PAD_TEMPLATE("sink", GST_PAD_SINK, GST_PAD_ALWAYS, GST_STATIC_CAPS("video/x-raw, format=RGBA"));
+
+GST_START_TEST(test_video_direction)
+{
+  GstElement* convert = gst_check_setup_element("cnconvert");
+  fail_if(!convert);
+  fail_unless(GST_IS_VIDEO_DIRECTION(convert));
+  gst_util_set_object_arg(G_OBJECT(convert), "video-direction", "90r");
+  gint method = -1;
+  g_object_get(convert, "video-direction", &method, NULL);
+  fail_unless(method == GST_VIDEO_ORIENTATION_90R);
+
+  GstPad* srcpad = gst_check_setup_src_pad(convert, &host_src_template);
+  GstPad* sinkpad = gst_check_setup_sink_pad(convert, &host_any_size_sink_template);
+  gst_pad_set_active(srcpad, TRUE);
+  gst_pad_set_active(sinkpad, TRUE);
+  ASSERT_SET_STATE(convert, GST_STATE_PLAYING, GST_STATE_CHANGE_SUCCESS);
+
+  GstCaps* caps = gst_caps_from_string("video/x-raw, format=NV12, width=64, height=48, framerate=30/1");
+  gst_check_setup_events(srcpad, convert, caps, GST_FORMAT_TIME);
+
+  // output is rotated as a whole when downstream does not ask for a size
+  GstCaps* outcaps = gst_pad_get_current_caps(sinkpad);
+  GstStructure* s = gst_caps_get_structure(outcaps, 0);
+  gint width = 0, height = 0;
+  fail_unless(gst_structure_get_int(s, "width", &width) && gst_structure_get_int(s, "height", &height));
+  fail_unless(width == 48 && height == 64);
+  gst_caps_unref(outcaps);
+
+  // top half white and bottom half black, after rotating clockwise the left half is black
+  gsize size = 64 * 48 * 3 / 2;
+  GstBuffer* buffer = gst_buffer_new_allocate(NULL, size, NULL);
+  gst_buffer_memset(buffer, 0, 235, 64 * 24);
+  gst_buffer_memset(buffer, 64 * 24, 16, 64 * 24);
+  gst_buffer_memset(buffer, 64 * 48, 128, 64 * 24);
+  fail_unless(gst_pad_push(srcpad, buffer) == GST_FLOW_OK);
+
+  fail_unless(g_list_length(buffers) == 1);
+  GstBuffer* outbuf = GST_BUFFER(buffers->data);
+  fail_unless(gst_buffer_get_size(outbuf) == 48 * 64 * 4);
+  GstMapInfo map;
+  fail_unless(gst_buffer_map(outbuf, &map, GST_MAP_READ));
+  for (gint row = 0; row < 64; ++row) {
+    fail_unless(map.data[(row * 48 + 4) * 4] < 32);
+    fail_unless(map.data[(row * 48 + 44) * 4] > 224);
+  }
+  gst_buffer_unmap(outbuf, &map);
+  gst_check_drop_buffers();
+
+  gst_caps_unref(caps);
+  ASSERT_SET_STATE(convert, GST_STATE_NULL, GST_STATE_CHANGE_SUCCESS);
+  gst_pad_set_active(srcpad, FALSE);
+  gst_pad_set_active(sinkpad, FALSE);
+  gst_check_teardown_sink_pad(convert);
+  gst_check_teardown_src_pad(convert);
+  gst_check_teardown_element(convert);
+}
+GST_END_TEST;
+
+static GstStaticPadTemplate host_square_sink_template =
+  GST_STATIC_PAD_TEMPLATE("sink",
+                          GST_PAD_SINK,
+                          GST_PAD_ALWAYS,
+                          GST_STATIC_CAPS("video/x-raw, format=RGBA, width=64, height=64"));
+
+GST_START_TEST(test_video_direction_letterbox)
+{
+  GstElement* convert = gst_check_setup_element("cnconvert");
+  fail_if(!convert);
+  gst_util_set_object_arg(G_OBJECT(convert), "video-direction", "90r");
+  g_object_set(convert, "keep-aspect-ratio", TRUE, NULL);
+
+  GstPad* srcpad = gst_check_setup_src_pad(convert, &host_src_template);
+  GstPad* sinkpad = gst_check_setup_sink_pad(convert, &host_square_sink_template);
+  gst_pad_set_active(srcpad, TRUE);
+  gst_pad_set_active(sinkpad, TRUE);
+  ASSERT_SET_STATE(convert, GST_STATE_PLAYING, GST_STATE_CHANGE_SUCCESS);
+
+  GstCaps* caps = gst_caps_from_string("video/x-raw, format=NV12, width=64, height=48, framerate=30/1");
+  gst_check_setup_events(srcpad, convert, caps, GST_FORMAT_TIME);
+
+  gsize size = 64 * 48 * 3 / 2;
+  GstBuffer* buffer = gst_buffer_new_allocate(NULL, size, NULL);
+  gst_buffer_memset(buffer, 0, 128, size);
+  fail_unless(gst_pad_push(srcpad, buffer) == GST_FLOW_OK);
+
+  // rotated input is 48x64, kept unscaled and centered in 64x64 output
+  fail_unless(g_list_length(buffers) == 1);
+  LetterboxMeta_t meta = gst_buffer_get_letterbox_meta(GST_BUFFER(buffers->data));
+  fail_unless(meta != NULL);
+  fail_unless(meta->src_x == 0 && meta->src_y == 0 && meta->src_w == 48 && meta->src_h == 64);
+  fail_unless(meta->dst_x == 8 && meta->dst_y == 0 && meta->dst_w == 48 && meta->dst_h == 64);
+  fail_unless(ABS(meta->scale_x - 1.0) < 1e-6 && ABS(meta->scale_y - 1.0) < 1e-6);
+  gst_check_drop_buffers();
+
+  gst_caps_unref(caps);
+  ASSERT_SET_STATE(convert, GST_STATE_NULL, GST_STATE_CHANGE_SUCCESS);
+  gst_pad_set_active(srcpad, FALSE);
+  gst_pad_set_active(sinkpad, FALSE);
+  gst_check_teardown_sink_pad(convert);
+  gst_check_teardown_src_pad(convert);
+  gst_check_teardown_element(convert);
+}
+GST_END_TEST;
+#endif
+
+static GstStaticPadTemplate host_nv12_src_template =
+  GST_STATIC_PAD_TEMPLATE("src", GST_PAD_SRC, GST_PAD_ALWAYS, GST_STATIC_CAPS("video/x-raw, format=NV12"));
+
+static GstStaticPadTemplate host_nv12_sink_template =
+  GST_STATIC_PAD_TEMPLATE("sink", GST_PAD_SINK, GST_PAD_ALWAYS, GST_STATIC_CAPS("video/x-raw, format=NV12"));
+
+GST_START_TEST(test_yuv_crop_refused)
+{
+  GstElement* convert = gst_check_setup_element("cnconvert");
+  fail_if(!convert);
+  g_object_set(convert, "crop", "16,8,32,24", NULL);
+  GstPad* srcpad = gst_check_setup_src_pad(convert, &host_nv12_src_template);
+  GstPad* sinkpad = gst_check_setup_sink_pad(convert, &host_nv12_sink_template);
+  gst_pad_set_active(srcpad, TRUE);
+  gst_pad_set_active(sinkpad, TRUE);
+  ASSERT_SET_STATE(convert, GST_STATE_PLAYING, GST_STATE_CHANGE_SUCCESS);
+
+  // yuv of the same format is passed through as a whole, crop would be dropped silently
+  fail_unless(gst_pad_push_event(srcpad, gst_event_new_stream_start("test")));
+  GstCaps* caps = gst_caps_from_string("video/x-raw, format=NV12, width=64, height=48, framerate=30/1");
+  fail_if(gst_pad_push_event(srcpad, gst_event_new_caps(caps)));
+  GstCaps* outcaps = gst_pad_get_current_caps(sinkpad);
+  fail_unless(outcaps == NULL);
+
+  gst_caps_unref(caps);
+  ASSERT_SET_STATE(convert, GST_STATE_NULL, GST_STATE_CHANGE_SUCCESS);
+  gst_pad_set_active(srcpad, FALSE);
+  gst_pad_set_active(sinkpad, FALSE);
+  gst_check_teardown_sink_pad(convert);
+  gst_check_teardown_src_pad(convert);
+  gst_check_teardown_element(convert);
+}
+GST_END_TEST;
+
+static GstStaticPadTemplate tensor_sink_template =
+  GST_STATIC_PAD_TEMPLATE("sink",
+                          GST_PAD_SINK,
+                          GST_PAD_ALWAYS,
+                          GST_STATIC_CAPS("other/tensor(memory:mlu), layout=nchw, dtype=float32, format=RGB, "
+                                          "width=64, height=48"));
+
+GST_START_TEST(test_tensor_values)
+{
+  GstElement* convert = gst_check_setup_element("cnconvert");
+  fail_if(!convert);
+  const gfloat mean[3] = {10, 20, 30}, std[3] = {2, 4, 8};
+  g_object_set(convert, "mean", "10,20,30", "std", "2,4,8", NULL);
+  GstPad* srcpad = gst_check_setup_src_pad(convert, &host_nv12_src_template);
+  GstPad* sinkpad = gst_check_setup_sink_pad(convert, &tensor_sink_template);
+  gst_pad_set_active(srcpad, TRUE);
+  gst_pad_set_active(sinkpad, TRUE);
+  ASSERT_SET_STATE(convert, GST_STATE_PLAYING, GST_STATE_CHANGE_SUCCESS);
+
+  GstCaps* caps = gst_caps_from_string("video/x-raw, format=NV12, width=64, height=48, framerate=30/1");
+  gst_check_setup_events(srcpad, convert, caps, GST_FORMAT_TIME);
+
+  // gray ramp along x, so every channel holds the same value before normalization
+  const gint width = 64, height = 48;
+  gsize size = width * height * 3 / 2;
+  GstBuffer* buffer = gst_buffer_new_allocate(NULL, size, NULL);
+  GstMapInfo map;
+  fail_unless(gst_buffer_map(buffer, &map, GST_MAP_WRITE));
+  for (gint y = 0; y < height; ++y) {
+    for (gint x = 0; x < width; ++x) {
+      map.data[y * width + x] = 16 + x * 3;
+    }
+  }
+  memset(map.data + width * height, 128, width * height / 2);
+  gst_buffer_unmap(buffer, &map);
+  GST_BUFFER_PTS(buffer) = 0;
+  fail_unless(gst_pad_push(srcpad, buffer) == GST_FLOW_OK);
+
+  // planes of r, g and b in float32, checked against conversion on cpu
+  fail_unless(g_list_length(buffers) == 1);
+  GstBuffer* outbuf = GST_BUFFER(buffers->data);
+  fail_unless(gst_buffer_get_size(outbuf) == width * height * 3 * sizeof(gfloat));
+  fail_unless(gst_buffer_map(outbuf, &map, GST_MAP_READ));
+  auto values = reinterpret_cast<const gfloat*>(map.data);
+  for (gint c = 0; c < 3; ++c) {
+    for (gint i = 0; i < width * height; ++i) {
+      gfloat expected = (1.164f * (i % width) * 3 - mean[c]) / std[c];
+      fail_unless(ABS(values[c * width * height + i] - expected) <= 3 / std[c], "channel %d pixel %d is %f, expect %f",
+                  c, i, values[c * width * height + i], expected);
+    }
+  }
+  gst_buffer_unmap(outbuf, &map);
+  gst_check_drop_buffers();
+
+  gst_caps_unref(caps);
+  ASSERT_SET_STATE(convert, GST_STATE_NULL, GST_STATE_CHANGE_SUCCESS);
+  gst_pad_set_active(srcpad, FALSE);
+  gst_pad_set_active(sinkpad, FALSE);
+  gst_check_teardown_sink_pad(convert);
+  gst_check_teardown_src_pad(convert);
+  gst_check_teardown_element(convert);
+}
+GST_END_TEST;
+
+static GstStaticPadTemplate host_yuv_src_template =
+  GST_STATIC_PAD_TEMPLATE("src", GST_PAD_SRC, GST_PAD_ALWAYS, GST_STATIC_CAPS("video/x-raw, format={NV12, I420}"));
+
+static GstStaticPadTemplate mlu_rgba_sink_template =
+  GST_STATIC_PAD_TEMPLATE("sink",
+                          GST_PAD_SINK,
+                          GST_PAD_ALWAYS,
+                          GST_STATIC_CAPS("video/x-raw(memory:mlu), format=RGBA, width=64, height=48"));
+
+// frames in system memory go through the ring of staging slots more than once while earlier uploads are in flight,
+// each output keeps the gray level of its own input
+GST_START_TEST(test_staging_ring)
+{
+  // outputs are held until all frames are pushed, fewer than buffers of the output pool
+  const gint width = 64, height = 48, n_frames = 7;
+  for (const gchar* format : { "NV12", "I420" }) {
+    GstElement* convert = gst_check_setup_element("cnconvert");
+    fail_if(!convert);
+    g_object_set(convert, "in-flight", 4, NULL);
+    GstPad* srcpad = gst_check_setup_src_pad(convert, &host_yuv_src_template);
+    GstPad* sinkpad = gst_check_setup_sink_pad(convert, &mlu_rgba_sink_template);
+    gst_pad_set_active(srcpad, TRUE);
+    gst_pad_set_active(sinkpad, TRUE);
+    ASSERT_SET_STATE(convert, GST_STATE_PLAYING, GST_STATE_CHANGE_SUCCESS);
+
+    gchar* caps_str = g_strdup_printf("video/x-raw, format=%s, width=%d, height=%d, framerate=30/1", format, width,
+                                      height);
+    GstCaps* caps = gst_caps_from_string(caps_str);
+    g_free(caps_str);
+    gst_check_setup_events(srcpad, convert, caps, GST_FORMAT_TIME);
+
+    // luma plane of level 40 + 20 * i, chroma planes of both formats are neutral
+    gsize size = width * height * 3 / 2;
+    for (gint i = 0; i < n_frames; ++i) {
+      GstBuffer* buffer = gst_buffer_new_allocate(NULL, size, NULL);
+      gst_buffer_memset(buffer, 0, 40 + 20 * i, width * height);
+      gst_buffer_memset(buffer, width * height, 128, size - width * height);
+      GST_BUFFER_PTS(buffer) = i * GST_SECOND / 30;
+      fail_unless(gst_pad_push(srcpad, buffer) == GST_FLOW_OK);
+    }
+
+    fail_unless_equals_int(g_list_length(buffers), n_frames);
+    gint i = 0;
+    for (GList* l = buffers; l; l = l->next, ++i) {
+      GstBuffer* outbuf = GST_BUFFER(l->data);
+      fail_unless(GST_BUFFER_PTS(outbuf) == i * GST_SECOND / 30);
+      fail_unless(gst_buffer_get_size(outbuf) == (gsize)width * height * 4);
+      GstMapInfo map;
+      fail_unless(gst_buffer_map(outbuf, &map, GST_MAP_READ));
+      gint expected = 1.164 * (40 + 20 * i - 16);
+      for (gsize p = 0; p < map.size; p += 4) {
+        fail_unless(ABS(map.data[p] - expected) <= 3 && ABS(map.data[p + 1] - expected) <= 3 &&
+                      ABS(map.data[p + 2] - expected) <= 3,
+                    "%s frame %d is %d, expect %d", format, i, map.data[p], expected);
+      }
+      gst_buffer_unmap(outbuf, &map);
+    }
+    gst_check_drop_buffers();
+
+    gst_caps_unref(caps);
+    ASSERT_SET_STATE(convert, GST_STATE_NULL, GST_STATE_CHANGE_SUCCESS);
+    gst_pad_set_active(srcpad, FALSE);
+    gst_pad_set_active(sinkpad, FALSE);
+    gst_check_teardown_sink_pad(convert);
+    gst_check_teardown_src_pad(convert);
+    gst_check_teardown_element(convert);
+  }
+}
+GST_END_TEST;
+
+GST_START_TEST(test_letterbox_meta)
+{
+  // 1280x720 to 416x416, centered
+  GstBuffer* buffer = gst_buffer_new();
+  gst_buffer_add_letterbox_meta(buffer, 0, 0, 1280, 720, 0, 91, 416, 234);
+  GstBuffer* copy = gst_buffer_copy(buffer);
+  gst_buffer_unref(buffer);
+
+  LetterboxMeta_t meta = gst_buffer_get_letterbox_meta(copy);
+  fail_unless(meta != NULL);
+  fail_unless(meta->dst_y == 91 && meta->dst_h == 234);
+  // bottom right of image on output maps to bottom right of input
+  fail_unless(ABS(meta->src_x + (416 - meta->dst_x) / meta->scale_x - 1280) < 1e-6);
+  fail_unless(ABS(meta->src_y + (91 + 234 - meta->dst_y) / meta->scale_y - 720) < 1e-6);
+  gst_buffer_unref(copy);
+}
+GST_END_TEST;
+
 GST_START_TEST(test_outcaps)
 {
   GstElement* convert;
@@ -248,6 +773,284 @@ GST_START_TEST(test_chain_func)
 }
 GST_END_TEST;
 
+#ifdef WITH_DECODE
+// decodes the sample video through tail to fakesink named sink
+static GstElement*
+sample_pipeline(const gchar* tail)
+{
+  gchar current_path[128];
+  memset(current_path, 0x00, sizeof(current_path));
+  fail_unless(getcwd(current_path, sizeof(current_path) - 1));
+  gchar* desc = g_strdup_printf("filesrc location=%s/../samples/data/videos/1080P.h264 ! h264parse ! cnvideo_dec ! "
+                                "%s ! fakesink name=sink signal-handoffs=true sync=false",
+                                current_path, tail);
+  GstElement* pipeline = gst_parse_launch(desc, NULL);
+  g_free(desc);
+  fail_unless(pipeline != NULL);
+  return pipeline;
+}
+
+// outputs reaching sink, with the size negotiated on its pad
+struct ConvertOutputs
+{
+  gint n_frames = 0;
+  gint width = 0;
+  gint height = 0;
+  // every buffer holds a whole frame of the negotiated size
+  bool sizes_match = true;
+  // contents of frames are recorded as checksums if set
+  bool digest = false;
+  std::vector<std::string> digests;
+  // regions of input outputs are converted from, taken from their letterbox metas
+  std::vector<GstVideoRectangle> src_regions;
+};
+
+static void
+record_output(GstElement* sink, GstBuffer* buffer, GstPad* pad, gpointer user_data)
+{
+  auto outputs = reinterpret_cast<ConvertOutputs*>(user_data);
+  GstCaps* caps = gst_pad_get_current_caps(pad);
+  GstVideoInfo info;
+  bool ok = caps && gst_video_info_from_caps(&info, caps);
+  if (caps) {
+    gst_caps_unref(caps);
+  }
+  outputs->n_frames++;
+  if (!ok || gst_buffer_get_size(buffer) != GST_VIDEO_INFO_SIZE(&info)) {
+    outputs->sizes_match = false;
+    return;
+  }
+  outputs->width = GST_VIDEO_INFO_WIDTH(&info);
+  outputs->height = GST_VIDEO_INFO_HEIGHT(&info);
+  if (LetterboxMeta_t meta = gst_buffer_get_letterbox_meta(buffer)) {
+    outputs->src_regions.push_back({ meta->src_x, meta->src_y, meta->src_w, meta->src_h });
+  }
+  if (outputs->digest) {
+    GstMapInfo map;
+    fail_unless(gst_buffer_map(buffer, &map, GST_MAP_READ));
+    gchar* sum = g_compute_checksum_for_data(G_CHECKSUM_MD5, map.data, map.size);
+    outputs->digests.push_back(sum);
+    g_free(sum);
+    gst_buffer_unmap(buffer, &map);
+  }
+}
+
+// plays pipeline to the end and leaves it in NULL state
+static void
+run_to_eos(GstElement* pipeline, ConvertOutputs* outputs)
+{
+  GstElement* sink = gst_bin_get_by_name(GST_BIN(pipeline), "sink");
+  g_signal_connect(sink, "handoff", G_CALLBACK(record_output), outputs);
+  GstBus* bus = gst_element_get_bus(pipeline);
+  fail_unless(gst_element_set_state(pipeline, GST_STATE_PLAYING) != GST_STATE_CHANGE_FAILURE);
+  GstMessage* msg =
+    gst_bus_timed_pop_filtered(bus, GST_CLOCK_TIME_NONE, (GstMessageType)(GST_MESSAGE_EOS | GST_MESSAGE_ERROR));
+  fail_unless(msg && GST_MESSAGE_TYPE(msg) == GST_MESSAGE_EOS);
+  gst_message_unref(msg);
+  gst_element_set_state(pipeline, GST_STATE_NULL);
+  gst_object_unref(bus);
+  gst_object_unref(sink);
+}
+
+// frames converted while others are in flight are the same as those converted one by one, outputs stay in MLU
+// memory so that they are synced by their notifiers when sink maps them
+GST_START_TEST(test_in_flight_outputs)
+{
+  ConvertOutputs outputs[2];
+  const gchar* tails[2] = { "cnconvert in-flight=0 ! video/x-raw(memory:mlu), format=RGBA, width=640, height=360",
+                            "cnconvert in-flight=4 ! video/x-raw(memory:mlu), format=RGBA, width=640, height=360" };
+  for (gint i = 0; i < 2; ++i) {
+    GstElement* pipeline = sample_pipeline(tails[i]);
+    outputs[i].digest = true;
+    run_to_eos(pipeline, &outputs[i]);
+    gst_object_unref(pipeline);
+    fail_unless(outputs[i].n_frames > 0 && outputs[i].sizes_match);
+  }
+
+  fail_unless_equals_int(outputs[1].n_frames, outputs[0].n_frames);
+  fail_unless(outputs[1].digests == outputs[0].digests);
+}
+GST_END_TEST;
+
+// bytes cnconvert copied to device, read for each frame as it reaches sink
+struct H2dBytes
+{
+  GstElement* convert = nullptr;
+  gint n_frames = 0;
+  guint64 warm_up = 0;
+  guint64 steady = 0;
+};
+
+// a pointer table is built for each pair of decoded and converted buffers, pools of both cycle within this many frames
+#define H2D_WARM_UP_FRAMES 64
+
+static void
+record_h2d_bytes(GstElement* sink, GstBuffer* buffer, GstPad* pad, gpointer user_data)
+{
+  auto bytes = reinterpret_cast<H2dBytes*>(user_data);
+  guint64 frame_bytes = 0;
+  g_object_get(bytes->convert, "h2d-bytes", &frame_bytes, NULL);
+  (bytes->n_frames++ < H2D_WARM_UP_FRAMES ? bytes->warm_up : bytes->steady) += frame_bytes;
+}
+
+// decoded frames are already on MLU and pointer tables are reused, so nothing is copied once tables are built
+GST_START_TEST(test_h2d_bytes_steady)
+{
+  GstElement* pipeline =
+    sample_pipeline("cnconvert name=convert ! video/x-raw(memory:mlu), format=RGBA, width=640, height=360");
+  H2dBytes bytes;
+  bytes.convert = gst_bin_get_by_name(GST_BIN(pipeline), "convert");
+  GstElement* sink = gst_bin_get_by_name(GST_BIN(pipeline), "sink");
+  g_signal_connect(sink, "handoff", G_CALLBACK(record_h2d_bytes), &bytes);
+  ConvertOutputs outputs;
+  run_to_eos(pipeline, &outputs);
+  gst_object_unref(sink);
+  gst_object_unref(bytes.convert);
+  gst_object_unref(pipeline);
+
+  fail_unless(outputs.n_frames > H2D_WARM_UP_FRAMES && outputs.sizes_match);
+  fail_unless(bytes.warm_up > 0);
+  fail_unless(bytes.steady == 0, "%" G_GUINT64_FORMAT " bytes copied after warm-up", bytes.steady);
+}
+GST_END_TEST;
+
+static gint
+count_sample_frames()
+{
+  GstElement* pipeline = sample_pipeline("identity");
+  ConvertOutputs outputs;
+  run_to_eos(pipeline, &outputs);
+  gst_object_unref(pipeline);
+  fail_unless(outputs.n_frames > 0);
+  return outputs.n_frames;
+}
+
+static inline bool
+same_region(const GstVideoRectangle& a, const GstVideoRectangle& b)
+{
+  return a.x == b.x && a.y == b.y && a.w == b.w && a.h == b.h;
+}
+
+// region every output is expected to be converted from
+static const GstVideoRectangle crop_region = { 64, 32, 640, 360 };
+
+static void
+check_crop_outputs(const ConvertOutputs& outputs, gint n_frames)
+{
+  fail_unless_equals_int(outputs.n_frames, n_frames);
+  fail_unless(outputs.sizes_match && outputs.width == 320 && outputs.height == 180);
+  fail_unless_equals_int(outputs.src_regions.size(), n_frames);
+  for (const auto& region : outputs.src_regions) {
+    fail_unless(same_region(region, crop_region), "converted from %d,%d,%d,%d", region.x, region.y, region.w, region.h);
+  }
+}
+
+static void
+add_sink_probe(GstElement* pipeline, GstPadProbeCallback callback)
+{
+  GstElement* convert = gst_bin_get_by_name(GST_BIN(pipeline), "convert");
+  GstPad* pad = gst_element_get_static_pad(convert, "sink");
+  gst_pad_add_probe(pad, GST_PAD_PROBE_TYPE_BUFFER, callback, NULL, NULL);
+  gst_object_unref(pad);
+  gst_object_unref(convert);
+}
+
+static GstPadProbeReturn
+add_crop_meta(GstPad* pad, GstPadProbeInfo* info, gpointer user_data)
+{
+  GstBuffer* buffer = gst_buffer_make_writable(GST_PAD_PROBE_INFO_BUFFER(info));
+  GstVideoCropMeta* meta = gst_buffer_add_video_crop_meta(buffer);
+  meta->x = crop_region.x;
+  meta->y = crop_region.y;
+  meta->width = crop_region.w;
+  meta->height = crop_region.h;
+  GST_PAD_PROBE_INFO_DATA(info) = buffer;
+  return GST_PAD_PROBE_OK;
+}
+
+// objects on each frame, the last one has another type and is not converted
+static const GstVideoRectangle roi_regions[] = { { 0, 0, 320, 240 }, { 800, 400, 224, 224 }, { 1280, 720, 640, 360 } };
+static const gchar* roi_types[] = { "face", "face", "face", "car" };
+
+static GstPadProbeReturn
+add_roi_metas(GstPad* pad, GstPadProbeInfo* info, gpointer user_data)
+{
+  GstBuffer* buffer = gst_buffer_make_writable(GST_PAD_PROBE_INFO_BUFFER(info));
+  for (guint i = 0; i < G_N_ELEMENTS(roi_types); ++i) {
+    const GstVideoRectangle& r = roi_regions[MIN(i, G_N_ELEMENTS(roi_regions) - 1)];
+    gst_buffer_add_video_region_of_interest_meta(buffer, roi_types[i], r.x, r.y, r.w, r.h);
+  }
+  GST_PAD_PROBE_INFO_DATA(info) = buffer;
+  return GST_PAD_PROBE_OK;
+}
+
+GST_START_TEST(test_crop_property_outputs)
+{
+  gint n_frames = count_sample_frames();
+  GstElement* pipeline = sample_pipeline("cnconvert crop=64,32,640,360 keep-aspect-ratio=true ! "
+                                         "video/x-raw(memory:mlu), format=RGBA, width=320, height=180");
+  ConvertOutputs outputs;
+  run_to_eos(pipeline, &outputs);
+  gst_object_unref(pipeline);
+  check_crop_outputs(outputs, n_frames);
+}
+GST_END_TEST;
+
+GST_START_TEST(test_crop_meta_outputs)
+{
+  gint n_frames = count_sample_frames();
+  GstElement* pipeline = sample_pipeline("cnconvert name=convert keep-aspect-ratio=true ! "
+                                         "video/x-raw(memory:mlu), format=RGBA, width=320, height=180");
+  add_sink_probe(pipeline, add_crop_meta);
+  ConvertOutputs outputs;
+  run_to_eos(pipeline, &outputs);
+  gst_object_unref(pipeline);
+  check_crop_outputs(outputs, n_frames);
+}
+GST_END_TEST;
+
+// each region of interest of the type is converted to an output of the negotiated size
+GST_START_TEST(test_roi_outputs)
+{
+  gint n_frames = count_sample_frames();
+  GstElement* pipeline = sample_pipeline("cnconvert name=convert roi-type=face keep-aspect-ratio=true ! "
+                                         "video/x-raw(memory:mlu), format=RGBA, width=224, height=224");
+  add_sink_probe(pipeline, add_roi_metas);
+  ConvertOutputs outputs;
+  run_to_eos(pipeline, &outputs);
+  gst_object_unref(pipeline);
+
+  guint n_rois = G_N_ELEMENTS(roi_regions);
+  fail_unless_equals_int(outputs.n_frames, n_frames * n_rois);
+  fail_unless(outputs.sizes_match && outputs.width == 224 && outputs.height == 224);
+  fail_unless_equals_int(outputs.src_regions.size(), n_frames * n_rois);
+  // metas are not kept in the order they are added, so outputs are counted for each region
+  for (const auto& roi : roi_regions) {
+    gint n = 0;
+    for (const auto& region : outputs.src_regions) {
+      n += same_region(region, roi);
+    }
+    fail_unless_equals_int(n, n_frames);
+  }
+}
+GST_END_TEST;
+
+#ifdef WITH_LIBYUV
+// frames decoded to MLU memory are rotated on host and uploaded back
+GST_START_TEST(test_video_direction_mlu)
+{
+  GstElement* pipeline = sample_pipeline("cnconvert video-direction=90r ! video/x-raw(memory:mlu), format=RGBA");
+  ConvertOutputs outputs;
+  run_to_eos(pipeline, &outputs);
+  gst_object_unref(pipeline);
+
+  fail_unless(outputs.n_frames > 0 && outputs.sizes_match);
+  fail_unless(outputs.width == 1080 && outputs.height == 1920);
+}
+GST_END_TEST;
+#endif  // WITH_LIBYUV
+#endif  // WITH_DECODE
+
 Suite*
 cnconvert_suite(void)
 {
@@ -256,9 +1059,36 @@ cnconvert_suite(void)
 
   suite_add_tcase(s, tc_chain);
   tcase_add_test(tc_chain, test_create_and_destroy);
+  tcase_add_test(tc_chain, test_in_flight_property);
+  tcase_add_test(tc_chain, test_crop_property);
+  tcase_add_test(tc_chain, test_keep_aspect_ratio_property);
+  tcase_add_test(tc_chain, test_letterbox_meta);
+  tcase_add_test(tc_chain, test_yuv_crop_refused);
+  tcase_add_test(tc_chain, test_fuse_rgb_resize_property);
+  tcase_add_test(tc_chain, test_backend_property);
+  tcase_add_test(tc_chain, test_dtype_property);
+  tcase_add_test(tc_chain, test_tensor_normalize_property);
+  tcase_add_test(tc_chain, test_h2d_bytes_property);
+#ifdef WITH_LIBYUV
+  tcase_add_test(tc_chain, test_cpu_backend);
+  tcase_add_test(tc_chain, test_video_direction);
+  tcase_add_test(tc_chain, test_video_direction_letterbox);
+#endif
   tcase_add_test(tc_chain, test_outcaps);
   tcase_add_test(tc_chain, test_event_func);
   tcase_add_test(tc_chain, test_chain_func);
+  tcase_add_test(tc_chain, test_tensor_values);
+  tcase_add_test(tc_chain, test_staging_ring);
+#ifdef WITH_DECODE
+  tcase_add_test(tc_chain, test_in_flight_outputs);
+  tcase_add_test(tc_chain, test_h2d_bytes_steady);
+  tcase_add_test(tc_chain, test_crop_property_outputs);
+  tcase_add_test(tc_chain, test_crop_meta_outputs);
+  tcase_add_test(tc_chain, test_roi_outputs);
+#endif
+#if defined(WITH_DECODE) && defined(WITH_LIBYUV)
+  tcase_add_test(tc_chain, test_video_direction_mlu);
+#endif
   return s;
 }
 
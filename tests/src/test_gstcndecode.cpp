@@ -22,13 +22,23 @@
 #include <gst/app/gstappsink.h>
 #include <gst/check/gstbufferstraw.h>
 #include <gst/check/gstcheck.h>
+#include <glib/gstdio.h>
 #include <gst/video/video.h>
 #include <unistd.h>
 #include <atomic>
+#include <chrono>
+#include <condition_variable>
 #include <cstdint>
+#include <fstream>
+#include <iterator>
+#include <mutex>
+#include <vector>
 
 #include "common/frame_deallocator.h"
+#include "common/gst_pinned_allocator.h"
 #include "common/mlu_memory_meta.h"
+#include "decode/decoder_pool.h"
+#include "decode/gstcnvideo_dec.h"
 
 static void
 src_handle_pad_added(GstElement* src, GstPad* new_pad, GstElement* sink)
@@ -66,6 +76,68 @@ GST_START_TEST(test_properties)
 }
 GST_END_TEST;
 
+GST_START_TEST(test_output_queue_properties)
+{
+  GstElement* cnvideodec = gst_check_setup_element("cnvideo_dec");
+  fail_unless(cnvideodec != NULL);
+
+  guint size = 0, high_water = G_MAXUINT;
+  g_object_get(G_OBJECT(cnvideodec), "output-queue-size", &size, "output-high-water", &high_water, NULL);
+  fail_unless_equals_int(size, 4);
+  fail_unless_equals_int(high_water, 0);
+
+  gint leaky = -1;
+  g_object_set(G_OBJECT(cnvideodec), "output-queue-size", 8, NULL);
+  gst_util_set_object_arg(G_OBJECT(cnvideodec), "output-leaky", "downstream");
+  g_object_get(G_OBJECT(cnvideodec), "output-queue-size", &size, "output-leaky", &leaky, NULL);
+  fail_unless_equals_int(size, 8);
+  fail_unless_equals_int(leaky, GST_CNVIDEODEC_LEAKY_DOWNSTREAM);
+
+  // statistic is read only
+  GParamSpec* pspec = g_object_class_find_property(G_OBJECT_GET_CLASS(cnvideodec), "output-high-water");
+  fail_unless(pspec && !(pspec->flags & G_PARAM_WRITABLE));
+
+  gst_check_teardown_element(cnvideodec);
+}
+GST_END_TEST;
+
+GST_START_TEST(test_decode_mode_properties)
+{
+  GstElement* cnvideodec = gst_check_setup_element("cnvideo_dec");
+  fail_unless(cnvideodec != NULL);
+
+  gint mode = -1;
+  guint interval = 0;
+  g_object_get(G_OBJECT(cnvideodec), "decode-mode", &mode, "output-interval", &interval, NULL);
+  fail_unless_equals_int(mode, GST_CNVIDEODEC_DECODE_MODE_ALL);
+  fail_unless_equals_int(interval, 1);
+
+  gst_util_set_object_arg(G_OBJECT(cnvideodec), "decode-mode", "keyframes");
+  g_object_set(G_OBJECT(cnvideodec), "output-interval", 5, NULL);
+  g_object_get(G_OBJECT(cnvideodec), "decode-mode", &mode, "output-interval", &interval, NULL);
+  fail_unless_equals_int(mode, GST_CNVIDEODEC_DECODE_MODE_KEYFRAMES);
+  fail_unless_equals_int(interval, 5);
+
+  gst_check_teardown_element(cnvideodec);
+}
+GST_END_TEST;
+
+GST_START_TEST(test_decoder_pool_property)
+{
+  GstElement* cnvideodec = gst_check_setup_element("cnvideo_dec");
+  fail_unless(cnvideodec != NULL);
+
+  guint pool_size = G_MAXUINT;
+  g_object_get(G_OBJECT(cnvideodec), "decoder-pool-size", &pool_size, NULL);
+  fail_unless_equals_int(pool_size, 0);
+  g_object_set(G_OBJECT(cnvideodec), "decoder-pool-size", 2, NULL);
+  g_object_get(G_OBJECT(cnvideodec), "decoder-pool-size", &pool_size, NULL);
+  fail_unless_equals_int(pool_size, 2);
+
+  gst_check_teardown_element(cnvideodec);
+}
+GST_END_TEST;
+
 static std::atomic<bool> eos(false);
 
 static gboolean
@@ -84,6 +156,724 @@ test_sink(GstPad* pad, GstObject* parent, GstEvent* event)
   return FALSE;
 }
 
+// frames fed to decoder but not output yet, counted as each frame reaches sink
+struct HeldFrames
+{
+  std::atomic<gint> n_in{ 0 };
+  gint n_out = 0;
+  gint max_held = 0;
+};
+
+static GstPadProbeReturn
+count_input(GstPad* pad, GstPadProbeInfo* info, gpointer user_data)
+{
+  reinterpret_cast<HeldFrames*>(user_data)->n_in++;
+  return GST_PAD_PROBE_OK;
+}
+
+static void
+count_held(GstElement* sink, GstBuffer* buffer, GstPad* pad, gpointer user_data)
+{
+  auto held = reinterpret_cast<HeldFrames*>(user_data);
+  held->n_out++;
+  held->max_held = MAX(held->max_held, held->n_in.load() - held->n_out);
+}
+
+// most frames decoder holds at once, which are bounded by its input and output buffers
+static gint
+max_held_frames(gboolean low_latency)
+{
+  gchar current_path[128];
+  memset(current_path, 0x00, sizeof(current_path));
+  fail_unless(getcwd(current_path, sizeof(current_path) - 1));
+  gchar* desc = g_strdup_printf("filesrc location=%s/../samples/data/videos/1080P.h264 ! h264parse ! "
+                                "cnvideo_dec name=dec low-latency=%s ! fakesink name=sink signal-handoffs=true "
+                                "sync=false",
+                                current_path, low_latency ? "true" : "false");
+  GstElement* pipeline = gst_parse_launch(desc, NULL);
+  g_free(desc);
+  fail_unless(pipeline != NULL);
+  HeldFrames held;
+  GstElement* dec = gst_bin_get_by_name(GST_BIN(pipeline), "dec");
+  GstPad* pad = gst_element_get_static_pad(dec, "sink");
+  gst_pad_add_probe(pad, GST_PAD_PROBE_TYPE_BUFFER, count_input, &held, NULL);
+  gst_object_unref(pad);
+  gst_object_unref(dec);
+  GstElement* sink = gst_bin_get_by_name(GST_BIN(pipeline), "sink");
+  g_signal_connect(sink, "handoff", G_CALLBACK(count_held), &held);
+  gst_object_unref(sink);
+
+  GstBus* bus = gst_element_get_bus(pipeline);
+  fail_unless(gst_element_set_state(pipeline, GST_STATE_PLAYING) != GST_STATE_CHANGE_FAILURE);
+  GstMessage* msg =
+    gst_bus_timed_pop_filtered(bus, GST_CLOCK_TIME_NONE, (GstMessageType)(GST_MESSAGE_EOS | GST_MESSAGE_ERROR));
+  fail_unless(msg && GST_MESSAGE_TYPE(msg) == GST_MESSAGE_EOS);
+  gst_message_unref(msg);
+  gst_element_set_state(pipeline, GST_STATE_NULL);
+  gst_object_unref(bus);
+  gst_object_unref(pipeline);
+  fail_unless(held.n_out > 0);
+  return held.max_held;
+}
+
+GST_START_TEST(test_low_latency)
+{
+  // fewer buffers hold fewer frames back than the default 4 input and 4 output buffers
+  gint held_low_latency = max_held_frames(TRUE);
+  gint held_default = max_held_frames(FALSE);
+  GST_INFO("decoder held at most %d frames with low latency, %d without", held_low_latency, held_default);
+  fail_unless(held_low_latency < held_default);
+
+  gchar current_path[128];
+  memset(current_path, 0x00, sizeof(current_path));
+  fail_unless(getcwd(current_path, sizeof(current_path) - 1));
+  gchar* desc = g_strdup_printf("filesrc location=%s/../samples/data/videos/1080P.h264 ! h264parse ! "
+                                "cnvideo_dec name=dec low-latency=true ! fakesink",
+                                current_path);
+  GstElement* pipeline = gst_parse_launch(desc, NULL);
+  g_free(desc);
+  fail_unless(pipeline != NULL);
+  GstElement* dec = gst_bin_get_by_name(GST_BIN(pipeline), "dec");
+  gboolean low_latency = FALSE;
+  g_object_get(G_OBJECT(dec), "low-latency", &low_latency, NULL);
+  fail_unless(low_latency);
+
+  fail_unless(gst_element_set_state(pipeline, GST_STATE_PAUSED) != GST_STATE_CHANGE_FAILURE);
+  fail_unless(gst_element_get_state(pipeline, NULL, NULL, GST_CLOCK_TIME_NONE) == GST_STATE_CHANGE_SUCCESS);
+
+  // sample stream has no B-frames, decoder adds no latency
+  GstQuery* query = gst_query_new_latency();
+  GstPad* srcpad = gst_element_get_static_pad(dec, "src");
+  fail_unless(gst_pad_query(srcpad, query));
+  GstClockTime min, max;
+  gst_query_parse_latency(query, NULL, &min, &max);
+  fail_unless_equals_uint64(min, 0);
+  gst_query_unref(query);
+  gst_object_unref(srcpad);
+
+  gst_element_set_state(pipeline, GST_STATE_NULL);
+  gst_object_unref(dec);
+  gst_object_unref(pipeline);
+}
+GST_END_TEST;
+
+GST_START_TEST(test_input_pool)
+{
+  GstElement* cnvideodec = gst_check_setup_element("cnvideo_dec");
+  fail_unless(cnvideodec != NULL);
+  guint pool_size = G_MAXUINT;
+  g_object_get(G_OBJECT(cnvideodec), "input-pool-size", &pool_size, NULL);
+  fail_unless_equals_int(pool_size, 0);
+  g_object_set(G_OBJECT(cnvideodec), "input-pool-size", 4, NULL);
+
+  // page-locked buffers sized for the resolution are proposed to upstream
+  GstCaps* caps = gst_caps_from_string("video/x-h264, stream-format=byte-stream, alignment=au, width=3840, height=2160");
+  GstQuery* query = gst_query_new_allocation(caps, TRUE);
+  GstPad* sinkpad = gst_element_get_static_pad(cnvideodec, "sink");
+  fail_unless(gst_pad_query(sinkpad, query));
+  fail_unless_equals_int(gst_query_get_n_allocation_pools(query), 1);
+  GstBufferPool* pool = nullptr;
+  guint size = 0, min = 0, max = 0;
+  gst_query_parse_nth_allocation_pool(query, 0, &pool, &size, &min, &max);
+  fail_unless(pool != NULL);
+  // half of NV12 frame
+  fail_unless_equals_int(size, 3840 * 2160 * 3 / 2 / 2);
+  fail_unless(min == 4 && max == 4);
+  GstAllocator* allocator = nullptr;
+  fail_unless(gst_query_get_n_allocation_params(query) >= 1);
+  gst_query_parse_nth_allocation_param(query, 0, &allocator, NULL);
+  fail_unless(allocator && GST_IS_PINNED_ALLOCATOR(allocator));
+
+  gst_object_unref(allocator);
+  gst_object_unref(pool);
+  gst_object_unref(sinkpad);
+  gst_query_unref(query);
+  gst_caps_unref(caps);
+  gst_check_teardown_element(cnvideodec);
+}
+GST_END_TEST;
+
+static void
+count_handoff(GstElement* sink, GstBuffer* buffer, GstPad* pad, gpointer user_data)
+{
+  g_atomic_int_inc(reinterpret_cast<gint*>(user_data));
+}
+
+// calls to decoder creation and destruction, counted by hooks on class of cnvideo_dec
+static std::atomic<gint> n_decoder_init{ 0 };
+static std::atomic<gint> n_decoder_destroy{ 0 };
+static gboolean (*parent_init_decoder)(GstCnvideodec* element) = nullptr;
+static gboolean (*parent_destroy_decoder)(GstCnvideodec* element) = nullptr;
+
+static gboolean
+counted_init_decoder(GstCnvideodec* element)
+{
+  n_decoder_init++;
+  return parent_init_decoder(element);
+}
+
+static gboolean
+counted_destroy_decoder(GstCnvideodec* element)
+{
+  n_decoder_destroy++;
+  return parent_destroy_decoder(element);
+}
+
+#define FLUSH_SEEK_HOLD_FRAMES 30
+#define FLUSH_SEEK_TARGET (4 * GST_SECOND)
+
+// frames around a flushing seek made while the decoder is in the middle of the stream
+struct FlushSeek
+{
+  std::mutex mutex;
+  std::condition_variable cond;
+  gint n_fed = 0;
+  bool holding = false;
+  bool released = false;
+  bool flushed = false;
+  // largest pts fed before flush, frames decoded from data before flush have pts up to it
+  GstClockTime max_fed_pts = 0;
+  // pts of the first buffer fed after FLUSH_STOP, upstream resumes from a key frame at or before the seek target
+  GstClockTime resume_pts = GST_CLOCK_TIME_NONE;
+  gint n_pushed_after = 0;
+  GstClockTime min_pts_after = GST_CLOCK_TIME_NONE;
+};
+
+// input is held once FLUSH_SEEK_HOLD_FRAMES are fed, until FLUSH_START of the seek comes
+static GstPadProbeReturn
+hold_input_until_flush(GstPad* pad, GstPadProbeInfo* info, gpointer user_data)
+{
+  auto seek = reinterpret_cast<FlushSeek*>(user_data);
+  std::unique_lock<std::mutex> lk(seek->mutex);
+  if (info->type & GST_PAD_PROBE_TYPE_EVENT_FLUSH) {
+    GstEvent* event = GST_PAD_PROBE_INFO_EVENT(info);
+    if (GST_EVENT_TYPE(event) == GST_EVENT_FLUSH_START) {
+      seek->released = true;
+      seek->cond.notify_all();
+    } else if (GST_EVENT_TYPE(event) == GST_EVENT_FLUSH_STOP) {
+      seek->flushed = true;
+    }
+    return GST_PAD_PROBE_OK;
+  }
+
+  GstBuffer* buffer = GST_PAD_PROBE_INFO_BUFFER(info);
+  if (seek->flushed) {
+    if (!GST_CLOCK_TIME_IS_VALID(seek->resume_pts) && GST_BUFFER_PTS_IS_VALID(buffer)) {
+      seek->resume_pts = GST_BUFFER_PTS(buffer);
+    }
+    return GST_PAD_PROBE_OK;
+  }
+  if (GST_BUFFER_PTS_IS_VALID(buffer)) {
+    seek->max_fed_pts = MAX(seek->max_fed_pts, GST_BUFFER_PTS(buffer));
+  }
+  if (++seek->n_fed == FLUSH_SEEK_HOLD_FRAMES) {
+    seek->holding = true;
+    seek->cond.notify_all();
+    seek->cond.wait(lk, [seek] { return seek->released; });
+  }
+  return GST_PAD_PROBE_OK;
+}
+
+static void
+record_after_flush(GstElement* sink, GstBuffer* buffer, GstPad* pad, gpointer user_data)
+{
+  auto seek = reinterpret_cast<FlushSeek*>(user_data);
+  std::lock_guard<std::mutex> lk(seek->mutex);
+  if (!seek->flushed) {
+    return;
+  }
+  seek->n_pushed_after++;
+  if (!GST_CLOCK_TIME_IS_VALID(seek->min_pts_after) || GST_BUFFER_PTS(buffer) < seek->min_pts_after) {
+    seek->min_pts_after = GST_BUFFER_PTS(buffer);
+  }
+}
+
+GST_START_TEST(test_flush_seek)
+{
+  gchar current_path[128];
+  memset(current_path, 0x00, sizeof(current_path));
+  fail_unless(getcwd(current_path, sizeof(current_path) - 1));
+  gchar* desc = g_strdup_printf("filesrc location=%s/../samples/data/videos/1080P.h264 ! h264parse ! "
+                                "cnvideo_dec name=dec ! fakesink name=sink signal-handoffs=true sync=false",
+                                current_path);
+  GstElement* pipeline = gst_parse_launch(desc, NULL);
+  g_free(desc);
+  fail_unless(pipeline != NULL);
+  GstElement* dec = gst_bin_get_by_name(GST_BIN(pipeline), "dec");
+  GstCnvideodecClass* klass = GST_CNVIDEODEC_GET_CLASS(dec);
+  parent_init_decoder = klass->init_decoder;
+  parent_destroy_decoder = klass->destroy_decoder;
+  klass->init_decoder = counted_init_decoder;
+  klass->destroy_decoder = counted_destroy_decoder;
+  n_decoder_init = 0;
+  n_decoder_destroy = 0;
+
+  FlushSeek seek;
+  GstPad* dec_sink = gst_element_get_static_pad(dec, "sink");
+  gulong probe =
+    gst_pad_add_probe(dec_sink, (GstPadProbeType)(GST_PAD_PROBE_TYPE_BUFFER | GST_PAD_PROBE_TYPE_EVENT_FLUSH),
+                      hold_input_until_flush, &seek, NULL);
+  GstElement* sink = gst_bin_get_by_name(GST_BIN(pipeline), "sink");
+  gulong handoff = g_signal_connect(sink, "handoff", G_CALLBACK(record_after_flush), &seek);
+  GstBus* bus = gst_element_get_bus(pipeline);
+
+  // seek forward while decoder still holds frames from before
+  fail_unless(gst_element_set_state(pipeline, GST_STATE_PLAYING) != GST_STATE_CHANGE_FAILURE);
+  {
+    std::unique_lock<std::mutex> lk(seek.mutex);
+    fail_unless(seek.cond.wait_for(lk, std::chrono::seconds(30), [&seek] { return seek.holding; }));
+  }
+  fail_unless(gst_element_seek_simple(pipeline, GST_FORMAT_TIME,
+                                      (GstSeekFlags)(GST_SEEK_FLAG_FLUSH | GST_SEEK_FLAG_KEY_UNIT), FLUSH_SEEK_TARGET));
+  GstMessage* msg =
+    gst_bus_timed_pop_filtered(bus, GST_CLOCK_TIME_NONE, (GstMessageType)(GST_MESSAGE_EOS | GST_MESSAGE_ERROR));
+  fail_unless(msg && GST_MESSAGE_TYPE(msg) == GST_MESSAGE_EOS);
+  gst_message_unref(msg);
+  gst_pad_remove_probe(dec_sink, probe);
+  g_signal_handler_disconnect(sink, handoff);
+  gst_object_unref(dec_sink);
+
+  // the decoder created on the first buffer goes on after flush
+  fail_unless_equals_int(n_decoder_init.load(), 1);
+  fail_unless_equals_int(n_decoder_destroy.load(), 0);
+  // none of the frames decoded from data before flush is pushed after FLUSH_STOP
+  GST_INFO("fed up to %" GST_TIME_FORMAT " before flush, resumed from %" GST_TIME_FORMAT,
+           GST_TIME_ARGS(seek.max_fed_pts), GST_TIME_ARGS(seek.resume_pts));
+  fail_unless(GST_CLOCK_TIME_IS_VALID(seek.resume_pts));
+  fail_unless(seek.resume_pts > seek.max_fed_pts);
+  fail_unless(seek.n_pushed_after > 0);
+  fail_unless(seek.min_pts_after >= seek.resume_pts);
+
+  // seek after EOS, decoder takes no data after EOS and is created again
+  gint n_frames = 0;
+  g_signal_connect(sink, "handoff", G_CALLBACK(count_handoff), &n_frames);
+  fail_unless(gst_element_set_state(pipeline, GST_STATE_PAUSED) != GST_STATE_CHANGE_FAILURE);
+  fail_unless(gst_element_get_state(pipeline, NULL, NULL, GST_CLOCK_TIME_NONE) == GST_STATE_CHANGE_SUCCESS);
+  fail_unless(gst_element_seek_simple(pipeline, GST_FORMAT_TIME,
+                                      (GstSeekFlags)(GST_SEEK_FLAG_FLUSH | GST_SEEK_FLAG_KEY_UNIT), 0));
+  fail_unless(gst_element_get_state(pipeline, NULL, NULL, GST_CLOCK_TIME_NONE) == GST_STATE_CHANGE_SUCCESS);
+  fail_unless(gst_element_set_state(pipeline, GST_STATE_PLAYING) != GST_STATE_CHANGE_FAILURE);
+  msg = gst_bus_timed_pop_filtered(bus, GST_CLOCK_TIME_NONE, (GstMessageType)(GST_MESSAGE_EOS | GST_MESSAGE_ERROR));
+  fail_unless(msg && GST_MESSAGE_TYPE(msg) == GST_MESSAGE_EOS);
+  gst_message_unref(msg);
+  fail_unless(g_atomic_int_get(&n_frames) > 0);
+  fail_unless_equals_int(n_decoder_init.load(), 2);
+
+  gst_element_set_state(pipeline, GST_STATE_NULL);
+  klass->init_decoder = parent_init_decoder;
+  klass->destroy_decoder = parent_destroy_decoder;
+  gst_object_unref(bus);
+  gst_object_unref(sink);
+  gst_object_unref(dec);
+  gst_object_unref(pipeline);
+}
+GST_END_TEST;
+
+static gchar*
+sample_location()
+{
+  gchar current_path[128];
+  memset(current_path, 0x00, sizeof(current_path));
+  fail_unless(getcwd(current_path, sizeof(current_path) - 1));
+  return g_strdup_printf("%s/../samples/data/videos/1080P.h264", current_path);
+}
+
+// decodes file through fakesink to the end, handoff is called with every frame
+static void
+decode_to_eos(const gchar* location, const gchar* dec_options, GCallback handoff, gpointer user_data,
+              GstPadProbeCallback sink_probe = nullptr)
+{
+  gchar* desc = g_strdup_printf("filesrc location=%s ! h264parse ! cnvideo_dec name=dec %s ! video/x-raw ! "
+                                "fakesink name=sink signal-handoffs=true sync=false",
+                                location, dec_options);
+  GstElement* pipeline = gst_parse_launch(desc, NULL);
+  g_free(desc);
+  fail_unless(pipeline != NULL);
+  GstElement* sink = gst_bin_get_by_name(GST_BIN(pipeline), "sink");
+  g_signal_connect(sink, "handoff", handoff, user_data);
+  if (sink_probe) {
+    GstElement* dec = gst_bin_get_by_name(GST_BIN(pipeline), "dec");
+    GstPad* pad = gst_element_get_static_pad(dec, "sink");
+    gst_pad_add_probe(pad, GST_PAD_PROBE_TYPE_EVENT_DOWNSTREAM, sink_probe, NULL, NULL);
+    gst_object_unref(pad);
+    gst_object_unref(dec);
+  }
+
+  GstBus* bus = gst_element_get_bus(pipeline);
+  fail_unless(gst_element_set_state(pipeline, GST_STATE_PLAYING) != GST_STATE_CHANGE_FAILURE);
+  GstMessage* msg =
+    gst_bus_timed_pop_filtered(bus, GST_CLOCK_TIME_NONE, (GstMessageType)(GST_MESSAGE_EOS | GST_MESSAGE_ERROR));
+  fail_unless(msg && GST_MESSAGE_TYPE(msg) == GST_MESSAGE_EOS);
+  gst_message_unref(msg);
+
+  gst_element_set_state(pipeline, GST_STATE_NULL);
+  gst_object_unref(bus);
+  gst_object_unref(sink);
+  gst_object_unref(pipeline);
+}
+
+// writes an H.264 NAL unit with start code, emulation prevention bytes are inserted into rbsp
+static void
+put_nal(std::vector<guint8>* out, guint8 header, const std::vector<guint8>& rbsp)
+{
+  out->insert(out->end(), { 0, 0, 0, 1, header });
+  guint zeros = 0;
+  for (guint8 byte : rbsp) {
+    if (zeros >= 2 && byte <= 3) {
+      out->push_back(3);
+      zeros = 0;
+    }
+    out->push_back(byte);
+    zeros = byte ? 0 : zeros + 1;
+  }
+}
+
+struct BitWriter
+{
+  std::vector<guint8> data;
+  guint n_bits = 0;
+
+  void put(guint value, guint n)
+  {
+    while (n--) {
+      if (n_bits % 8 == 0)
+        data.push_back(0);
+      data.back() |= ((value >> n) & 1) << (7 - n_bits % 8);
+      n_bits++;
+    }
+  }
+  void ue(guint value)
+  {
+    guint len = g_bit_storage(value + 1);
+    put(0, len - 1);
+    put(value + 1, len);
+  }
+  void align()
+  {
+    while (n_bits % 8)
+      put(0, 1);
+  }
+  void trailing()
+  {
+    put(1, 1);
+    align();
+  }
+};
+
+/* Baseline stream of IDR pictures made of I_PCM macroblocks, so that a stream of another resolution could be built
+ * without an encoder.
+ */
+static std::vector<guint8>
+make_pcm_stream(guint width, guint height, guint n_frames)
+{
+  std::vector<guint8> stream;
+  BitWriter sps;
+  sps.put(66, 8);    // profile_idc, baseline
+  sps.put(0xc0, 8);  // constraint_set0/1
+  sps.put(30, 8);    // level_idc
+  sps.ue(0);         // seq_parameter_set_id
+  sps.ue(0);         // log2_max_frame_num_minus4
+  sps.ue(2);         // pic_order_cnt_type
+  sps.ue(1);         // max_num_ref_frames
+  sps.put(0, 1);     // gaps_in_frame_num_value_allowed_flag
+  sps.ue(width / 16 - 1);
+  sps.ue(height / 16 - 1);
+  sps.put(1, 1);  // frame_mbs_only_flag
+  sps.put(1, 1);  // direct_8x8_inference_flag
+  sps.put(0, 1);  // frame_cropping_flag
+  sps.put(0, 1);  // vui_parameters_present_flag
+  sps.trailing();
+
+  BitWriter pps;
+  pps.ue(0);        // pic_parameter_set_id
+  pps.ue(0);        // seq_parameter_set_id
+  pps.put(0, 1);    // entropy_coding_mode_flag
+  pps.put(0, 1);    // bottom_field_pic_order_in_frame_present_flag
+  pps.ue(0);        // num_slice_groups_minus1
+  pps.ue(0);        // num_ref_idx_l0_default_active_minus1
+  pps.ue(0);        // num_ref_idx_l1_default_active_minus1
+  pps.put(0, 3);    // weighted_pred_flag, weighted_bipred_idc
+  pps.ue(0);        // pic_init_qp_minus26
+  pps.ue(0);        // pic_init_qs_minus26
+  pps.ue(0);        // chroma_qp_index_offset
+  pps.put(4, 3);    // deblocking_filter_control_present_flag, constrained_intra_pred, redundant_pic_cnt_present
+  pps.trailing();
+
+  for (guint i = 0; i < n_frames; ++i) {
+    put_nal(&stream, 0x67, sps.data);
+    put_nal(&stream, 0x68, pps.data);
+    BitWriter slice;
+    slice.ue(0);         // first_mb_in_slice
+    slice.ue(7);         // slice_type, I
+    slice.ue(0);         // pic_parameter_set_id
+    slice.put(0, 4);     // frame_num
+    slice.ue(i % 2);     // idr_pic_id, differs in consecutive IDR pictures
+    slice.put(0, 2);     // no_output_of_prior_pics_flag, long_term_reference_flag
+    slice.ue(0);         // slice_qp_delta
+    slice.ue(1);         // disable_deblocking_filter_idc
+    for (guint mb = 0; mb < width / 16 * height / 16; ++mb) {
+      slice.ue(25);  // mb_type, I_PCM
+      slice.align();
+      for (guint s = 0; s < 256 + 128; ++s) {
+        slice.put(s < 256 ? 16 + (mb * 8 + i * 16) % 220 : 128, 8);
+      }
+    }
+    slice.trailing();
+    put_nal(&stream, 0x65, slice.data);
+  }
+  return stream;
+}
+
+// sample stream followed by pictures of a smaller resolution
+static gchar*
+write_resolution_change_stream(guint width, guint height, guint n_frames)
+{
+  gchar* sample = sample_location();
+  std::ifstream in(sample, std::ios::binary);
+  g_free(sample);
+  std::vector<guint8> stream((std::istreambuf_iterator<char>(in)), std::istreambuf_iterator<char>());
+  fail_unless(!stream.empty());
+  auto tail = make_pcm_stream(width, height, n_frames);
+  stream.insert(stream.end(), tail.begin(), tail.end());
+
+  gchar* location = g_build_filename(g_get_tmp_dir(), "cnvideo_dec_resolution_change.h264", NULL);
+  fail_unless(g_file_set_contents(location, reinterpret_cast<const gchar*>(stream.data()), stream.size(), NULL));
+  return location;
+}
+
+struct FrameSizes
+{
+  gint n_1080p;
+  gint n_small;
+  // frame not matching caps it is pushed with
+  gint n_wrong;
+};
+
+static void
+count_frame_sizes(GstElement* sink, GstBuffer* buffer, GstPad* pad, gpointer user_data)
+{
+  auto sizes = reinterpret_cast<FrameSizes*>(user_data);
+  GstCaps* caps = gst_pad_get_current_caps(pad);
+  GstVideoInfo info;
+  if (!caps || !gst_video_info_from_caps(&info, caps) || gst_buffer_get_size(buffer) != info.size) {
+    g_atomic_int_inc(&sizes->n_wrong);
+  } else if (info.width == 1920 && info.height == 1080) {
+    g_atomic_int_inc(&sizes->n_1080p);
+  } else if (info.width == 352 && info.height == 288) {
+    g_atomic_int_inc(&sizes->n_small);
+  } else {
+    g_atomic_int_inc(&sizes->n_wrong);
+  }
+  if (caps)
+    gst_caps_unref(caps);
+}
+
+// decoder is reused when caps change to a smaller resolution, frames before the change keep their caps
+GST_START_TEST(test_reuse_on_caps_change)
+{
+  gchar* location = write_resolution_change_stream(352, 288, 5);
+  FrameSizes sizes = { 0, 0, 0 };
+  decode_to_eos(location, "", G_CALLBACK(count_frame_sizes), &sizes);
+  g_remove(location);
+  g_free(location);
+
+  fail_unless(sizes.n_1080p > 0);
+  fail_unless_equals_int(sizes.n_small, 5);
+  fail_unless_equals_int(sizes.n_wrong, 0);
+}
+GST_END_TEST;
+
+// caps of the first sequence stay, later sequences are told only by parameter sets in band
+static GstPadProbeReturn
+drop_caps_change(GstPad* pad, GstPadProbeInfo* info, gpointer user_data)
+{
+  GstEvent* event = GST_PAD_PROBE_INFO_EVENT(info);
+  if (GST_EVENT_TYPE(event) == GST_EVENT_CAPS && gst_pad_has_current_caps(pad)) {
+    return GST_PAD_PROBE_DROP;
+  }
+  return GST_PAD_PROBE_OK;
+}
+
+// SPS of a smaller resolution in band starts a new sequence of the decoder, and caps follow it
+GST_START_TEST(test_resolution_change_in_band)
+{
+  gchar* location = write_resolution_change_stream(352, 288, 5);
+  FrameSizes sizes = { 0, 0, 0 };
+  decode_to_eos(location, "", G_CALLBACK(count_frame_sizes), &sizes, drop_caps_change);
+  g_remove(location);
+  g_free(location);
+
+  fail_unless(sizes.n_1080p > 0);
+  fail_unless_equals_int(sizes.n_small, 5);
+  fail_unless_equals_int(sizes.n_wrong, 0);
+}
+GST_END_TEST;
+
+// decoder of the pool runs through SEQUENCE event and decodes a stream restarted after EOS
+GST_START_TEST(test_decoder_pool_restart)
+{
+  gchar* location = sample_location();
+  gchar* desc = g_strdup_printf("filesrc location=%s ! h264parse ! cnvideo_dec decoder-pool-size=1 ! video/x-raw ! "
+                                "fakesink name=sink signal-handoffs=true sync=false",
+                                location);
+  g_free(location);
+  GstElement* pipeline = gst_parse_launch(desc, NULL);
+  g_free(desc);
+  fail_unless(pipeline != NULL);
+  GstElement* sink = gst_bin_get_by_name(GST_BIN(pipeline), "sink");
+  FrameSizes sizes[2] = { { 0, 0, 0 }, { 0, 0, 0 } };
+  GstBus* bus = gst_element_get_bus(pipeline);
+
+  for (auto& pass : sizes) {
+    if (&pass != sizes) {
+      // spare decoder is created in background while the first stream is decoded
+      for (int i = 0; i < 500 && DecoderPool::get()->n_idle() == 0; ++i) {
+        g_usleep(10000);
+      }
+      fail_unless(DecoderPool::get()->n_idle() > 0);
+      // flush after EOS restarts the decoder, which is checked out of pool
+      fail_unless(gst_element_seek_simple(pipeline, GST_FORMAT_TIME, GST_SEEK_FLAG_FLUSH, 0));
+    }
+    gulong id = g_signal_connect(sink, "handoff", G_CALLBACK(count_frame_sizes), &pass);
+    fail_unless(gst_element_set_state(pipeline, GST_STATE_PLAYING) != GST_STATE_CHANGE_FAILURE);
+    GstMessage* msg =
+      gst_bus_timed_pop_filtered(bus, GST_CLOCK_TIME_NONE, (GstMessageType)(GST_MESSAGE_EOS | GST_MESSAGE_ERROR));
+    fail_unless(msg && GST_MESSAGE_TYPE(msg) == GST_MESSAGE_EOS);
+    gst_message_unref(msg);
+    fail_unless(gst_element_set_state(pipeline, GST_STATE_PAUSED) != GST_STATE_CHANGE_FAILURE);
+    fail_unless(gst_element_get_state(pipeline, NULL, NULL, GST_CLOCK_TIME_NONE) == GST_STATE_CHANGE_SUCCESS);
+    g_signal_handler_disconnect(sink, id);
+  }
+  fail_unless(sizes[0].n_1080p > 0);
+  fail_unless_equals_int(sizes[1].n_1080p, sizes[0].n_1080p);
+  fail_unless_equals_int(sizes[0].n_wrong + sizes[1].n_wrong, 0);
+
+  gst_element_set_state(pipeline, GST_STATE_NULL);
+  gst_object_unref(bus);
+  gst_object_unref(sink);
+  gst_object_unref(pipeline);
+}
+GST_END_TEST;
+
+// a second stream is decoded by the spare decoder the first one left in pool, which is emptied once both are freed
+GST_START_TEST(test_decoder_pool_two_streams)
+{
+  gchar* location = sample_location();
+  FrameSizes sizes[2] = { { 0, 0, 0 }, { 0, 0, 0 } };
+  // pool is held like an element would hold it, so that it is kept between the two streams
+  DecoderPool::get()->attach();
+  decode_to_eos(location, "decoder-pool-size=1", G_CALLBACK(count_frame_sizes), &sizes[0]);
+  for (int i = 0; i < 500 && DecoderPool::get()->n_idle() == 0; ++i) {
+    g_usleep(10000);
+  }
+  fail_unless(DecoderPool::get()->n_idle() > 0);
+  decode_to_eos(location, "decoder-pool-size=1", G_CALLBACK(count_frame_sizes), &sizes[1]);
+  g_free(location);
+
+  fail_unless(sizes[0].n_1080p > 0);
+  fail_unless_equals_int(sizes[1].n_1080p, sizes[0].n_1080p);
+  fail_unless_equals_int(sizes[0].n_wrong + sizes[1].n_wrong, 0);
+
+  DecoderPool::get()->detach();
+  for (int i = 0; i < 500 && DecoderPool::get()->n_idle() > 0; ++i) {
+    g_usleep(10000);
+  }
+  fail_unless_equals_int(DecoderPool::get()->n_idle(), 0);
+}
+GST_END_TEST;
+
+struct OutputThreads
+{
+  // thread feeding the decoder
+  gpointer input;
+  gint n_frames;
+  // frames pushed by the thread feeding the decoder
+  gint n_pushed_by_input;
+};
+
+static GstPadProbeReturn
+record_input_thread(GstPad* pad, GstPadProbeInfo* info, gpointer user_data)
+{
+  g_atomic_pointer_set(&reinterpret_cast<OutputThreads*>(user_data)->input, g_thread_self());
+  return GST_PAD_PROBE_OK;
+}
+
+static void
+slow_handoff(GstElement* sink, GstBuffer* buffer, GstPad* pad, gpointer user_data)
+{
+  auto threads = reinterpret_cast<OutputThreads*>(user_data);
+  if (g_atomic_pointer_get(&threads->input) == g_thread_self()) {
+    g_atomic_int_inc(&threads->n_pushed_by_input);
+  }
+  g_atomic_int_inc(&threads->n_frames);
+  // output queue fills up behind a slow consumer
+  g_usleep(2000);
+}
+
+// frames are pushed by the task of src pad through a bounded queue, none is lost without leaky
+GST_START_TEST(test_output_queue)
+{
+  gchar* location = sample_location();
+  FrameSizes sizes = { 0, 0, 0 };
+  decode_to_eos(location, "", G_CALLBACK(count_frame_sizes), &sizes);
+
+  gchar* desc = g_strdup_printf("filesrc location=%s ! h264parse ! cnvideo_dec name=dec output-queue-size=2 ! "
+                                "video/x-raw ! fakesink name=sink signal-handoffs=true sync=false",
+                                location);
+  g_free(location);
+  GstElement* pipeline = gst_parse_launch(desc, NULL);
+  g_free(desc);
+  fail_unless(pipeline != NULL);
+  GstElement* dec = gst_bin_get_by_name(GST_BIN(pipeline), "dec");
+  GstElement* sink = gst_bin_get_by_name(GST_BIN(pipeline), "sink");
+  OutputThreads threads = { nullptr, 0, 0 };
+  GstPad* pad = gst_element_get_static_pad(dec, "sink");
+  gst_pad_add_probe(pad, GST_PAD_PROBE_TYPE_BUFFER, record_input_thread, &threads, NULL);
+  gst_object_unref(pad);
+  g_signal_connect(sink, "handoff", G_CALLBACK(slow_handoff), &threads);
+
+  GstBus* bus = gst_element_get_bus(pipeline);
+  fail_unless(gst_element_set_state(pipeline, GST_STATE_PLAYING) != GST_STATE_CHANGE_FAILURE);
+  GstMessage* msg =
+    gst_bus_timed_pop_filtered(bus, GST_CLOCK_TIME_NONE, (GstMessageType)(GST_MESSAGE_EOS | GST_MESSAGE_ERROR));
+  fail_unless(msg && GST_MESSAGE_TYPE(msg) == GST_MESSAGE_EOS);
+  gst_message_unref(msg);
+
+  guint high_water = 0;
+  g_object_get(G_OBJECT(dec), "output-high-water", &high_water, NULL);
+  fail_unless(high_water >= 1 && high_water <= 2);
+  fail_unless(sizes.n_1080p > 0);
+  fail_unless_equals_int(threads.n_frames, sizes.n_1080p);
+  fail_unless_equals_int(threads.n_pushed_by_input, 0);
+
+  gst_element_set_state(pipeline, GST_STATE_NULL);
+  gst_object_unref(bus);
+  gst_object_unref(sink);
+  gst_object_unref(dec);
+  gst_object_unref(pipeline);
+}
+GST_END_TEST;
+
+// pictures dropped before decoding and frames dropped after it leave well formed frames of fewer number
+GST_START_TEST(test_decode_mode_and_interval)
+{
+  gchar* location = sample_location();
+  FrameSizes all = { 0, 0, 0 }, keyframes = { 0, 0, 0 }, reference = { 0, 0, 0 }, interval = { 0, 0, 0 };
+  decode_to_eos(location, "", G_CALLBACK(count_frame_sizes), &all);
+  decode_to_eos(location, "decode-mode=keyframes", G_CALLBACK(count_frame_sizes), &keyframes);
+  decode_to_eos(location, "decode-mode=reference-only", G_CALLBACK(count_frame_sizes), &reference);
+  decode_to_eos(location, "output-interval=5", G_CALLBACK(count_frame_sizes), &interval);
+  g_free(location);
+
+  fail_unless_equals_int(all.n_wrong + keyframes.n_wrong + reference.n_wrong + interval.n_wrong, 0);
+  // sample has inter pictures between its keyframes
+  fail_unless(keyframes.n_1080p > 0 && keyframes.n_1080p < all.n_1080p);
+  fail_unless(reference.n_1080p >= keyframes.n_1080p && reference.n_1080p <= all.n_1080p);
+  // the first frame and every 5th after it
+  fail_unless_equals_int(interval.n_1080p, (all.n_1080p + 4) / 5);
+}
+GST_END_TEST;
+
 /* Verify h264 is working when explictly requested by a pipeline. */
 GST_START_TEST(test_h264dec_NV21_explicit)
 {
@@ -251,6 +1041,18 @@ cnvideodec_suite(void)
 
   suite_add_tcase(s, tc_chain);
   tcase_add_test(tc_chain, test_properties);
+  tcase_add_test(tc_chain, test_output_queue_properties);
+  tcase_add_test(tc_chain, test_decode_mode_properties);
+  tcase_add_test(tc_chain, test_decoder_pool_property);
+  tcase_add_test(tc_chain, test_low_latency);
+  tcase_add_test(tc_chain, test_flush_seek);
+  tcase_add_test(tc_chain, test_input_pool);
+  tcase_add_test(tc_chain, test_reuse_on_caps_change);
+  tcase_add_test(tc_chain, test_resolution_change_in_band);
+  tcase_add_test(tc_chain, test_decoder_pool_restart);
+  tcase_add_test(tc_chain, test_decoder_pool_two_streams);
+  tcase_add_test(tc_chain, test_output_queue);
+  tcase_add_test(tc_chain, test_decode_mode_and_interval);
   tcase_add_test(tc_chain, test_h264dec_NV21_explicit);
   tcase_add_test(tc_chain, test_h264dec_NV12_explicit);
   tcase_add_test(tc_chain, test_h264dec_I420_explicit);
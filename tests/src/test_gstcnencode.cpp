@@ -24,14 +24,18 @@
 #include <unistd.h>
 
 #include <cstdio>
+#include <cstring>
+#include <vector>
 
 #include "cn_codec_common.h"
+#include "common/mlu_memory_meta.h"
 
 static GstStaticPadTemplate srctemplate =
   GST_STATIC_PAD_TEMPLATE("src",
                           GST_PAD_SRC,
                           GST_PAD_ALWAYS,
-                          GST_STATIC_CAPS(GST_VIDEO_CAPS_MAKE("{ NV21, NV12, I420, BGRA, RGBA, ABGR, ARGB }")));
+                          GST_STATIC_CAPS("video/x-raw(memory:mlu), format={ NV21, NV12, I420, BGRA, RGBA, ABGR, ARGB };"
+                                          GST_VIDEO_CAPS_MAKE("{ NV21, NV12, I420, BGRA, RGBA, ABGR, ARGB }")));
 
 static GstStaticPadTemplate sinktemplate =
   GST_STATIC_PAD_TEMPLATE("sink",
@@ -170,6 +174,62 @@ feed_stream(GstVideoFormat format, guint width, guint height)
   return TRUE;
 }
 
+// upload NV12 frames into mlu buffers with rows of stride bytes, as cnconvert or cnvideo_dec would hand them over
+static gboolean
+feed_mlu_stream(guint width, guint height, guint stride)
+{
+  int frame_size = width * height * 3 / 2;
+  GstSegment seg;
+
+  input_count = output_count = 0;
+  frame_count = 0;
+  got_eos = FALSE;
+
+  fail_unless(test_stream != NULL, "test stream is NULL");
+
+  fseek(test_stream, 0, SEEK_END);
+  int file_len = ftell(test_stream);
+  fail_unless(file_len >= frame_size, "input file size invalid!");
+  fseek(test_stream, 0, SEEK_SET);
+
+  gst_segment_init(&seg, GST_FORMAT_TIME);
+  fail_unless(gst_pad_push_event(mysrcpad, gst_event_new_segment(&seg)));
+
+  frame_count = file_len / frame_size;
+  std::vector<guint8> host(frame_size);
+  for (guint i = 0; i < frame_count; ++i) {
+    fail_unless(fread(host.data(), 1, frame_size, test_stream) == static_cast<size_t>(frame_size));
+
+    GstMluFrame_t frame = gst_mlu_frame_new();
+    frame->width = width;
+    frame->height = height;
+    frame->n_planes = 2;
+    const guint rows[2] = { height, height / 2 };
+    for (guint p = 0; p < 2; ++p) {
+      frame->stride[p] = stride;
+      frame->data[p] = cn_syncedmem_new(stride * rows[p]);
+      auto dst = static_cast<guint8*>(cn_syncedmem_get_mutable_host_data(frame->data[p]));
+      const guint8* src = host.data() + (p ? width * height : 0);
+      memset(dst, 0, stride * rows[p]);
+      for (guint row = 0; row < rows[p]; ++row) {
+        memcpy(dst + row * stride, src + row * width, width);
+      }
+      // move data to device, encoder only reads the device side
+      cn_syncedmem_get_dev_data(frame->data[p]);
+    }
+    GstBuffer* buffer = gst_buffer_new();
+    gst_buffer_add_mlu_memory_meta(buffer, frame, "test");
+
+    GST_BUFFER_TIMESTAMP(buffer) = gst_util_uint64_scale(input_count, GST_SECOND, 25);
+    GST_BUFFER_DURATION(buffer) = gst_util_uint64_scale(1, GST_SECOND, 25);
+    fail_unless(gst_pad_push(mysrcpad, buffer) == GST_FLOW_OK);
+    input_count++;
+  }
+
+  fail_unless(gst_pad_push_event(mysrcpad, gst_event_new_eos()));
+  return TRUE;
+}
+
 static void
 save_output(GstBuffer* buffer)
 {
@@ -488,6 +548,57 @@ GST_START_TEST(test_cnvideoenc_NV21_H265)
 }
 GST_END_TEST;
 
+static void
+encode_mlu_stream(guint stride, const gchar* output)
+{
+  GstElement* cnvideoenc;
+
+  // setup the element for testing
+  cnvideoenc = setup_cnvideoenc("video/x-raw(memory:mlu),format=(string)NV12,"
+                            "width=(int)1280,height=(int)720,"
+                            "framerate=(fraction)25/1",
+                            CNCODEC_H264);
+
+  setup_stream("../tests/data/cars_nv12.yuv", output);
+  feed_mlu_stream(1280, 720, stride);
+
+  // wait encoder finish encoding work
+  while (got_eos == FALSE) {
+    usleep(10000);
+  }
+  fail_unless(output_count > 0);
+
+  cleanup_stream();
+
+  // tear down the element
+  cleanup_cnvideoenc(cnvideoenc);
+}
+
+GST_START_TEST(test_cnvideoenc_mlu_NV12_H264)
+{
+  g_print("test_cnvideoenc_mlu_NV12_H264()\n");
+  encode_mlu_stream(1280, "cars_mlu_nv12.h264");
+}
+GST_END_TEST;
+
+// padding of rows is dropped when frames are copied into input buffers of encoder
+GST_START_TEST(test_cnvideoenc_mlu_padded_stride)
+{
+  g_print("test_cnvideoenc_mlu_padded_stride()\n");
+  encode_mlu_stream(1280, "cars_mlu_nv12.h264");
+  encode_mlu_stream(1280 + 64, "cars_mlu_nv12_padded.h264");
+
+  gchar *packed = NULL, *padded = NULL;
+  gsize packed_size = 0, padded_size = 0;
+  fail_unless(g_file_get_contents("cars_mlu_nv12.h264", &packed, &packed_size, NULL));
+  fail_unless(g_file_get_contents("cars_mlu_nv12_padded.h264", &padded, &padded_size, NULL));
+  fail_unless(packed_size > 0 && packed_size == padded_size);
+  fail_unless(memcmp(packed, padded, packed_size) == 0);
+  g_free(packed);
+  g_free(padded);
+}
+GST_END_TEST;
+
 Suite*
 cnvideoenc_suite(void)
 {
@@ -503,6 +614,8 @@ cnvideoenc_suite(void)
   tcase_add_test(tc_chain, test_cnvideoenc_NV21_H264);
   tcase_add_test(tc_chain, test_cnvideoenc_NV12_H265);
   tcase_add_test(tc_chain, test_cnvideoenc_NV21_H265);
+  tcase_add_test(tc_chain, test_cnvideoenc_mlu_NV12_H264);
+  tcase_add_test(tc_chain, test_cnvideoenc_mlu_padded_stride);
 
   return s;
 }
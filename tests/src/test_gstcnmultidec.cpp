@@ -0,0 +1,191 @@
+/*
+ *  Copyright (C) [2019-2020] by Cambricon, Inc.
+ *
+ *  This file is part of CNStream-Gst.
+ *
+ *  CNStream-Gst is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU Lesser General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  CNStream-Gst is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU Lesser General Public License for more details.
+ *
+ *  You should have received a copy of the GNU Lesser General Public License
+ *  along with CNStream-Gst.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#ifdef WITH_DECODE
+
+#include <gst/check/gstcheck.h>
+#include <sys/resource.h>
+#include <unistd.h>
+#include <cstdio>
+#include <cstring>
+#include <string>
+
+static gchar*
+video_path(void)
+{
+  gchar current_path[128];
+  memset(current_path, 0x00, sizeof(current_path));
+  fail_unless(getcwd(current_path, sizeof(current_path) - 1));
+  return g_strconcat(current_path, "/../samples/data/videos/1080P.h264", NULL);
+}
+
+// threads of the process, from /proc/self/status
+static guint
+thread_count(void)
+{
+  guint threads = 0;
+  FILE* fp = fopen("/proc/self/status", "r");
+  if (!fp) {
+    return 0;
+  }
+  char line[256];
+  while (fgets(line, sizeof(line), fp)) {
+    if (sscanf(line, "Threads: %u", &threads) == 1) {
+      break;
+    }
+  }
+  fclose(fp);
+  return threads;
+}
+
+static gdouble
+cpu_seconds(void)
+{
+  struct rusage usage;
+  getrusage(RUSAGE_SELF, &usage);
+  return usage.ru_utime.tv_sec + usage.ru_stime.tv_sec + (usage.ru_utime.tv_usec + usage.ru_stime.tv_usec) / 1e6;
+}
+
+// n streams of the sample video decoded by one cnmultidec
+static GstElement*
+create_pipeline(guint n_streams, const gchar* location, const gchar* sink)
+{
+  std::string desc = "cnmultidec name=d";
+  for (guint i = 0; i < n_streams; ++i) {
+    gchar* branch = g_strdup_printf(" filesrc location=%s ! h264parse ! d.sink_%u d.src_%u ! "
+                                    "video/x-raw(memory:mlu), format=NV12 ! %s",
+                                    location, i, i, sink);
+    desc += branch;
+    g_free(branch);
+  }
+  GError* error = NULL;
+  GstElement* pipeline = gst_parse_launch(desc.c_str(), &error);
+  fail_unless(pipeline && !error);
+  return pipeline;
+}
+
+static void
+run_to_eos(GstElement* pipeline)
+{
+  fail_unless(gst_element_set_state(pipeline, GST_STATE_PLAYING) != GST_STATE_CHANGE_FAILURE);
+  GstBus* bus = gst_element_get_bus(pipeline);
+  GstMessage* msg =
+    gst_bus_timed_pop_filtered(bus, GST_CLOCK_TIME_NONE, (GstMessageType)(GST_MESSAGE_EOS | GST_MESSAGE_ERROR));
+  fail_unless(msg && GST_MESSAGE_TYPE(msg) == GST_MESSAGE_EOS);
+  gst_message_unref(msg);
+  gst_object_unref(bus);
+}
+
+GST_START_TEST(test_request_pads)
+{
+  GstElement* multidec = gst_check_setup_element("cnmultidec");
+  fail_unless(multidec != NULL);
+
+  guint event_threads = 0, output_threads = 0;
+  g_object_get(G_OBJECT(multidec), "event-threads", &event_threads, "output-threads", &output_threads, NULL);
+  fail_unless_equals_int(event_threads, 1);
+  fail_unless_equals_int(output_threads, 2);
+
+  // each sink pad comes with the src pad of same index
+  GstPad* sink0 = gst_element_get_request_pad(multidec, "sink_%u");
+  GstPad* sink3 = gst_element_get_request_pad(multidec, "sink_3");
+  GstPad* sink4 = gst_element_get_request_pad(multidec, "sink_%u");
+  fail_unless(sink0 && sink3 && sink4);
+  fail_unless(gst_element_get_request_pad(multidec, "sink_3") == NULL);
+  fail_unless_equals_string(GST_PAD_NAME(sink4), "sink_4");
+  GstPad* src3 = gst_element_get_static_pad(multidec, "src_3");
+  fail_unless(src3 != NULL);
+  gst_object_unref(src3);
+  fail_unless_equals_int(multidec->numpads, 6);
+
+  gst_element_release_request_pad(multidec, sink3);
+  gst_object_unref(sink3);
+  fail_unless(gst_element_get_static_pad(multidec, "src_3") == NULL);
+  fail_unless_equals_int(multidec->numpads, 4);
+
+  gst_element_release_request_pad(multidec, sink0);
+  gst_object_unref(sink0);
+  gst_element_release_request_pad(multidec, sink4);
+  gst_object_unref(sink4);
+  gst_check_teardown_element(multidec);
+}
+GST_END_TEST;
+
+GST_START_TEST(test_decode_streams)
+{
+  gchar* location = video_path();
+  GstElement* pipeline = create_pipeline(4, location, "fakesink sync=false");
+  g_free(location);
+  // more streams than output threads, each stream prerolls its sink while the others go on
+  GstElement* multidec = gst_bin_get_by_name(GST_BIN(pipeline), "d");
+  g_object_set(G_OBJECT(multidec), "output-threads", 1, NULL);
+  gst_object_unref(multidec);
+
+  // every stream gets its EOS after its frames
+  run_to_eos(pipeline);
+  gst_element_set_state(pipeline, GST_STATE_NULL);
+  gst_object_unref(pipeline);
+}
+GST_END_TEST;
+
+GST_START_TEST(test_benchmark)
+{
+  gchar* location = video_path();
+  guint base_threads = thread_count();
+
+  for (guint n_streams : { 16, 64, 128 }) {
+    GstElement* pipeline = create_pipeline(n_streams, location, "fakesink sync=false");
+    gdouble cpu_start = cpu_seconds();
+    gint64 start = g_get_monotonic_time();
+    fail_unless(gst_element_set_state(pipeline, GST_STATE_PAUSED) != GST_STATE_CHANGE_FAILURE);
+    fail_unless(gst_element_get_state(pipeline, NULL, NULL, GST_CLOCK_TIME_NONE) != GST_STATE_CHANGE_FAILURE);
+    guint threads = thread_count() - base_threads;
+    run_to_eos(pipeline);
+    gdouble elapsed = (g_get_monotonic_time() - start) / 1e6;
+    gdouble cpu = cpu_seconds() - cpu_start;
+    GST_INFO("cnmultidec %u streams: %u threads (%.2f per stream), cpu %.1f%% per stream, %.2f s", n_streams, threads,
+             (gdouble)threads / n_streams, cpu * 100 / elapsed / n_streams, elapsed);
+    gst_element_set_state(pipeline, GST_STATE_NULL);
+    gst_object_unref(pipeline);
+  }
+  g_free(location);
+}
+GST_END_TEST;
+
+Suite*
+cnmultidec_suite(void)
+{
+  Suite* s = suite_create("cnmultidec");
+  TCase* tc_chain = tcase_create("general");
+
+  suite_add_tcase(s, tc_chain);
+  tcase_add_test(tc_chain, test_request_pads);
+  tcase_add_test(tc_chain, test_decode_streams);
+
+  // takes minutes, run with CNMULTIDEC_BENCHMARK=1 and read results with GST_DEBUG=check:4
+  if (g_getenv("CNMULTIDEC_BENCHMARK")) {
+    TCase* tc_benchmark = tcase_create("benchmark");
+    suite_add_tcase(s, tc_benchmark);
+    tcase_set_timeout(tc_benchmark, 600);
+    tcase_add_test(tc_benchmark, test_benchmark);
+  }
+  return s;
+}
+
+#endif
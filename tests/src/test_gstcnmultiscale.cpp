@@ -0,0 +1,245 @@
+/*
+ *  Copyright (C) [2019-2020] by Cambricon, Inc.
+ *
+ *  This file is part of CNStream-Gst.
+ *
+ *  CNStream-Gst is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU Lesser General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  CNStream-Gst is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU Lesser General Public License for more details.
+ *
+ *  You should have received a copy of the GNU Lesser General Public License
+ *  along with CNStream-Gst.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#ifdef WITH_CONVERT
+
+#include <gst/check/gstcheck.h>
+#include <gst/video/video.h>
+#include <unistd.h>
+#include <chrono>
+#include <condition_variable>
+#include <cstring>
+#include <mutex>
+
+GST_START_TEST(test_create_and_destroy)
+{
+  GstElement* scale;
+
+  scale = gst_check_setup_element("cnmultiscale");
+  fail_if(!scale);
+
+  gst_check_teardown_element(scale);
+}
+GST_END_TEST;
+
+GST_START_TEST(test_request_pads)
+{
+  GstElement* scale = gst_check_setup_element("cnmultiscale");
+  fail_if(!scale);
+
+  // outputs of a ladder are request pads sharing the only sink pad
+  GstPad* src0 = gst_element_get_request_pad(scale, "src_%u");
+  GstPad* src1 = gst_element_get_request_pad(scale, "src_3");
+  fail_unless(src0 && src1);
+  fail_unless(g_strcmp0(GST_PAD_NAME(src0), "src_0") == 0);
+  fail_unless(g_strcmp0(GST_PAD_NAME(src1), "src_3") == 0);
+  fail_unless(gst_element_get_request_pad(scale, "src_3") == NULL);
+  fail_unless(scale->numsrcpads == 2 && scale->numsinkpads == 1);
+
+  gst_element_release_request_pad(scale, src1);
+  gst_object_unref(src1);
+  fail_unless(scale->numsrcpads == 1);
+
+  GstPad* src2 = gst_element_get_request_pad(scale, "src_%u");
+  fail_unless(g_strcmp0(GST_PAD_NAME(src2), "src_4") == 0);
+
+  gst_element_release_request_pad(scale, src0);
+  gst_element_release_request_pad(scale, src2);
+  gst_object_unref(src0);
+  gst_object_unref(src2);
+  gst_check_teardown_element(scale);
+}
+GST_END_TEST;
+
+GST_START_TEST(test_sink_caps)
+{
+  GstElement* scale = gst_check_setup_element("cnmultiscale");
+  fail_if(!scale);
+
+  // input is accepted whatever outputs are
+  GstPad* sinkpad = gst_element_get_static_pad(scale, "sink");
+  GstCaps* caps = gst_pad_query_caps(sinkpad, NULL);
+  GstCaps* nv12 = gst_caps_from_string("video/x-raw(memory:mlu), format=NV12, width=1920, height=1080");
+  fail_unless(gst_caps_can_intersect(caps, nv12));
+
+  gst_caps_unref(nv12);
+  gst_caps_unref(caps);
+  gst_object_unref(sinkpad);
+  gst_check_teardown_element(scale);
+}
+GST_END_TEST;
+
+#ifdef WITH_DECODE
+// frames reaching a sink, each expected at the size negotiated on its pad
+struct ScaleOutputs
+{
+  gint width;
+  gint height;
+  gint n_frames = 0;
+  bool sizes_match = true;
+};
+
+static void
+record_output(GstElement* sink, GstBuffer* buffer, GstPad* pad, gpointer user_data)
+{
+  auto outputs = reinterpret_cast<ScaleOutputs*>(user_data);
+  GstCaps* caps = gst_pad_get_current_caps(pad);
+  GstVideoInfo info;
+  bool ok = caps && gst_video_info_from_caps(&info, caps);
+  if (caps) {
+    gst_caps_unref(caps);
+  }
+  outputs->n_frames++;
+  if (!ok || GST_VIDEO_INFO_WIDTH(&info) != outputs->width || GST_VIDEO_INFO_HEIGHT(&info) != outputs->height ||
+      gst_buffer_get_size(buffer) != GST_VIDEO_INFO_SIZE(&info)) {
+    outputs->sizes_match = false;
+  }
+}
+
+// input is held after this many frames until an output is requested
+#define LATE_OUTPUT_FRAME 10
+
+struct InputGate
+{
+  std::mutex mutex;
+  std::condition_variable cond;
+  gint n_frames = 0;
+  bool holding = false;
+  bool released = false;
+};
+
+static GstPadProbeReturn
+hold_input(GstPad* pad, GstPadProbeInfo* info, gpointer user_data)
+{
+  auto gate = reinterpret_cast<InputGate*>(user_data);
+  std::unique_lock<std::mutex> lk(gate->mutex);
+  if (++gate->n_frames == LATE_OUTPUT_FRAME + 1) {
+    gate->holding = true;
+    gate->cond.notify_all();
+    gate->cond.wait(lk, [gate] { return gate->released; });
+  }
+  return GST_PAD_PROBE_OK;
+}
+
+static void
+connect_output(GstElement* pipeline, const gchar* sink_name, ScaleOutputs* outputs)
+{
+  GstElement* sink = gst_bin_get_by_name(GST_BIN(pipeline), sink_name);
+  fail_unless(sink != NULL);
+  g_signal_connect(sink, "handoff", G_CALLBACK(record_output), outputs);
+  gst_object_unref(sink);
+}
+
+// decoded frames are scaled to outputs of different sizes and formats, one of them requested while streaming
+GST_START_TEST(test_run)
+{
+  gchar current_path[128];
+  memset(current_path, 0x00, sizeof(current_path));
+  fail_unless(getcwd(current_path, sizeof(current_path) - 1));
+  gchar* desc = g_strdup_printf(
+    "filesrc location=%s/../samples/data/videos/1080P.h264 ! h264parse ! cnvideo_dec ! cnmultiscale name=scale "
+    "scale.src_0 ! video/x-raw(memory:mlu), format=RGBA, width=640, height=360 ! "
+    "fakesink name=sink0 signal-handoffs=true sync=false "
+    "scale.src_1 ! video/x-raw, format=BGR, width=320, height=180 ! "
+    "fakesink name=sink1 signal-handoffs=true sync=false",
+    current_path);
+  GstElement* pipeline = gst_parse_launch(desc, NULL);
+  g_free(desc);
+  fail_unless(pipeline != NULL);
+
+  ScaleOutputs outputs[3];
+  outputs[0].width = 640, outputs[0].height = 360;
+  outputs[1].width = 320, outputs[1].height = 180;
+  outputs[2].width = 224, outputs[2].height = 224;
+  connect_output(pipeline, "sink0", &outputs[0]);
+  connect_output(pipeline, "sink1", &outputs[1]);
+  GstElement* scale = gst_bin_get_by_name(GST_BIN(pipeline), "scale");
+  GstPad* scale_sink = gst_element_get_static_pad(scale, "sink");
+  InputGate gate;
+  gst_pad_add_probe(scale_sink, GST_PAD_PROBE_TYPE_BUFFER, hold_input, &gate, NULL);
+  gst_object_unref(scale_sink);
+
+  GstBus* bus = gst_element_get_bus(pipeline);
+  fail_unless(gst_element_set_state(pipeline, GST_STATE_PLAYING) != GST_STATE_CHANGE_FAILURE);
+  {
+    std::unique_lock<std::mutex> lk(gate.mutex);
+    fail_unless(gate.cond.wait_for(lk, std::chrono::seconds(30), [&gate] { return gate.holding; }));
+  }
+
+  // third output joins a running stream
+  GstElement* filter = gst_element_factory_make("capsfilter", NULL);
+  GstElement* sink = gst_element_factory_make("fakesink", NULL);
+  fail_unless(filter && sink);
+  GstCaps* caps = gst_caps_from_string("video/x-raw, format=RGB, width=224, height=224");
+  g_object_set(filter, "caps", caps, NULL);
+  gst_caps_unref(caps);
+  g_object_set(sink, "signal-handoffs", TRUE, "sync", FALSE, NULL);
+  g_signal_connect(sink, "handoff", G_CALLBACK(record_output), &outputs[2]);
+  gst_bin_add_many(GST_BIN(pipeline), filter, sink, NULL);
+  fail_unless(gst_element_link(filter, sink));
+  fail_unless(gst_element_sync_state_with_parent(sink) && gst_element_sync_state_with_parent(filter));
+  GstPad* late = gst_element_get_request_pad(scale, "src_%u");
+  GstPad* filter_sink = gst_element_get_static_pad(filter, "sink");
+  fail_unless(late && gst_pad_link(late, filter_sink) == GST_PAD_LINK_OK);
+  gst_object_unref(filter_sink);
+  {
+    std::lock_guard<std::mutex> lk(gate.mutex);
+    gate.released = true;
+    gate.cond.notify_all();
+  }
+
+  GstMessage* msg =
+    gst_bus_timed_pop_filtered(bus, GST_CLOCK_TIME_NONE, (GstMessageType)(GST_MESSAGE_EOS | GST_MESSAGE_ERROR));
+  fail_unless(msg && GST_MESSAGE_TYPE(msg) == GST_MESSAGE_EOS);
+  gst_message_unref(msg);
+  gst_element_set_state(pipeline, GST_STATE_NULL);
+  gst_object_unref(late);
+  gst_object_unref(scale);
+  gst_object_unref(bus);
+  gst_object_unref(pipeline);
+
+  fail_unless(gate.n_frames > LATE_OUTPUT_FRAME);
+  fail_unless_equals_int(outputs[0].n_frames, gate.n_frames);
+  fail_unless_equals_int(outputs[1].n_frames, gate.n_frames);
+  // frames held back when the output is requested reach it as well
+  fail_unless_equals_int(outputs[2].n_frames, gate.n_frames - LATE_OUTPUT_FRAME);
+  for (const auto& output : outputs) {
+    fail_unless(output.sizes_match);
+  }
+}
+GST_END_TEST;
+#endif  // WITH_DECODE
+
+Suite*
+cnmultiscale_suite(void)
+{
+  Suite* s = suite_create("cnmultiscale");
+  TCase* tc_chain = tcase_create("general");
+
+  suite_add_tcase(s, tc_chain);
+  tcase_add_test(tc_chain, test_create_and_destroy);
+  tcase_add_test(tc_chain, test_request_pads);
+  tcase_add_test(tc_chain, test_sink_caps);
+#ifdef WITH_DECODE
+  tcase_add_test(tc_chain, test_run);
+#endif
+  return s;
+}
+
+#endif  // WITH_CONVERT
@@ -0,0 +1,153 @@
+/*
+ *  Copyright (C) [2019-2020] by Cambricon, Inc.
+ *
+ *  This file is part of CNStream-Gst.
+ *
+ *  CNStream-Gst is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU Lesser General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  CNStream-Gst is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU Lesser General Public License for more details.
+ *
+ *  You should have received a copy of the GNU Lesser General Public License
+ *  along with CNStream-Gst.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#include <gst/check/gstcheck.h>
+#include <unistd.h>
+
+#include "common/h26x_parser.h"
+
+// SPS of samples/data/videos/1080P.h264, main profile level 4.2, 1920x1080
+static const guint8 h264_sps[] = { 0x67, 0x4d, 0x00, 0x2a, 0x95, 0xa8, 0x1e, 0x00, 0x89, 0xf9, 0x50 };
+
+// main profile level 4, 1920x1080, 6 pictures in DPB
+static const guint8 h265_sps[] = { 0x42, 0x01, 0x01, 0x01, 0x60, 0x00, 0x00, 0x03, 0x00, 0x90, 0x00, 0x00, 0x03, 0x00,
+                                   0x00, 0x03, 0x00, 0x78, 0xa0, 0x03, 0xc0, 0x80, 0x10, 0xe5, 0x96, 0x66, 0x69, 0x24,
+                                   0xca, 0xe0, 0x10, 0x00, 0x00, 0x03, 0x00, 0x10, 0x00, 0x00, 0x03, 0x01, 0xe0, 0x80 };
+
+GST_START_TEST(test_bit_reader)
+{
+  const guint8 ue[] = { 0x08, 0x80 };
+  NalBitReader reader(ue, sizeof(ue));
+  fail_unless(reader.read_ue() == 16);
+  fail_unless(!reader.failed());
+  reader.read_bits(8);
+  fail_unless(reader.failed());
+
+  // codes 2 and 3 are 1 and -1
+  const guint8 se[] = { 0x4c };
+  NalBitReader se_reader(se, sizeof(se));
+  fail_unless(se_reader.read_se() == 1);
+  fail_unless(se_reader.read_se() == -1);
+
+  // emulation prevention byte is skipped
+  const guint8 escaped[] = { 0x00, 0x00, 0x03, 0x01 };
+  NalBitReader escaped_reader(escaped, sizeof(escaped));
+  fail_unless(escaped_reader.read_bits(24) == 0x000001);
+}
+GST_END_TEST;
+
+GST_START_TEST(test_split)
+{
+  const guint8 stream[] = { 0, 0, 0, 1, 0x67, 0x42, 0x00, 0x1e, 0, 0, 1, 0x68, 0xce, 0x3c, 0x80, 0, 0, 0, 1, 0x65, 0x88 };
+  auto units = split_annexb(stream, sizeof(stream));
+  fail_unless(units.size() == 3);
+  fail_unless(units[0].data[0] == 0x67 && units[0].size == 4);
+  // trailing zero before 4 bytes start code is not part of unit
+  fail_unless(units[1].data[0] == 0x68 && units[1].size == 4);
+  fail_unless(units[2].data[0] == 0x65 && units[2].size == 2);
+}
+GST_END_TEST;
+
+GST_START_TEST(test_parse_sps)
+{
+  H26xSequenceInfo info;
+  fail_unless(h264_parse_sps(h264_sps, sizeof(h264_sps), &info));
+  fail_unless(info.profile_idc == 77 && info.level_idc == 42);
+  fail_unless(info.chroma_format_idc == 1 && info.bit_depth_luma == 8 && info.bit_depth_chroma == 8);
+  fail_unless(info.width == 1920 && info.height == 1080);
+  // MaxDpbMbs 34816 of level 4.2 over 8160 macroblocks
+  fail_unless(info.dpb_size == 4);
+  // pictures are output in decoding order, POC type 2
+  fail_unless(info.num_reorder_frames == 0);
+
+  fail_unless(h265_parse_sps(h265_sps, sizeof(h265_sps), &info));
+  fail_unless(info.profile_idc == 1 && info.level_idc == 120);
+  fail_unless(info.width == 1920 && info.height == 1080);
+  fail_unless(info.bit_depth_luma == 8 && info.dpb_size == 6);
+  fail_unless(info.num_reorder_frames == 2);
+
+  // wrong codec or truncated
+  fail_unless(!h265_parse_sps(h264_sps, sizeof(h264_sps), &info));
+  fail_unless(!h264_parse_sps(h264_sps, 6, &info));
+}
+GST_END_TEST;
+
+// malformed units are rejected or parsed to bounded values, never read out of range
+GST_START_TEST(test_fuzz_sps)
+{
+  GRand* rand = g_rand_new_with_seed(2020);
+  guint8 data[64];
+  H26xSequenceInfo info;
+  for (guint n = 0; n < 100000; ++n) {
+    gsize size = g_rand_int_range(rand, 1, sizeof(data) + 1);
+    const guint8* seed = n % 2 ? h264_sps : h265_sps;
+    gsize seed_size = n % 2 ? sizeof(h264_sps) : sizeof(h265_sps);
+    for (gsize i = 0; i < size; ++i) {
+      // mutated copy of valid SPS half of the time, random bytes otherwise
+      data[i] = n % 4 < 2 && i < seed_size ? seed[i] ^ (g_rand_int_range(rand, 0, 8) ? 0 : g_rand_int(rand)) :
+                                              g_rand_int(rand);
+    }
+    bool parsed = n % 2 ? h264_parse_sps(data, size, &info) : h265_parse_sps(data, size, &info);
+    if (parsed) {
+      fail_unless(info.width > 0 && info.width <= 16888 && info.height > 0 && info.height <= 16888);
+      fail_unless(info.dpb_size <= 16 && info.num_reorder_frames <= info.dpb_size);
+    }
+  }
+  g_rand_free(rand);
+}
+GST_END_TEST;
+
+GST_START_TEST(test_parse_samples)
+{
+  const gchar* videos[] = { "1080P.h264", "1080p.h264" };
+  gchar current_path[128] = { 0 };
+  fail_unless(getcwd(current_path, sizeof(current_path) - 1));
+  for (auto video : videos) {
+    gchar* path = g_build_filename(current_path, "..", "samples", "data", "videos", video, NULL);
+    gchar* contents = nullptr;
+    gsize size = 0;
+    fail_unless(g_file_get_contents(path, &contents, &size, NULL));
+    g_free(path);
+
+    H26xSequenceInfo info;
+    gint64 start = g_get_monotonic_time();
+    fail_unless(h26x_find_sps(false, reinterpret_cast<guint8*>(contents), size, &info));
+    gint64 elapsed = MAX(g_get_monotonic_time() - start, 1);
+    fail_unless(info.width == 1920 && info.height == 1080 && info.dpb_size == 4);
+    GST_INFO("scan %s for SPS: %" G_GSIZE_FORMAT " bytes in %" G_GINT64_FORMAT " us, %.1f MB/s", video, size,
+             elapsed, (double)size / elapsed);
+    g_free(contents);
+  }
+}
+GST_END_TEST;
+
+Suite*
+h26x_parser_suite(void)
+{
+  Suite* s = suite_create("h26x_parser");
+  TCase* tc_chain = tcase_create("general");
+
+  suite_add_tcase(s, tc_chain);
+  tcase_add_test(tc_chain, test_bit_reader);
+  tcase_add_test(tc_chain, test_split);
+  tcase_add_test(tc_chain, test_parse_sps);
+  tcase_add_test(tc_chain, test_fuzz_sps);
+  tcase_add_test(tc_chain, test_parse_samples);
+  return s;
+}
@@ -1,8 +1,32 @@
 #include <gst/check/gstcheck.h>
 
+extern Suite*
+mlu_memory_pool_suite(void);
+
+extern Suite*
+mlu_allocator_suite(void);
+
+extern Suite*
+mlu_buffer_pool_suite(void);
+
+extern Suite*
+mlu_download_suite(void);
+
+extern Suite*
+h26x_parser_suite(void);
+
 #ifdef WITH_DECODE
 extern Suite*
 cnvideodec_suite(void);
+
+extern Suite*
+vpu_scheduler_suite(void);
+
+extern Suite*
+nal_parser_suite(void);
+
+extern Suite*
+cnmultidec_suite(void);
 #endif
 
 #ifdef WITH_ENCODE
@@ -13,6 +37,10 @@ cnvideoenc_suite(void);
 #ifdef WITH_CONVERT
 extern Suite*
 cnconvert_suite(void);
+extern Suite*
+cnbatchconvert_suite(void);
+extern Suite*
+cnmultiscale_suite(void);
 #endif
 
 int
@@ -22,10 +50,42 @@ main(int argc, char** argv)
 
   gst_check_init(&argc, &argv);
 
+  Suite* memory_pool;
+  memory_pool = mlu_memory_pool_suite();
+  ret += gst_check_run_suite(memory_pool, "mlu_memory_pool", __FILE__);
+
+  Suite* allocator;
+  allocator = mlu_allocator_suite();
+  ret += gst_check_run_suite(allocator, "mlu_allocator", __FILE__);
+
+  Suite* buffer_pool;
+  buffer_pool = mlu_buffer_pool_suite();
+  ret += gst_check_run_suite(buffer_pool, "mlu_buffer_pool", __FILE__);
+
+  Suite* download;
+  download = mlu_download_suite();
+  ret += gst_check_run_suite(download, "mlu_download", __FILE__);
+
+  Suite* h26x_parser;
+  h26x_parser = h26x_parser_suite();
+  ret += gst_check_run_suite(h26x_parser, "h26x_parser", __FILE__);
+
 #ifdef WITH_DECODE
   Suite *video_decode;
   video_decode = cnvideodec_suite();
   ret += gst_check_run_suite(video_decode, "cnvideo_dec", __FILE__);
+
+  Suite *vpu_scheduler;
+  vpu_scheduler = vpu_scheduler_suite();
+  ret += gst_check_run_suite(vpu_scheduler, "vpu_scheduler", __FILE__);
+
+  Suite *nal_parser;
+  nal_parser = nal_parser_suite();
+  ret += gst_check_run_suite(nal_parser, "nal_parser", __FILE__);
+
+  Suite *multidec;
+  multidec = cnmultidec_suite();
+  ret += gst_check_run_suite(multidec, "cnmultidec", __FILE__);
 #endif
 
 #ifdef WITH_ENCODE
@@ -38,6 +98,14 @@ main(int argc, char** argv)
   Suite *convert;
   convert = cnconvert_suite();
   ret += gst_check_run_suite(convert, "cnconvert", __FILE__);
+
+  Suite *batch_convert;
+  batch_convert = cnbatchconvert_suite();
+  ret += gst_check_run_suite(batch_convert, "cnbatchconvert", __FILE__);
+
+  Suite *multiscale;
+  multiscale = cnmultiscale_suite();
+  ret += gst_check_run_suite(multiscale, "cnmultiscale", __FILE__);
 #endif
 
   return ret;
@@ -0,0 +1,163 @@
+/*
+ *  Copyright (C) [2019-2020] by Cambricon, Inc.
+ *
+ *  This file is part of CNStream-Gst.
+ *
+ *  CNStream-Gst is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU Lesser General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  CNStream-Gst is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU Lesser General Public License for more details.
+ *
+ *  You should have received a copy of the GNU Lesser General Public License
+ *  along with CNStream-Gst.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#include <gst/check/gstcheck.h>
+#include <gst/video/video.h>
+#include <cstring>
+#include "common/frame_syncer.h"
+#include "common/gst_mlu_allocator.h"
+#include "common/mlu_memory_meta.h"
+
+static constexpr guint WIDTH = 64;
+static constexpr guint HEIGHT = 32;
+
+// data of frame is on host, so that no device access is required
+static GstMluFrame_t
+create_host_nv12_frame(guint8* y, guint8* uv)
+{
+  GstMluFrame_t frame = gst_mlu_frame_new();
+  frame->n_planes = 2;
+  frame->width = WIDTH;
+  frame->height = HEIGHT;
+  frame->stride[0] = frame->stride[1] = WIDTH;
+  frame->data[0] = cn_syncedmem_new(WIDTH * HEIGHT);
+  frame->data[1] = cn_syncedmem_new(WIDTH * HEIGHT / 2);
+  cn_syncedmem_set_host_data(frame->data[0], y);
+  cn_syncedmem_set_host_data(frame->data[1], uv);
+  return frame;
+}
+
+GST_START_TEST(test_map_memory)
+{
+  guint8 y[WIDTH * HEIGHT], uv[WIDTH * HEIGHT / 2];
+  memset(y, 1, sizeof(y));
+  memset(uv, 2, sizeof(uv));
+  GstMluFrame_t frame = create_host_nv12_frame(y, uv);
+
+  GstMemory* mem = gst_mlu_memory_new(frame, 1, sizeof(uv));
+  fail_unless(gst_is_mlu_memory(mem));
+  fail_unless(GST_MINI_OBJECT_REFCOUNT_VALUE(frame) == 2);
+
+  GstMapInfo info;
+  fail_unless(gst_memory_map(mem, &info, GST_MAP_READ));
+  fail_unless(info.data == uv && info.size == sizeof(uv));
+  fail_unless(GST_MLU_MEMORY_CAST(mem)->map_count == 1);
+  gst_memory_unmap(mem, &info);
+  fail_unless(GST_MLU_MEMORY_CAST(mem)->map_count == 0);
+
+  fail_unless(gst_memory_map(mem, &info, GST_MAP_WRITE));
+  fail_unless(cn_syncedmem_get_head(frame->data[1]) == GST_SYNCHEAD_AT_CPU);
+  gst_memory_unmap(mem, &info);
+
+  // shared memory refers to the same plane
+  GstMemory* sub = gst_memory_share(mem, 16, 16);
+  fail_unless(gst_is_mlu_memory(sub));
+  fail_unless(gst_memory_map(sub, &info, GST_MAP_READ));
+  fail_unless(info.data == uv + 16 && info.size == 16);
+  gst_memory_unmap(sub, &info);
+  gst_memory_unref(sub);
+
+  gst_memory_unref(mem);
+  fail_unless(GST_MINI_OBJECT_REFCOUNT_VALUE(frame) == 1);
+  gst_mlu_frame_unref(frame);
+}
+GST_END_TEST;
+
+GST_START_TEST(test_map_video_frame)
+{
+  guint8 y[WIDTH * HEIGHT], uv[WIDTH * HEIGHT / 2];
+  memset(y, 1, sizeof(y));
+  memset(uv, 2, sizeof(uv));
+  GstMluFrame_t frame = create_host_nv12_frame(y, uv);
+
+  GstVideoInfo info;
+  gst_video_info_set_format(&info, GST_VIDEO_FORMAT_NV12, WIDTH, HEIGHT);
+  fail_unless(gst_mlu_frame_match_video_info(frame, &info));
+
+  GstBuffer* buffer = gst_buffer_new();
+  gst_buffer_add_mlu_memory_meta(buffer, frame, "test");
+  fail_unless(gst_buffer_set_mlu_frame_memory(buffer, frame, &info));
+  fail_unless(gst_buffer_n_memory(buffer) == 2);
+  fail_unless(gst_buffer_get_size(buffer) == sizeof(y) + sizeof(uv));
+  fail_unless(gst_buffer_get_video_meta(buffer) != NULL);
+
+  GstVideoFrame video_frame;
+  fail_unless(gst_video_frame_map(&video_frame, &info, buffer, GST_MAP_READ));
+  fail_unless(GST_VIDEO_FRAME_PLANE_DATA(&video_frame, 0) == y);
+  fail_unless(GST_VIDEO_FRAME_PLANE_DATA(&video_frame, 1) == uv);
+  gst_video_frame_unmap(&video_frame);
+
+  // region copies keep the frame
+  GstBuffer* copy = gst_buffer_copy_region(buffer, GST_BUFFER_COPY_ALL, 0, sizeof(y));
+  MluMemoryMeta_t meta = gst_buffer_get_mlu_memory_meta(copy);
+  fail_unless(meta && meta->frame == frame);
+  gst_buffer_unref(copy);
+
+  gst_buffer_unref(buffer);
+}
+GST_END_TEST;
+
+struct CountingSyncer : public FrameSyncer
+{
+  explicit CountingSyncer(int* n)
+    : count(n)
+  {}
+  bool sync() override
+  {
+    ++*count;
+    return true;
+  }
+  int* count;
+};
+
+GST_START_TEST(test_map_syncs_frame)
+{
+  guint8 y[WIDTH * HEIGHT], uv[WIDTH * HEIGHT / 2];
+  GstMluFrame_t frame = create_host_nv12_frame(y, uv);
+  int n_sync = 0;
+  gst_mlu_frame_set_syncer(frame, new CountingSyncer(&n_sync));
+
+  // producer may be still writing frame, consumers wait for it before touching data
+  GstMemory* mem = gst_mlu_memory_new(frame, 0, sizeof(y));
+  GstMapInfo info;
+  fail_unless(gst_memory_map(mem, &info, GST_MAP_READ));
+  gst_memory_unmap(mem, &info);
+  fail_unless(n_sync == 1);
+  fail_unless(gst_mlu_frame_sync(frame));
+  fail_unless(n_sync == 2);
+  gst_memory_unref(mem);
+
+  // memory of frame is not released before producer is done
+  gst_mlu_frame_unref(frame);
+  fail_unless(n_sync == 3);
+}
+GST_END_TEST;
+
+Suite*
+mlu_allocator_suite(void)
+{
+  Suite* s = suite_create("mlu_allocator");
+  TCase* tc_chain = tcase_create("general");
+
+  suite_add_tcase(s, tc_chain);
+  tcase_add_test(tc_chain, test_map_memory);
+  tcase_add_test(tc_chain, test_map_video_frame);
+  tcase_add_test(tc_chain, test_map_syncs_frame);
+  return s;
+}
@@ -0,0 +1,106 @@
+/*
+ *  Copyright (C) [2019-2020] by Cambricon, Inc.
+ *
+ *  This file is part of CNStream-Gst.
+ *
+ *  CNStream-Gst is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU Lesser General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  CNStream-Gst is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU Lesser General Public License for more details.
+ *
+ *  You should have received a copy of the GNU Lesser General Public License
+ *  along with CNStream-Gst.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#include <gst/check/gstcheck.h>
+#include <gst/video/video.h>
+#include "common/gst_mlu_allocator.h"
+#include "common/gst_mlu_buffer_pool.h"
+#include "common/mlu_memory_meta.h"
+
+static GstBufferPool*
+create_pool(const gchar* caps_str, guint min_buffers, guint max_buffers)
+{
+  GstBufferPool* pool = gst_mlu_buffer_pool_new();
+  GstCaps* caps = gst_caps_from_string(caps_str);
+  GstStructure* config = gst_buffer_pool_get_config(pool);
+  gst_buffer_pool_config_set_params(config, caps, 0, min_buffers, max_buffers);
+  fail_unless(gst_buffer_pool_set_config(pool, config));
+  fail_unless(gst_buffer_pool_set_active(pool, TRUE));
+  gst_caps_unref(caps);
+  return pool;
+}
+
+GST_START_TEST(test_buffer_layout)
+{
+  GstBufferPool* pool = create_pool("video/x-raw(memory:mlu), format=NV12, width=1280, height=720", 2, 8);
+
+  GstBuffer* buffer = nullptr;
+  fail_unless(gst_buffer_pool_acquire_buffer(pool, &buffer, NULL) == GST_FLOW_OK);
+  MluMemoryMeta_t meta = gst_buffer_get_mlu_memory_meta(buffer);
+  fail_unless(meta && meta->frame);
+  fail_unless(meta->frame->n_planes == 2);
+  fail_unless(meta->frame->width == 1280 && meta->frame->height == 720);
+  fail_unless(gst_buffer_n_memory(buffer) == 2);
+  fail_unless(gst_is_mlu_memory(gst_buffer_peek_memory(buffer, 0)));
+  fail_unless(gst_buffer_get_size(buffer) == 1280 * 720 * 3 / 2);
+  fail_unless(gst_buffer_get_video_meta(buffer) != NULL);
+  gst_buffer_unref(buffer);
+
+  gst_buffer_pool_set_active(pool, FALSE);
+  gst_object_unref(pool);
+}
+GST_END_TEST;
+
+GST_START_TEST(test_steady_state)
+{
+  GstBufferPool* pool = create_pool("video/x-raw(memory:mlu), format=RGBA, width=320, height=240", 2, 4);
+  fail_unless(gst_mlu_buffer_pool_get_n_allocated(pool) == 2);
+
+  // buffers are recycled, no allocation after warm up
+  GstBuffer* buffers[3];
+  for (int i = 0; i < 100; ++i) {
+    for (auto& buffer : buffers) {
+      fail_unless(gst_buffer_pool_acquire_buffer(pool, &buffer, NULL) == GST_FLOW_OK);
+      GST_BUFFER_PTS(buffer) = i;
+    }
+    for (auto& buffer : buffers) {
+      gst_buffer_unref(buffer);
+    }
+  }
+  fail_unless(gst_mlu_buffer_pool_get_n_allocated(pool) == 3);
+
+  // pool is bounded by max buffers
+  GstBuffer* held[4];
+  for (auto& buffer : held) {
+    fail_unless(gst_buffer_pool_acquire_buffer(pool, &buffer, NULL) == GST_FLOW_OK);
+  }
+  GstBufferPoolAcquireParams params = { GST_FORMAT_UNDEFINED, 0, 0, GST_BUFFER_POOL_ACQUIRE_FLAG_DONTWAIT };
+  GstBuffer* extra = nullptr;
+  fail_unless(gst_buffer_pool_acquire_buffer(pool, &extra, &params) == GST_FLOW_EOS);
+  for (auto& buffer : held) {
+    gst_buffer_unref(buffer);
+  }
+  fail_unless(gst_mlu_buffer_pool_get_n_allocated(pool) == 4);
+
+  gst_buffer_pool_set_active(pool, FALSE);
+  gst_object_unref(pool);
+}
+GST_END_TEST;
+
+Suite*
+mlu_buffer_pool_suite(void)
+{
+  Suite* s = suite_create("mlu_buffer_pool");
+  TCase* tc_chain = tcase_create("general");
+
+  suite_add_tcase(s, tc_chain);
+  tcase_add_test(tc_chain, test_buffer_layout);
+  tcase_add_test(tc_chain, test_steady_state);
+  return s;
+}
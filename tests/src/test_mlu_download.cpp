@@ -0,0 +1,133 @@
+/*
+ *  Copyright (C) [2019-2020] by Cambricon, Inc.
+ *
+ *  This file is part of CNStream-Gst.
+ *
+ *  CNStream-Gst is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU Lesser General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  CNStream-Gst is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU Lesser General Public License for more details.
+ *
+ *  You should have received a copy of the GNU Lesser General Public License
+ *  along with CNStream-Gst.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#include <gst/check/gstcheck.h>
+#include <gst/video/video.h>
+#include "common/gst_mlu_download.h"
+#include "common/synced_memory.h"
+#include "device/mlu_context.h"
+
+static constexpr guint WIDTH = 4;
+static constexpr guint HEIGHT = 4;
+// planes on device are padded
+static constexpr guint STRIDE = 8;
+
+static inline guint8
+pixel(guint plane, guint row, guint col)
+{
+  return col < WIDTH ? plane * 64 + row * WIDTH + col : 0xFF;
+}
+
+// nv12 frame on device, pixels are numbered, padding is 0xFF
+static void
+upload_nv12(GstSyncedMemory_t mem[2], void* planes[2])
+{
+  edk::MluContext context;
+  context.SetDeviceId(0);
+  context.BindDevice();
+  for (guint p = 0; p < 2; ++p) {
+    guint rows = p == 0 ? HEIGHT : HEIGHT / 2;
+    mem[p] = cn_syncedmem_new(STRIDE * rows);
+    auto host = static_cast<guint8*>(cn_syncedmem_get_mutable_host_data(mem[p]));
+    for (guint r = 0; r < rows; ++r) {
+      for (guint c = 0; c < STRIDE; ++c) {
+        host[r * STRIDE + c] = pixel(p, r, c);
+      }
+    }
+    planes[p] = const_cast<void*>(cn_syncedmem_get_dev_data(mem[p]));
+  }
+}
+
+GST_START_TEST(test_download_strided)
+{
+  GstVideoInfo info;
+  gst_video_info_set_format(&info, GST_VIDEO_FORMAT_NV12, WIDTH, HEIGHT);
+  GstSyncedMemory_t mem[2];
+  void* planes[2];
+  guint strides[2] = { STRIDE, STRIDE };
+  upload_nv12(mem, planes);
+
+  GstBuffer* buffer = gst_mlu_download_frame(&info, planes, strides, TRUE);
+  fail_unless(buffer != NULL);
+  fail_unless(gst_buffer_get_size(buffer) == STRIDE * HEIGHT * 3 / 2);
+  GstVideoMeta* meta = gst_buffer_get_video_meta(buffer);
+  fail_unless(meta != NULL);
+  fail_unless(meta->stride[0] == (gint)STRIDE && meta->stride[1] == (gint)STRIDE);
+  fail_unless(meta->offset[0] == 0 && meta->offset[1] == STRIDE * HEIGHT);
+
+  GstVideoFrame frame;
+  fail_unless(gst_video_frame_map(&frame, &info, buffer, GST_MAP_READ));
+  for (guint p = 0; p < 2; ++p) {
+    auto data = static_cast<guint8*>(GST_VIDEO_FRAME_PLANE_DATA(&frame, p));
+    for (guint r = 0; r < (p == 0 ? HEIGHT : HEIGHT / 2); ++r) {
+      for (guint c = 0; c < WIDTH; ++c) {
+        fail_unless(data[r * GST_VIDEO_FRAME_PLANE_STRIDE(&frame, p) + c] == pixel(p, r, c));
+      }
+    }
+  }
+  gst_video_frame_unmap(&frame);
+  gst_buffer_unref(buffer);
+  cn_syncedmem_free(mem[0]);
+  cn_syncedmem_free(mem[1]);
+}
+GST_END_TEST;
+
+GST_START_TEST(test_download_packed)
+{
+  GstVideoInfo info;
+  gst_video_info_set_format(&info, GST_VIDEO_FORMAT_NV12, WIDTH, HEIGHT);
+  GstSyncedMemory_t mem[2];
+  void* planes[2];
+  guint strides[2] = { STRIDE, STRIDE };
+  upload_nv12(mem, planes);
+
+  // downstream without video meta sees default layout
+  GstBuffer* buffer = gst_mlu_download_frame(&info, planes, strides, FALSE);
+  fail_unless(buffer != NULL);
+  fail_unless(gst_buffer_get_video_meta(buffer) == NULL);
+  fail_unless(gst_buffer_get_size(buffer) == GST_VIDEO_INFO_SIZE(&info));
+
+  GstMapInfo map;
+  fail_unless(gst_buffer_map(buffer, &map, GST_MAP_READ));
+  for (guint p = 0; p < 2; ++p) {
+    guint8* data = map.data + GST_VIDEO_INFO_PLANE_OFFSET(&info, p);
+    for (guint r = 0; r < (p == 0 ? HEIGHT : HEIGHT / 2); ++r) {
+      for (guint c = 0; c < WIDTH; ++c) {
+        fail_unless(data[r * GST_VIDEO_INFO_PLANE_STRIDE(&info, p) + c] == pixel(p, r, c));
+      }
+    }
+  }
+  gst_buffer_unmap(buffer, &map);
+  gst_buffer_unref(buffer);
+  cn_syncedmem_free(mem[0]);
+  cn_syncedmem_free(mem[1]);
+}
+GST_END_TEST;
+
+Suite*
+mlu_download_suite(void)
+{
+  Suite* s = suite_create("mlu_download");
+  TCase* tc_chain = tcase_create("general");
+
+  suite_add_tcase(s, tc_chain);
+  tcase_add_test(tc_chain, test_download_strided);
+  tcase_add_test(tc_chain, test_download_packed);
+  return s;
+}
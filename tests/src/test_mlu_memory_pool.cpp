@@ -0,0 +1,140 @@
+/*
+ *  Copyright (C) [2019-2020] by Cambricon, Inc.
+ *
+ *  This file is part of CNStream-Gst.
+ *
+ *  CNStream-Gst is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU Lesser General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  CNStream-Gst is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU Lesser General Public License for more details.
+ *
+ *  You should have received a copy of the GNU Lesser General Public License
+ *  along with CNStream-Gst.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#include <gst/check/gstcheck.h>
+#include <memory>
+#include <vector>
+#include "common/mlu_memory_pool.h"
+
+static MluMemoryPool*
+create_host_pool(const MluMemoryPoolConfig& config = MluMemoryPoolConfig())
+{
+  return new MluMemoryPool(std::unique_ptr<MemoryPoolBackend>(new HostMemoryBackend), config);
+}
+
+GST_START_TEST(test_size_class)
+{
+  fail_unless(MluMemoryPool::size_class(1) == 4096);
+  fail_unless(MluMemoryPool::size_class(4096) == 4096);
+  fail_unless(MluMemoryPool::size_class(4097) == 5120);
+  fail_unless(MluMemoryPool::size_class(8192) == 8192);
+  // 1080p NV12
+  size_t size = 1920 * 1080 * 3 / 2;
+  size_t cls = MluMemoryPool::size_class(size);
+  fail_unless(cls >= size && cls - size <= size / 4);
+  // same class for close sizes, so frames of one stream always hit the same free list
+  fail_unless(MluMemoryPool::size_class(size - 64) == cls);
+}
+GST_END_TEST;
+
+GST_START_TEST(test_recycle)
+{
+  std::unique_ptr<MluMemoryPool> pool(create_host_pool());
+
+  void* ptr = pool->alloc(1920 * 1080 * 3 / 2);
+  fail_if(!ptr);
+  auto stats = pool->stats();
+  fail_unless(stats.misses == 1 && stats.hits == 0);
+  fail_unless(stats.in_use_bytes == MluMemoryPool::size_class(1920 * 1080 * 3 / 2));
+
+  fail_unless(pool->free(ptr));
+  stats = pool->stats();
+  fail_unless(stats.in_use_bytes == 0);
+  fail_unless(stats.cached_bytes == MluMemoryPool::size_class(1920 * 1080 * 3 / 2));
+
+  for (int i = 0; i < 100; ++i) {
+    void* reused = pool->alloc(1920 * 1080 * 3 / 2);
+    fail_unless(reused == ptr);
+    fail_unless(pool->free(reused));
+  }
+  stats = pool->stats();
+  fail_unless(stats.misses == 1 && stats.hits == 100);
+
+  // unknown pointer is not accepted
+  int dummy;
+  fail_if(pool->free(&dummy));
+}
+GST_END_TEST;
+
+GST_START_TEST(test_cache_limit)
+{
+  MluMemoryPoolConfig config;
+  config.max_cached_bytes = 3 * 4096;
+  config.max_block_size = 1 << 20;
+  std::unique_ptr<MluMemoryPool> pool(create_host_pool(config));
+
+  std::vector<void*> ptrs;
+  for (int i = 0; i < 5; ++i) {
+    ptrs.push_back(pool->alloc(4096));
+  }
+  for (auto ptr : ptrs) {
+    fail_unless(pool->free(ptr));
+  }
+  auto stats = pool->stats();
+  fail_unless(stats.cached_bytes == 3 * 4096);
+  fail_unless(stats.trimmed == 2);
+
+  // large block bypasses pool
+  void* large = pool->alloc(2 << 20);
+  fail_if(!large);
+  fail_unless(pool->stats().in_use_bytes == (2 << 20));
+  fail_unless(pool->free(large));
+  stats = pool->stats();
+  fail_unless(stats.in_use_bytes == 0);
+  fail_unless(stats.cached_bytes == 3 * 4096);
+
+  pool->trim(4096);
+  fail_unless(pool->stats().cached_bytes == 4096);
+  pool->trim();
+  fail_unless(pool->stats().cached_bytes == 0);
+}
+GST_END_TEST;
+
+GST_START_TEST(test_trim_idle)
+{
+  MluMemoryPoolConfig config;
+  config.idle_timeout_ms = 100;
+  std::unique_ptr<MluMemoryPool> pool(create_host_pool(config));
+
+  fail_unless(pool->free(pool->alloc(4096)));
+  fail_unless(pool->stats().cached_bytes == 4096);
+
+  // idle blocks are checked at most once per second
+  g_usleep(1100 * 1000);
+  void* ptr = pool->alloc(8192);
+  auto stats = pool->stats();
+  fail_unless(stats.cached_bytes == 0);
+  fail_unless(stats.trimmed == 1);
+  fail_unless(pool->free(ptr));
+}
+GST_END_TEST;
+
+Suite*
+mlu_memory_pool_suite(void)
+{
+  Suite* s = suite_create("mlu_memory_pool");
+  TCase* tc_chain = tcase_create("general");
+
+  suite_add_tcase(s, tc_chain);
+  tcase_add_test(tc_chain, test_size_class);
+  tcase_add_test(tc_chain, test_recycle);
+  tcase_add_test(tc_chain, test_cache_limit);
+  tcase_add_test(tc_chain, test_trim_idle);
+  return s;
+}
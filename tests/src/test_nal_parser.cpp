@@ -0,0 +1,94 @@
+/*
+ *  Copyright (C) [2019-2020] by Cambricon, Inc.
+ *
+ *  This file is part of CNStream-Gst.
+ *
+ *  CNStream-Gst is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU Lesser General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  CNStream-Gst is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU Lesser General Public License for more details.
+ *
+ *  You should have received a copy of the GNU Lesser General Public License
+ *  along with CNStream-Gst.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#ifdef WITH_DECODE
+
+#include <gst/check/gstcheck.h>
+
+#include "decode/nal_parser.h"
+
+// SPS, PPS, IDR, P, non-reference B and non-IDR I slices
+static const guint8 h264_stream[] = { 0, 0, 0, 1, 0x67, 0x42, 0x00, 0x1e, 0, 0, 1, 0x68, 0xce, 0x3c, 0x80,
+                                      0, 0, 1,    0x65, 0x88, 0x80, 0,    0, 1, 0x41, 0xc0, 0x80, 0,    0,
+                                      1, 0x01, 0xa0, 0x80, 0,    0,    1,    0x61, 0xb0, 0x80 };
+
+// VPS, SPS, PPS, IDR_W_RADL, TRAIL_R and TRAIL_N of temporal sub-layer 0
+static const guint8 h265_stream[] = { 0, 0, 0, 1, 0x40, 0x01, 0x0c, 0, 0, 1, 0x42, 0x01, 0x01, 0, 0, 1,
+                                      0x44, 0x01, 0xc1, 0, 0, 1, 0x26, 0x01, 0xaf, 0, 0, 1, 0x02, 0x01, 0xd0,
+                                      0,    0,    1,    0x00, 0x01, 0xd0 };
+
+static guint
+count_dropped(bool hevc, GstCnvideodecDecodeMode mode, const guint8* data, gsize size)
+{
+  NalFilter filter(hevc, mode);
+  std::vector<guint8> out;
+  guint dropped = filter.filter(data, size, &out);
+  fail_unless(split_annexb(out.data(), out.size()).size() + dropped == split_annexb(data, size).size());
+  return dropped;
+}
+
+GST_START_TEST(test_h264_filter)
+{
+  fail_unless(count_dropped(false, GST_CNVIDEODEC_DECODE_MODE_ALL, h264_stream, sizeof(h264_stream)) == 0);
+  // P and B slices
+  fail_unless(count_dropped(false, GST_CNVIDEODEC_DECODE_MODE_KEYFRAMES, h264_stream, sizeof(h264_stream)) == 2);
+  // B slice with nal_ref_idc 0
+  fail_unless(count_dropped(false, GST_CNVIDEODEC_DECODE_MODE_REFERENCE_ONLY, h264_stream, sizeof(h264_stream)) == 1);
+}
+GST_END_TEST;
+
+GST_START_TEST(test_h265_filter)
+{
+  fail_unless(count_dropped(true, GST_CNVIDEODEC_DECODE_MODE_KEYFRAMES, h265_stream, sizeof(h265_stream)) == 2);
+  fail_unless(count_dropped(true, GST_CNVIDEODEC_DECODE_MODE_REFERENCE_ONLY, h265_stream, sizeof(h265_stream)) == 1);
+
+  // TRAIL_N of sub-layer 0 may be referenced by sub-layer 1
+  const guint8 layered[] = { 0, 0, 1, 0x02, 0x02, 0xd0, 0, 0, 1, 0x00, 0x01, 0xd0 };
+  fail_unless(count_dropped(true, GST_CNVIDEODEC_DECODE_MODE_REFERENCE_ONLY, layered, sizeof(layered)) == 0);
+}
+GST_END_TEST;
+
+GST_START_TEST(test_has_slice)
+{
+  // parameter sets only
+  fail_unless(!annexb_has_slice(false, h264_stream, 15));
+  fail_unless(annexb_has_slice(false, h264_stream, sizeof(h264_stream)));
+  fail_unless(!annexb_has_slice(true, h265_stream, 19));
+  fail_unless(annexb_has_slice(true, h265_stream, sizeof(h265_stream)));
+
+  // not a byte stream, taken as a picture
+  const guint8 raw[] = { 0x65, 0x88, 0x80 };
+  fail_unless(annexb_has_slice(false, raw, sizeof(raw)));
+}
+GST_END_TEST;
+
+Suite*
+nal_parser_suite(void)
+{
+  Suite* s = suite_create("nal_parser");
+  TCase* tc_chain = tcase_create("general");
+
+  suite_add_tcase(s, tc_chain);
+  tcase_add_test(tc_chain, test_h264_filter);
+  tcase_add_test(tc_chain, test_h265_filter);
+  tcase_add_test(tc_chain, test_has_slice);
+  return s;
+}
+
+#endif
@@ -0,0 +1,100 @@
+/*
+ *  Copyright (C) [2019-2020] by Cambricon, Inc.
+ *
+ *  This file is part of CNStream-Gst.
+ *
+ *  CNStream-Gst is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU Lesser General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  CNStream-Gst is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU Lesser General Public License for more details.
+ *
+ *  You should have received a copy of the GNU Lesser General Public License
+ *  along with CNStream-Gst.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#ifdef WITH_DECODE
+
+#include <gst/check/gstcheck.h>
+
+#include "decode/vpu_scheduler.h"
+
+GST_START_TEST(test_balance)
+{
+  VpuScheduler scheduler(3);
+  fail_unless(scheduler.acquire(100) == 0);
+  fail_unless(scheduler.acquire(100) == 1);
+  fail_unless(scheduler.acquire(100) == 2);
+  fail_unless(scheduler.acquire(100) == 0);
+
+  auto loads = scheduler.loads();
+  fail_unless(loads.size() == 3);
+  fail_unless(loads[0].streams == 2 && loads[0].pixel_rate == 200);
+  fail_unless(loads[1].streams == 1 && loads[2].streams == 1);
+}
+GST_END_TEST;
+
+GST_START_TEST(test_release)
+{
+  VpuScheduler scheduler(3);
+  for (int i = 0; i < 6; ++i) {
+    scheduler.acquire(100);
+  }
+  // slot freed on teardown is taken by the next decoder
+  scheduler.release(1, 100);
+  fail_unless(scheduler.loads()[1].streams == 1);
+  fail_unless(scheduler.acquire(100) == 1);
+  fail_unless(scheduler.loads()[1].streams == 2);
+}
+GST_END_TEST;
+
+GST_START_TEST(test_pixel_rate)
+{
+  VpuScheduler scheduler(3);
+  // one 4k stream weighs more than several small ones
+  guint64 uhd = 3840ull * 2160 * 30, cif = 352ull * 288 * 30;
+  fail_unless(scheduler.acquire(uhd) == 0);
+  fail_unless(scheduler.acquire(cif) == 1);
+  fail_unless(scheduler.acquire(cif) == 2);
+  fail_unless(scheduler.acquire(cif) == 1);
+  fail_unless(scheduler.acquire(cif) == 2);
+  fail_unless(scheduler.loads()[0].streams == 1);
+}
+GST_END_TEST;
+
+GST_START_TEST(test_take)
+{
+  VpuScheduler scheduler(3);
+  fail_unless(scheduler.acquire(100) == 0);
+  // decoder bound to instance 2 is moved there, whatever the loads are
+  scheduler.release(0, 100);
+  scheduler.take(2, 100);
+  scheduler.take(2, 100);
+  auto loads = scheduler.loads();
+  fail_unless(loads[0].streams == 0 && loads[0].pixel_rate == 0);
+  fail_unless(loads[2].streams == 2 && loads[2].pixel_rate == 200);
+  // out of range is ignored
+  scheduler.take(3, 100);
+  fail_unless(scheduler.acquire(100) == 0);
+}
+GST_END_TEST;
+
+Suite*
+vpu_scheduler_suite(void)
+{
+  Suite* s = suite_create("vpu_scheduler");
+  TCase* tc_chain = tcase_create("general");
+
+  suite_add_tcase(s, tc_chain);
+  tcase_add_test(tc_chain, test_balance);
+  tcase_add_test(tc_chain, test_release);
+  tcase_add_test(tc_chain, test_pixel_rate);
+  tcase_add_test(tc_chain, test_take);
+  return s;
+}
+
+#endif